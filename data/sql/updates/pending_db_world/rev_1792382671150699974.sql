@@ -0,0 +1,5 @@
+INSERT INTO `version_db_world` (`sql_rev`) VALUES ('1792382671150699974');
+
+DELETE FROM `command` WHERE `name` = 'debug terrainbench';
+INSERT INTO `command` (`name`, `security`, `help`) VALUES
+('debug terrainbench', 3, 'Syntax: .debug terrainbench [#points]\r\n\r\nMeasures scalar and batched grid height and liquid level lookups on #points (default 100000) random positions around you.');
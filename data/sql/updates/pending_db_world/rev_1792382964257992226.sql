@@ -0,0 +1,5 @@
+INSERT INTO `version_db_world` (`sql_rev`) VALUES ('1792382964257992226');
+
+DELETE FROM `command` WHERE `name` = 'server memory';
+INSERT INTO `command` (`name`, `security`, `help`) VALUES
+('server memory', 3, 'Syntax: .server memory\r\n\r\nShows the memory held by terrain, vmap and mmap tiles of every map, the shared vmap models and the configured TileBudget.MemoryLimit.');
@@ -0,0 +1,5 @@
+INSERT INTO `version_db_world` (`sql_rev`) VALUES ('1792385055195409590');
+
+DELETE FROM `command` WHERE `name` = 'debug collisionbench';
+INSERT INTO `command` (`name`, `security`, `help`) VALUES
+('debug collisionbench', 3, 'Syntax: .debug collisionbench [#rays]\r\n\r\nMeasures vmap line of sight and height queries on random rays around you with the scalar and the SIMD collision kernel and reports the time taken and the number of differing results.');
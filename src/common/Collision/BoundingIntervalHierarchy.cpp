@@ -16,6 +16,7 @@
  */
 
 #include "BoundingIntervalHierarchy.h"
+#include "MappedFile.h"
 
 #ifdef _MSC_VER
 #define isnan _isnan
@@ -267,21 +268,28 @@ bool BIH::writeToFile(FILE* wf) const
     return check == (3 + 3 + 2 + treeSize + count);
 }
 
-bool BIH::readFromFile(FILE* rf)
+bool BIH::readFromFile(MappedFileReader& reader)
 {
-    uint32 treeSize;
+    uint32 treeSize = 0, count = 0;
     G3D::Vector3 lo, hi;
-    uint32 check = 0, count = 0;
-    check += fread(&lo, sizeof(float), 3, rf);
-    check += fread(&hi, sizeof(float), 3, rf);
+    if (!reader.Read(&lo, sizeof(float) * 3) || !reader.Read(&hi, sizeof(float) * 3) || !reader.Read(treeSize))
+        return false;
+
     bounds = G3D::AABox(lo, hi);
-    check += fread(&treeSize, sizeof(uint32), 1, rf);
+
+    // the tree is copied, the vmtree node chunk is not aligned
+    if (treeSize > reader.GetRemaining() / sizeof(uint32))
+        return false;
+
     tree.resize(treeSize);
-    check += fread(&tree[0], sizeof(uint32), treeSize, rf);
-    check += fread(&count, sizeof(uint32), 1, rf);
-    objects.resize(count); // = new uint32[nObjects];
-    check += fread(&objects[0], sizeof(uint32), count, rf);
-    return uint64(check) == uint64(3 + 3 + 1 + 1 + uint64(treeSize) + uint64(count));
+    if (treeSize && !reader.Read(&tree[0], sizeof(uint32) * treeSize))
+        return false;
+
+    if (!reader.Read(count) || count > reader.GetRemaining() / sizeof(uint32))
+        return false;
+
+    objects.resize(count);
+    return !count || reader.Read(&objects[0], sizeof(uint32) * count);
 }
 
 void BIH::BuildStats::updateLeaf(int depth, int n)
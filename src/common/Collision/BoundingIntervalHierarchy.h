@@ -28,11 +28,14 @@
 #include <vector>
 #include <algorithm>
 #include <limits>
+#include <utility>
 #include <cmath>
 #include "string.h"
 
 #define MAX_STACK_SIZE 64
 
+class MappedFileReader;
+
 // https://stackoverflow.com/a/4328396
 
 static inline uint32 floatToRawIntBits(float f)
@@ -112,6 +115,8 @@ public:
         delete[] dat.indices;
     }
     uint32 primCount() const { return objects.size(); }
+    std::size_t GetMemoryUsage() const { return (tree.capacity() + objects.capacity()) * sizeof(uint32); }
+    std::vector<uint32> const& getObjects() const { return objects; }
 
     template<typename RayCallback>
     void intersectRay(const G3D::Ray& r, RayCallback& intersectCallback, float& maxDist, bool stopAtFirstHit) const
@@ -215,13 +220,8 @@ public:
                     {
                         // leaf - test some objects
                         int n = tree[node + 1];
-                        while (n > 0)
-                        {
-                            bool hit = intersectCallback(r, objects[offset], maxDist, stopAtFirstHit);
-                            if (stopAtFirstHit && hit) return;
-                            --n;
-                            ++offset;
-                        }
+                        if (intersectLeaf(intersectCallback, r, uint32(offset), uint32(n), maxDist, stopAtFirstHit, 0) && stopAtFirstHit)
+                            return;
                         break;
                     }
                 }
@@ -335,9 +335,31 @@ public:
     }
 
     bool writeToFile(FILE* wf) const;
-    bool readFromFile(FILE* rf);
+    bool readFromFile(MappedFileReader& reader);
 
 protected:
+    // callbacks providing IntersectLeaf(ray, objects, first, count, maxDist, stopAtFirstHit) test a whole leaf at once
+    template<typename RayCallback>
+    auto intersectLeaf(RayCallback& intersectCallback, const G3D::Ray& r, uint32 first, uint32 count, float& maxDist, bool stopAtFirstHit, int) const
+        -> decltype(intersectCallback.IntersectLeaf(r, std::declval<std::vector<uint32> const&>(), first, count, maxDist, stopAtFirstHit))
+    {
+        return intersectCallback.IntersectLeaf(r, objects, first, count, maxDist, stopAtFirstHit);
+    }
+
+    template<typename RayCallback>
+    bool intersectLeaf(RayCallback& intersectCallback, const G3D::Ray& r, uint32 first, uint32 count, float& maxDist, bool stopAtFirstHit, long) const
+    {
+        bool result = false;
+        for (uint32 i = 0; i < count; ++i)
+        {
+            bool hit = intersectCallback(r, objects[first + i], maxDist, stopAtFirstHit);
+            if (stopAtFirstHit && hit)
+                return true;
+            result = result || hit;
+        }
+        return result;
+    }
+
     std::vector<uint32> tree;
     std::vector<uint32> objects;
     G3D::AABox bounds;
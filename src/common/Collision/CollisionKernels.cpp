@@ -0,0 +1,407 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "CollisionKernels.h"
+#include "WorldModel.h"
+#include "Errors.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define COLLISION_USE_SSE
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(_MSC_VER)
+#define COLLISION_USE_AVX2
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(COLLISION_USE_AVX2) && defined(__GNUC__)
+#define COLLISION_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define COLLISION_TARGET_AVX2
+#endif
+
+namespace
+{
+    // same threshold as the scalar test in WorldModel.cpp
+    constexpr float TRIANGLE_EPS = 1e-5f;
+    constexpr float BOX_MARGIN = 0.01f;
+    constexpr uint32 PACKET_PADDING = 8;
+
+    enum PacketArray
+    {
+        V0X, V0Y, V0Z,
+        E1X, E1Y, E1Z,
+        E2X, E2Y, E2Z,
+        PACKET_ARRAYS
+    };
+
+    VMAP::CollisionKernel DetectCollisionKernel()
+    {
+#if defined(COLLISION_USE_AVX2) && defined(__GNUC__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return VMAP::COLLISION_KERNEL_AVX2;
+#elif defined(COLLISION_USE_AVX2) && defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] >= 7)
+        {
+            __cpuid(info, 1);
+            bool osxsave = (info[2] & (1 << 27)) != 0;
+            bool avx = (info[2] & (1 << 28)) != 0;
+            __cpuidex(info, 7, 0);
+            bool avx2 = (info[1] & (1 << 5)) != 0;
+            // the os has to save the ymm registers as well
+            if (osxsave && avx && avx2 && (_xgetbv(0) & 6) == 6)
+                return VMAP::COLLISION_KERNEL_AVX2;
+        }
+#endif
+
+#ifdef COLLISION_USE_SSE
+        return VMAP::COLLISION_KERNEL_SSE;
+#else
+        return VMAP::COLLISION_KERNEL_SCALAR;
+#endif
+    }
+
+    VMAP::CollisionKernel const BestCollisionKernel = DetectCollisionKernel();
+    std::atomic<uint8> SelectedCollisionKernel(BestCollisionKernel);
+    // set by CollisionKernelScope, -1 if the thread uses SelectedCollisionKernel
+    thread_local int16 ThreadCollisionKernel = -1;
+
+#ifdef COLLISION_USE_SSE
+    bool IntersectPacketSSE(float const* data, uint32 stride, G3D::Ray const& ray, uint32 first, uint32 count, float& distance)
+    {
+        __m128 const zero = _mm_setzero_ps();
+        __m128 const one = _mm_set1_ps(1.0f);
+        __m128 const eps = _mm_set1_ps(TRIANGLE_EPS);
+        __m128 const absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+        __m128 const dx = _mm_set1_ps(ray.direction().x);
+        __m128 const dy = _mm_set1_ps(ray.direction().y);
+        __m128 const dz = _mm_set1_ps(ray.direction().z);
+        __m128 const ox = _mm_set1_ps(ray.origin().x);
+        __m128 const oy = _mm_set1_ps(ray.origin().y);
+        __m128 const oz = _mm_set1_ps(ray.origin().z);
+
+        __m128 const maxDist = _mm_set1_ps(distance);
+        __m128 best = maxDist;
+
+        uint32 end = first + count;
+        for (uint32 i = first; i < end; i += 4)
+        {
+            __m128 v0x = _mm_loadu_ps(data + V0X * stride + i);
+            __m128 v0y = _mm_loadu_ps(data + V0Y * stride + i);
+            __m128 v0z = _mm_loadu_ps(data + V0Z * stride + i);
+            __m128 e1x = _mm_loadu_ps(data + E1X * stride + i);
+            __m128 e1y = _mm_loadu_ps(data + E1Y * stride + i);
+            __m128 e1z = _mm_loadu_ps(data + E1Z * stride + i);
+            __m128 e2x = _mm_loadu_ps(data + E2X * stride + i);
+            __m128 e2y = _mm_loadu_ps(data + E2Y * stride + i);
+            __m128 e2z = _mm_loadu_ps(data + E2Z * stride + i);
+
+            // p = dir x e2, a = e1 . p
+            __m128 px = _mm_sub_ps(_mm_mul_ps(dy, e2z), _mm_mul_ps(dz, e2y));
+            __m128 py = _mm_sub_ps(_mm_mul_ps(dz, e2x), _mm_mul_ps(dx, e2z));
+            __m128 pz = _mm_sub_ps(_mm_mul_ps(dx, e2y), _mm_mul_ps(dy, e2x));
+            __m128 a = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1x, px), _mm_mul_ps(e1y, py)), _mm_mul_ps(e1z, pz));
+
+            // the scalar test only rejects on true comparisons, nan passes them the same way here
+            __m128 valid = _mm_cmpnlt_ps(_mm_and_ps(a, absMask), eps);
+
+            __m128 f = _mm_div_ps(one, a);
+            __m128 sx = _mm_sub_ps(ox, v0x);
+            __m128 sy = _mm_sub_ps(oy, v0y);
+            __m128 sz = _mm_sub_ps(oz, v0z);
+            __m128 u = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(sx, px), _mm_mul_ps(sy, py)), _mm_mul_ps(sz, pz)));
+            valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpnlt_ps(u, zero), _mm_cmpngt_ps(u, one)));
+
+            // q = s x e1
+            __m128 qx = _mm_sub_ps(_mm_mul_ps(sy, e1z), _mm_mul_ps(sz, e1y));
+            __m128 qy = _mm_sub_ps(_mm_mul_ps(sz, e1x), _mm_mul_ps(sx, e1z));
+            __m128 qz = _mm_sub_ps(_mm_mul_ps(sx, e1y), _mm_mul_ps(sy, e1x));
+            __m128 v = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, qx), _mm_mul_ps(dy, qy)), _mm_mul_ps(dz, qz)));
+            valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpnlt_ps(v, zero), _mm_cmpngt_ps(_mm_add_ps(u, v), one)));
+
+            __m128 t = _mm_mul_ps(f, _mm_add_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_mul_ps(e2y, qy)), _mm_mul_ps(e2z, qz)));
+            valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpgt_ps(t, zero), _mm_cmplt_ps(t, best)));
+
+            // lanes past the leaf belong to the next one
+            uint32 remaining = end - i;
+            if (remaining < 4)
+            {
+                static int32 const laneMasks[8] = { -1, -1, -1, -1, 0, 0, 0, 0 };
+                valid = _mm_and_ps(valid, _mm_loadu_ps(reinterpret_cast<float const*>(laneMasks + 4 - remaining)));
+            }
+
+            best = _mm_or_ps(_mm_and_ps(valid, t), _mm_andnot_ps(valid, best));
+        }
+
+        // horizontal minimum
+        best = _mm_min_ps(best, _mm_shuffle_ps(best, best, _MM_SHUFFLE(2, 3, 0, 1)));
+        best = _mm_min_ps(best, _mm_shuffle_ps(best, best, _MM_SHUFFLE(1, 0, 3, 2)));
+
+        float result = _mm_cvtss_f32(best);
+        if (!(result < distance))
+            return false;
+
+        distance = result;
+        return true;
+    }
+#endif
+
+#ifdef COLLISION_USE_AVX2
+    COLLISION_TARGET_AVX2 bool IntersectPacketAVX2(float const* data, uint32 stride, G3D::Ray const& ray, uint32 first, uint32 count, float& distance)
+    {
+        __m256 const zero = _mm256_setzero_ps();
+        __m256 const one = _mm256_set1_ps(1.0f);
+        __m256 const eps = _mm256_set1_ps(TRIANGLE_EPS);
+        __m256 const absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+
+        __m256 const dx = _mm256_set1_ps(ray.direction().x);
+        __m256 const dy = _mm256_set1_ps(ray.direction().y);
+        __m256 const dz = _mm256_set1_ps(ray.direction().z);
+        __m256 const ox = _mm256_set1_ps(ray.origin().x);
+        __m256 const oy = _mm256_set1_ps(ray.origin().y);
+        __m256 const oz = _mm256_set1_ps(ray.origin().z);
+
+        __m256 best = _mm256_set1_ps(distance);
+
+        uint32 end = first + count;
+        for (uint32 i = first; i < end; i += 8)
+        {
+            __m256 v0x = _mm256_loadu_ps(data + V0X * stride + i);
+            __m256 v0y = _mm256_loadu_ps(data + V0Y * stride + i);
+            __m256 v0z = _mm256_loadu_ps(data + V0Z * stride + i);
+            __m256 e1x = _mm256_loadu_ps(data + E1X * stride + i);
+            __m256 e1y = _mm256_loadu_ps(data + E1Y * stride + i);
+            __m256 e1z = _mm256_loadu_ps(data + E1Z * stride + i);
+            __m256 e2x = _mm256_loadu_ps(data + E2X * stride + i);
+            __m256 e2y = _mm256_loadu_ps(data + E2Y * stride + i);
+            __m256 e2z = _mm256_loadu_ps(data + E2Z * stride + i);
+
+            __m256 px = _mm256_sub_ps(_mm256_mul_ps(dy, e2z), _mm256_mul_ps(dz, e2y));
+            __m256 py = _mm256_sub_ps(_mm256_mul_ps(dz, e2x), _mm256_mul_ps(dx, e2z));
+            __m256 pz = _mm256_sub_ps(_mm256_mul_ps(dx, e2y), _mm256_mul_ps(dy, e2x));
+            __m256 a = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e1x, px), _mm256_mul_ps(e1y, py)), _mm256_mul_ps(e1z, pz));
+
+            __m256 valid = _mm256_cmp_ps(_mm256_and_ps(a, absMask), eps, _CMP_NLT_UQ);
+
+            __m256 f = _mm256_div_ps(one, a);
+            __m256 sx = _mm256_sub_ps(ox, v0x);
+            __m256 sy = _mm256_sub_ps(oy, v0y);
+            __m256 sz = _mm256_sub_ps(oz, v0z);
+            __m256 u = _mm256_mul_ps(f, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(sx, px), _mm256_mul_ps(sy, py)), _mm256_mul_ps(sz, pz)));
+            valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_NLT_UQ), _mm256_cmp_ps(u, one, _CMP_NGT_UQ)));
+
+            __m256 qx = _mm256_sub_ps(_mm256_mul_ps(sy, e1z), _mm256_mul_ps(sz, e1y));
+            __m256 qy = _mm256_sub_ps(_mm256_mul_ps(sz, e1x), _mm256_mul_ps(sx, e1z));
+            __m256 qz = _mm256_sub_ps(_mm256_mul_ps(sx, e1y), _mm256_mul_ps(sy, e1x));
+            __m256 v = _mm256_mul_ps(f, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, qx), _mm256_mul_ps(dy, qy)), _mm256_mul_ps(dz, qz)));
+            valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(v, zero, _CMP_NLT_UQ), _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_NGT_UQ)));
+
+            __m256 t = _mm256_mul_ps(f, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(e2x, qx), _mm256_mul_ps(e2y, qy)), _mm256_mul_ps(e2z, qz)));
+            valid = _mm256_and_ps(valid, _mm256_and_ps(_mm256_cmp_ps(t, zero, _CMP_GT_OQ), _mm256_cmp_ps(t, best, _CMP_LT_OQ)));
+
+            uint32 remaining = end - i;
+            if (remaining < 8)
+            {
+                static int32 const laneMasks[16] = { -1, -1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0 };
+                valid = _mm256_and_ps(valid, _mm256_loadu_ps(reinterpret_cast<float const*>(laneMasks + 8 - remaining)));
+            }
+
+            best = _mm256_blendv_ps(best, t, valid);
+        }
+
+        __m128 low = _mm_min_ps(_mm256_castps256_ps128(best), _mm256_extractf128_ps(best, 1));
+        low = _mm_min_ps(low, _mm_shuffle_ps(low, low, _MM_SHUFFLE(2, 3, 0, 1)));
+        low = _mm_min_ps(low, _mm_shuffle_ps(low, low, _MM_SHUFFLE(1, 0, 3, 2)));
+
+        float result = _mm_cvtss_f32(low);
+        if (!(result < distance))
+            return false;
+
+        distance = result;
+        return true;
+    }
+#endif
+}
+
+namespace VMAP
+{
+    CollisionKernel GetBestCollisionKernel()
+    {
+        return BestCollisionKernel;
+    }
+
+    CollisionKernel GetCollisionKernel()
+    {
+        if (ThreadCollisionKernel >= 0)
+            return CollisionKernel(ThreadCollisionKernel);
+
+        return CollisionKernel(SelectedCollisionKernel.load(std::memory_order_relaxed));
+    }
+
+    void SetCollisionKernel(CollisionKernel kernel)
+    {
+        SelectedCollisionKernel.store(uint8(std::min(kernel, BestCollisionKernel)), std::memory_order_relaxed);
+    }
+
+    CollisionKernelScope::CollisionKernelScope(CollisionKernel kernel) : _previous(ThreadCollisionKernel)
+    {
+        ThreadCollisionKernel = int16(std::min(kernel, BestCollisionKernel));
+    }
+
+    CollisionKernelScope::~CollisionKernelScope()
+    {
+        ThreadCollisionKernel = _previous;
+    }
+
+    char const* GetCollisionKernelName(CollisionKernel kernel)
+    {
+        switch (kernel)
+        {
+            case COLLISION_KERNEL_SSE:
+                return "SSE";
+            case COLLISION_KERNEL_AVX2:
+                return "AVX2";
+            default:
+                return "scalar";
+        }
+    }
+
+    bool IntersectRayAABox(G3D::Ray const& ray, G3D::AABox const& box, float maxDist)
+    {
+        float tNear = 0.0f;
+        float tFar = maxDist;
+
+        for (int i = 0; i < 3; ++i)
+        {
+            float origin = ray.origin()[i];
+            float direction = ray.direction()[i];
+            float low = box.low()[i] - BOX_MARGIN;
+            float high = box.high()[i] + BOX_MARGIN;
+
+            if (direction == 0.0f)
+            {
+                // parallel to the slab
+                if (origin < low || origin > high)
+                    return false;
+
+                continue;
+            }
+
+            float invDir = 1.0f / direction;
+            float t1 = (low - origin) * invDir;
+            float t2 = (high - origin) * invDir;
+            if (t1 > t2)
+                std::swap(t1, t2);
+
+            // written so nan keeps the interval open
+            if (t1 > tNear)
+                tNear = t1;
+            if (t2 < tFar)
+                tFar = t2;
+
+            if (tNear > tFar)
+                return false;
+        }
+
+        return true;
+    }
+
+    void TrianglePacket::Build(G3D::Vector3 const* vertices, uint32 vertexCount, MeshTriangle const* triangles, uint32 triangleCount, std::vector<uint32> const& order)
+    {
+        Clear();
+
+        if (order.empty() || GetCollisionKernel() == COLLISION_KERNEL_SCALAR)
+            return;
+
+        // room for a full step past the last position
+        _stride = uint32(order.size() + PACKET_PADDING);
+        _data.assign(std::size_t(_stride) * PACKET_ARRAYS, 0.0f);
+
+        for (uint32 i = 0; i < order.size(); ++i)
+        {
+            if (order[i] >= triangleCount)
+            {
+                Clear();
+                return;
+            }
+
+            MeshTriangle const& tri = triangles[order[i]];
+            if (tri.idx0 >= vertexCount || tri.idx1 >= vertexCount || tri.idx2 >= vertexCount)
+            {
+                Clear();
+                return;
+            }
+
+            // same operations as the scalar test, so both see bit identical edges
+            G3D::Vector3 const& v0 = vertices[tri.idx0];
+            G3D::Vector3 const e1 = vertices[tri.idx1] - v0;
+            G3D::Vector3 const e2 = vertices[tri.idx2] - v0;
+
+            _data[V0X * _stride + i] = v0.x;
+            _data[V0Y * _stride + i] = v0.y;
+            _data[V0Z * _stride + i] = v0.z;
+            _data[E1X * _stride + i] = e1.x;
+            _data[E1Y * _stride + i] = e1.y;
+            _data[E1Z * _stride + i] = e1.z;
+            _data[E2X * _stride + i] = e2.x;
+            _data[E2Y * _stride + i] = e2.y;
+            _data[E2Z * _stride + i] = e2.z;
+        }
+    }
+
+    void TrianglePacket::Clear()
+    {
+        std::vector<float>().swap(_data);
+        _stride = 0;
+    }
+
+    bool TrianglePacket::IntersectRay(G3D::Ray const& ray, uint32 first, uint32 count, float& distance, CollisionKernel kernel) const
+    {
+        switch (kernel)
+        {
+#ifdef COLLISION_USE_AVX2
+            case COLLISION_KERNEL_AVX2:
+                // a leaf rarely holds more than a few triangles, half empty 8 wide steps are not worth it
+                if (count > 4)
+                    return IntersectPacketAVX2(_data.data(), _stride, ray, first, count, distance);
+                [[fallthrough]];
+#endif
+#ifdef COLLISION_USE_SSE
+            case COLLISION_KERNEL_SSE:
+                return IntersectPacketSSE(_data.data(), _stride, ray, first, count, distance);
+#endif
+            default:
+                break;
+        }
+
+        // callers keep the scalar kernel for themselves
+        ASSERT(false, "TrianglePacket::IntersectRay called with the scalar kernel");
+        return false;
+    }
+}
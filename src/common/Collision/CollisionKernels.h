@@ -0,0 +1,92 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _COLLISION_KERNELS_H
+#define _COLLISION_KERNELS_H
+
+#include "Define.h"
+#include <G3D/AABox.h>
+#include <G3D/Ray.h>
+#include <G3D/Vector3.h>
+#include <vector>
+
+namespace VMAP
+{
+    class MeshTriangle;
+
+    enum CollisionKernel : uint8
+    {
+        COLLISION_KERNEL_SCALAR = 0,                        // one triangle at a time, no packet data
+        COLLISION_KERNEL_SSE    = 1,                        // 4 triangles per step
+        COLLISION_KERNEL_AVX2   = 2                         // 8 triangles per step, picked at runtime
+    };
+
+    // best kernel the cpu supports
+    WH_COMMON_API CollisionKernel GetBestCollisionKernel();
+    WH_COMMON_API CollisionKernel GetCollisionKernel();
+    // clamped to what the cpu supports. Models only get packet data while a SIMD kernel is
+    // selected, so pick the kernel before any vmap is loaded
+    WH_COMMON_API void SetCollisionKernel(CollisionKernel kernel);
+    WH_COMMON_API char const* GetCollisionKernelName(CollisionKernel kernel);
+
+    // Replaces the kernel for the queries of the calling thread while in scope, other threads keep
+    // using the selected one. Lets a benchmark compare kernels without changing the server wide setting
+    class WH_COMMON_API CollisionKernelScope
+    {
+    public:
+        explicit CollisionKernelScope(CollisionKernel kernel);
+        ~CollisionKernelScope();
+
+        CollisionKernelScope(CollisionKernelScope const&) = delete;
+        CollisionKernelScope& operator=(CollisionKernelScope const&) = delete;
+
+    private:
+        int16 _previous;
+    };
+
+    // Slab test of a ray against a box. Returns false if the box is missed or only hit beyond maxDist.
+    // Conservative: the box is widened slightly so grazing rays are never rejected
+    WH_COMMON_API bool IntersectRayAABox(G3D::Ray const& ray, G3D::AABox const& box, float maxDist);
+
+    // Triangles of a mesh in BIH leaf order as structure of arrays (first vertex and both edges),
+    // so a leaf of the mesh tree is tested with a few SIMD steps instead of one triangle at a time.
+    // Same results as the scalar Moeller-Trumbore test used before.
+    class WH_COMMON_API TrianglePacket
+    {
+    public:
+        TrianglePacket() : _stride(0) { }
+
+        // order holds the triangle index for every position, the object list of the BIH
+        void Build(G3D::Vector3 const* vertices, uint32 vertexCount, MeshTriangle const* triangles, uint32 triangleCount, std::vector<uint32> const& order);
+        void Clear();
+
+        bool IsEmpty() const { return _data.empty(); }
+
+        // Tests the triangles at positions [first, first + count) with a SIMD kernel,
+        // shortens distance and returns true on a closer hit
+        bool IntersectRay(G3D::Ray const& ray, uint32 first, uint32 count, float& distance, CollisionKernel kernel) const;
+
+        std::size_t GetMemoryUsage() const { return _data.capacity() * sizeof(float); }
+
+    private:
+        std::vector<float> _data;                           // v0.x, v0.y, v0.z, e1.x ... e2.z arrays of _stride floats
+        uint32 _stride;
+    };
+}
+
+#endif
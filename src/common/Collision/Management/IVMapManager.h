@@ -59,6 +59,19 @@ namespace VMAP
         virtual void unloadMap(unsigned int pMapId, int x, int y) = 0;
         virtual void unloadMap(unsigned int pMapId) = 0;
 
+        /**
+        Thread safe. Loads the models used by a tile ahead of time, so the following loadMap for it
+        only has to link them into the map tree. discardPreloadedMap drops a preload that was not used
+        */
+        virtual void preloadMap(const char* pBasePath, unsigned int pMapId, int x, int y) = 0;
+        virtual void discardPreloadedMap(unsigned int pMapId, int x, int y) = 0;
+
+        /**
+        Memory used by the collision tree of a map and by all loaded models (shared by all maps)
+        */
+        virtual std::size_t getMapMemoryUsage(unsigned int pMapId) const = 0;
+        virtual std::size_t getModelMemoryUsage() = 0;
+
         virtual bool isInLineOfSight(unsigned int pMapId, float x1, float y1, float z1, float x2, float y2, float z2) = 0;
         virtual float getHeight(unsigned int pMapId, float x, float y, float z, float maxSearchDist) = 0;
         /**
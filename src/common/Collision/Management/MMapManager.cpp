@@ -18,9 +18,12 @@
 #include "MMapManager.h"
 #include "Config.h"
 #include "MapDefines.h"
+#include "MappedFile.h"
 #include "Log.h"
 #include "StringFormat.h"
 #include "Errors.h"
+#include "Timer.h"
+#include <algorithm>
 
 namespace MMAP
 {
@@ -33,6 +36,9 @@ namespace MMAP
         for (MMapDataSet::iterator i = loadedMMaps.begin(); i != loadedMMaps.end(); ++i)
             delete i->second;
 
+        for (PreloadedTileSet::iterator i = preloadedTiles.begin(); i != preloadedTiles.end(); ++i)
+            dtFree(i->second.data);
+
         // by now we should not have maps loaded
         // if we had, tiles in MMapData->loadedTileRefs, their actual data is lost!
     }
@@ -46,6 +52,15 @@ namespace MMAP
         thread_safe_environment = false;
     }
 
+    std::string MMapManager::getDataDir() const
+    {
+        // tools have no config to read from
+        if (!dataDir.empty())
+            return dataDir;
+
+        return sConfigMgr->GetStringDefault("DataDir", ".");
+    }
+
     MMapDataSet::const_iterator MMapManager::GetMMapData(uint32 mapId) const
     {
         // return the iterator if found or end() if not found/NULL
@@ -74,18 +89,17 @@ namespace MMAP
         }
 
         // load and init dtNavMesh - read parameters from file
-        std::string fileName = Warhead::StringFormat(MAP_FILE_NAME_FORMAT, sConfigMgr->GetStringDefault("DataDir", ".").c_str(), mapId);
-        FILE* file = fopen(fileName.c_str(), "rb");
-        if (!file)
+        std::string fileName = Warhead::StringFormat(MAP_FILE_NAME_FORMAT, getDataDir().c_str(), mapId);
+        MappedFile file;
+        if (!file.Open(fileName))
         {
             LOG_DEBUG("maps", "MMAP:loadMapData: Error: Could not open mmap file '%s'", fileName.c_str());
             return false;
         }
 
         dtNavMeshParams params;
-        uint32 count = uint32(fread(&params, sizeof(dtNavMeshParams), 1, file));
-        fclose(file);
-        if (count != 1)
+        MappedFileReader reader(file);
+        if (!reader.Read(params))
         {
             LOG_DEBUG("maps", "MMAP:loadMapData: Error: Could not read params from file '%s'", fileName.c_str());
             return false;
@@ -109,7 +123,7 @@ namespace MMAP
         return true;
     }
 
-    uint32 MMapManager::packTileID(int32 x, int32 y)
+    uint32 MMapManager::packTileID(int32 x, int32 y) const
     {
         return uint32(x << 16 | y);
     }
@@ -126,27 +140,85 @@ namespace MMAP
 
         // check if we already have this tile loaded
         uint32 packedGridPos = packTileID(x, y);
-        if (mmap->loadedTileRefs.find(packedGridPos) != mmap->loadedTileRefs.end())
+        MMapTileSet::iterator tileItr = mmap->loadedTileRefs.find(packedGridPos);
+        if (tileItr != mmap->loadedTileRefs.end())
+        {
+            if (tileItr->second.refCount)
+            {
+                LOG_ERROR("maps", "MMAP:loadMap: Asked to load already loaded navmesh tile. %03u%02i%02i.mmtile", mapId, x, y);
+                return false;
+            }
+
+            // still cached from an earlier use, the data read ahead is not needed
+            ++tileItr->second.refCount;
+            ++tileCacheHits;
+            discardPreloadedMap(mapId, x, y);
+            LOG_DEBUG("maps", "MMAP:loadMap: Reused cached mmtile %03i[%02i,%02i]", mapId, x, y);
+            return true;
+        }
+
+        PreloadedTile tile;
+
+        // a background thread may have read the file already
+        {
+            std::lock_guard<std::mutex> lock(preloadedTilesLock);
+            PreloadedTileSet::iterator preloaded = preloadedTiles.find(packPreloadedTileID(mapId, x, y));
+            if (preloaded != preloadedTiles.end())
+            {
+                tile = preloaded->second;
+                preloadedTiles.erase(preloaded);
+            }
+            else
+                tile.data = nullptr;
+        }
+
+        if (!tile.data && !readTileData(mapId, x, y, tile))
+            return false;
+
+        unsigned char* data = tile.data;
+
+        dtTileRef tileRef = 0;
+
+        std::lock_guard<std::mutex> writerGuard(mmap->navMeshWriterLock);
+        std::unique_lock<std::shared_mutex> navMeshGuard(mmap->navMeshLock);
+
+        // memory allocated for data is now managed by detour, and will be deallocated when the tile is removed
+        if (dtStatusSucceed(mmap->navMesh->addTile(data, tile.size, DT_TILE_FREE_DATA, 0, &tileRef)))
+        {
+            mmap->loadedTileRefs.insert(MMapTileSet::value_type(packedGridPos, MMapTile{ tileRef, tile.size, 1, 0 }));
+            ++loadedTiles;
+            ++tileCacheMisses;
+            residentTileMemory += tile.size;
+            dtMeshHeader* header = (dtMeshHeader*)data;
+            LOG_DEBUG("maps", "MMAP:loadMap: Loaded mmtile %03i[%02i,%02i] into %03i[%02i,%02i]", mapId, x, y, mapId, header->x, header->y);
+            return true;
+        }
+        else
         {
-            LOG_ERROR("maps", "MMAP:loadMap: Asked to load already loaded navmesh tile. %03u%02i%02i.mmtile", mapId, x, y);
+            LOG_ERROR("maps", "MMAP:loadMap: Could not load %03u%02i%02i.mmtile into navmesh", mapId, x, y);
+            dtFree(data);
             return false;
         }
+    }
 
+    bool MMapManager::readTileData(uint32 mapId, int32 x, int32 y, PreloadedTile& tile)
+    {
         // load this tile :: mmaps/MMMXXYY.mmtile
-        std::string fileName = Warhead::StringFormat(TILE_FILE_NAME_FORMAT, sConfigMgr->GetStringDefault("DataDir", ".").c_str(), mapId, x, y);
-        FILE* file = fopen(fileName.c_str(), "rb");
-        if (!file)
+        std::string fileName = Warhead::StringFormat(TILE_FILE_NAME_FORMAT, getDataDir().c_str(), mapId, x, y);
+        // compressed tiles are decompressed by MappedFile
+        MappedFile file;
+        if (!file.Open(fileName))
         {
             LOG_DEBUG("maps", "MMAP:loadMap: Could not open mmtile file '%s'", fileName.c_str());
             return false;
         }
 
         // read header
+        MappedFileReader reader(file);
         MmapTileHeader fileHeader;
-        if (fread(&fileHeader, sizeof(MmapTileHeader), 1, file) != 1 || fileHeader.mmapMagic != MMAP_MAGIC)
+        if (!reader.Read(fileHeader) || fileHeader.mmapMagic != MMAP_MAGIC)
         {
             LOG_ERROR("maps", "MMAP:loadMap: Bad header in mmap %03u%02i%02i.mmtile", mapId, x, y);
-            fclose(file);
             return false;
         }
 
@@ -154,40 +226,80 @@ namespace MMAP
         {
             LOG_ERROR("maps", "MMAP:loadMap: %03u%02i%02i.mmtile was built with generator v%i, expected v%i",
                       mapId, x, y, fileHeader.mmapVersion, MMAP_VERSION);
-            fclose(file);
             return false;
         }
 
         unsigned char* data = (unsigned char*)dtAlloc(fileHeader.size, DT_ALLOC_PERM);
         ASSERT(data);
 
-        size_t result = fread(data, fileHeader.size, 1, file);
-        if (!result)
+        // detour needs its own copy, the tile data is freed by dtNavMesh::removeTile
+        if (!reader.Read(data, fileHeader.size))
         {
             LOG_ERROR("maps", "MMAP:loadMap: Bad header or data in mmap %03u%02i%02i.mmtile", mapId, x, y);
-            fclose(file);
+            dtFree(data);
             return false;
         }
 
-        fclose(file);
-
-        dtTileRef tileRef = 0;
+        tile.data = data;
+        tile.size = fileHeader.size;
+        return true;
+    }
 
-        // memory allocated for data is now managed by detour, and will be deallocated when the tile is removed
-        if (dtStatusSucceed(mmap->navMesh->addTile(data, fileHeader.size, DT_TILE_FREE_DATA, 0, &tileRef)))
+    bool MMapManager::preloadMap(uint32 mapId, int32 x, int32 y)
+    {
+        uint64 tileId = packPreloadedTileID(mapId, x, y);
         {
-            mmap->loadedTileRefs.insert(std::pair<uint32, dtTileRef>(packedGridPos, tileRef));
-            ++loadedTiles;
-            dtMeshHeader* header = (dtMeshHeader*)data;
-            LOG_DEBUG("maps", "MMAP:loadMap: Loaded mmtile %03i[%02i,%02i] into %03i[%02i,%02i]", mapId, x, y, mapId, header->x, header->y);
-            return true;
+            std::lock_guard<std::mutex> lock(preloadedTilesLock);
+            if (preloadedTiles.find(tileId) != preloadedTiles.end())
+                return true;
         }
-        else
-        {
-            LOG_ERROR("maps", "MMAP:loadMap: Could not load %03u%02i%02i.mmtile into navmesh", mapId, x, y);
-            dtFree(data);
+
+        PreloadedTile tile;
+        if (!readTileData(mapId, x, y, tile))
             return false;
-        }
+
+        std::lock_guard<std::mutex> lock(preloadedTilesLock);
+        if (!preloadedTiles.insert(PreloadedTileSet::value_type(tileId, tile)).second)
+            dtFree(tile.data);
+
+        return true;
+    }
+
+    void MMapManager::discardPreloadedMap(uint32 mapId, int32 x, int32 y)
+    {
+        std::lock_guard<std::mutex> lock(preloadedTilesLock);
+        PreloadedTileSet::iterator itr = preloadedTiles.find(packPreloadedTileID(mapId, x, y));
+        if (itr == preloadedTiles.end())
+            return;
+
+        dtFree(itr->second.data);
+        preloadedTiles.erase(itr);
+    }
+
+    uint32 MMapManager::getTileMemoryUsage(uint32 mapId, int32 x, int32 y) const
+    {
+        MMapDataSet::const_iterator itr = GetMMapData(mapId);
+        if (itr == loadedMMaps.end())
+            return 0;
+
+        MMapTileSet::const_iterator tileItr = itr->second->loadedTileRefs.find(packTileID(x, y));
+        if (tileItr == itr->second->loadedTileRefs.end() || !tileItr->second.refCount)
+            return 0;
+
+        return tileItr->second.size;
+    }
+
+    std::size_t MMapManager::getMapMemoryUsage(uint32 mapId) const
+    {
+        MMapDataSet::const_iterator itr = GetMMapData(mapId);
+        if (itr == loadedMMaps.end())
+            return 0;
+
+        std::size_t size = 0;
+        for (MMapTileSet::const_iterator tileItr = itr->second->loadedTileRefs.begin(); tileItr != itr->second->loadedTileRefs.end(); ++tileItr)
+            size += tileItr->second.size;
+
+        return size;
     }
 
     bool MMapManager::unloadMap(uint32 mapId, int32 x, int32 y)
@@ -204,18 +316,38 @@ namespace MMAP
         MMapData* mmap = itr->second;
 
         // check if we have this tile loaded
-        uint32 packedGridPos = packTileID(x, y);
-        if (mmap->loadedTileRefs.find(packedGridPos) == mmap->loadedTileRefs.end())
+        MMapTileSet::iterator tileItr = mmap->loadedTileRefs.find(packTileID(x, y));
+        if (tileItr == mmap->loadedTileRefs.end() || !tileItr->second.refCount)
         {
             // file may not exist, therefore not loaded
             LOG_DEBUG("maps", "MMAP:unloadMap: Asked to unload not loaded navmesh tile. %03u%02i%02i.mmtile", mapId, x, y);
             return false;
         }
 
-        dtTileRef tileRef = mmap->loadedTileRefs[packedGridPos];
+        if (--tileItr->second.refCount)
+            return true;
+
+        // keep it for the next grid needing it, trimTileCache removes it when memory gets short
+        if (tileCacheLimit)
+        {
+            tileItr->second.lastUsed = getMSTime();
+            LOG_DEBUG("maps", "MMAP:unloadMap: Cached idle mmtile %03i[%02i,%02i]", mapId, x, y);
+            return true;
+        }
+
+        return removeTile(mapId, mmap, tileItr);
+    }
+
+    bool MMapManager::removeTile(uint32 mapId, MMapData* mmap, MMapTileSet::iterator tileItr)
+    {
+        uint32 x = (tileItr->first >> 16);
+        uint32 y = (tileItr->first & 0x0000FFFF);
+
+        std::lock_guard<std::mutex> writerGuard(mmap->navMeshWriterLock);
+        std::unique_lock<std::shared_mutex> navMeshGuard(mmap->navMeshLock);
 
         // unload, and mark as non loaded
-        if (dtStatusFailed(mmap->navMesh->removeTile(tileRef, nullptr, nullptr)))
+        if (dtStatusFailed(mmap->navMesh->removeTile(tileItr->second.ref, nullptr, nullptr)))
         {
             // this is technically a memory leak
             // if the grid is later reloaded, dtNavMesh::addTile will return error but no extra memory is used
@@ -223,15 +355,83 @@ namespace MMAP
             LOG_ERROR("maps", "MMAP:unloadMap: Could not unload %03u%02i%02i.mmtile from navmesh", mapId, x, y);
             ABORT();
         }
-        else
+
+        residentTileMemory -= tileItr->second.size;
+        mmap->loadedTileRefs.erase(tileItr);
+        --loadedTiles;
+        LOG_DEBUG("maps", "MMAP:unloadMap: Unloaded mmtile %03i[%02i,%02i] from %03i", mapId, x, y, mapId);
+        return true;
+    }
+
+    uint32 MMapManager::trimTileCache()
+    {
+        std::size_t limit = tileCacheLimit;
+        if (residentTileMemory <= limit)
+            return 0;
+
+        struct IdleTile
         {
-            mmap->loadedTileRefs.erase(packedGridPos);
-            --loadedTiles;
-            LOG_DEBUG("maps", "MMAP:unloadMap: Unloaded mmtile %03i[%02i,%02i] from %03i", mapId, x, y, mapId);
-            return true;
+            uint32 mapId;
+            uint32 packedGridPos;
+            uint32 lastUsed;
+        };
+
+        std::vector<IdleTile> idleTiles;
+        for (MMapDataSet::value_type const& mapItr : loadedMMaps)
+        {
+            if (!mapItr.second)
+                continue;
+
+            for (MMapTileSet::value_type const& tileItr : mapItr.second->loadedTileRefs)
+                if (!tileItr.second.refCount)
+                    idleTiles.push_back({ mapItr.first, tileItr.first, tileItr.second.lastUsed });
+        }
+
+        // least recently used first
+        uint32 now = getMSTime();
+        std::sort(idleTiles.begin(), idleTiles.end(), [now](IdleTile const& left, IdleTile const& right)
+        {
+            return getMSTimeDiff(left.lastUsed, now) > getMSTimeDiff(right.lastUsed, now);
+        });
+
+        uint32 evicted = 0;
+        for (IdleTile const& idleTile : idleTiles)
+        {
+            if (residentTileMemory <= limit)
+                break;
+
+            MMapData* mmap = loadedMMaps[idleTile.mapId];
+            removeTile(idleTile.mapId, mmap, mmap->loadedTileRefs.find(idleTile.packedGridPos));
+            ++evicted;
         }
 
-        return false;
+        tileCacheEvictions += evicted;
+        return evicted;
+    }
+
+    void MMapManager::getTileCacheStats(TileCacheStats& stats)
+    {
+        stats.hits = tileCacheHits.exchange(0);
+        stats.misses = tileCacheMisses.exchange(0);
+        stats.evictions = tileCacheEvictions.exchange(0);
+        stats.idleTiles = 0;
+        stats.residentMemory = residentTileMemory;
+        stats.idleMemory = 0;
+
+        for (MMapDataSet::value_type const& mapItr : loadedMMaps)
+        {
+            if (!mapItr.second)
+                continue;
+
+            for (MMapTileSet::value_type const& tileItr : mapItr.second->loadedTileRefs)
+            {
+                if (tileItr.second.refCount)
+                    continue;
+
+                ++stats.idleTiles;
+                stats.idleMemory += tileItr.second.size;
+            }
+        }
     }
 
     bool MMapManager::unloadMap(uint32 mapId)
@@ -246,20 +446,25 @@ namespace MMAP
 
         // unload all tiles from given map
         MMapData* mmap = itr->second;
+        std::unique_lock<std::mutex> writerGuard(mmap->navMeshWriterLock);
+        std::unique_lock<std::shared_mutex> navMeshGuard(mmap->navMeshLock);
         for (auto i = mmap->loadedTileRefs.begin(); i != mmap->loadedTileRefs.end(); ++i)
         {
             uint32 x = (i->first >> 16);
             uint32 y = (i->first & 0x0000FFFF);
 
-            if (dtStatusFailed(mmap->navMesh->removeTile(i->second, nullptr, nullptr)))
+            if (dtStatusFailed(mmap->navMesh->removeTile(i->second.ref, nullptr, nullptr)))
                 LOG_ERROR("server", "MMAP:unloadMap: Could not unload %03u%02i%02i.mmtile from navmesh", mapId, x, y);
             else
             {
                 --loadedTiles;
+                residentTileMemory -= i->second.size;
                 LOG_DEBUG("maps", "MMAP:unloadMap: Unloaded mmtile %03i[%02i,%02i] from %03i", mapId, x, y, mapId);
             }
         }
 
+        navMeshGuard.unlock();
+        writerGuard.unlock();
         delete mmap;
         itr->second = nullptr;
 
@@ -268,34 +473,6 @@ namespace MMAP
         return true;
     }
 
-    bool MMapManager::unloadMapInstance(uint32 mapId, uint32 instanceId)
-    {
-        // check if we have this map loaded
-        MMapDataSet::const_iterator itr = GetMMapData(mapId);
-        if (itr == loadedMMaps.end())
-        {
-            // file may not exist, therefore not loaded
-            LOG_DEBUG("maps", "MMAP:unloadMapInstance: Asked to unload not loaded navmesh map %03u", mapId);
-            return false;
-        }
-
-        MMapData* mmap = itr->second;
-        if (mmap->navMeshQueries.find(instanceId) == mmap->navMeshQueries.end())
-        {
-            LOG_DEBUG("maps", "MMAP:unloadMapInstance: Asked to unload not loaded dtNavMeshQuery mapId %03u instanceId %u", mapId, instanceId);
-            return false;
-        }
-
-        dtNavMeshQuery* query = mmap->navMeshQueries[instanceId];
-
-        dtFreeNavMeshQuery(query);
-        mmap->navMeshQueries.erase(instanceId);
-
-        LOG_DEBUG("maps", "MMAP:unloadMapInstance: Unloaded mapId %03u instanceId %u", mapId, instanceId);
-
-        return true;
-    }
-
     dtNavMesh const* MMapManager::GetNavMesh(uint32 mapId)
     {
         MMapDataSet::const_iterator itr = GetMMapData(mapId);
@@ -305,29 +482,77 @@ namespace MMAP
         return itr->second->navMesh;
     }
 
-    dtNavMeshQuery const* MMapManager::GetNavMeshQuery(uint32 mapId, uint32 instanceId)
+    dtNavMeshQuery* MMapManager::AcquireNavMeshQuery(uint32 mapId)
     {
         MMapDataSet::const_iterator itr = GetMMapData(mapId);
         if (itr == loadedMMaps.end())
             return nullptr;
 
         MMapData* mmap = itr->second;
-        if (mmap->navMeshQueries.find(instanceId) == mmap->navMeshQueries.end())
+        dtNavMeshQuery* query = nullptr;
+        {
+            std::lock_guard<std::mutex> guard(mmap->navMeshQueryPoolLock);
+            if (!mmap->navMeshQueryPool.empty())
+            {
+                query = mmap->navMeshQueryPool.back();
+                mmap->navMeshQueryPool.pop_back();
+            }
+        }
+
+        // pool is empty, every query is in use by another thread - allocate a new one
+        if (!query)
         {
-            // allocate mesh query
-            dtNavMeshQuery* query = dtAllocNavMeshQuery();
+            query = dtAllocNavMeshQuery();
             ASSERT(query);
             if (dtStatusFailed(query->init(mmap->navMesh, 1024)))
             {
                 dtFreeNavMeshQuery(query);
-                LOG_ERROR("maps", "MMAP:GetNavMeshQuery: Failed to initialize dtNavMeshQuery for mapId %03u instanceId %u", mapId, instanceId);
+                LOG_ERROR("maps", "MMAP:AcquireNavMeshQuery: Failed to initialize dtNavMeshQuery for mapId %03u", mapId);
                 return nullptr;
             }
 
-            LOG_DEBUG("maps", "MMAP:GetNavMeshQuery: created dtNavMeshQuery for mapId %03u instanceId %u", mapId, instanceId);
-            mmap->navMeshQueries.insert(std::pair<uint32, dtNavMeshQuery*>(instanceId, query));
+            uint32 count;
+            {
+                std::lock_guard<std::mutex> guard(mmap->navMeshQueryPoolLock);
+                count = ++mmap->navMeshQueryCount;
+            }
+
+            LOG_DEBUG("maps", "MMAP:AcquireNavMeshQuery: created dtNavMeshQuery for mapId %03u, %u queries allocated", mapId, count);
         }
 
-        return mmap->navMeshQueries[instanceId];
+        // wait for a tile load or unload that is already waiting for the lock, so a steady stream
+        // of path searches can not keep it out. Neither pool lock may be held here, a query being
+        // released needs navMeshQueryPoolLock to let the waiting writer in
+        {
+            std::lock_guard<std::mutex> turnstile(mmap->navMeshWriterLock);
+        }
+
+        mmap->navMeshLock.lock_shared();
+        return query;
+    }
+
+    void MMapManager::ReleaseNavMeshQuery(uint32 mapId, dtNavMeshQuery* query)
+    {
+        // the map can not be unloaded while we hold its navmesh lock
+        MMapDataSet::const_iterator itr = GetMMapData(mapId);
+        ASSERT(itr != loadedMMaps.end() && query->getAttachedNavMesh() == itr->second->navMesh);
+
+        MMapData* mmap = itr->second;
+        {
+            std::lock_guard<std::mutex> guard(mmap->navMeshQueryPoolLock);
+            mmap->navMeshQueryPool.push_back(query);
+        }
+
+        mmap->navMeshLock.unlock_shared();
+    }
+
+    uint32 MMapManager::getNavMeshQueryCount(uint32 mapId) const
+    {
+        MMapDataSet::const_iterator itr = GetMMapData(mapId);
+        if (itr == loadedMMaps.end())
+            return 0;
+
+        std::lock_guard<std::mutex> guard(itr->second->navMeshQueryPoolLock);
+        return itr->second->navMeshQueryCount;
     }
 }
@@ -22,7 +22,12 @@
 #include "DetourAlloc.h"
 #include "DetourNavMesh.h"
 #include "DetourNavMeshQuery.h"
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
 //  memory management
 inline void* dtCustomAlloc(size_t size, dtAllocHint /*hint*/)
@@ -38,59 +43,163 @@ inline void dtCustomFree(void* ptr)
 //  move map related classes
 namespace MMAP
 {
-    typedef std::unordered_map<uint32, dtTileRef> MMapTileSet;
-    typedef std::unordered_map<uint32, dtNavMeshQuery*> NavMeshQuerySet;
+    struct MMapTile
+    {
+        dtTileRef ref;
+        uint32 size;
+        uint32 refCount;                    // grids using the tile, idle tiles stay cached until evicted
+        uint32 lastUsed;                    // getMSTime when it became idle
+    };
+
+    typedef std::unordered_map<uint32, MMapTile> MMapTileSet;
+    typedef std::vector<dtNavMeshQuery*> NavMeshQueryPool;
 
     // dummy struct to hold map's mmap data
     struct WH_COMMON_API MMapData
     {
-        MMapData(dtNavMesh* mesh) : navMesh(mesh) {}
+        MMapData(dtNavMesh* mesh) : navMesh(mesh), navMeshQueryCount(0) {}
         ~MMapData()
         {
-            for (NavMeshQuerySet::iterator i = navMeshQueries.begin(); i != navMeshQueries.end(); ++i)
-                dtFreeNavMeshQuery(i->second);
+            for (dtNavMeshQuery* query : navMeshQueryPool)
+                dtFreeNavMeshQuery(query);
 
             if (navMesh)
                 dtFreeNavMesh(navMesh);
         }
 
-        // we have to use single dtNavMeshQuery for every instance, since those are not thread safe
-        NavMeshQuerySet navMeshQueries;     // instanceId to query
+        // dtNavMeshQuery is not thread safe, every caller takes one out of the pool for exclusive use
+        // and puts it back when done, so the pool only grows up to the number of threads pathing at once
+        NavMeshQueryPool navMeshQueryPool;  // idle queries
+        std::mutex navMeshQueryPoolLock;
+        uint32 navMeshQueryCount;           // idle and in use
+
+        // held shared by every query out of the pool, exclusive while tiles are added or removed
+        std::shared_mutex navMeshLock;
+        // held by writers while they wait for and hold navMeshLock, readers pass it before locking shared.
+        // std::shared_mutex may prefer readers, this keeps path searches from starving tile loads
+        std::mutex navMeshWriterLock;
 
         dtNavMesh* navMesh;
-        MMapTileSet loadedTileRefs;        // maps [map grid coords] to [dtTile]
+        MMapTileSet loadedTileRefs;        // maps [map grid coords] to [dtTile], including idle ones
     };
 
     typedef std::unordered_map<uint32, MMapData*> MMapDataSet;
 
+    // tile data read ahead of time by a background thread, waiting to be added to its navmesh
+    struct PreloadedTile
+    {
+        unsigned char* data;
+        uint32 size;
+    };
+
+    typedef std::unordered_map<uint64, PreloadedTile> PreloadedTileSet;
+
+    struct TileCacheStats
+    {
+        uint32 hits;                        // tiles loaded again while still cached
+        uint32 misses;                      // tiles read from disk (or taken from a preload)
+        uint32 evictions;
+        uint32 idleTiles;
+        std::size_t residentMemory;         // all tiles added to navmeshes
+        std::size_t idleMemory;             // tiles no grid uses anymore
+    };
+
     // singleton class
     // holds all all access to mmap loading unloading and meshes
+    //
+    // Tiles are reference counted by the grids using them. When the last grid lets go of a
+    // tile it is not removed right away but kept as idle, so a grid loaded again soon after
+    // (tile budget, grid unloading) finds its navmesh still in memory. Idle tiles are removed
+    // least recently used first by trimTileCache once the navmesh memory exceeds the limit
+    // set with setTileCacheLimit. Tile files are read ahead of time by preloadMap.
+    // Paths being searched keep the tiles they pass through alive by holding the navmesh
+    // lock shared (see AcquireNavMeshQuery), tiles are only ever removed under the exclusive lock.
     class WH_COMMON_API MMapManager
     {
     public:
-        MMapManager() : loadedTiles(0), thread_safe_environment(true) {}
+        MMapManager() : loadedTiles(0), thread_safe_environment(true), tileCacheLimit(0), residentTileMemory(0),
+            tileCacheHits(0), tileCacheMisses(0), tileCacheEvictions(0) {}
         ~MMapManager();
 
         void InitializeThreadUnsafe(const std::vector<uint32>& mapIds);
         bool loadMap(uint32 mapId, int32 x, int32 y);
-        bool unloadMap(uint32 mapId, int32 x, int32 y);
+        bool unloadMap(uint32 mapId, int32 x, int32 y);     // the tile stays cached while the tile cache has room
         bool unloadMap(uint32 mapId);
-        bool unloadMapInstance(uint32 mapId, uint32 instanceId);
 
-        // the returned [dtNavMeshQuery const*] is NOT threadsafe
-        dtNavMeshQuery const* GetNavMeshQuery(uint32 mapId, uint32 instanceId);
+        // directory holding the mmaps directory, DataDir of the config if not set. Set it before any map is loaded
+        void setDataDir(std::string const& dir) { dataDir = dir; }
+
+        // memory navmesh tiles may use before idle ones are removed, 0 removes them as soon as they are idle
+        void setTileCacheLimit(std::size_t limit) { tileCacheLimit = limit; }
+        // removes idle tiles of all maps until the limit is met, no map may load or unload tiles meanwhile
+        uint32 trimTileCache();
+        // counters are reset by every call, no map may load or unload tiles meanwhile
+        void getTileCacheStats(TileCacheStats& stats);
+
+        // thread safe, reads the tile file so a later loadMap only has to add it to the navmesh
+        bool preloadMap(uint32 mapId, int32 x, int32 y);
+        void discardPreloadedMap(uint32 mapId, int32 x, int32 y);
+
+        // thread safe, the returned query is owned by the caller until it is given back with ReleaseNavMeshQuery
+        // tiles of the map can not be loaded or unloaded meanwhile, so do not hold a query while creating grids
+        // or looking up terrain (GetGrid may load tiles) and never hold two queries of one map on one thread:
+        // a waiting tile load blocks new queries until the ones in use are released
+        // prefer NavMeshQueryHolder over calling these directly
+        dtNavMeshQuery* AcquireNavMeshQuery(uint32 mapId);
+        void ReleaseNavMeshQuery(uint32 mapId, dtNavMeshQuery* query);
         dtNavMesh const* GetNavMesh(uint32 mapId);
 
         uint32 getLoadedTilesCount() const { return loadedTiles; }
         uint32 getLoadedMapsCount() const { return loadedMMaps.size(); }
+        uint32 getNavMeshQueryCount(uint32 mapId) const;
+
+        // navmesh tile data held for a single tile or a whole map, the caller must not load/unload concurrently
+        uint32 getTileMemoryUsage(uint32 mapId, int32 x, int32 y) const;
+        std::size_t getMapMemoryUsage(uint32 mapId) const;
     private:
         bool loadMapData(uint32 mapId);
-        uint32 packTileID(int32 x, int32 y);
+        uint32 packTileID(int32 x, int32 y) const;
+        uint64 packPreloadedTileID(uint32 mapId, int32 x, int32 y) { return uint64(mapId) << 32 | packTileID(x, y); }
+        bool readTileData(uint32 mapId, int32 x, int32 y, PreloadedTile& tile);
+        bool removeTile(uint32 mapId, MMapData* mmap, MMapTileSet::iterator tileItr);
+        std::string getDataDir() const;
 
         MMapDataSet::const_iterator GetMMapData(uint32 mapId) const;
         MMapDataSet loadedMMaps;
         uint32 loadedTiles;
         bool thread_safe_environment;
+        std::string dataDir;
+
+        PreloadedTileSet preloadedTiles;
+        std::mutex preloadedTilesLock;
+
+        std::atomic<std::size_t> tileCacheLimit;
+        std::atomic<std::size_t> residentTileMemory;
+        std::atomic<uint32> tileCacheHits;
+        std::atomic<uint32> tileCacheMisses;
+        std::atomic<uint32> tileCacheEvictions;
+    };
+
+    // Takes a navmesh query out of the pool of a map for the lifetime of the holder
+    class NavMeshQueryHolder
+    {
+    public:
+        NavMeshQueryHolder(MMapManager* manager, uint32 mapId) : _manager(manager), _mapId(mapId), _query(manager->AcquireNavMeshQuery(mapId)) { }
+        ~NavMeshQueryHolder()
+        {
+            if (_query)
+                _manager->ReleaseNavMeshQuery(_mapId, _query);
+        }
+
+        NavMeshQueryHolder(NavMeshQueryHolder const&) = delete;
+        NavMeshQueryHolder& operator=(NavMeshQueryHolder const&) = delete;
+
+        dtNavMeshQuery const* GetQuery() const { return _query; }
+
+    private:
+        MMapManager* _manager;
+        uint32 _mapId;
+        dtNavMeshQuery* _query;
     };
 }
 
@@ -43,8 +43,9 @@ namespace VMAP
     {
         for (InstanceTreeMap::iterator i = iInstanceMapTrees.begin(); i != iInstanceMapTrees.end(); ++i)
             delete i->second;
-        for (ModelFileMap::iterator i = iLoadedModelFiles.begin(); i != iLoadedModelFiles.end(); ++i)
-            delete i->second.getModel();
+        for (ModelFileShard& shard : iLoadedModelFiles)
+            for (ModelFileMap::iterator i = shard.Models.begin(); i != shard.Models.end(); ++i)
+                delete i->second.getModel();
     }
 
     void VMapManager2::InitializeThreadUnsafe(const std::vector<uint32>& mapIds)
@@ -88,9 +89,83 @@ namespace VMAP
                 result = VMAP_LOAD_RESULT_ERROR;
         }
 
+        // the tile holds its own references now
+        discardPreloadedMap(mapId, x, y);
+
         return result;
     }
 
+    void VMapManager2::preloadMap(const char* pBasePath, unsigned int mapId, int x, int y)
+    {
+        if (!isMapLoadingEnabled())
+            return;
+
+        uint64 tileId = uint64(mapId) << 32 | StaticMapTree::packTileID(x, y);
+        {
+            std::lock_guard<std::mutex> lock(PreloadedTilesLock);
+            if (iPreloadedTiles.find(tileId) != iPreloadedTiles.end())
+                return;
+        }
+
+        std::string basePath = pBasePath;
+        if (basePath.length() > 0 && basePath[basePath.length() - 1] != '/' && basePath[basePath.length() - 1] != '\\')
+            basePath.push_back('/');
+
+        std::vector<std::string> names;
+        if (!StaticMapTree::getTileModelNames(basePath, mapId, x, y, names))
+            return;
+
+        std::vector<std::string> acquired;
+        acquired.reserve(names.size());
+        for (std::string const& name : names)
+            if (acquireModelInstance(basePath, name))
+                acquired.push_back(name);
+
+        // another thread may have preloaded the same tile meanwhile, keep both sets of references
+        std::lock_guard<std::mutex> lock(PreloadedTilesLock);
+        std::vector<std::string>& pinned = iPreloadedTiles[tileId];
+        pinned.insert(pinned.end(), acquired.begin(), acquired.end());
+    }
+
+    void VMapManager2::discardPreloadedMap(unsigned int mapId, int x, int y)
+    {
+        std::vector<std::string> names;
+        {
+            std::lock_guard<std::mutex> lock(PreloadedTilesLock);
+            PreloadedTileMap::iterator itr = iPreloadedTiles.find(uint64(mapId) << 32 | StaticMapTree::packTileID(x, y));
+            if (itr == iPreloadedTiles.end())
+                return;
+
+            names = std::move(itr->second);
+            iPreloadedTiles.erase(itr);
+        }
+
+        for (std::string const& name : names)
+            releaseModelInstance(name);
+    }
+
+    std::size_t VMapManager2::getMapMemoryUsage(unsigned int mapId) const
+    {
+        InstanceTreeMap::const_iterator instanceTree = GetMapTree(mapId);
+        if (instanceTree == iInstanceMapTrees.end())
+            return 0;
+
+        return instanceTree->second->GetMemoryUsage();
+    }
+
+    std::size_t VMapManager2::getModelMemoryUsage()
+    {
+        std::size_t size = 0;
+        for (ModelFileShard& shard : iLoadedModelFiles)
+        {
+            std::shared_lock<std::shared_mutex> lock(shard.Lock);
+            for (ModelFileMap::iterator itr = shard.Models.begin(); itr != shard.Models.end(); ++itr)
+                size += itr->first.capacity() + itr->second.getModel()->GetMemoryUsage();
+        }
+
+        return size;
+    }
+
     InstanceTreeMap::const_iterator VMapManager2::GetMapTree(uint32 mapId) const
     {
         // return the iterator if found or end() if not found/NULL
@@ -283,49 +358,81 @@ namespace VMAP
 
     WorldModel* VMapManager2::acquireModelInstance(const std::string& basepath, const std::string& filename)
     {
-        //! Critical section, thread safe access to iLoadedModelFiles
-        std::lock_guard<std::mutex> lock(LoadedModelFilesLock);
+        ModelFileShard& shard = GetModelFileShard(filename);
 
-        ModelFileMap::iterator model = iLoadedModelFiles.find(filename);
-        if (model == iLoadedModelFiles.end())
         {
-            WorldModel* worldmodel = new WorldModel();
-            if (!worldmodel->readFile(basepath + filename + ".vmo"))
+            std::shared_lock<std::shared_mutex> lock(shard.Lock);
+            ModelFileMap::iterator model = shard.Models.find(filename);
+            if (model != shard.Models.end())
             {
-                LOG_ERROR("maps", "VMapManager2: could not load '%s%s.vmo'", basepath.c_str(), filename.c_str());
-                delete worldmodel;
-                return nullptr;
+                //model->second.incRefCount();
+                return model->second.getModel();
             }
+        }
 
-            LOG_DEBUG("maps", "VMapManager2: loading file '%s%s'", basepath.c_str(), filename.c_str());
+        // read without holding the shard, another thread may load the same model meanwhile
+        WorldModel* worldmodel = new WorldModel();
+        if (!worldmodel->readFile(basepath + filename + ".vmo"))
+        {
+            LOG_ERROR("maps", "VMapManager2: could not load '%s%s.vmo'", basepath.c_str(), filename.c_str());
+            delete worldmodel;
+            return nullptr;
+        }
 
-            model = iLoadedModelFiles.insert(std::pair<std::string, ManagedModel>(filename, ManagedModel())).first;
-            model->second.setModel(worldmodel);
+        WorldModel* duplicate = nullptr;
+        WorldModel* result = nullptr;
+        {
+            std::unique_lock<std::shared_mutex> lock(shard.Lock);
+            std::pair<ModelFileMap::iterator, bool> model = shard.Models.try_emplace(filename);
+            if (model.second)
+            {
+                LOG_DEBUG("maps", "VMapManager2: loading file '%s%s'", basepath.c_str(), filename.c_str());
+                model.first->second.setModel(worldmodel);
+            }
+            else
+                duplicate = worldmodel;
+
+            //model.first->second.incRefCount();
+            result = model.first->second.getModel();
         }
 
-        //model->second.incRefCount();
-        return model->second.getModel();
+        // the other thread was first, both copies map the same file so dropping ours is cheap
+        delete duplicate;
+        return result;
     }
 
     void VMapManager2::releaseModelInstance(const std::string& filename)
     {
-        //! Critical section, thread safe access to iLoadedModelFiles
-        std::lock_guard<std::mutex> lock(LoadedModelFilesLock);
+        ModelFileShard& shard = GetModelFileShard(filename);
 
-        ModelFileMap::iterator model = iLoadedModelFiles.find(filename);
-        if (model == iLoadedModelFiles.end())
         {
-            LOG_ERROR("server", "VMapManager2: trying to unload non-loaded file '%s'", filename.c_str());
-            return;
+            std::shared_lock<std::shared_mutex> lock(shard.Lock);
+            ModelFileMap::iterator model = shard.Models.find(filename);
+            if (model == shard.Models.end())
+            {
+                LOG_ERROR("server", "VMapManager2: trying to unload non-loaded file '%s'", filename.c_str());
+                return;
+            }
+
+            if (model->second.decRefCount() != 0)
+                return;
         }
 
-        if (model->second.decRefCount() == 0)
+        // last reference, it may have been acquired again or unloaded by another thread meanwhile
+        WorldModel* unloaded = nullptr;
         {
+            std::unique_lock<std::shared_mutex> lock(shard.Lock);
+            ModelFileMap::iterator model = shard.Models.find(filename);
+            if (model == shard.Models.end() || model->second.getRefCount() != 0)
+                return;
+
             LOG_DEBUG("maps", "VMapManager2: unloading file '%s'", filename.c_str());
 
-            delete model->second.getModel();
-            iLoadedModelFiles.erase(model);
+            unloaded = model->second.getModel();
+            shard.Models.erase(model);
         }
+
+        delete unloaded;
     }
 
     bool VMapManager2::existsMap(const char* basePath, unsigned int mapId, int x, int y)
@@ -20,7 +20,10 @@
 
 #include "IVMapManager.h"
 #include "Common.h"
+#include <array>
+#include <atomic>
 #include <mutex>
+#include <shared_mutex>
 #include <unordered_map>
 #include <vector>
 
@@ -30,6 +33,9 @@
 
 #define FILENAMEBUFFER_SIZE 500
 
+// number of independently locked parts of the loaded model registry
+#define VMAP_MODEL_FILE_SHARDS 32
+
 /**
 This is the main Class to manage loading and unloading of maps, line of sight, height calculation and so on.
 For each map or map tile to load it reads a directory file that contains the ModelContainer files used by this map or map tile.
@@ -56,15 +62,18 @@ namespace VMAP
         ManagedModel() : iModel(0), iRefCount(0) { }
         void setModel(WorldModel* model) { iModel = model; }
         WorldModel* getModel() { return iModel; }
+        // atomic, changed while the registry shard is only locked shared
         void incRefCount() { ++iRefCount; }
         int decRefCount() { return --iRefCount; }
+        int getRefCount() const { return iRefCount; }
     protected:
         WorldModel* iModel;
-        int iRefCount;
+        std::atomic<int> iRefCount;
     };
 
     typedef std::unordered_map<uint32, StaticMapTree*> InstanceTreeMap;
     typedef std::unordered_map<std::string, ManagedModel> ModelFileMap;
+    typedef std::unordered_map<uint64, std::vector<std::string>> PreloadedTileMap;
 
     enum DisableTypes
     {
@@ -77,13 +86,25 @@ namespace VMAP
     class WH_COMMON_API VMapManager2 : public IVMapManager
     {
     protected:
+        // Loaded models, spread over shards by file name so map threads loading
+        // different models do not wait for each other. Lookups only lock a shard shared,
+        // model files are read without holding any lock
+        struct ModelFileShard
+        {
+            std::shared_mutex Lock;
+            ModelFileMap Models;
+        };
+
+        ModelFileShard& GetModelFileShard(const std::string& filename) { return iLoadedModelFiles[std::hash<std::string>()(filename) % VMAP_MODEL_FILE_SHARDS]; }
+
         // Tree to check collision
-        ModelFileMap iLoadedModelFiles;
+        std::array<ModelFileShard, VMAP_MODEL_FILE_SHARDS> iLoadedModelFiles;
         InstanceTreeMap iInstanceMapTrees;
         bool thread_safe_environment;
 
-        // Mutex for iLoadedModelFiles
-        std::mutex LoadedModelFilesLock;
+        // Models acquired by preloadMap, held until the tile itself is loaded
+        PreloadedTileMap iPreloadedTiles;
+        std::mutex PreloadedTilesLock;
 
         bool _loadMap(uint32 mapId, const std::string& basePath, uint32 tileX, uint32 tileY);
         /* void _unloadMap(uint32 pMapId, uint32 x, uint32 y); */
@@ -108,6 +129,12 @@ namespace VMAP
         void unloadMap(unsigned int mapId, int x, int y);
         void unloadMap(unsigned int mapId);
 
+        void preloadMap(const char* pBasePath, unsigned int mapId, int x, int y) override;
+        void discardPreloadedMap(unsigned int mapId, int x, int y) override;
+
+        std::size_t getMapMemoryUsage(unsigned int mapId) const override;
+        std::size_t getModelMemoryUsage() override;
+
         bool isInLineOfSight(unsigned int mapId, float x1, float y1, float z1, float x2, float y2, float z2) ;
         /**
         fill the hit pos and return true, if an object was hit
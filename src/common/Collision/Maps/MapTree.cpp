@@ -22,6 +22,7 @@
 #include "Log.h"
 #include "Errors.h"
 #include "Metric.h"
+#include "MappedFile.h"
 #include <string>
 #include <sstream>
 #include <iomanip>
@@ -228,33 +229,56 @@ namespace VMAP
         if (basePath.length() > 0 && basePath[basePath.length() - 1] != '/' && basePath[basePath.length() - 1] != '\\')
             basePath.push_back('/');
         std::string fullname = basePath + VMapManager2::getMapFileName(mapID);
-        bool success = true;
-        FILE* rf = fopen(fullname.c_str(), "rb");
-        if (!rf)
+        MappedFile mapFile;
+        if (!mapFile.Open(fullname))
             return false;
         // TODO: check magic number when implemented...
+        MappedFileReader reader(mapFile);
         char tiled;
         char chunk[8];
-        if (!readChunk(rf, chunk, VMAP_MAGIC, 8) || fread(&tiled, sizeof(char), 1, rf) != 1)
-        {
-            fclose(rf);
+        if (!readChunk(reader, chunk, VMAP_MAGIC, 8) || !reader.Read(tiled))
             return false;
-        }
         if (tiled)
         {
             std::string tilefile = basePath + getTileFileName(mapID, tileX, tileY);
-            FILE* tf = fopen(tilefile.c_str(), "rb");
-            if (!tf)
-                success = false;
-            else
-            {
-                if (!readChunk(tf, chunk, VMAP_MAGIC, 8))
-                    success = false;
-                fclose(tf);
-            }
+            MappedFile tileFile;
+            if (!tileFile.Open(tilefile))
+                return false;
+
+            MappedFileReader tileReader(tileFile);
+            if (!readChunk(tileReader, chunk, VMAP_MAGIC, 8))
+                return false;
         }
-        fclose(rf);
-        return success;
+        return true;
+    }
+
+    //=========================================================
+
+    bool StaticMapTree::getTileModelNames(const std::string& basePath, uint32 mapID, uint32 tileX, uint32 tileY, std::vector<std::string>& names)
+    {
+        std::string tilefile = basePath + getTileFileName(mapID, tileX, tileY);
+        MappedFile tileFile;
+        if (!tileFile.Open(tilefile))
+            return false;
+
+        MappedFileReader reader(tileFile);
+        bool result = true;
+        char chunk[8];
+        if (!readChunk(reader, chunk, VMAP_MAGIC, 8))
+            result = false;
+        uint32 numSpawns = 0;
+        if (result && !reader.Read(numSpawns))
+            result = false;
+        for (uint32 i = 0; i < numSpawns && result; ++i)
+        {
+            ModelSpawn spawn;
+            uint32 referencedVal;
+            result = ModelSpawn::readFromFile(reader, spawn) && reader.Read(referencedVal);
+            if (result)
+                names.push_back(spawn.name);
+        }
+
+        return result;
     }
 
     //=========================================================
@@ -264,19 +288,20 @@ namespace VMAP
         //VMAP_DEBUG_LOG(LOG_FILTER_MAPS, "StaticMapTree::InitMap() : initializing StaticMapTree '%s'", fname.c_str());
         bool success = false;
         std::string fullname = iBasePath + fname;
-        FILE* rf = fopen(fullname.c_str(), "rb");
-        if (!rf)
+        MappedFile mapFile;
+        if (!mapFile.Open(fullname))
             return false;
 
+        MappedFileReader reader(mapFile);
         char chunk[8];
         char tiled = '\0';
 
-        if (readChunk(rf, chunk, VMAP_MAGIC, 8) && fread(&tiled, sizeof(char), 1, rf) == 1 &&
-                readChunk(rf, chunk, "NODE", 4) && iTree.readFromFile(rf))
+        if (readChunk(reader, chunk, VMAP_MAGIC, 8) && reader.Read(tiled) &&
+                readChunk(reader, chunk, "NODE", 4) && iTree.readFromFile(reader))
         {
             iNTreeValues = iTree.primCount();
             iTreeValues = new ModelInstance[iNTreeValues];
-            success = readChunk(rf, chunk, "GOBJ", 4);
+            success = readChunk(reader, chunk, "GOBJ", 4);
         }
 
         iIsTiled = bool(tiled);
@@ -287,7 +312,7 @@ namespace VMAP
 #ifdef VMAP_DEBUG
         //TC_LOG_DEBUG(LOG_FILTER_MAPS, "StaticMapTree::InitMap() : map isTiled: %u", static_cast<uint32>(iIsTiled));
 #endif
-        if (!iIsTiled && ModelSpawn::readFromFile(rf, spawn))
+        if (!iIsTiled && ModelSpawn::readFromFile(reader, spawn))
         {
             WorldModel* model = vm->acquireModelInstance(iBasePath, spawn.name);
             //VMAP_DEBUG_LOG(LOG_FILTER_MAPS, "StaticMapTree::InitMap() : loading %s", spawn.name.c_str());
@@ -304,7 +329,6 @@ namespace VMAP
             }
         }
 
-        fclose(rf);
         return success;
     }
 
@@ -341,21 +365,22 @@ namespace VMAP
         bool result = true;
 
         std::string tilefile = iBasePath + getTileFileName(iMapID, tileX, tileY);
-        FILE* tf = fopen(tilefile.c_str(), "rb");
-        if (tf)
+        MappedFile tileFile;
+        if (tileFile.Open(tilefile))
         {
+            MappedFileReader reader(tileFile);
             char chunk[8];
 
-            if (!readChunk(tf, chunk, VMAP_MAGIC, 8))
+            if (!readChunk(reader, chunk, VMAP_MAGIC, 8))
                 result = false;
             uint32 numSpawns = 0;
-            if (result && fread(&numSpawns, sizeof(uint32), 1, tf) != 1)
+            if (result && !reader.Read(numSpawns))
                 result = false;
             for (uint32 i = 0; i < numSpawns && result; ++i)
             {
                 // read model spawns
                 ModelSpawn spawn;
-                result = ModelSpawn::readFromFile(tf, spawn);
+                result = ModelSpawn::readFromFile(reader, spawn);
                 if (result)
                 {
                     // acquire model instance
@@ -366,7 +391,7 @@ namespace VMAP
                     // update tree
                     uint32 referencedVal;
 
-                    if (fread(&referencedVal, sizeof(uint32), 1, tf) == 1)
+                    if (reader.Read(referencedVal))
                     {
                         if (!iLoadedSpawns.count(referencedVal))
                         {
@@ -392,7 +417,6 @@ namespace VMAP
                 }
             }
             iLoadedTiles[packTileID(tileX, tileY)] = true;
-            fclose(tf);
         }
         else
             iLoadedTiles[packTileID(tileX, tileY)] = false;
@@ -417,21 +441,22 @@ namespace VMAP
         if (tile->second) // file associated with tile
         {
             std::string tilefile = iBasePath + getTileFileName(iMapID, tileX, tileY);
-            FILE* tf = fopen(tilefile.c_str(), "rb");
-            if (tf)
+            MappedFile tileFile;
+            if (tileFile.Open(tilefile))
             {
+                MappedFileReader reader(tileFile);
                 bool result = true;
                 char chunk[8];
-                if (!readChunk(tf, chunk, VMAP_MAGIC, 8))
+                if (!readChunk(reader, chunk, VMAP_MAGIC, 8))
                     result = false;
-                uint32 numSpawns;
-                if (fread(&numSpawns, sizeof(uint32), 1, tf) != 1)
+                uint32 numSpawns = 0;
+                if (!reader.Read(numSpawns))
                     result = false;
                 for (uint32 i = 0; i < numSpawns && result; ++i)
                 {
                     // read model spawns
                     ModelSpawn spawn;
-                    result = ModelSpawn::readFromFile(tf, spawn);
+                    result = ModelSpawn::readFromFile(reader, spawn);
                     if (result)
                     {
                         // release model instance
@@ -440,7 +465,7 @@ namespace VMAP
                         // update tree
                         uint32 referencedNode;
 
-                        if (fread(&referencedNode, sizeof(uint32), 1, tf) != 1)
+                        if (!reader.Read(referencedNode))
                             result = false;
                         else
                         {
@@ -454,7 +479,6 @@ namespace VMAP
                         }
                     }
                 }
-                fclose(tf);
             }
         }
 
@@ -464,6 +488,11 @@ namespace VMAP
                         "Map: " + std::to_string(iMapID) + " TileX: " + std::to_string(tileX) + " TileY: " + std::to_string(tileY));
     }
 
+    std::size_t StaticMapTree::GetMemoryUsage() const
+    {
+        return sizeof(StaticMapTree) + iTree.GetMemoryUsage() + iNTreeValues * sizeof(ModelInstance);
+    }
+
     void StaticMapTree::getModelInstances(ModelInstance*& models, uint32& count)
     {
         models = iTreeValues;
@@ -21,6 +21,7 @@
 #include "Define.h"
 #include "BoundingIntervalHierarchy.h"
 #include <unordered_map>
+#include <vector>
 
 namespace VMAP
 {
@@ -63,6 +64,7 @@ namespace VMAP
         static uint32 packTileID(uint32 tileX, uint32 tileY) { return tileX << 16 | tileY; }
         static void unpackTileID(uint32 ID, uint32& tileX, uint32& tileY) { tileX = ID >> 16; tileY = ID & 0xFF; }
         static bool CanLoadMap(const std::string& basePath, uint32 mapID, uint32 tileX, uint32 tileY);
+        static bool getTileModelNames(const std::string& basePath, uint32 mapID, uint32 tileX, uint32 tileY, std::vector<std::string>& names);
 
         StaticMapTree(uint32 mapID, const std::string& basePath);
         ~StaticMapTree();
@@ -79,6 +81,8 @@ namespace VMAP
         void UnloadMapTile(uint32 tileX, uint32 tileY, VMapManager2* vm);
         bool isTiled() const { return iIsTiled; }
         uint32 numLoadedTiles() const { return iLoadedTiles.size(); }
+        // memory of the tree itself, the models are owned by VMapManager2
+        std::size_t GetMemoryUsage() const;
         void getModelInstances(ModelInstance*& models, uint32& count);
     };
 
@@ -18,13 +18,18 @@
 #include "TileAssembler.h"
 #include "MapTree.h"
 #include "BoundingIntervalHierarchy.h"
+#include "DataCompression.h"
 #include "VMapDefinitions.h"
 #include "MapDefines.h"
+#include "MappedFile.h"
+#include "Timer.h"
 
+#include <atomic>
 #include <set>
 #include <iomanip>
 #include <sstream>
 #include <iomanip>
+#include <thread>
 
 using G3D::Vector3;
 using G3D::AABox;
@@ -36,6 +41,36 @@ template<> struct BoundsTrait<VMAP::ModelSpawn*>
     static void getBounds(const VMAP::ModelSpawn* const& obj, G3D::AABox& out) { out = obj->getBounds(); }
 };
 
+namespace
+{
+    // Calls work for every index below count on up to threads threads
+    void parallelFor(size_t count, unsigned int threads, std::function<void(size_t)> const& work)
+    {
+        threads = unsigned(std::min<size_t>(threads, count));
+        if (threads <= 1)
+        {
+            for (size_t i = 0; i < count; ++i)
+                work(i);
+
+            return;
+        }
+
+        std::atomic<size_t> next(0);
+        std::vector<std::thread> workers;
+        for (unsigned int t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&]()
+            {
+                for (size_t i = next++; i < count; i = next++)
+                    work(i);
+            });
+        }
+
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+}
+
 namespace VMAP
 {
     bool readChunk(FILE* rf, char* dest, const char* compare, uint32 len)
@@ -44,6 +79,12 @@ namespace VMAP
         return memcmp(dest, compare, len) == 0;
     }
 
+    bool readChunk(MappedFileReader& reader, char* dest, const char* compare, uint32 len)
+    {
+        if (!reader.Read(dest, len)) return false;
+        return memcmp(dest, compare, len) == 0;
+    }
+
     Vector3 ModelPosition::transform(const Vector3& pIn) const
     {
         Vector3 out = pIn * iScale;
@@ -54,7 +95,7 @@ namespace VMAP
     //=================================================================
 
     TileAssembler::TileAssembler(const std::string& pSrcDirName, const std::string& pDestDirName)
-        : iDestDir(pDestDirName), iSrcDir(pSrcDirName), iFilterMethod(NULL), iCurrentUniqueNameId(0)
+        : iDestDir(pDestDirName), iSrcDir(pSrcDirName), iFilterMethod(NULL), iCurrentUniqueNameId(0), iThreads(1), iCompress(false)
     {
         //mkdir(iDestDir);
         //init();
@@ -67,140 +108,228 @@ namespace VMAP
 
     bool TileAssembler::convertWorld2()
     {
+        uint32 startTime = getMSTime();
         bool success = readMapSpawns();
         if (!success)
             return false;
 
-        // export Map data
-        for (MapData::iterator map_iter = mapData.begin(); map_iter != mapData.end() && success; ++map_iter)
+        uint32 readTime = GetMSTimeDiffToNow(startTime);
+
+        printf("Using %u threads\n", iThreads);
+
+        // export Map data, biggest maps first so they don't end up running alone
+        std::vector<std::pair<uint32, MapSpawns*>> maps(mapData.begin(), mapData.end());
+        std::stable_sort(maps.begin(), maps.end(), [](std::pair<uint32, MapSpawns*> const& a, std::pair<uint32, MapSpawns*> const& b)
+        {
+            return a.second->UniqueEntries.size() > b.second->UniqueEntries.size();
+        });
+
+        startTime = getMSTime();
+        std::atomic<bool> mapsConverted(true);
+        parallelFor(maps.size(), iThreads, [&](size_t i)
         {
-            // build global map tree
-            std::vector<ModelSpawn*> mapSpawns;
-            UniqueEntryMap::iterator entry;
-            printf("Calculating model bounds for map %u...\n", map_iter->first);
-            for (entry = map_iter->second->UniqueEntries.begin(); entry != map_iter->second->UniqueEntries.end(); ++entry)
+            if (mapsConverted && !convertMap(maps[i].first, *maps[i].second))
+                mapsConverted = false;
+        });
+
+        success = mapsConverted;
+        uint32 mapTime = GetMSTimeDiffToNow(startTime);
+
+        // add an object models, listed in temp_gameobject_models file
+        startTime = getMSTime();
+        exportGameobjectModels();
+        uint32 gameobjectTime = GetMSTimeDiffToNow(startTime);
+
+        // export objects
+        std::cout << "\nConverting Model Files" << std::endl;
+        startTime = getMSTime();
+        std::vector<std::string> modelFiles(spawnedModelFiles.begin(), spawnedModelFiles.end());
+        std::atomic<bool> modelsConverted(true);
+        parallelFor(modelFiles.size(), iThreads, [&](size_t i)
+        {
+            if (!modelsConverted)
+                return;
+
+            printf("Converting %s\n", modelFiles[i].c_str());
+            if (!convertRawFile(modelFiles[i]))
             {
-                // M2 models don't have a bound set in WDT/ADT placement data, i still think they're not used for LoS at all on retail
-                if (entry->second.flags & MOD_M2)
-                {
-                    if (!calculateTransformedBound(entry->second))
-                        break;
-                }
-                else if (entry->second.flags & MOD_WORLDSPAWN) // WMO maps and terrain maps use different origin, so we need to adapt :/
-                {
-                    /// @todo remove extractor hack and uncomment below line:
-                    //entry->second.iPos += Vector3(533.33333f*32, 533.33333f*32, 0.f);
-                    entry->second.iBound = entry->second.iBound + Vector3(533.33333f * 32, 533.33333f * 32, 0.f);
-                }
-                mapSpawns.push_back(&(entry->second));
-                spawnedModelFiles.insert(entry->second.name);
+                printf("error converting %s\n", modelFiles[i].c_str());
+                modelsConverted = false;
             }
+        });
+
+        success = success && modelsConverted;
+        uint32 modelTime = GetMSTimeDiffToNow(startTime);
+
+        printf("\nStage timings:\n");
+        printf("   Read spawns:            %u ms\n", readTime);
+        printf("   Map trees and tiles:    %u ms\n", mapTime);
+        printf("   GameObject models:      %u ms\n", gameobjectTime);
+        printf("   Model conversion:       %u ms\n", modelTime);
 
-            printf("Creating map tree for map %u...\n", map_iter->first);
-            BIH pTree;
+        //cleanup:
+        for (MapData::iterator map_iter = mapData.begin(); map_iter != mapData.end(); ++map_iter)
+            delete map_iter->second;
+        return success;
+    }
+
+    bool TileAssembler::convertMap(uint32 mapId, MapSpawns& spawns)
+    {
+        bool success = true;
 
-            try
+        // build global map tree
+        std::vector<ModelSpawn*> mapSpawns;
+        std::set<std::string> modelFiles;
+        UniqueEntryMap::iterator entry;
+        printf("Calculating model bounds for map %u...\n", mapId);
+        for (entry = spawns.UniqueEntries.begin(); entry != spawns.UniqueEntries.end(); ++entry)
+        {
+            // M2 models don't have a bound set in WDT/ADT placement data, i still think they're not used for LoS at all on retail
+            if (entry->second.flags & MOD_M2)
             {
-                pTree.build(mapSpawns, BoundsTrait<ModelSpawn*>::getBounds);
+                if (!calculateTransformedBound(entry->second))
+                    break;
             }
-            catch (std::exception& e)
+            else if (entry->second.flags & MOD_WORLDSPAWN) // WMO maps and terrain maps use different origin, so we need to adapt :/
             {
-                printf("Exception ""%s"" when calling pTree.build", e.what());
-                return false;
+                /// @todo remove extractor hack and uncomment below line:
+                //entry->second.iPos += Vector3(533.33333f*32, 533.33333f*32, 0.f);
+                entry->second.iBound = entry->second.iBound + Vector3(533.33333f * 32, 533.33333f * 32, 0.f);
             }
+            mapSpawns.push_back(&(entry->second));
+            modelFiles.insert(entry->second.name);
+        }
 
-            // ===> possibly move this code to StaticMapTree class
-            std::map<uint32, uint32> modelNodeIdx;
-            for (uint32 i = 0; i < mapSpawns.size(); ++i)
-                modelNodeIdx.insert(pair<uint32, uint32>(mapSpawns[i]->ID, i));
+        addSpawnedModelFiles(modelFiles);
 
-            // write map tree file
-            std::stringstream mapfilename;
-            mapfilename << iDestDir << '/' << std::setfill('0') << std::setw(3) << map_iter->first << ".vmtree";
-            FILE* mapfile = fopen(mapfilename.str().c_str(), "wb");
-            if (!mapfile)
-            {
-                success = false;
-                printf("Cannot open %s\n", mapfilename.str().c_str());
-                break;
-            }
+        printf("Creating map tree for map %u...\n", mapId);
+        BIH pTree;
+
+        try
+        {
+            pTree.build(mapSpawns, BoundsTrait<ModelSpawn*>::getBounds);
+        }
+        catch (std::exception& e)
+        {
+            printf("Exception ""%s"" when calling pTree.build", e.what());
+            return false;
+        }
+
+        // ===> possibly move this code to StaticMapTree class
+        std::map<uint32, uint32> modelNodeIdx;
+        for (uint32 i = 0; i < mapSpawns.size(); ++i)
+            modelNodeIdx.insert(pair<uint32, uint32>(mapSpawns[i]->ID, i));
+
+        // write map tree file
+        std::stringstream mapfilename;
+        mapfilename << iDestDir << '/' << std::setfill('0') << std::setw(3) << mapId << ".vmtree";
+        FILE* mapfile = fopen(mapfilename.str().c_str(), "wb");
+        if (!mapfile)
+        {
+            printf("Cannot open %s\n", mapfilename.str().c_str());
+            return false;
+        }
+
+        //general info
+        if (success && fwrite(VMAP_MAGIC, 1, 8, mapfile) != 8) success = false;
+        uint32 globalTileID = StaticMapTree::packTileID(65, 65);
+        pair<TileMap::iterator, TileMap::iterator> globalRange = spawns.TileEntries.equal_range(globalTileID);
+        char isTiled = globalRange.first == globalRange.second; // only maps without terrain (tiles) have global WMO
+        if (success && fwrite(&isTiled, sizeof(char), 1, mapfile) != 1) success = false;
+        // Nodes
+        if (success && fwrite("NODE", 4, 1, mapfile) != 1) success = false;
+        if (success) success = pTree.writeToFile(mapfile);
+        // global map spawns (WDT), if any (most instances)
+        if (success && fwrite("GOBJ", 4, 1, mapfile) != 1) success = false;
 
-            //general info
-            if (success && fwrite(VMAP_MAGIC, 1, 8, mapfile) != 8) success = false;
-            uint32 globalTileID = StaticMapTree::packTileID(65, 65);
-            pair<TileMap::iterator, TileMap::iterator> globalRange = map_iter->second->TileEntries.equal_range(globalTileID);
-            char isTiled = globalRange.first == globalRange.second; // only maps without terrain (tiles) have global WMO
-            if (success && fwrite(&isTiled, sizeof(char), 1, mapfile) != 1) success = false;
-            // Nodes
-            if (success && fwrite("NODE", 4, 1, mapfile) != 1) success = false;
-            if (success) success = pTree.writeToFile(mapfile);
-            // global map spawns (WDT), if any (most instances)
-            if (success && fwrite("GOBJ", 4, 1, mapfile) != 1) success = false;
-
-            for (TileMap::iterator glob = globalRange.first; glob != globalRange.second && success; ++glob)
-                success = ModelSpawn::writeToFile(mapfile, map_iter->second->UniqueEntries[glob->second]);
-
-            fclose(mapfile);
-
-            // <====
-
-            // write map tile files, similar to ADT files, only with extra BSP tree node info
-            TileMap& tileEntries = map_iter->second->TileEntries;
-            TileMap::iterator tile;
-            for (tile = tileEntries.begin(); tile != tileEntries.end(); ++tile)
+        for (TileMap::iterator glob = globalRange.first; glob != globalRange.second && success; ++glob)
+            success = ModelSpawn::writeToFile(mapfile, spawns.UniqueEntries[glob->second]);
+
+        fclose(mapfile);
+
+        if (success)
+            success = compressOutput(mapfilename.str());
+
+        // <====
+
+        // write map tile files, similar to ADT files, only with extra BSP tree node info
+        TileMap& tileEntries = spawns.TileEntries;
+        TileMap::iterator tile;
+        for (tile = tileEntries.begin(); tile != tileEntries.end(); ++tile)
+        {
+            const ModelSpawn& spawn = spawns.UniqueEntries[tile->second];
+            if (spawn.flags & MOD_WORLDSPAWN) // WDT spawn, saved as tile 65/65 currently...
+                continue;
+            uint32 nSpawns = tileEntries.count(tile->first);
+            std::stringstream tilefilename;
+            tilefilename.fill('0');
+            tilefilename << iDestDir << '/' << std::setw(3) << mapId << '_';
+            uint32 x, y;
+            StaticMapTree::unpackTileID(tile->first, x, y);
+            tilefilename << std::setw(2) << x << '_' << std::setw(2) << y << ".vmtile";
+            if (FILE* tilefile = fopen(tilefilename.str().c_str(), "wb"))
             {
-                const ModelSpawn& spawn = map_iter->second->UniqueEntries[tile->second];
-                if (spawn.flags & MOD_WORLDSPAWN) // WDT spawn, saved as tile 65/65 currently...
-                    continue;
-                uint32 nSpawns = tileEntries.count(tile->first);
-                std::stringstream tilefilename;
-                tilefilename.fill('0');
-                tilefilename << iDestDir << '/' << std::setw(3) << map_iter->first << '_';
-                uint32 x, y;
-                StaticMapTree::unpackTileID(tile->first, x, y);
-                tilefilename << std::setw(2) << x << '_' << std::setw(2) << y << ".vmtile";
-                if (FILE* tilefile = fopen(tilefilename.str().c_str(), "wb"))
+                // file header
+                if (success && fwrite(VMAP_MAGIC, 1, 8, tilefile) != 8) success = false;
+                // write number of tile spawns
+                if (success && fwrite(&nSpawns, sizeof(uint32), 1, tilefile) != 1) success = false;
+                // write tile spawns
+                for (uint32 s = 0; s < nSpawns; ++s)
                 {
-                    // file header
-                    if (success && fwrite(VMAP_MAGIC, 1, 8, tilefile) != 8) success = false;
-                    // write number of tile spawns
-                    if (success && fwrite(&nSpawns, sizeof(uint32), 1, tilefile) != 1) success = false;
-                    // write tile spawns
-                    for (uint32 s = 0; s < nSpawns; ++s)
-                    {
-                        if (s)
-                            ++tile;
-                        const ModelSpawn& spawn2 = map_iter->second->UniqueEntries[tile->second];
-                        success = success && ModelSpawn::writeToFile(tilefile, spawn2);
-                        // MapTree nodes to update when loading tile:
-                        std::map<uint32, uint32>::iterator nIdx = modelNodeIdx.find(spawn2.ID);
-                        if (success && fwrite(&nIdx->second, sizeof(uint32), 1, tilefile) != 1) success = false;
-                    }
-                    fclose(tilefile);
+                    if (s)
+                        ++tile;
+                    const ModelSpawn& spawn2 = spawns.UniqueEntries[tile->second];
+                    success = success && ModelSpawn::writeToFile(tilefile, spawn2);
+                    // MapTree nodes to update when loading tile:
+                    std::map<uint32, uint32>::iterator nIdx = modelNodeIdx.find(spawn2.ID);
+                    if (success && fwrite(&nIdx->second, sizeof(uint32), 1, tilefile) != 1) success = false;
                 }
+                fclose(tilefile);
+
+                if (success)
+                    success = compressOutput(tilefilename.str());
             }
-            // break; //test, extract only first map; TODO: remvoe this line
         }
 
-        // add an object models, listed in temp_gameobject_models file
-        exportGameobjectModels();
-        // export objects
-        std::cout << "\nConverting Model Files" << std::endl;
-        for (std::set<std::string>::iterator mfile = spawnedModelFiles.begin(); mfile != spawnedModelFiles.end(); ++mfile)
+        return success;
+    }
+
+    bool TileAssembler::compressOutput(std::string const& fileName)
+    {
+        if (!iCompress)
+            return true;
+
+        if (!Warhead::DataCompression::CompressFile(fileName))
         {
-            std::cout << "Converting " << *mfile << std::endl;
-            if (!convertRawFile(*mfile))
-            {
-                std::cout << "error converting " << *mfile << std::endl;
-                success = false;
-                break;
-            }
+            printf("Cannot compress %s\n", fileName.c_str());
+            return false;
         }
 
-        //cleanup:
-        for (MapData::iterator map_iter = mapData.begin(); map_iter != mapData.end(); ++map_iter)
-            delete map_iter->second;
-        return success;
+        return true;
+    }
+
+    void TileAssembler::addSpawnedModelFiles(std::set<std::string> const& modelFiles)
+    {
+        std::lock_guard<std::mutex> lock(spawnedModelFilesLock);
+        spawnedModelFiles.insert(modelFiles.begin(), modelFiles.end());
+    }
+
+    std::shared_ptr<WorldModel_Raw const> TileAssembler::getRawModel(std::string const& modelFilename)
+    {
+        {
+            std::lock_guard<std::mutex> lock(rawModelsLock);
+            auto itr = rawModels.find(modelFilename);
+            if (itr != rawModels.end())
+                return itr->second;
+        }
+
+        // read outside the lock, at worst two threads read the same model at once
+        std::shared_ptr<WorldModel_Raw> raw_model = std::make_shared<WorldModel_Raw>();
+        if (!raw_model->Read(modelFilename.c_str()))
+            return nullptr;
+
+        std::lock_guard<std::mutex> lock(rawModelsLock);
+        return rawModels.emplace(modelFilename, raw_model).first->second;
     }
 
     bool TileAssembler::readMapSpawns()
@@ -255,11 +384,12 @@ namespace VMAP
         modelPosition.iScale = spawn.iScale;
         modelPosition.init();
 
-        WorldModel_Raw raw_model;
-        if (!raw_model.Read(modelFilename.c_str()))
+        // M2 models are placed many times, every file is only read once
+        std::shared_ptr<WorldModel_Raw const> raw_model = getRawModel(modelFilename);
+        if (!raw_model)
             return false;
 
-        uint32 groups = raw_model.groupsArray.size();
+        uint32 groups = raw_model->groupsArray.size();
         if (groups != 1)
             printf("Warning: '%s' does not seem to be a M2 model!\n", modelFilename.c_str());
 
@@ -268,7 +398,7 @@ namespace VMAP
 
         for (uint32 g = 0; g < groups; ++g) // should be only one for M2 files...
         {
-            std::vector<Vector3>& vertices = raw_model.groupsArray[g].vertexArray;
+            std::vector<Vector3> const& vertices = raw_model->groupsArray[g].vertexArray;
 
             if (vertices.empty())
             {
@@ -332,7 +462,8 @@ namespace VMAP
             model.setGroupModels(groupsArray);
         }
 
-        success = model.writeFile(iDestDir + "/" + pModelFilename + ".vmo");
+        std::string const modelFilename = iDestDir + "/" + pModelFilename + ".vmo";
+        success = model.writeFile(modelFilename) && compressOutput(modelFilename);
         //std::cout << "readRawFile2: '" << pModelFilename << "' tris: " << nElements << " nodes: " << nNodes << std::endl;
         return success;
     }
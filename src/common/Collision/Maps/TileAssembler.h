@@ -20,8 +20,12 @@
 
 #include <G3D/Vector3.h>
 #include <G3D/Matrix3.h>
+#include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <set>
+#include <unordered_map>
 
 #include "ModelInstance.h"
 #include "WorldModel.h"
@@ -98,7 +102,19 @@ namespace VMAP
         G3D::Table<std::string, unsigned int > iUniqueNameIds;
         unsigned int iCurrentUniqueNameId;
         MapData mapData;
+        unsigned int iThreads;
+        bool iCompress;
+
+        // maps and models are converted on several threads
+        std::mutex spawnedModelFilesLock;
         std::set<std::string> spawnedModelFiles;
+        std::mutex rawModelsLock;
+        std::unordered_map<std::string, std::shared_ptr<WorldModel_Raw>> rawModels;
+
+        bool convertMap(uint32 mapId, MapSpawns& spawns);
+        void addSpawnedModelFiles(std::set<std::string> const& modelFiles);
+        std::shared_ptr<WorldModel_Raw const> getRawModel(std::string const& modelFilename);
+        bool compressOutput(std::string const& fileName);
 
     public:
         TileAssembler(const std::string& pSrcDirName, const std::string& pDestDirName);
@@ -111,6 +127,8 @@ namespace VMAP
 
         bool convertRawFile(const std::string& pModelFilename);
         void setModelNameFilterMethod(bool (*pFilterMethod)(char* pName)) { iFilterMethod = pFilterMethod; }
+        void setThreads(unsigned int threads) { iThreads = std::max(threads, 1u); }
+        void setCompression(bool compress) { iCompress = compress; }
         std::string getDirEntryNameFromModName(unsigned int pMapId, const std::string& pModPosName);
     };
 
@@ -19,6 +19,7 @@
 #include "WorldModel.h"
 #include "MapTree.h"
 #include "VMapDefinitions.h"
+#include "MappedFile.h"
 
 using G3D::Vector3;
 using G3D::Ray;
@@ -38,8 +39,7 @@ namespace VMAP
             //std::cout << "<object not loaded>\n";
             return false;
         }
-        float time = pRay.intersectionTime(iBound);
-        if (time == G3D::inf())
+        if (!IntersectRayAABox(pRay, iBound, pMaxDist))
         {
             //            std::cout << "Ray does not hit '" << name << "'\n";
 
@@ -196,6 +196,45 @@ namespace VMAP
         return true;
     }
 
+    bool ModelSpawn::readFromFile(MappedFileReader& reader, ModelSpawn& spawn)
+    {
+        // end of the spawn list
+        if (!reader.Read(spawn.flags))
+            return false;
+
+        uint32 nameLen = 0;
+        bool result = reader.Read(spawn.adtId) && reader.Read(spawn.ID) &&
+            reader.Read(&spawn.iPos, sizeof(float) * 3) && reader.Read(&spawn.iRot, sizeof(float) * 3) && reader.Read(spawn.iScale);
+        if (result && (spawn.flags & MOD_HAS_BOUND)) // only WMOs have bound in MPQ, only available after computation
+        {
+            Vector3 bLow, bHigh;
+            result = reader.Read(&bLow, sizeof(float) * 3) && reader.Read(&bHigh, sizeof(float) * 3);
+            spawn.iBound = G3D::AABox(bLow, bHigh);
+        }
+
+        if (!result || !reader.Read(nameLen))
+        {
+            std::cout << "Error reading ModelSpawn!\n";
+            return false;
+        }
+
+        if (nameLen > 500) // file names should never be that long, must be file error
+        {
+            std::cout << "Error reading ModelSpawn, file name too long!\n";
+            return false;
+        }
+
+        char const* name = reader.ReadArray<char>(nameLen);
+        if (!name)
+        {
+            std::cout << "Error reading ModelSpawn!\n";
+            return false;
+        }
+
+        spawn.name.assign(name, nameLen);
+        return true;
+    }
+
     bool ModelSpawn::writeToFile(FILE* wf, const ModelSpawn& spawn)
     {
         uint32 check = 0;
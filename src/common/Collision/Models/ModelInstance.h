@@ -25,6 +25,8 @@
 
 #include "Define.h"
 
+class MappedFileReader;
+
 namespace VMAP
 {
     class WorldModel;
@@ -56,6 +58,7 @@ namespace VMAP
         const G3D::AABox& getBounds() const { return iBound; }
 
         static bool readFromFile(FILE* rf, ModelSpawn& spawn);
+        static bool readFromFile(MappedFileReader& reader, ModelSpawn& spawn);
         static bool writeToFile(FILE* rw, const ModelSpawn& spawn);
     };
 
@@ -30,7 +30,7 @@ template<> struct BoundsTrait<VMAP::GroupModel>
 
 namespace VMAP
 {
-    bool IntersectTriangle(const MeshTriangle& tri, std::vector<Vector3>::const_iterator points, const G3D::Ray& ray, float& distance)
+    bool IntersectTriangle(const MeshTriangle& tri, const Vector3* points, const G3D::Ray& ray, float& distance)
     {
         static const float EPS = 1e-5f;
 
@@ -197,12 +197,18 @@ namespace VMAP
         return true;
     }
 
+    // the flags are padded to 4 bytes, so the following group data stays aligned in the file
+    static uint32 GetLiquidFlagsPadding(uint32 size)
+    {
+        return (4 - size % 4) % 4;
+    }
+
     uint32 WmoLiquid::GetFileSize()
     {
         return 2 * sizeof(uint32) +
                sizeof(Vector3) +
                (iTilesX + 1) * (iTilesY + 1) * sizeof(float) +
-               iTilesX * iTilesY;
+               iTilesX * iTilesY + GetLiquidFlagsPadding(iTilesX * iTilesY);
     }
 
     bool WmoLiquid::writeToFile(FILE* wf)
@@ -218,29 +224,40 @@ namespace VMAP
             {
                 size = iTilesX * iTilesY;
                 result = fwrite(iFlags, sizeof(uint8), size, wf) == size;
+
+                static const uint8 padding[4] = { };
+                uint32 paddingSize = GetLiquidFlagsPadding(size);
+                if (result && paddingSize)
+                    result = fwrite(padding, sizeof(uint8), paddingSize, wf) == paddingSize;
             }
         }
 
         return result;
     }
 
-    bool WmoLiquid::readFromFile(FILE* rf, WmoLiquid*& out)
+    bool WmoLiquid::readFromFile(MappedFileReader& reader, WmoLiquid*& out)
     {
         bool result = false;
         WmoLiquid* liquid = new WmoLiquid();
 
-        if (fread(&liquid->iTilesX, sizeof(uint32), 1, rf) == 1 &&
-                fread(&liquid->iTilesY, sizeof(uint32), 1, rf) == 1 &&
-                fread(&liquid->iCorner, sizeof(Vector3), 1, rf) == 1 &&
-                fread(&liquid->iType, sizeof(uint32), 1, rf) == 1)
+        if (reader.Read(liquid->iTilesX) &&
+                reader.Read(liquid->iTilesY) &&
+                reader.Read(liquid->iCorner) &&
+                reader.Read(liquid->iType))
         {
-            uint32 size = (liquid->iTilesX + 1) * (liquid->iTilesY + 1);
-            liquid->iHeight = new float[size];
-            if (fread(liquid->iHeight, sizeof(float), size, rf) == size)
+            uint64 size = uint64(liquid->iTilesX + 1) * (liquid->iTilesY + 1);
+            if (size <= reader.GetRemaining() / sizeof(float))
             {
-                size = liquid->iTilesX * liquid->iTilesY;
-                liquid->iFlags = new uint8[size];
-                result = fread(liquid->iFlags, sizeof(uint8), size, rf) == size;
+                liquid->iHeight = new float[size];
+                if (reader.Read(liquid->iHeight, size * sizeof(float)))
+                {
+                    size = uint64(liquid->iTilesX) * liquid->iTilesY;
+                    if (size <= reader.GetRemaining())
+                    {
+                        liquid->iFlags = new uint8[size];
+                        result = reader.Read(liquid->iFlags, size) && reader.Skip(GetLiquidFlagsPadding(uint32(size)));
+                    }
+                }
             }
         }
 
@@ -261,18 +278,34 @@ namespace VMAP
 
     // ===================== GroupModel ==================================
 
-    GroupModel::GroupModel(const GroupModel& other):
-        iBound(other.iBound), iMogpFlags(other.iMogpFlags), iGroupWMOID(other.iGroupWMOID),
-        vertices(other.vertices), triangles(other.triangles), meshTree(other.meshTree), iLiquid(0)
+    GroupModel::GroupModel(const GroupModel& other): iMogpFlags(0), iGroupWMOID(0), iVertices(nullptr), iNumVertices(0),
+        iTriangles(nullptr), iNumTriangles(0), iLiquid(0)
+    {
+        *this = other; // use assignment operator...
+    }
+
+    GroupModel& GroupModel::operator=(const GroupModel& other)
     {
-        if (other.iLiquid)
-            iLiquid = new WmoLiquid(*other.iLiquid);
+        if (this == &other)
+            return *this;
+        iBound = other.iBound;
+        iMogpFlags = other.iMogpFlags;
+        iGroupWMOID = other.iGroupWMOID;
+        vertices.assign(other.iVertices, other.iVertices + other.iNumVertices);
+        triangles.assign(other.iTriangles, other.iTriangles + other.iNumTriangles);
+        useOwnedMeshData();
+        meshTree = other.meshTree;
+        meshPacket = other.meshPacket;
+        delete iLiquid;
+        iLiquid = other.iLiquid ? new WmoLiquid(*other.iLiquid) : 0;
+        return *this;
     }
 
     void GroupModel::setMeshData(std::vector<Vector3>& vert, std::vector<MeshTriangle>& tri)
     {
         vertices.swap(vert);
         triangles.swap(tri);
+        useOwnedMeshData();
         TriBoundFunc bFunc(vertices);
         meshTree.build(triangles, bFunc);
     }
@@ -288,21 +321,21 @@ namespace VMAP
 
         // write vertices
         if (result && fwrite("VERT", 1, 4, wf) != 4) result = false;
-        count = vertices.size();
+        count = iNumVertices;
         chunkSize = sizeof(uint32) + sizeof(Vector3) * count;
         if (result && fwrite(&chunkSize, sizeof(uint32), 1, wf) != 1) result = false;
         if (result && fwrite(&count, sizeof(uint32), 1, wf) != 1) result = false;
         if (!count) // models without (collision) geometry end here, unsure if they are useful
             return result;
-        if (result && fwrite(&vertices[0], sizeof(Vector3), count, wf) != count) result = false;
+        if (result && fwrite(iVertices, sizeof(Vector3), count, wf) != count) result = false;
 
         // write triangle mesh
         if (result && fwrite("TRIM", 1, 4, wf) != 4) result = false;
-        count = triangles.size();
+        count = iNumTriangles;
         chunkSize = sizeof(uint32) + sizeof(MeshTriangle) * count;
         if (result && fwrite(&chunkSize, sizeof(uint32), 1, wf) != 1) result = false;
         if (result && fwrite(&count, sizeof(uint32), 1, wf) != 1) result = false;
-        if (result && fwrite(&triangles[0], sizeof(MeshTriangle), count, wf) != count) result = false;
+        if (result && fwrite(iTriangles, sizeof(MeshTriangle), count, wf) != count) result = false;
 
         // write mesh BIH
         if (result && fwrite("MBIH", 1, 4, wf) != 4) result = false;
@@ -323,7 +356,7 @@ namespace VMAP
         return result;
     }
 
-    bool GroupModel::readFromFile(FILE* rf)
+    bool GroupModel::readFromFile(MappedFileReader& reader)
     {
         char chunk[8];
         bool result = true;
@@ -331,71 +364,94 @@ namespace VMAP
         uint32 count = 0;
         triangles.clear();
         vertices.clear();
+        useOwnedMeshData();
+        meshPacket.Clear();
         delete iLiquid;
         iLiquid = NULL;
 
-        if (result && fread(&iBound, sizeof(G3D::AABox), 1, rf) != 1) result = false;
-        if (result && fread(&iMogpFlags, sizeof(uint32), 1, rf) != 1) result = false;
-        if (result && fread(&iGroupWMOID, sizeof(uint32), 1, rf) != 1) result = false;
+        if (result && !reader.Read(iBound)) result = false;
+        if (result && !reader.Read(iMogpFlags)) result = false;
+        if (result && !reader.Read(iGroupWMOID)) result = false;
 
-        // read vertices
-        if (result && !readChunk(rf, chunk, "VERT", 4)) result = false;
-        if (result && fread(&chunkSize, sizeof(uint32), 1, rf) != 1) result = false;
-        if (result && fread(&count, sizeof(uint32), 1, rf) != 1) result = false;
+        // read vertices, used in place
+        if (result && !readChunk(reader, chunk, "VERT", 4)) result = false;
+        if (result && !reader.Read(chunkSize)) result = false;
+        if (result && !reader.Read(count)) result = false;
         if (!count) // models without (collision) geometry end here, unsure if they are useful
             return result;
-        if (result) vertices.resize(count);
-        if (result && fread(&vertices[0], sizeof(Vector3), count, rf) != count) result = false;
+        if (result && !(iVertices = reader.ReadArray<Vector3>(count))) result = false;
+        if (result) iNumVertices = count;
 
-        // read triangle mesh
-        if (result && !readChunk(rf, chunk, "TRIM", 4)) result = false;
-        if (result && fread(&chunkSize, sizeof(uint32), 1, rf) != 1) result = false;
-        if (result && fread(&count, sizeof(uint32), 1, rf) != 1) result = false;
-        if (result) triangles.resize(count);
-        if (result && fread(&triangles[0], sizeof(MeshTriangle), count, rf) != count) result = false;
+        // read triangle mesh, used in place
+        if (result && !readChunk(reader, chunk, "TRIM", 4)) result = false;
+        if (result && !reader.Read(chunkSize)) result = false;
+        if (result && !reader.Read(count)) result = false;
+        if (result && !(iTriangles = reader.ReadArray<MeshTriangle>(count))) result = false;
+        if (result) iNumTriangles = count;
 
         // read mesh BIH
-        if (result && !readChunk(rf, chunk, "MBIH", 4)) result = false;
-        if (result) result = meshTree.readFromFile(rf);
+        if (result && !readChunk(reader, chunk, "MBIH", 4)) result = false;
+        if (result) result = meshTree.readFromFile(reader);
+        if (result) meshPacket.Build(iVertices, iNumVertices, iTriangles, iNumTriangles, meshTree.getObjects());
 
-        // write liquid data
-        if (result && !readChunk(rf, chunk, "LIQU", 4)) result = false;
-        if (result && fread(&chunkSize, sizeof(uint32), 1, rf) != 1) result = false;
+        // read liquid data
+        if (result && !readChunk(reader, chunk, "LIQU", 4)) result = false;
+        if (result && !reader.Read(chunkSize)) result = false;
         if (result && chunkSize > 0)
-            result = WmoLiquid::readFromFile(rf, iLiquid);
+            result = WmoLiquid::readFromFile(reader, iLiquid);
+
+        if (!result)
+            useOwnedMeshData();
         return result;
     }
 
     struct GModelRayCallback
     {
-        GModelRayCallback(const std::vector<MeshTriangle>& tris, const std::vector<Vector3>& vert):
-            vertices(vert.begin()), triangles(tris.begin()), hit(false) { }
+        GModelRayCallback(const MeshTriangle* tris, const Vector3* vert, const TrianglePacket* packet = nullptr):
+            vertices(vert), triangles(tris), packet(packet), kernel(GetCollisionKernel()), hit(false) { }
         bool operator()(const G3D::Ray& ray, uint32 entry, float& distance, bool /*StopAtFirstHit*/)
         {
             bool result = IntersectTriangle(triangles[entry], vertices, ray, distance);
             if (result)  hit = true;
             return hit;
         }
-        std::vector<Vector3>::const_iterator vertices;
-        std::vector<MeshTriangle>::const_iterator triangles;
+        // called by the BIH for a whole leaf, the packet positions match the BIH object list
+        bool IntersectLeaf(const G3D::Ray& ray, const std::vector<uint32>& objects, uint32 first, uint32 count, float& distance, bool stopAtFirstHit)
+        {
+            if (packet && !packet->IsEmpty() && kernel != COLLISION_KERNEL_SCALAR)
+            {
+                if (packet->IntersectRay(ray, first, count, distance, kernel))
+                    hit = true;
+                return hit;
+            }
+
+            for (uint32 i = 0; i < count; ++i)
+                if ((*this)(ray, objects[first + i], distance, stopAtFirstHit) && stopAtFirstHit)
+                    return true;
+            return hit;
+        }
+        const Vector3* vertices;
+        const MeshTriangle* triangles;
+        const TrianglePacket* packet;
+        CollisionKernel kernel;
         bool hit;
     };
 
     bool GroupModel::IntersectRay(const G3D::Ray& ray, float& distance, bool stopAtFirstHit) const
     {
-        if (triangles.empty())
+        if (!iNumTriangles)
             return false;
 
-        GModelRayCallback callback(triangles, vertices);
+        GModelRayCallback callback(iTriangles, iVertices, &meshPacket);
         meshTree.intersectRay(ray, callback, distance, stopAtFirstHit);
         return callback.hit;
     }
 
     bool GroupModel::IsInsideObject(const Vector3& pos, const Vector3& down, float& z_dist) const
     {
-        if (triangles.empty() || !iBound.contains(pos))
+        if (!iNumTriangles || !iBound.contains(pos))
             return false;
-        GModelRayCallback callback(triangles, vertices);
+        GModelRayCallback callback(iTriangles, iVertices);
         Vector3 rPos = pos - 0.1f * down;
         float dist = G3D::inf();
         G3D::Ray ray(rPos, down);
@@ -421,11 +477,21 @@ namespace VMAP
 
     void GroupModel::getMeshData(std::vector<G3D::Vector3>& outVertices, std::vector<MeshTriangle>& outTriangles, WmoLiquid*& liquid)
     {
-        outVertices = vertices;
-        outTriangles = triangles;
+        outVertices.assign(iVertices, iVertices + iNumVertices);
+        outTriangles.assign(iTriangles, iTriangles + iNumTriangles);
         liquid = iLiquid;
     }
 
+    std::size_t GroupModel::GetMemoryUsage() const
+    {
+        // geometry used from the mapped file is not counted, it lives in the shared page cache
+        std::size_t size = vertices.capacity() * sizeof(G3D::Vector3) + triangles.capacity() * sizeof(MeshTriangle) + meshTree.GetMemoryUsage() + meshPacket.GetMemoryUsage();
+        if (iLiquid)
+            size += sizeof(WmoLiquid) + iLiquid->GetFileSize();
+
+        return size;
+    }
+
     // ===================== WorldModel ==================================
 
     void WorldModel::setGroupModels(std::vector<GroupModel>& models)
@@ -567,37 +633,45 @@ namespace VMAP
 
     bool WorldModel::readFile(const std::string& filename)
     {
-        FILE* rf = fopen(filename.c_str(), "rb");
-        if (!rf)
+        // the groups may still point into an old mapping
+        groupModels.clear();
+
+        if (!iFile.Open(filename))
             return false;
 
+        MappedFileReader reader(iFile);
+
         bool result = true;
         uint32 chunkSize = 0;
         uint32 count = 0;
         char chunk[8];                          // Ignore the added magic header
-        if (!readChunk(rf, chunk, VMAP_MAGIC, 8)) result = false;
+        if (!readChunk(reader, chunk, VMAP_MAGIC, 8)) result = false;
 
-        if (result && !readChunk(rf, chunk, "WMOD", 4)) result = false;
-        if (result && fread(&chunkSize, sizeof(uint32), 1, rf) != 1) result = false;
-        if (result && fread(&RootWMOID, sizeof(uint32), 1, rf) != 1) result = false;
+        if (result && !readChunk(reader, chunk, "WMOD", 4)) result = false;
+        if (result && !reader.Read(chunkSize)) result = false;
+        if (result && !reader.Read(RootWMOID)) result = false;
 
         // read group models
-        if (result && readChunk(rf, chunk, "GMOD", 4))
+        if (result && readChunk(reader, chunk, "GMOD", 4))
         {
-            //if (fread(&chunkSize, sizeof(uint32), 1, rf) != 1) result = false;
-
-            if (result && fread(&count, sizeof(uint32), 1, rf) != 1) result = false;
+            if (result && !reader.Read(count)) result = false;
+            // every group takes more than its bound, sanity check before allocating
+            if (result && count > reader.GetRemaining() / sizeof(G3D::AABox)) result = false;
             if (result) groupModels.resize(count);
-            //if (result && fread(&groupModels[0], sizeof(GroupModel), count, rf) != count) result = false;
             for (uint32 i = 0; i < count && result; ++i)
-                result = groupModels[i].readFromFile(rf);
+                result = groupModels[i].readFromFile(reader);
 
             // read group BIH
-            if (result && !readChunk(rf, chunk, "GBIH", 4)) result = false;
-            if (result) result = groupTree.readFromFile(rf);
+            if (result && !readChunk(reader, chunk, "GBIH", 4)) result = false;
+            if (result) result = groupTree.readFromFile(reader);
+        }
+
+        if (!result)
+        {
+            groupModels.clear();
+            iFile.Close();
         }
 
-        fclose(rf);
         return result;
     }
 
@@ -605,4 +679,13 @@ namespace VMAP
     {
         outGroupModels = groupModels;
     }
+
+    std::size_t WorldModel::GetMemoryUsage() const
+    {
+        std::size_t size = sizeof(WorldModel) + groupModels.capacity() * sizeof(GroupModel) + groupTree.GetMemoryUsage();
+        for (GroupModel const& groupModel : groupModels)
+            size += groupModel.GetMemoryUsage();
+
+        return size;
+    }
 }
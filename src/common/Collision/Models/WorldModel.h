@@ -23,8 +23,10 @@
 #include <G3D/AABox.h>
 #include <G3D/Ray.h>
 #include "BoundingIntervalHierarchy.h"
+#include "CollisionKernels.h"
 
 #include "Define.h"
+#include "MappedFile.h"
 
 namespace VMAP
 {
@@ -56,7 +58,7 @@ namespace VMAP
         uint8* GetFlagsStorage() { return iFlags; }
         uint32 GetFileSize();
         bool writeToFile(FILE* wf);
-        static bool readFromFile(FILE* rf, WmoLiquid*& liquid);
+        static bool readFromFile(MappedFileReader& reader, WmoLiquid*& liquid);
         void getPosInfo(uint32& tilesX, uint32& tilesY, G3D::Vector3& corner) const;
     private:
         WmoLiquid(): iTilesX(0), iTilesY(0), iType(0), iHeight(0), iFlags(0) { }
@@ -72,11 +74,13 @@ namespace VMAP
     class WH_COMMON_API GroupModel
     {
     public:
-        GroupModel(): iMogpFlags(0), iGroupWMOID(0), iLiquid(0) { }
+        GroupModel(): iMogpFlags(0), iGroupWMOID(0), iVertices(nullptr), iNumVertices(0), iTriangles(nullptr), iNumTriangles(0), iLiquid(0) { }
         GroupModel(const GroupModel& other);
         GroupModel(uint32 mogpFlags, uint32 groupWMOID, const G3D::AABox& bound):
-            iBound(bound), iMogpFlags(mogpFlags), iGroupWMOID(groupWMOID), iLiquid(0) { }
+            iBound(bound), iMogpFlags(mogpFlags), iGroupWMOID(groupWMOID), iVertices(nullptr), iNumVertices(0), iTriangles(nullptr), iNumTriangles(0), iLiquid(0) { }
         ~GroupModel() { delete iLiquid; }
+        //! copies always own their geometry, even if other uses it from a mapped file
+        GroupModel& operator=(const GroupModel& other);
 
         //! pass mesh data to object and create BIH. Passed vectors get get swapped with old geometry!
         void setMeshData(std::vector<G3D::Vector3>& vert, std::vector<MeshTriangle>& tri);
@@ -86,18 +90,33 @@ namespace VMAP
         bool GetLiquidLevel(const G3D::Vector3& pos, float& liqHeight) const;
         uint32 GetLiquidType() const;
         bool writeToFile(FILE* wf);
-        bool readFromFile(FILE* rf);
+        //! vertices and triangles are used in place, the mapping must outlive this group
+        bool readFromFile(MappedFileReader& reader);
         const G3D::AABox& GetBound() const { return iBound; }
         uint32 GetMogpFlags() const { return iMogpFlags; }
         uint32 GetWmoID() const { return iGroupWMOID; }
         void getMeshData(std::vector<G3D::Vector3>& outVertices, std::vector<MeshTriangle>& outTriangles, WmoLiquid*& liquid);
+        std::size_t GetMemoryUsage() const;
     protected:
+        void useOwnedMeshData()
+        {
+            iVertices = vertices.data();
+            iNumVertices = vertices.size();
+            iTriangles = triangles.data();
+            iNumTriangles = triangles.size();
+        }
+
         G3D::AABox iBound;
         uint32 iMogpFlags;// 0x8 outdor; 0x2000 indoor
         uint32 iGroupWMOID;
-        std::vector<G3D::Vector3> vertices;
+        std::vector<G3D::Vector3> vertices;                 // owned geometry, empty if it is used from the mapped .vmo
         std::vector<MeshTriangle> triangles;
+        const G3D::Vector3* iVertices;                      // geometry in use, points into vertices or the mapped .vmo
+        uint32 iNumVertices;
+        const MeshTriangle* iTriangles;
+        uint32 iNumTriangles;
         BIH meshTree;
+        TrianglePacket meshPacket;                          // triangles in meshTree leaf order for the SIMD kernels, only built when loading
         WmoLiquid* iLiquid;
     };
 
@@ -114,12 +133,15 @@ namespace VMAP
         bool IntersectPoint(const G3D::Vector3& p, const G3D::Vector3& down, float& dist, AreaInfo& info) const;
         bool GetLocationInfo(const G3D::Vector3& p, const G3D::Vector3& down, float& dist, LocationInfo& info) const;
         bool writeFile(const std::string& filename);
+        //! maps the file, the geometry of all groups stays in the mapping (shared through the OS page cache)
         bool readFile(const std::string& filename);
         void getGroupModels(std::vector<GroupModel>& outGroupModels);
+        std::size_t GetMemoryUsage() const;
     protected:
         uint32 RootWMOID;
         std::vector<GroupModel> groupModels;
         BIH groupTree;
+        MappedFile iFile;
     };
 } // namespace VMAP
 
@@ -21,13 +21,16 @@
 
 #define LIQUID_TILE_SIZE (533.333f / 128.f)
 
+class MappedFileReader;
+
 namespace VMAP
 {
-    const char VMAP_MAGIC[] = "VMAP_4.4";
+    const char VMAP_MAGIC[] = "VMAP_4.5";
     const char RAW_VMAP_MAGIC[] = "VMAP044";                // used in extracted vmap files with raw data
     const char GAMEOBJECT_MODELS[] = "GameObjectModels.dtree";
 
     // defined in TileAssembler.cpp currently...
     bool readChunk(FILE* rf, char* dest, const char* compare, uint32 len);
+    bool readChunk(MappedFileReader& reader, char* dest, const char* compare, uint32 len);
 }
 #endif
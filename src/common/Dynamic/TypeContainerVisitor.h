@@ -103,6 +103,8 @@ public:
         VisitorHelper(i_visitor, c);
     }
 
+    VISITOR& GetVisitor() const { return i_visitor; }
+
 private:
     VISITOR& i_visitor;
 };
@@ -151,7 +151,7 @@ MetricStopWatch<LoggerType> MakeMetricStopWatch(LoggerType&& loggerFunc)
 
 #if defined PERFORMANCE_PROFILING || defined WITHOUT_METRICS
 #define WH_METRIC_EVENT(category, title, description) ((void)0)
-#define WH_METRIC_VALUE(category, value) ((void)0)
+#define WH_METRIC_VALUE(category, value, ...) ((void)0)
 #define WH_METRIC_TIMER(category, ...) ((void)0)
 #else
 #  if WH_PLATFORM != WH_PLATFORM_WINDOWS
@@ -25,7 +25,7 @@ template <class T, typename StorageType = std::deque<T>>
 class LockedQueue
 {
     //! Lock access to the queue.
-    std::mutex _lock;
+    mutable std::mutex _lock;
 
     //! Storage backing the queue.
     StorageType _queue;
@@ -142,7 +142,7 @@ public:
     }
 
     ///! Checks if we're empty or not with locks held
-    bool empty()
+    bool empty() const
     {
         std::lock_guard<std::mutex> lock(_lock);
         return _queue.empty();
@@ -0,0 +1,207 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "DataCompression.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <zlib.h>
+
+namespace Warhead
+{
+    namespace DataCompression
+    {
+        namespace
+        {
+            CompressedDataHeader const* GetHeader(uint8 const* data, std::size_t size)
+            {
+                if (!data || size < sizeof(CompressedDataHeader))
+                    return nullptr;
+
+                CompressedDataHeader const* header = reinterpret_cast<CompressedDataHeader const*>(data);
+                if (header->magic != COMPRESSED_DATA_MAGIC || header->version != COMPRESSED_DATA_VERSION)
+                    return nullptr;
+
+                if (header->blockCount > (size - sizeof(CompressedDataHeader)) / sizeof(CompressedDataBlock))
+                    return nullptr;
+
+                return header;
+            }
+
+            // no block holds more than COMPRESSED_DATA_BLOCK_SIZE, a larger size is a broken file
+            bool IsValidRawSize(CompressedDataHeader const* header)
+            {
+                return header->rawSize <= COMPRESSED_DATA_MAX_RAW_SIZE && header->rawSize <= uint64(header->blockCount) * COMPRESSED_DATA_BLOCK_SIZE;
+            }
+        }
+
+        bool IsCompressed(uint8 const* data, std::size_t size)
+        {
+            return GetHeader(data, size) != nullptr;
+        }
+
+        uint32 GetRawSize(uint8 const* data, std::size_t size)
+        {
+            CompressedDataHeader const* header = GetHeader(data, size);
+            return header && IsValidRawSize(header) ? header->rawSize : 0;
+        }
+
+        bool Decompress(uint8 const* data, std::size_t size, uint32 offset, uint32 count, uint8* dest)
+        {
+            CompressedDataHeader const* header = GetHeader(data, size);
+            if (!header || !IsValidRawSize(header) || offset > header->rawSize || count > header->rawSize - offset)
+                return false;
+
+            CompressedDataBlock const* blocks = reinterpret_cast<CompressedDataBlock const*>(data + sizeof(CompressedDataHeader));
+            std::size_t blockOffset = sizeof(CompressedDataHeader) + header->blockCount * sizeof(CompressedDataBlock);
+            uint32 rawOffset = 0;
+            uint32 end = offset + count;
+            std::vector<uint8> partial;
+
+            for (uint32 i = 0; i < header->blockCount && rawOffset < end; ++i)
+            {
+                CompressedDataBlock const& block = blocks[i];
+                if (block.compressedSize > size - blockOffset || block.rawSize > COMPRESSED_DATA_BLOCK_SIZE)
+                    return false;
+
+                // only blocks overlapping the requested range are decompressed
+                if (rawOffset + block.rawSize > offset)
+                {
+                    uint32 from = std::max(offset, rawOffset) - rawOffset;
+                    uint32 to = std::min(end, rawOffset + block.rawSize) - rawOffset;
+
+                    uLongf rawSize = block.rawSize;
+                    uint8* target = dest + (rawOffset + from - offset);
+                    if (from != 0 || to != block.rawSize)
+                    {
+                        partial.resize(block.rawSize);
+                        target = partial.data();
+                    }
+
+                    if (uncompress(target, &rawSize, data + blockOffset, block.compressedSize) != Z_OK || rawSize != block.rawSize)
+                        return false;
+
+                    if (target == partial.data())
+                        memcpy(dest + (rawOffset + from - offset), partial.data() + from, to - from);
+                }
+
+                rawOffset += block.rawSize;
+                blockOffset += block.compressedSize;
+            }
+
+            return rawOffset >= end;
+        }
+
+        bool Compress(uint8 const* data, std::size_t size, std::vector<uint32> const& sectionOffsets, std::vector<uint8>& output)
+        {
+            if (size > COMPRESSED_DATA_MAX_RAW_SIZE)
+                return false;
+
+            // block boundaries, every section is split further into COMPRESSED_DATA_BLOCK_SIZE pieces
+            std::vector<uint32> boundaries(sectionOffsets);
+            boundaries.push_back(0);
+            boundaries.push_back(uint32(size));
+            std::sort(boundaries.begin(), boundaries.end());
+            boundaries.erase(std::unique(boundaries.begin(), boundaries.end()), boundaries.end());
+            boundaries.erase(std::remove_if(boundaries.begin(), boundaries.end(), [size](uint32 offset) { return offset > size; }), boundaries.end());
+
+            std::vector<CompressedDataBlock> blocks;
+            std::vector<uint8> compressed;
+            for (std::size_t i = 0; i + 1 < boundaries.size(); ++i)
+            {
+                for (uint32 offset = boundaries[i]; offset < boundaries[i + 1]; offset += COMPRESSED_DATA_BLOCK_SIZE)
+                {
+                    uint32 rawSize = std::min<uint32>(COMPRESSED_DATA_BLOCK_SIZE, boundaries[i + 1] - offset);
+
+                    uLongf compressedSize = compressBound(rawSize);
+                    std::size_t pos = compressed.size();
+                    compressed.resize(pos + compressedSize);
+                    if (compress2(compressed.data() + pos, &compressedSize, data + offset, rawSize, Z_BEST_COMPRESSION) != Z_OK)
+                        return false;
+
+                    compressed.resize(pos + compressedSize);
+                    blocks.push_back({ rawSize, uint32(compressedSize) });
+                }
+            }
+
+            CompressedDataHeader header;
+            header.magic = COMPRESSED_DATA_MAGIC;
+            header.version = COMPRESSED_DATA_VERSION;
+            header.rawSize = uint32(size);
+            header.blockCount = uint32(blocks.size());
+
+            output.resize(sizeof(header) + blocks.size() * sizeof(CompressedDataBlock) + compressed.size());
+            uint8* out = output.data();
+            memcpy(out, &header, sizeof(header));
+            out += sizeof(header);
+            if (!blocks.empty())
+                memcpy(out, blocks.data(), blocks.size() * sizeof(CompressedDataBlock));
+            out += blocks.size() * sizeof(CompressedDataBlock);
+            if (!compressed.empty())
+                memcpy(out, compressed.data(), compressed.size());
+
+            return true;
+        }
+
+        bool CompressFile(std::string const& fileName, std::vector<uint32> const& sectionOffsets)
+        {
+            FILE* file = fopen(fileName.c_str(), "rb");
+            if (!file)
+                return false;
+
+            std::vector<uint8> data;
+            uint8 buffer[64 * 1024];
+            std::size_t count;
+            while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+                data.insert(data.end(), buffer, buffer + count);
+
+            fclose(file);
+
+            // already compressed by an earlier run
+            if (IsCompressed(data.data(), data.size()))
+                return true;
+
+            std::vector<uint8> output;
+            if (!Compress(data.data(), data.size(), sectionOffsets, output))
+                return false;
+
+            // write to a temporary file first, a failed write must not leave a truncated file behind
+            std::string tempFileName = fileName + ".tmp";
+            file = fopen(tempFileName.c_str(), "wb");
+            if (!file)
+                return false;
+
+            bool written = fwrite(output.data(), 1, output.size(), file) == output.size();
+            written = fclose(file) == 0 && written;
+
+#if WH_PLATFORM == WH_PLATFORM_WINDOWS
+            // rename does not replace existing files on windows
+            if (written)
+                remove(fileName.c_str());
+#endif
+
+            if (!written || rename(tempFileName.c_str(), fileName.c_str()) != 0)
+            {
+                remove(tempFileName.c_str());
+                return false;
+            }
+
+            return true;
+        }
+    }
+}
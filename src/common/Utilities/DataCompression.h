@@ -0,0 +1,76 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _DATA_COMPRESSION_H
+#define _DATA_COMPRESSION_H
+
+#include "Define.h"
+#include <string>
+#include <vector>
+
+// Optional compressed container for the client data files (maps, vmaps and mmaps).
+// The contents are split into blocks that are compressed independently, block
+// boundaries follow the section offsets of the contained format, so a single
+// section (e.g. a file header) can be read without decompressing the rest.
+// Readers going through MappedFile decompress these files transparently.
+//
+// Layout: CompressedDataHeader, blockCount * CompressedDataBlock, compressed blocks
+#define COMPRESSED_DATA_MAGIC       0x5A434857  // 'WHCZ'
+#define COMPRESSED_DATA_VERSION     1
+#define COMPRESSED_DATA_BLOCK_SIZE  (64 * 1024)
+// containers claiming more are rejected before anything is allocated for them
+#define COMPRESSED_DATA_MAX_RAW_SIZE (1024 * 1024 * 1024)
+
+struct CompressedDataHeader
+{
+    uint32 magic;
+    uint32 version;
+    uint32 rawSize;
+    uint32 blockCount;
+};
+
+struct CompressedDataBlock
+{
+    uint32 rawSize;
+    uint32 compressedSize;
+};
+
+namespace Warhead
+{
+    namespace DataCompression
+    {
+        WH_COMMON_API bool IsCompressed(uint8 const* data, std::size_t size);
+
+        // Returns the size of the contained data, 0 if data is not a valid container. The size is
+        // at most blockCount * COMPRESSED_DATA_BLOCK_SIZE and COMPRESSED_DATA_MAX_RAW_SIZE
+        WH_COMMON_API uint32 GetRawSize(uint8 const* data, std::size_t size);
+
+        // Decompresses count bytes starting at offset of the contained data, only the blocks
+        // covering that range are touched
+        WH_COMMON_API bool Decompress(uint8 const* data, std::size_t size, uint32 offset, uint32 count, uint8* dest);
+
+        // Compresses data, no block spans one of sectionOffsets
+        WH_COMMON_API bool Compress(uint8 const* data, std::size_t size, std::vector<uint32> const& sectionOffsets, std::vector<uint8>& output);
+
+        // Replaces an uncompressed file with its compressed container, for the extractors.
+        // The container is written to fileName.tmp first, the original stays intact on failure
+        WH_COMMON_API bool CompressFile(std::string const& fileName, std::vector<uint32> const& sectionOffsets = { });
+    }
+}
+
+#endif
@@ -0,0 +1,204 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MappedFile.h"
+#include "DataCompression.h"
+#include <cstring>
+#include <limits>
+
+#if WH_PLATFORM == WH_PLATFORM_WINDOWS
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool MappedFile::Open(std::string const& filename)
+{
+    Close();
+
+    if (!Map(filename))
+        return false;
+
+    if (!Warhead::DataCompression::IsCompressed(_data, _size))
+        return true;
+
+    // bounded by the block count of the container and COMPRESSED_DATA_MAX_RAW_SIZE, 0 if the header is broken
+    uint32 rawSize = Warhead::DataCompression::GetRawSize(_data, _size);
+    if (!rawSize)
+    {
+        Unmap();
+        return false;
+    }
+
+    std::unique_ptr<uint8[]> decompressed(new uint8[rawSize]);
+    bool decompressedOk = Warhead::DataCompression::Decompress(_data, _size, 0, rawSize, decompressed.get());
+
+    // the mapping is not needed any more, everything is read from the decompressed copy
+    Unmap();
+
+    if (!decompressedOk)
+        return false;
+
+    _decompressed = std::move(decompressed);
+    _data = _decompressed.get();
+    _size = rawSize;
+    return true;
+}
+
+bool MappedFile::ReadHeader(std::string const& filename, void* dest, std::size_t size)
+{
+    MappedFile file;
+    if (!file.Map(filename))
+        return false;
+
+    if (Warhead::DataCompression::IsCompressed(file._data, file._size))
+        return size <= std::numeric_limits<uint32>::max() && Warhead::DataCompression::Decompress(file._data, file._size, 0, uint32(size), static_cast<uint8*>(dest));
+
+    if (size > file._size)
+        return false;
+
+    memcpy(dest, file._data, size);
+    return true;
+}
+
+bool MappedFile::Map(std::string const& filename)
+{
+#if WH_PLATFORM == WH_PLATFORM_WINDOWS
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || !fileSize.QuadPart)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping)
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    _fileHandle = file;
+    _mappingHandle = mapping;
+    _data = static_cast<uint8 const*>(data);
+    _size = std::size_t(fileSize.QuadPart);
+#else
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size <= 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void* data = mmap(nullptr, std::size_t(fileStat.st_size), PROT_READ, MAP_SHARED, fd, 0);
+
+    // the mapping keeps its own reference to the file
+    close(fd);
+
+    if (data == MAP_FAILED)
+        return false;
+
+    _data = static_cast<uint8 const*>(data);
+    _size = std::size_t(fileStat.st_size);
+#endif
+
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (!_data)
+        return;
+
+    if (_decompressed)
+    {
+        _decompressed.reset();
+        _data = nullptr;
+        _size = 0;
+        return;
+    }
+
+    Unmap();
+}
+
+void MappedFile::Unmap()
+{
+#if WH_PLATFORM == WH_PLATFORM_WINDOWS
+    UnmapViewOfFile(_data);
+    CloseHandle(_mappingHandle);
+    CloseHandle(_fileHandle);
+    _mappingHandle = nullptr;
+    _fileHandle = nullptr;
+#else
+    munmap(const_cast<uint8*>(_data), _size);
+#endif
+
+    _data = nullptr;
+    _size = 0;
+}
+
+bool MappedFileReader::Read(void* dest, std::size_t size)
+{
+    if (!_file.IsOpen() || _offset > _file.GetSize() || size > _file.GetSize() - _offset)
+        return false;
+
+    memcpy(dest, _file.GetData() + _offset, size);
+    _offset += size;
+    return true;
+}
+
+bool MappedFileReader::Skip(std::size_t size)
+{
+    if (!_file.IsOpen() || _offset > _file.GetSize() || size > _file.GetSize() - _offset)
+        return false;
+
+    _offset += size;
+    return true;
+}
+
+bool MappedFileReader::Seek(std::size_t offset)
+{
+    if (!_file.IsOpen() || offset > _file.GetSize())
+        return false;
+
+    _offset = offset;
+    return true;
+}
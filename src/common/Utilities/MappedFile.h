@@ -0,0 +1,110 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MAPPED_FILE_H
+#define _MAPPED_FILE_H
+
+#include "Define.h"
+#include <memory>
+#include <string>
+
+// Read-only memory mapping of a whole file.
+// Pages are backed by the OS page cache, so every mapping of the same file
+// (in this process or any other) shares the same physical memory.
+// Files in the compressed container of DataCompression.h are decompressed into
+// private memory instead, the contents look the same to the caller.
+class WH_COMMON_API MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+
+    bool Open(std::string const& filename);
+    void Close();
+
+    bool IsOpen() const { return _data != nullptr; }
+    bool IsCompressed() const { return _decompressed != nullptr; }
+    uint8 const* GetData() const { return _data; }
+    std::size_t GetSize() const { return _size; }
+
+    // Returns a pointer to count elements of T at offset, or nullptr if the range
+    // does not fit into the file or the offset is not suitably aligned for T
+    template<class T>
+    T const* GetAt(std::size_t offset, std::size_t count = 1) const
+    {
+        if (!_data || offset % alignof(T) != 0 || offset > _size || count > (_size - offset) / sizeof(T))
+            return nullptr;
+
+        return reinterpret_cast<T const*>(_data + offset);
+    }
+
+    // Copies the first size bytes of a file, compressed files only decompress the blocks needed for it
+    static bool ReadHeader(std::string const& filename, void* dest, std::size_t size);
+
+private:
+    bool Map(std::string const& filename);
+    void Unmap();
+
+    uint8 const* _data = nullptr;
+    std::size_t _size = 0;
+    std::unique_ptr<uint8[]> _decompressed;
+
+#if WH_PLATFORM == WH_PLATFORM_WINDOWS
+    void* _fileHandle = nullptr;
+    void* _mappingHandle = nullptr;
+#endif
+};
+
+// Sequential reads from a MappedFile, for formats written field by field with fwrite
+class WH_COMMON_API MappedFileReader
+{
+public:
+    explicit MappedFileReader(MappedFile const& file, std::size_t offset = 0) : _file(file), _offset(offset) { }
+
+    // Copies size bytes, no alignment requirements
+    bool Read(void* dest, std::size_t size);
+
+    template<class T>
+    bool Read(T& value) { return Read(&value, sizeof(T)); }
+
+    // Returns count elements of T in place and skips them, nullptr if they do not fit or are misaligned
+    template<class T>
+    T const* ReadArray(std::size_t count)
+    {
+        T const* data = _file.GetAt<T>(_offset, count);
+        if (data)
+            _offset += count * sizeof(T);
+
+        return data;
+    }
+
+    bool Skip(std::size_t size);
+    bool Seek(std::size_t offset);
+
+    std::size_t GetOffset() const { return _offset; }
+    std::size_t GetRemaining() const { return _offset < _file.GetSize() ? _file.GetSize() - _offset : 0; }
+    bool IsEnd() const { return !GetRemaining(); }
+
+private:
+    MappedFile const& _file;
+    std::size_t _offset;
+};
+
+#endif
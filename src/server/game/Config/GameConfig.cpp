@@ -315,11 +315,16 @@ void GameConfig::LoadBoolConfigs(bool reload /*= false*/)
 
     AddOption<bool>("EnableLoginAfterDC", true);
     AddOption<bool>("DontCacheRandomMovementPaths", true);
+    AddOption<bool>("RandomMovementCache.Persist");
 
     AddOption<bool>("SkillChance.Prospecting");
     AddOption<bool>("SkillChance.Milling");
 
     AddOption<bool>("SaveRespawnTimeImmediately", true);
+    AddOption<bool>("Respawn.Release.Enable", false);
+    AddOption<bool>("Hibernation.Enable", false);
+    AddOption<bool>("Hibernation.Dormant", false);
+    AddOption<bool>("MapTickRate.Enable", false);
     AddOption<bool>("ActivateWeather", true);
     AddOption<bool>("AlwaysMaxSkillForLevel");
     AddOption<bool>("Chat.MuteFirstLogin");
@@ -416,6 +421,9 @@ void GameConfig::LoadBoolConfigs(bool reload /*= false*/)
     AddOption<bool>("QuestTracker.Enable");
     AddOption<bool>("QuestTracker.Queue.Enable");
 
+    // Visibility
+    AddOption<bool>("Visibility.Adaptive.Enable", false);
+
     LOG_INFO("config", "> Loaded %u bool configs", static_cast<uint32>(_boolConfigs.size()));
 }
 
@@ -528,6 +536,18 @@ void GameConfig::LoadIntConfigs(bool reload /*= false*/)
     AddOption<int32>("GM.InWhoList.Level", SEC_ADMINISTRATOR);
     AddOption<int32>("GM.StartLevel", 1);
     AddOption<int32>("Visibility.GroupMode", 1);
+    AddOption<int32>("Respawn.Release.Delay", 60);
+    AddOption<int32>("Respawn.Release.MinRespawnTime", 300);
+    AddOption<int32>("Hibernation.UpdateInterval", 1000);
+    AddOption<int32>("MapTickRate.IdleInterval", 400);
+    AddOption<int32>("MapTickRate.EmptyInterval", 2000);
+    AddOption<int32>("LineOfSight.Cache.Size", 4096);
+    AddOption<int32>("Visibility.Adaptive.TargetUpdateTime", 20);
+    AddOption<int32>("Visibility.Adaptive.AdjustInterval", 1000);
+    AddOption<int32>("Visibility.Adaptive.NotifyDelay.Min", 300);
+    AddOption<int32>("Visibility.Adaptive.NotifyDelay.Max", 1200);
+    AddOption<int32>("Visibility.Adaptive.AINotifyDelay.Min", 150);
+    AddOption<int32>("Visibility.Adaptive.AINotifyDelay.Max", 550);
     AddOption<int32>("MailDeliveryDelay", HOUR);
     AddOption<int32>("UpdateUptimeInterval", 10);
 
@@ -616,6 +636,16 @@ void GameConfig::LoadIntConfigs(bool reload /*= false*/)
     AddOption<int32>("PvPToken.ItemCount", 1);
 
     AddOption<int32>("MapUpdate.Threads", 1);
+    AddOption<int32>("GridPreload.Threads", 1);
+    AddOption<int32>("GridPreload.LookAheadTime", 10 * IN_MILLISECONDS);
+    AddOption<int32>("GridPreload.KeepTime", MINUTE * IN_MILLISECONDS);
+    AddOption<int32>("Pathfinding.Threads", 1);
+    AddOption<int32>("Pathfinding.Cache.Size", 256);
+    AddOption<int32>("Pathfinding.Cache.Lifetime", 2 * IN_MILLISECONDS);
+    AddOption<int32>("TileBudget.MemoryLimit", 0);
+    AddOption<int32>("TileBudget.MinIdleTime", 5 * MINUTE * IN_MILLISECONDS);
+    AddOption<int32>("MMap.TileCache.MemoryLimit", 64);
+    AddOption<int32>("vmap.collisionKernel", 2);
     AddOption<int32>("Command.LookupMaxResults");
 
     // Warden
@@ -820,6 +850,15 @@ void GameConfig::LoadFloatConfigs(bool reload /*= false*/)
     AddOption<float>("Visibility.Distance.Continents", DEFAULT_VISIBILITY_DISTANCE);
     AddOption<float>("Visibility.Distance.Instances", DEFAULT_VISIBILITY_INSTANCE);
     AddOption<float>("Visibility.Distance.BGArenas", DEFAULT_VISIBILITY_BGARENAS);
+    AddOption<float>("Visibility.Adaptive.MoveDistance.Min", 1.0f);
+    AddOption<float>("Visibility.Adaptive.MoveDistance.Max", 5.0f);
+    AddOption<float>("Visibility.Adaptive.Smoothing", 0.1f);
+    AddOption<float>("Visibility.Adaptive.Gain", 0.1f);
+    AddOption<float>("Visibility.Adaptive.CurveExponent", 1.0f);
+    AddOption<float>("Hibernation.Radius", 40.0f);
+    AddOption<float>("LineOfSight.Cache.Precision", 0.25f);
+    AddOption<float>("Pathfinding.Cache.Tolerance", 5.0f);
+    AddOption<float>("Pathfinding.Chase.RepathRatio", 0.2f);
 
     // Rate.SellValue.Item
     AddOption<float>("Rate.SellValue.Item.Poor");
@@ -289,6 +289,9 @@ void Creature::RemoveCorpse(bool setSpawnTime, bool skipVisibility)
     {
         m_respawnTime = GameTime::GetGameTime() + respawnDelay;
         //SaveRespawnTime();
+
+        // nothing left to see, the creature may be deleted until it respawns
+        GetMap()->ScheduleRespawnRelease(this);
     }
 
     float x, y, z, o;
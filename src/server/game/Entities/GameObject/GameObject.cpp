@@ -742,6 +742,8 @@ void GameObject::Update(uint32 diff)
                 if (GetMap()->IsDungeon())
                     SaveRespawnTime();
 
+                GetMap()->ScheduleRespawnRelease(this);
+
                 DestroyForNearbyPlayers(); // xinef: old UpdateObjectVisibility();
                 break;
             }
@@ -2269,6 +2271,9 @@ void GameObject::EnableCollision(bool enable)
         phaseMask = GetPhaseMask();
 
     m_model->enable(phaseMask);
+
+    if (Map* map = FindMap())
+        map->InvalidateLineOfSight(*m_model);
 }
 
 void GameObject::UpdateModel()
@@ -2350,93 +2355,113 @@ void GameObject::BuildValuesUpdate(uint8 updateType, ByteBuffer* data, Player* t
         return;
 
     bool forcedFlags = GetGoType() == GAMEOBJECT_TYPE_CHEST && GetGOInfo()->chest.groupLootRules && HasLootRecipient();
-    bool targetIsGM = target->IsGameMaster() && AccountMgr::IsGMAccount(target->GetSession()->GetSecurity());
+
+    uint32* flags = GameObjectUpdateFieldFlags;
+    uint32 visibleFlag = UF_FLAG_PUBLIC;
+    if (GetOwnerGUID() == target->GetGUID())
+        visibleFlag |= UF_FLAG_OWNER;
+
+    // the loot recipient is no update field, forced flags change the mask without a field change
+    uint32 visibilityClass = forcedFlags ? (visibleFlag | 0x80000000) : visibleFlag;
+    if (AppendCachedValuesUpdate(updateType, visibilityClass, data, target))
+        return;
 
     ByteBuffer fieldBuffer;
 
     UpdateMask updateMask;
     updateMask.SetCount(m_valuesCount);
 
-    uint32* flags = GameObjectUpdateFieldFlags;
-    uint32 visibleFlag = UF_FLAG_PUBLIC;
-    if (GetOwnerGUID() == target->GetGUID())
-        visibleFlag |= UF_FLAG_OWNER;
+    UpdateFieldOffsets targetFields;
 
-    for (uint16 index = 0; index < m_valuesCount; ++index)
+    for (uint16 index : GetVisibleUpdateFields(flags, visibleFlag | _fieldNotifyFlags))
     {
+        if (index >= m_valuesCount)
+            break;
+
         if (_fieldNotifyFlags & flags[index] ||
                 ((updateType == UPDATETYPE_VALUES ? _changesMask.GetBit(index) : m_uint32Values[index]) && (flags[index] & visibleFlag)) ||
                 (index == GAMEOBJECT_FLAGS && forcedFlags))
         {
             updateMask.SetBit(index);
 
-            if (index == GAMEOBJECT_DYNAMIC)
-            {
-                uint16 dynFlags = 0;
-                int16 pathProgress = -1;
-                switch (GetGoType())
-                {
-                    case GAMEOBJECT_TYPE_QUESTGIVER:
-                        if (ActivateToQuest(target))
-                            dynFlags |= GO_DYNFLAG_LO_ACTIVATE;
-                        break;
-                    case GAMEOBJECT_TYPE_CHEST:
-                    case GAMEOBJECT_TYPE_GOOBER:
-                        if (ActivateToQuest(target))
-                            dynFlags |= GO_DYNFLAG_LO_ACTIVATE | GO_DYNFLAG_LO_SPARKLE;
-                        else if (targetIsGM)
-                            dynFlags |= GO_DYNFLAG_LO_ACTIVATE;
-                        break;
-                    case GAMEOBJECT_TYPE_SPELL_FOCUS:
-                    case GAMEOBJECT_TYPE_GENERIC:
-                        if (ActivateToQuest(target))
-                            dynFlags |= GO_DYNFLAG_LO_SPARKLE;
-                        break;
-                    case GAMEOBJECT_TYPE_TRANSPORT:
-                        if (const StaticTransport* t = ToStaticTransport())
-                            if (t->GetPauseTime())
-                            {
-                                if (GetGoState() == GO_STATE_READY)
-                                {
-                                    if (t->GetPathProgress() >= t->GetPauseTime()) // if not, send 100% progress
-                                        pathProgress = int16(float(t->GetPathProgress() - t->GetPauseTime()) / float(t->GetPeriod() - t->GetPauseTime()) * 65535.0f);
-                                }
-                                else
-                                {
-                                    if (t->GetPathProgress() <= t->GetPauseTime()) // if not, send 100% progress
-                                        pathProgress = int16(float(t->GetPathProgress()) / float(t->GetPauseTime()) * 65535.0f);
-                                }
-                            }
-                        // else it's ignored
-                        break;
-                    case GAMEOBJECT_TYPE_MO_TRANSPORT:
-                        if (const MotionTransport* t = ToMotionTransport())
-                            pathProgress = int16(float(t->GetPathProgress()) / float(t->GetPeriod()) * 65535.0f);
-                        break;
-                    default:
-                        break;
-                }
-
-                fieldBuffer << uint16(dynFlags);
-                fieldBuffer << int16(pathProgress);
-            }
-            else if (index == GAMEOBJECT_FLAGS)
+            if (index == GAMEOBJECT_DYNAMIC || index == GAMEOBJECT_FLAGS)
             {
-                uint32 flags = m_uint32Values[GAMEOBJECT_FLAGS];
-                if (GetGoType() == GAMEOBJECT_TYPE_CHEST)
-                    if (GetGOInfo()->chest.groupLootRules && !IsLootAllowedFor(target))
-                        flags |= GO_FLAG_LOCKED | GO_FLAG_NOT_SELECTABLE;
-
-                fieldBuffer << flags;
+                targetFields.emplace_back(index, uint32(fieldBuffer.wpos()));
+                fieldBuffer << GetUpdateFieldValueForTarget(index, target);
             }
             else
                 fieldBuffer << m_uint32Values[index];                // other cases
         }
     }
 
-    *data << uint8(updateMask.GetBlockCount());
-    updateMask.AppendToPacket(data);
-    data->append(fieldBuffer);
+    AppendValuesUpdate(updateType, visibilityClass, updateMask, fieldBuffer, targetFields, data);
+}
+
+uint32 GameObject::GetUpdateFieldValueForTarget(uint16 index, Player* target) const
+{
+    if (index == GAMEOBJECT_DYNAMIC)
+    {
+        bool targetIsGM = target->IsGameMaster() && AccountMgr::IsGMAccount(target->GetSession()->GetSecurity());
+
+        uint16 dynFlags = 0;
+        int16 pathProgress = -1;
+        switch (GetGoType())
+        {
+            case GAMEOBJECT_TYPE_QUESTGIVER:
+                if (ActivateToQuest(target))
+                    dynFlags |= GO_DYNFLAG_LO_ACTIVATE;
+                break;
+            case GAMEOBJECT_TYPE_CHEST:
+            case GAMEOBJECT_TYPE_GOOBER:
+                if (ActivateToQuest(target))
+                    dynFlags |= GO_DYNFLAG_LO_ACTIVATE | GO_DYNFLAG_LO_SPARKLE;
+                else if (targetIsGM)
+                    dynFlags |= GO_DYNFLAG_LO_ACTIVATE;
+                break;
+            case GAMEOBJECT_TYPE_SPELL_FOCUS:
+            case GAMEOBJECT_TYPE_GENERIC:
+                if (ActivateToQuest(target))
+                    dynFlags |= GO_DYNFLAG_LO_SPARKLE;
+                break;
+            case GAMEOBJECT_TYPE_TRANSPORT:
+                if (const StaticTransport* t = ToStaticTransport())
+                    if (t->GetPauseTime())
+                    {
+                        if (GetGoState() == GO_STATE_READY)
+                        {
+                            if (t->GetPathProgress() >= t->GetPauseTime()) // if not, send 100% progress
+                                pathProgress = int16(float(t->GetPathProgress() - t->GetPauseTime()) / float(t->GetPeriod() - t->GetPauseTime()) * 65535.0f);
+                        }
+                        else
+                        {
+                            if (t->GetPathProgress() <= t->GetPauseTime()) // if not, send 100% progress
+                                pathProgress = int16(float(t->GetPathProgress()) / float(t->GetPauseTime()) * 65535.0f);
+                        }
+                    }
+                // else it's ignored
+                break;
+            case GAMEOBJECT_TYPE_MO_TRANSPORT:
+                if (const MotionTransport* t = ToMotionTransport())
+                    pathProgress = int16(float(t->GetPathProgress()) / float(t->GetPeriod()) * 65535.0f);
+                break;
+            default:
+                break;
+        }
+
+        // sent as two 16 bit values
+        return uint32(dynFlags) | (uint32(uint16(pathProgress)) << 16);
+    }
+    else if (index == GAMEOBJECT_FLAGS)
+    {
+        uint32 flags = m_uint32Values[GAMEOBJECT_FLAGS];
+        if (GetGoType() == GAMEOBJECT_TYPE_CHEST)
+            if (GetGOInfo()->chest.groupLootRules && !IsLootAllowedFor(target))
+                flags |= GO_FLAG_LOCKED | GO_FLAG_NOT_SELECTABLE;
+
+        return flags;
+    }
+
+    return m_uint32Values[index];
 }
 
 void GameObject::GetRespawnPosition(float& x, float& y, float& z, float* ori /* = NULL*/) const
@@ -739,6 +739,7 @@ public:
     ~GameObject();
 
     void BuildValuesUpdate(uint8 updatetype, ByteBuffer* data, Player* target) const override;
+    uint32 GetUpdateFieldValueForTarget(uint16 index, Player* target) const override;
 
     void AddToWorld() override;
     void RemoveFromWorld() override;
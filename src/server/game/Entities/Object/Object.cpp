@@ -95,11 +95,17 @@ Object::Object() : m_PackGUID(sizeof(uint64) + 1)
     m_inWorld           = false;
     m_objectUpdated     = false;
 
+    _changesGeneration  = 0;
+    _valuesUpdateCacheGeneration = 0;
+
     m_PackGUID.appendPackGUID(0);
 }
 
 WorldObject::~WorldObject()
 {
+    // objects of unloaded grids are deleted while still linked to their cell
+    RemoveFromCellIndex();
+
     // this may happen because there are many !create/delete
     if (IsWorldObject() && m_currMap)
     {
@@ -470,15 +476,21 @@ void Object::BuildValuesUpdate(uint8 updateType, ByteBuffer* data, Player* targe
     if (!target)
         return;
 
+    uint32* flags = nullptr;
+    uint32 visibleFlag = GetUpdateFieldData(target, flags);
+
+    if (AppendCachedValuesUpdate(updateType, visibleFlag, data, target))
+        return;
+
     ByteBuffer fieldBuffer;
     UpdateMask updateMask;
     updateMask.SetCount(m_valuesCount);
 
-    uint32* flags = nullptr;
-    uint32 visibleFlag = GetUpdateFieldData(target, flags);
-
-    for (uint16 index = 0; index < m_valuesCount; ++index)
+    for (uint16 index : GetVisibleUpdateFields(flags, visibleFlag | _fieldNotifyFlags))
     {
+        if (index >= m_valuesCount)
+            break;
+
         if (_fieldNotifyFlags & flags[index] ||
                 ((updateType == UPDATETYPE_VALUES ? _changesMask.GetBit(index) : m_uint32Values[index]) && (flags[index] & visibleFlag)))
         {
@@ -487,15 +499,68 @@ void Object::BuildValuesUpdate(uint8 updateType, ByteBuffer* data, Player* targe
         }
     }
 
+    AppendValuesUpdate(updateType, visibleFlag, updateMask, fieldBuffer, UpdateFieldOffsets(), data);
+}
+
+bool Object::AppendCachedValuesUpdate(uint8 updateType, uint32 visibilityClass, ByteBuffer* data, Player* target) const
+{
+    // create blocks depend on all values and are rarely sent to many players at once
+    if (updateType != UPDATETYPE_VALUES)
+        return false;
+
+    if (_valuesUpdateCacheGeneration != _changesGeneration)
+    {
+        _valuesUpdateCache.clear();
+        _valuesUpdateCacheGeneration = _changesGeneration;
+        return false;
+    }
+
+    for (ValuesUpdateBlock const& block : _valuesUpdateCache)
+    {
+        if (block.visibilityClass != visibilityClass)
+            continue;
+
+        std::size_t start = data->wpos();
+        data->append(block.data.data(), block.data.size());
+
+        for (std::pair<uint16, uint32> const& field : block.targetFields)
+            data->put<uint32>(start + field.second, GetUpdateFieldValueForTarget(field.first, target));
+
+        return true;
+    }
+
+    return false;
+}
+
+void Object::AppendValuesUpdate(uint8 updateType, uint32 visibilityClass, UpdateMask& updateMask, ByteBuffer const& fieldBuffer, UpdateFieldOffsets const& targetFields, ByteBuffer* data) const
+{
+    std::size_t start = data->wpos();
+
     *data << uint8(updateMask.GetBlockCount());
     updateMask.AppendToPacket(data);
+
+    std::size_t fieldsOffset = data->wpos() - start;
     data->append(fieldBuffer);
+
+    if (updateType != UPDATETYPE_VALUES || _valuesUpdateCacheGeneration != _changesGeneration)
+        return;
+
+    _valuesUpdateCache.emplace_back();
+    ValuesUpdateBlock& block = _valuesUpdateCache.back();
+    block.visibilityClass = visibilityClass;
+    block.data.assign(data->contents() + start, data->contents() + data->wpos());
+    block.targetFields.reserve(targetFields.size());
+    for (std::pair<uint16, uint32> const& field : targetFields)
+        block.targetFields.emplace_back(field.first, uint32(fieldsOffset + field.second));
 }
 
 void Object::ClearUpdateMask(bool remove)
 {
     _changesMask.Clear();
 
+    ++_changesGeneration;
+    _valuesUpdateCache.clear();
+
     if (m_objectUpdated)
     {
         if (remove)
@@ -588,7 +653,7 @@ bool Object::_LoadIntoDataField(std::string const& data, uint32 startOffset, uin
             return false;
 
         m_uint32Values[startOffset + index] = *val;
-        _changesMask.SetBit(startOffset + index);
+        SetChangesMaskBit(startOffset + index);
     }
 
     return true;
@@ -601,7 +666,7 @@ void Object::SetInt32Value(uint16 index, int32 value)
     if (m_int32Values[index] != value)
     {
         m_int32Values[index] = value;
-        _changesMask.SetBit(index);
+        SetChangesMaskBit(index);
 
         if (m_inWorld && !m_objectUpdated)
         {
@@ -618,7 +683,7 @@ void Object::SetUInt32Value(uint16 index, uint32 value)
     if (m_uint32Values[index] != value)
     {
         m_uint32Values[index] = value;
-        _changesMask.SetBit(index);
+        SetChangesMaskBit(index);
 
         if (m_inWorld && !m_objectUpdated)
         {
@@ -633,7 +698,7 @@ void Object::UpdateUInt32Value(uint16 index, uint32 value)
     ASSERT(index < m_valuesCount || PrintIndexError(index, true));
 
     m_uint32Values[index] = value;
-    _changesMask.SetBit(index);
+    SetChangesMaskBit(index);
 }
 
 void Object::SetUInt64Value(uint16 index, uint64 value)
@@ -643,8 +708,8 @@ void Object::SetUInt64Value(uint16 index, uint64 value)
     {
         m_uint32Values[index] = PAIR64_LOPART(value);
         m_uint32Values[index + 1] = PAIR64_HIPART(value);
-        _changesMask.SetBit(index);
-        _changesMask.SetBit(index + 1);
+        SetChangesMaskBit(index);
+        SetChangesMaskBit(index + 1);
 
         if (m_inWorld && !m_objectUpdated)
         {
@@ -661,8 +726,8 @@ bool Object::AddUInt64Value(uint16 index, uint64 value)
     {
         m_uint32Values[index] = PAIR64_LOPART(value);
         m_uint32Values[index + 1] = PAIR64_HIPART(value);
-        _changesMask.SetBit(index);
-        _changesMask.SetBit(index + 1);
+        SetChangesMaskBit(index);
+        SetChangesMaskBit(index + 1);
 
         if (m_inWorld && !m_objectUpdated)
         {
@@ -683,8 +748,8 @@ bool Object::RemoveUInt64Value(uint16 index, uint64 value)
     {
         m_uint32Values[index] = 0;
         m_uint32Values[index + 1] = 0;
-        _changesMask.SetBit(index);
-        _changesMask.SetBit(index + 1);
+        SetChangesMaskBit(index);
+        SetChangesMaskBit(index + 1);
 
         if (m_inWorld && !m_objectUpdated)
         {
@@ -705,7 +770,11 @@ void Object::SetFloatValue(uint16 index, float value)
     if (m_floatValues[index] != value)
     {
         m_floatValues[index] = value;
-        _changesMask.SetBit(index);
+        SetChangesMaskBit(index);
+
+        // combat reach is the object size kept in the cell index
+        if (index == UNIT_FIELD_COMBATREACH && isType(TYPEMASK_UNIT))
+            static_cast<WorldObject*>(this)->UpdateCellIndex();
 
         if (m_inWorld && !m_objectUpdated)
         {
@@ -729,7 +798,7 @@ void Object::SetByteValue(uint16 index, uint8 offset, uint8 value)
     {
         m_uint32Values[index] &= ~uint32(uint32(0xFF) << (offset * 8));
         m_uint32Values[index] |= uint32(uint32(value) << (offset * 8));
-        _changesMask.SetBit(index);
+        SetChangesMaskBit(index);
 
         if (m_inWorld && !m_objectUpdated)
         {
@@ -753,7 +822,7 @@ void Object::SetUInt16Value(uint16 index, uint8 offset, uint16 value)
     {
         m_uint32Values[index] &= ~uint32(uint32(0xFFFF) << (offset * 16));
         m_uint32Values[index] |= uint32(uint32(value) << (offset * 16));
-        _changesMask.SetBit(index);
+        SetChangesMaskBit(index);
 
         if (m_inWorld && !m_objectUpdated)
         {
@@ -820,7 +889,7 @@ void Object::SetFlag(uint16 index, uint32 newFlag)
     if (oldval != newval)
     {
         m_uint32Values[index] = newval;
-        _changesMask.SetBit(index);
+        SetChangesMaskBit(index);
 
         if (m_inWorld && !m_objectUpdated)
         {
@@ -841,7 +910,7 @@ void Object::RemoveFlag(uint16 index, uint32 oldFlag)
     if (oldval != newval)
     {
         m_uint32Values[index] = newval;
-        _changesMask.SetBit(index);
+        SetChangesMaskBit(index);
 
         if (m_inWorld && !m_objectUpdated)
         {
@@ -864,7 +933,7 @@ void Object::SetByteFlag(uint16 index, uint8 offset, uint8 newFlag)
     if (!(uint8(m_uint32Values[index] >> (offset * 8)) & newFlag))
     {
         m_uint32Values[index] |= uint32(uint32(newFlag) << (offset * 8));
-        _changesMask.SetBit(index);
+        SetChangesMaskBit(index);
 
         if (m_inWorld && !m_objectUpdated)
         {
@@ -887,7 +956,7 @@ void Object::RemoveByteFlag(uint16 index, uint8 offset, uint8 oldFlag)
     if (uint8(m_uint32Values[index] >> (offset * 8)) & oldFlag)
     {
         m_uint32Values[index] &= ~uint32(uint32(oldFlag) << (offset * 8));
-        _changesMask.SetBit(index);
+        SetChangesMaskBit(index);
 
         if (m_inWorld && !m_objectUpdated)
         {
@@ -938,7 +1007,8 @@ void MovementInfo::OutDebug()
 WorldObject::WorldObject(bool isWorldObject) : WorldLocation(),
     LastUsedScriptID(0), m_name(""), m_isActive(false), m_isVisibilityDistanceOverride(false), m_isWorldObject(isWorldObject), m_zoneScript(NULL),
     m_transport(NULL), m_currMap(NULL), m_InstanceId(0),
-    m_phaseMask(PHASEMASK_NORMAL), m_useCombinedPhases(true), m_notifyflags(0), m_executed_notifies(0)
+    m_phaseMask(PHASEMASK_NORMAL), m_useCombinedPhases(true), m_notifyflags(0), m_executed_notifies(0),
+    m_cellIndex(nullptr), m_cellIndexSlot(0), m_fullRateUpdate(false), m_hibernationDiff(0)
 {
     m_serverSideVisibility.SetValue(SERVERSIDE_VISIBILITY_GHOST, GHOST_VISIBILITY_ALIVE | GHOST_VISIBILITY_GHOST);
     m_serverSideVisibilityDetect.SetValue(SERVERSIDE_VISIBILITY_GHOST, GHOST_VISIBILITY_ALIVE);
@@ -1684,7 +1754,7 @@ void WorldObject::SendPlayMusic(uint32 Music, bool OnlySelf)
 
 void Object::ForceValuesUpdateAtIndex(uint32 i)
 {
-    _changesMask.SetBit(i);
+    SetChangesMaskBit(i);
     if (m_inWorld && !m_objectUpdated)
     {
         sObjectAccessor->AddUpdateObject(this);
@@ -2511,6 +2581,7 @@ void WorldObject::SetPhaseMask(uint32 newPhaseMask, bool update)
 {
     sScriptMgr->OnBeforeWorldObjectSetPhaseMask(this, m_phaseMask, newPhaseMask, m_useCombinedPhases, update);
     m_phaseMask = newPhaseMask;
+    UpdateCellIndex();
 
     if (update && IsInWorld())
         UpdateObjectVisibility();
@@ -2588,7 +2659,7 @@ void WorldObject::AddToNotify(uint16 f)
         {
             if (f & NOTIFY_VISIBILITY_CHANGED)
             {
-                uint32 EVENT_VISIBILITY_DELAY = u->FindMap() ? DynamicVisibilityMgr::GetVisibilityNotifyDelay(u->FindMap()->GetEntry()->map_type) : 1000;
+                uint32 EVENT_VISIBILITY_DELAY = u->FindMap() ? u->FindMap()->GetDynamicVisibility().GetVisibilityNotifyDelay() : 1000;
 
                 uint32 diff = getMSTimeDiff(u->m_last_notify_mstime, GameTime::GetGameTimeMS());
                 if (diff >= EVENT_VISIBILITY_DELAY / 2)
@@ -2599,7 +2670,7 @@ void WorldObject::AddToNotify(uint16 f)
                 u->m_last_notify_mstime = GameTime::GetGameTimeMS() + EVENT_VISIBILITY_DELAY - 1;
             }
             else if (f & NOTIFY_AI_RELOCATION)
-                u->m_delayed_unit_ai_notify_timer = u->FindMap() ? DynamicVisibilityMgr::GetAINotifyDelay(u->FindMap()->GetEntry()->map_type) : 500;
+                u->m_delayed_unit_ai_notify_timer = u->FindMap() ? u->FindMap()->GetDynamicVisibility().GetAINotifyDelay() : 500;
 
             m_notifyflags |= f;
         }
@@ -24,6 +24,7 @@
 #include "UpdateMask.h"
 #include "UpdateData.h"
 #include "GridReference.h"
+#include "CellObjectIndex.h"
 #include "ObjectDefines.h"
 #include "GridDefines.h"
 #include "Map.h"
@@ -31,6 +32,7 @@
 #include <set>
 #include <string>
 #include <sstream>
+#include <vector>
 
 #define CONTACT_DISTANCE            0.5f
 #define INTERACTION_DISTANCE        5.5f
@@ -311,8 +313,8 @@ public:
     virtual void BuildUpdate(UpdateDataMapType&, UpdatePlayerSet&) {}
     void BuildFieldsUpdate(Player*, UpdateDataMapType&) const;
 
-    void SetFieldNotifyFlag(uint16 flag) { _fieldNotifyFlags |= flag; }
-    void RemoveFieldNotifyFlag(uint16 flag) { _fieldNotifyFlags &= ~flag; }
+    void SetFieldNotifyFlag(uint16 flag) { _fieldNotifyFlags |= flag; ++_changesGeneration; }
+    void RemoveFieldNotifyFlag(uint16 flag) { _fieldNotifyFlags &= ~flag; ++_changesGeneration; }
 
     // FG: some hacky helpers
     void ForceValuesUpdateAtIndex(uint32);
@@ -349,6 +351,19 @@ protected:
     void BuildMovementUpdate(ByteBuffer* data, uint16 flags) const;
     virtual void BuildValuesUpdate(uint8 updatetype, ByteBuffer* data, Player* target) const;
 
+    // Values updates are the same for every receiver with the same visibility flags, except for a few fields
+    // the builders adjust per receiver. A built update is kept per visibility class until the object changes
+    // again, later receivers get a copy with only those fields rewritten by GetUpdateFieldValueForTarget.
+    typedef std::vector<std::pair<uint16, uint32>> UpdateFieldOffsets;       // field index, offset of its value
+
+    bool AppendCachedValuesUpdate(uint8 updateType, uint32 visibilityClass, ByteBuffer* data, Player* target) const;
+    void AppendValuesUpdate(uint8 updateType, uint32 visibilityClass, UpdateMask& updateMask, ByteBuffer const& fieldBuffer, UpdateFieldOffsets const& targetFields, ByteBuffer* data) const;
+    virtual uint32 GetUpdateFieldValueForTarget(uint16 index, Player* /*target*/) const { return m_uint32Values[index]; }
+
+    // every change of a field invalidates the cached values updates
+    void SetChangesMaskBit(uint16 index) { _changesMask.SetBit(index); ++_changesGeneration; }
+    void UnsetChangesMaskBit(uint16 index) { _changesMask.UnsetBit(index); ++_changesGeneration; }
+
     uint16 m_objectType;
 
     TypeID m_objectTypeId;
@@ -370,6 +385,17 @@ protected:
     bool m_objectUpdated;
 
 private:
+    struct ValuesUpdateBlock
+    {
+        uint32 visibilityClass;
+        std::vector<uint8> data;            // mask block count, mask and field values
+        UpdateFieldOffsets targetFields;
+    };
+
+    uint32 _changesGeneration;
+    mutable uint32 _valuesUpdateCacheGeneration;
+    mutable std::vector<ValuesUpdateBlock> _valuesUpdateCache;
+
     bool m_inWorld;
 
     ByteBuffer m_PackGUID;
@@ -458,7 +484,7 @@ class GridObject
 public:
     bool IsInGrid() const { return _gridRef.isValid(); }
     void AddToGrid(GridRefManager<T>& m) { ASSERT(!IsInGrid()); _gridRef.link(&m, (T*)this); }
-    void RemoveFromGrid() { ASSERT(IsInGrid()); _gridRef.unlink(); }
+    void RemoveFromGrid() { ASSERT(IsInGrid()); static_cast<T*>(this)->RemoveFromCellIndex(); _gridRef.unlink(); }
 private:
     GridReference<T> _gridRef;
 };
@@ -521,6 +547,10 @@ public:
     virtual void Update(uint32 /*time_diff*/) { };
     void _Create(uint32 guidlow, HighGuid guidhigh, uint32 phaseMask);
 
+    // position changes are passed to the cell index by the Map::*Relocation functions, see CellObjectIndex
+    void UpdateCellIndex() { if (m_cellIndex) m_cellIndex->Update(this); }
+    void RemoveFromCellIndex() { if (m_cellIndex) m_cellIndex->Remove(this); }
+
     virtual void RemoveFromWorld()
     {
         if (!IsInWorld())
@@ -754,6 +784,10 @@ public:
     void setActive(bool isActiveObject);
     bool IsVisibilityOverridden() const { return m_isVisibilityDistanceOverride; }
     void SetVisibilityDistanceOverride(bool isVisibilityDistanceOverride);
+    // objects away from players are updated less often, see MapHibernation.
+    // Scripts relying on every update while out of combat opt out here
+    bool RequiresFullRateUpdate() const { return m_fullRateUpdate; }
+    void SetFullRateUpdate(bool fullRate) { m_fullRateUpdate = fullRate; }
     void SetWorldObject(bool apply);
     bool IsPermanentWorldObject() const { return m_isWorldObject; }
     bool IsWorldObject() const;
@@ -828,6 +862,14 @@ private:
     uint16 m_notifyflags;
     uint16 m_executed_notifies;
 
+    friend class CellObjectIndex;
+    CellObjectIndex* m_cellIndex;                       // index of the cell container the object is linked to
+    uint32 m_cellIndexSlot;
+
+    friend class MapHibernation;
+    bool m_fullRateUpdate;
+    uint32 m_hibernationDiff;                           // time since the last update while hibernating
+
     virtual bool _IsWithinDist(WorldObject const* obj, float dist2compare, bool is3D) const;
 
     bool CanNeverSee(WorldObject const* obj) const;
@@ -16,6 +16,7 @@
  */
 
 #include "UpdateFieldFlags.h"
+#include "Errors.h"
 
 uint32 ItemUpdateFieldFlags[CONTAINER_END] =
 {
@@ -1566,3 +1567,74 @@ uint32 CorpseUpdateFieldFlags[CORPSE_END] =
     UF_FLAG_DYNAMIC,                                        // CORPSE_FIELD_DYNAMIC_FLAGS
     UF_FLAG_NONE,                                           // CORPSE_FIELD_PAD
 };
+
+namespace
+{
+    // the flags receivers (Object::GetUpdateFieldData) and field notify flags can be made of
+    uint32 const VisibilityFlags[] = { UF_FLAG_PUBLIC, UF_FLAG_PRIVATE, UF_FLAG_OWNER, UF_FLAG_ITEM_OWNER, UF_FLAG_SPECIAL_INFO, UF_FLAG_PARTY_MEMBER, UF_FLAG_DYNAMIC };
+    uint32 const MAX_VISIBILITY_CLASSES = 1 << (sizeof(VisibilityFlags) / sizeof(VisibilityFlags[0]));
+
+    struct UpdateFieldTable
+    {
+        uint32 const* flags;
+        uint16 count;
+        std::vector<uint16> visibleFields[MAX_VISIBILITY_CLASSES];
+    };
+
+    UpdateFieldTable UpdateFieldTables[] =
+    {
+        { ItemUpdateFieldFlags, CONTAINER_END, { } },
+        { UnitUpdateFieldFlags, PLAYER_END, { } },
+        { GameObjectUpdateFieldFlags, GAMEOBJECT_END, { } },
+        { DynamicObjectUpdateFieldFlags, DYNAMICOBJECT_END, { } },
+        { CorpseUpdateFieldFlags, CORPSE_END, { } }
+    };
+
+    uint32 GetVisibilityFlags(uint32 visibilityClass)
+    {
+        uint32 flags = 0;
+        for (uint32 i = 0; i < sizeof(VisibilityFlags) / sizeof(VisibilityFlags[0]); ++i)
+            if (visibilityClass & (1 << i))
+                flags |= VisibilityFlags[i];
+
+        return flags;
+    }
+
+    uint32 GetVisibilityClass(uint32 flags)
+    {
+        uint32 visibilityClass = 0;
+        for (uint32 i = 0; i < sizeof(VisibilityFlags) / sizeof(VisibilityFlags[0]); ++i)
+            if (flags & VisibilityFlags[i])
+                visibilityClass |= 1 << i;
+
+        return visibilityClass;
+    }
+}
+
+void InitUpdateFieldVisibility()
+{
+    for (UpdateFieldTable& table : UpdateFieldTables)
+    {
+        for (uint32 visibilityClass = 0; visibilityClass < MAX_VISIBILITY_CLASSES; ++visibilityClass)
+        {
+            uint32 visibleFlags = GetVisibilityFlags(visibilityClass);
+            std::vector<uint16>& fields = table.visibleFields[visibilityClass];
+            fields.clear();
+
+            for (uint16 index = 0; index < table.count; ++index)
+                if (table.flags[index] & visibleFlags)
+                    fields.push_back(index);
+
+            fields.shrink_to_fit();
+        }
+    }
+}
+
+std::vector<uint16> const& GetVisibleUpdateFields(uint32 const* flags, uint32 visibleFlags)
+{
+    for (UpdateFieldTable const& table : UpdateFieldTables)
+        if (table.flags == flags)
+            return table.visibleFields[GetVisibilityClass(visibleFlags)];
+
+    ABORT_MSG("GetVisibleUpdateFields: unknown update field table");
+}
@@ -20,6 +20,7 @@
 
 #include "UpdateFields.h"
 #include "Define.h"
+#include <vector>
 
 enum UpdatefieldFlags
 {
@@ -41,4 +42,11 @@ extern uint32 GameObjectUpdateFieldFlags[GAMEOBJECT_END];
 extern uint32 DynamicObjectUpdateFieldFlags[DYNAMICOBJECT_END];
 extern uint32 CorpseUpdateFieldFlags[CORPSE_END];
 
+// Indexes of the fields in one of the tables above that have any of the given flags, ascending.
+// A values update only ever contains fields matching the receiver's visibility flags or the
+// object's field notify flags, so the builders walk this list instead of every field.
+// The lists are built for every combination of flags by InitUpdateFieldVisibility at startup.
+void InitUpdateFieldVisibility();
+std::vector<uint16> const& GetVisibleUpdateFields(uint32 const* flags, uint32 visibleFlags);
+
 #endif // _UPDATEFIELDFLAGS_H
@@ -0,0 +1,124 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "ClientGUIDSet.h"
+#include "Errors.h"
+
+bool ClientGUIDSet::insert(uint64 guid)
+{
+    ASSERT(IsUsedKey(guid));
+
+    // keep at least a quarter of the table empty so probing always terminates
+    if ((_size + _tombstones + 1) * 4 > GetCapacity() * 3)
+    {
+        // grow if live entries would fill half of the table, otherwise just drop the tombstones
+        uint32 capacity = GetCapacity() ? GetCapacity() : 64;
+        if ((_size + 1) * 2 > capacity)
+            capacity *= 2;
+
+        Rehash(capacity);
+    }
+
+    uint32 mask = GetCapacity() - 1;
+    int32 tombstone = -1;
+    for (uint32 slot = Hash(guid) & mask;; slot = (slot + 1) & mask)
+    {
+        if (_keys[slot] == guid)
+            return false;
+
+        if (_keys[slot] == DELETED_KEY)
+        {
+            if (tombstone < 0)
+                tombstone = int32(slot);
+            continue;
+        }
+
+        if (_keys[slot] == EMPTY_KEY)
+        {
+            if (tombstone >= 0)
+            {
+                slot = uint32(tombstone);
+                --_tombstones;
+            }
+
+            _keys[slot] = guid;
+            _stamps[slot] = _pass;
+            ++_size;
+            return true;
+        }
+    }
+}
+
+std::size_t ClientGUIDSet::erase(uint64 guid)
+{
+    int32 slot = FindSlot(guid);
+    if (slot < 0)
+        return 0;
+
+    _keys[slot] = DELETED_KEY;
+    --_size;
+    ++_tombstones;
+    return 1;
+}
+
+ClientGUIDSet::const_iterator ClientGUIDSet::erase(const_iterator itr)
+{
+    _keys[itr._slot] = DELETED_KEY;
+    --_size;
+    ++_tombstones;
+    return ++itr;
+}
+
+void ClientGUIDSet::clear()
+{
+    _keys.clear();
+    _stamps.clear();
+    _size = 0;
+    _tombstones = 0;
+}
+
+void ClientGUIDSet::GetUnseen(uint32 pass, std::vector<uint64>& guids) const
+{
+    for (uint32 slot = 0; slot < GetCapacity(); ++slot)
+        if (IsUsedKey(_keys[slot]) && _stamps[slot] < pass)
+            guids.push_back(_keys[slot]);
+}
+
+void ClientGUIDSet::Rehash(uint32 capacity)
+{
+    std::vector<uint64> keys(capacity, EMPTY_KEY);
+    std::vector<uint32> stamps(capacity, 0);
+
+    uint32 mask = capacity - 1;
+    for (uint32 i = 0; i < GetCapacity(); ++i)
+    {
+        if (!IsUsedKey(_keys[i]))
+            continue;
+
+        uint32 slot = Hash(_keys[i]) & mask;
+        while (keys[slot] != EMPTY_KEY)
+            slot = (slot + 1) & mask;
+
+        keys[slot] = _keys[i];
+        stamps[slot] = _stamps[i];
+    }
+
+    _keys.swap(keys);
+    _stamps.swap(stamps);
+    _tombstones = 0;
+}
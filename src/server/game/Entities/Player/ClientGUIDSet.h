@@ -0,0 +1,153 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _CLIENT_GUID_SET_H
+#define _CLIENT_GUID_SET_H
+
+#include "Define.h"
+#include <iterator>
+#include <vector>
+
+// Set of the object guids a client knows about (Player::m_clientGUIDs).
+// Flat open addressing table with linear probing; erased slots become tombstones
+// so erasing while iterating is safe, only insert may invalidate iterators.
+//
+// Every entry carries the number of the last visibility pass that saw it, which lets
+// VisibleNotifier find the objects that went out of range without copying the set:
+// BeginPass() starts a pass, Touch() marks a visited guid and entries inserted during the pass
+// count as seen. Everything left with an older stamp was not visited, see GetUnseen().
+class ClientGUIDSet
+{
+public:
+    class const_iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef uint64 value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef uint64 const* pointer;
+        typedef uint64 const& reference;
+
+        const_iterator() : _set(nullptr), _slot(0) { }
+        const_iterator(ClientGUIDSet const* set, uint32 slot) : _set(set), _slot(slot) { SkipFree(); }
+
+        reference operator*() const { return _set->_keys[_slot]; }
+        pointer operator->() const { return &_set->_keys[_slot]; }
+
+        const_iterator& operator++() { ++_slot; SkipFree(); return *this; }
+        const_iterator operator++(int) { const_iterator tmp = *this; ++*this; return tmp; }
+
+        bool operator==(const_iterator const& right) const { return _slot == right._slot; }
+        bool operator!=(const_iterator const& right) const { return _slot != right._slot; }
+
+    private:
+        friend class ClientGUIDSet;
+
+        void SkipFree()
+        {
+            while (_slot < _set->GetCapacity() && !IsUsedKey(_set->_keys[_slot]))
+                ++_slot;
+        }
+
+        ClientGUIDSet const* _set;
+        uint32 _slot;
+    };
+
+    typedef const_iterator iterator;
+
+    ClientGUIDSet() : _size(0), _tombstones(0), _pass(0) { }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, GetCapacity()); }
+
+    bool empty() const { return _size == 0; }
+    std::size_t size() const { return _size; }
+
+    const_iterator find(uint64 guid) const
+    {
+        int32 slot = FindSlot(guid);
+        return slot >= 0 ? const_iterator(this, uint32(slot)) : end();
+    }
+
+    std::size_t count(uint64 guid) const { return FindSlot(guid) >= 0 ? 1 : 0; }
+
+    bool insert(uint64 guid);
+    std::size_t erase(uint64 guid);
+    const_iterator erase(const_iterator itr);
+    void clear();
+
+    uint32 BeginPass() { return ++_pass; }
+
+    // marks guid as seen by the current pass, false if it is not in the set
+    bool Touch(uint64 guid)
+    {
+        int32 slot = FindSlot(guid);
+        if (slot < 0)
+            return false;
+
+        _stamps[slot] = _pass;
+        return true;
+    }
+
+    // true if guid is in the set and was neither touched nor inserted since pass began
+    bool IsUnseen(uint64 guid, uint32 pass) const
+    {
+        int32 slot = FindSlot(guid);
+        return slot >= 0 && _stamps[slot] < pass;
+    }
+
+    // collects all guids not seen since pass began, nested passes count as seen
+    void GetUnseen(uint32 pass, std::vector<uint64>& guids) const;
+
+private:
+    static constexpr uint64 EMPTY_KEY = 0;
+    static constexpr uint64 DELETED_KEY = ~uint64(0);
+
+    static bool IsUsedKey(uint64 key) { return key != EMPTY_KEY && key != DELETED_KEY; }
+
+    // guids of one type differ in the low bits only, spread them over the whole table
+    static uint32 Hash(uint64 guid) { return uint32((guid * UI64LIT(0x9E3779B97F4A7C15)) >> 32); }
+
+    uint32 GetCapacity() const { return uint32(_keys.size()); }
+
+    int32 FindSlot(uint64 guid) const
+    {
+        if (_keys.empty() || !IsUsedKey(guid))
+            return -1;
+
+        uint32 mask = GetCapacity() - 1;
+        for (uint32 slot = Hash(guid) & mask;; slot = (slot + 1) & mask)
+        {
+            if (_keys[slot] == guid)
+                return int32(slot);
+
+            if (_keys[slot] == EMPTY_KEY)
+                return -1;
+        }
+    }
+
+    void Rehash(uint32 capacity);
+
+    std::vector<uint64> _keys;
+    std::vector<uint32> _stamps;
+    uint32 _size;
+    uint32 _tombstones;
+    uint32 _pass;
+};
+
+#endif
@@ -18,6 +18,7 @@
 #ifndef _PLAYER_H
 #define _PLAYER_H
 
+#include "ClientGUIDSet.h"
 #include "DBCStores.h"
 #include "GroupReference.h"
 #include "MapReference.h"
@@ -2413,7 +2414,7 @@ public:
     void SetEntryPoint();
 
     // currently visible objects at player client
-    typedef std::unordered_set<uint64> ClientGUIDs;
+    typedef ClientGUIDSet ClientGUIDs;
     ClientGUIDs m_clientGUIDs;
     std::vector<Unit*> m_newVisible; // pussywizard
 
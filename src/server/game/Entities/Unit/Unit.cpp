@@ -14336,7 +14336,7 @@ void Unit::SetLevel(uint8 lvl, bool showLevelChange)
 
     // Xinef: unmark field bit update
     if (!showLevelChange)
-        _changesMask.UnsetBit(UNIT_FIELD_LEVEL);
+        UnsetChangesMaskBit(UNIT_FIELD_LEVEL);
 
     // group update
     if (GetTypeId() == TYPEID_PLAYER && ToPlayer()->GetGroup())
@@ -19224,7 +19224,7 @@ void Unit::ExecuteDelayedUnitRelocationEvent()
                     float dy = active->m_last_notify_position.GetPositionY() - active->GetPositionY();
                     float dz = active->m_last_notify_position.GetPositionZ() - active->GetPositionZ();
                     float distsq = dx * dx + dy * dy + dz * dz;
-                    float mindistsq = DynamicVisibilityMgr::GetReqMoveDistSq(active->FindMap()->GetEntry()->map_type);
+                    float mindistsq = active->FindMap()->GetDynamicVisibility().GetReqMoveDistSq();
                     if (distsq < mindistsq)
                         continue;
 
@@ -19259,7 +19259,7 @@ void Unit::ExecuteDelayedUnitRelocationEvent()
             float dz = active->m_last_notify_position.GetPositionZ() - active->GetPositionZ();
             float distsq = dx * dx + dy * dy + dz * dz;
 
-            float mindistsq = DynamicVisibilityMgr::GetReqMoveDistSq(active->FindMap()->GetEntry()->map_type);
+            float mindistsq = active->FindMap()->GetDynamicVisibility().GetReqMoveDistSq();
             if (distsq < mindistsq)
                 return;
 
@@ -19284,7 +19284,7 @@ void Unit::ExecuteDelayedUnitRelocationEvent()
         float dy = unit->m_last_notify_position.GetPositionY() - unit->GetPositionY();
         float dz = unit->m_last_notify_position.GetPositionZ() - unit->GetPositionZ();
         float distsq = dx * dx + dy * dy + dz * dz;
-        float mindistsq = DynamicVisibilityMgr::GetReqMoveDistSq(unit->FindMap()->GetEntry()->map_type);
+        float mindistsq = unit->FindMap()->GetDynamicVisibility().GetReqMoveDistSq();
         if (distsq < mindistsq)
             return;
 
@@ -19484,11 +19484,6 @@ void Unit::BuildValuesUpdate(uint8 updateType, ByteBuffer* data, Player* target)
     if (!target)
         return;
 
-    ByteBuffer fieldBuffer;
-
-    UpdateMask updateMask;
-    updateMask.SetCount(m_valuesCount);
-
     uint32* flags = UnitUpdateFieldFlags;
     uint32 visibleFlag = UF_FLAG_PUBLIC;
 
@@ -19506,9 +19501,21 @@ void Unit::BuildValuesUpdate(uint8 updateType, ByteBuffer* data, Player* target)
     if (plr && plr->IsInSameRaidWith(target))
         visibleFlag |= UF_FLAG_PARTY_MEMBER;
 
-    Creature const* creature = ToCreature();
-    for (uint16 index = 0; index < m_valuesCount; ++index)
+    if (AppendCachedValuesUpdate(updateType, visibleFlag, data, target))
+        return;
+
+    ByteBuffer fieldBuffer;
+
+    UpdateMask updateMask;
+    updateMask.SetCount(m_valuesCount);
+
+    UpdateFieldOffsets targetFields;
+
+    for (uint16 index : GetVisibleUpdateFields(flags, visibleFlag | _fieldNotifyFlags))
     {
+        if (index >= m_valuesCount)
+            break;
+
         if (_fieldNotifyFlags & flags[index] ||
                 ((flags[index] & visibleFlag) & UF_FLAG_SPECIAL_INFO) ||
                 ((updateType == UPDATETYPE_VALUES ? _changesMask.GetBit(index) : m_uint32Values[index]) && (flags[index] & visibleFlag)) ||
@@ -19516,25 +19523,10 @@ void Unit::BuildValuesUpdate(uint8 updateType, ByteBuffer* data, Player* target)
         {
             updateMask.SetBit(index);
 
-            if (index == UNIT_NPC_FLAGS)
-            {
-                uint32 appendValue = m_uint32Values[UNIT_NPC_FLAGS];
-
-                if (creature)
-                {
-                    if (CONF_GET_INT("InstantFlightPaths") == 2 && appendValue & UNIT_NPC_FLAG_FLIGHTMASTER)
-                        appendValue |= UNIT_NPC_FLAG_GOSSIP; // flight masters need NPC gossip flag to show instant flight toggle option
-
-                    if (!target->CanSeeSpellClickOn(creature))
-                        appendValue &= ~UNIT_NPC_FLAG_SPELLCLICK;
-                }
-
-                fieldBuffer << uint32(appendValue);
-            }
-            else if (index == UNIT_FIELD_AURASTATE)
+            if (IsUpdateFieldTargetDependent(index))
             {
-                // Check per caster aura states to not enable using a spell in client if specified aura is not by target
-                fieldBuffer << BuildAuraStateUpdateForTarget(target);
+                targetFields.emplace_back(index, uint32(fieldBuffer.wpos()));
+                fieldBuffer << GetUpdateFieldValueForTarget(index, target);
             }
             // FIXME: Some values at server stored in float format but must be sent to client in uint32 format
             else if (index >= UNIT_FIELD_BASEATTACKTIME && index <= UNIT_FIELD_RANGEDATTACKTIME)
@@ -19548,118 +19540,161 @@ void Unit::BuildValuesUpdate(uint8 updateType, ByteBuffer* data, Player* target)
                      (index >= UNIT_FIELD_RESISTANCEBUFFMODSNEGATIVE  && index <= (UNIT_FIELD_RESISTANCEBUFFMODSNEGATIVE + 6)) ||
                      (index >= UNIT_FIELD_POSSTAT0   && index <= UNIT_FIELD_POSSTAT4))
                 fieldBuffer << uint32(m_floatValues[index]);
-            // Gamemasters should be always able to select units - remove not selectable flag
-            else if (index == UNIT_FIELD_FLAGS)
+            else
+                // send in current format (float as float, uint32 as uint32)
+                fieldBuffer << m_uint32Values[index];
+        }
+    }
+
+    AppendValuesUpdate(updateType, visibleFlag, updateMask, fieldBuffer, targetFields, data);
+}
+
+bool Unit::IsUpdateFieldTargetDependent(uint16 index)
+{
+    switch (index)
+    {
+        case UNIT_NPC_FLAGS:
+        case UNIT_FIELD_AURASTATE:
+        case UNIT_FIELD_FLAGS:
+        case UNIT_FIELD_DISPLAYID:
+        case UNIT_DYNAMIC_FLAGS:
+        case UNIT_FIELD_BYTES_2:
+        case UNIT_FIELD_FACTIONTEMPLATE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+uint32 Unit::GetUpdateFieldValueForTarget(uint16 index, Player* target) const
+{
+    Creature const* creature = ToCreature();
+
+    switch (index)
+    {
+        case UNIT_NPC_FLAGS:
+        {
+            uint32 appendValue = m_uint32Values[UNIT_NPC_FLAGS];
+
+            if (creature)
             {
-                uint32 appendValue = m_uint32Values[UNIT_FIELD_FLAGS];
-                if (target->IsGameMaster() && AccountMgr::IsGMAccount(target->GetSession()->GetSecurity()))
-                    appendValue &= ~UNIT_FLAG_NOT_SELECTABLE;
+                if (CONF_GET_INT("InstantFlightPaths") == 2 && appendValue & UNIT_NPC_FLAG_FLIGHTMASTER)
+                    appendValue |= UNIT_NPC_FLAG_GOSSIP; // flight masters need NPC gossip flag to show instant flight toggle option
 
-                fieldBuffer << uint32(appendValue);
+                if (!target->CanSeeSpellClickOn(creature))
+                    appendValue &= ~UNIT_NPC_FLAG_SPELLCLICK;
             }
-            // use modelid_a if not gm, _h if gm for CREATURE_FLAG_EXTRA_TRIGGER creatures
-            else if (index == UNIT_FIELD_DISPLAYID)
+
+            return appendValue;
+        }
+        case UNIT_FIELD_AURASTATE:
+            // Check per caster aura states to not enable using a spell in client if specified aura is not by target
+            return BuildAuraStateUpdateForTarget(target);
+        // Gamemasters should be always able to select units - remove not selectable flag
+        case UNIT_FIELD_FLAGS:
+        {
+            uint32 appendValue = m_uint32Values[UNIT_FIELD_FLAGS];
+            if (target->IsGameMaster() && AccountMgr::IsGMAccount(target->GetSession()->GetSecurity()))
+                appendValue &= ~UNIT_FLAG_NOT_SELECTABLE;
+
+            return appendValue;
+        }
+        // use modelid_a if not gm, _h if gm for CREATURE_FLAG_EXTRA_TRIGGER creatures
+        case UNIT_FIELD_DISPLAYID:
+        {
+            uint32 displayId = m_uint32Values[UNIT_FIELD_DISPLAYID];
+            if (creature)
             {
-                uint32 displayId = m_uint32Values[UNIT_FIELD_DISPLAYID];
-                if (creature)
-                {
-                    CreatureTemplate const* cinfo = creature->GetCreatureTemplate();
+                CreatureTemplate const* cinfo = creature->GetCreatureTemplate();
 
-                    // this also applies for transform auras
-                    if (SpellInfo const* transform = sSpellMgr->GetSpellInfo(getTransForm()))
-                        for (uint8 i = 0; i < MAX_SPELL_EFFECTS; ++i)
-                            if (transform->Effects[i].IsAura(SPELL_AURA_TRANSFORM))
-                                if (CreatureTemplate const* transformInfo = sObjectMgr->GetCreatureTemplate(transform->Effects[i].MiscValue))
-                                {
-                                    cinfo = transformInfo;
-                                    break;
-                                }
+                // this also applies for transform auras
+                if (SpellInfo const* transform = sSpellMgr->GetSpellInfo(getTransForm()))
+                    for (uint8 i = 0; i < MAX_SPELL_EFFECTS; ++i)
+                        if (transform->Effects[i].IsAura(SPELL_AURA_TRANSFORM))
+                            if (CreatureTemplate const* transformInfo = sObjectMgr->GetCreatureTemplate(transform->Effects[i].MiscValue))
+                            {
+                                cinfo = transformInfo;
+                                break;
+                            }
 
-                    if (cinfo->flags_extra & CREATURE_FLAG_EXTRA_TRIGGER)
+                if (cinfo->flags_extra & CREATURE_FLAG_EXTRA_TRIGGER)
+                {
+                    if (target->IsGameMaster() && AccountMgr::IsGMAccount(target->GetSession()->GetSecurity()))
                     {
-                        if (target->IsGameMaster() && AccountMgr::IsGMAccount(target->GetSession()->GetSecurity()))
-                        {
-                            if (cinfo->Modelid1)
-                                displayId = cinfo->Modelid1;    // Modelid1 is a visible model for gms
-                            else
-                                displayId = 17519;              // world visible trigger's model
-                        }
+                        if (cinfo->Modelid1)
+                            displayId = cinfo->Modelid1;    // Modelid1 is a visible model for gms
                         else
-                        {
-                            if (cinfo->Modelid2)
-                                displayId = cinfo->Modelid2;    // Modelid2 is an invisible model for players
-                            else
-                                displayId = 11686;              // world invisible trigger's model
-                        }
+                            displayId = 17519;              // world visible trigger's model
+                    }
+                    else
+                    {
+                        if (cinfo->Modelid2)
+                            displayId = cinfo->Modelid2;    // Modelid2 is an invisible model for players
+                        else
+                            displayId = 11686;              // world invisible trigger's model
                     }
                 }
-
-                fieldBuffer << uint32(displayId);
             }
-            // hide lootable animation for unallowed players
-            else if (index == UNIT_DYNAMIC_FLAGS)
-            {
-                uint32 dynamicFlags = m_uint32Values[UNIT_DYNAMIC_FLAGS] & ~(UNIT_DYNFLAG_TAPPED | UNIT_DYNFLAG_TAPPED_BY_PLAYER);
 
-                if (creature)
-                {
-                    if (creature->hasLootRecipient())
-                    {
-                        dynamicFlags |= UNIT_DYNFLAG_TAPPED;
-                        if (creature->isTappedBy(target))
-                            dynamicFlags |= UNIT_DYNFLAG_TAPPED_BY_PLAYER;
-                    }
+            return displayId;
+        }
+        // hide lootable animation for unallowed players
+        case UNIT_DYNAMIC_FLAGS:
+        {
+            uint32 dynamicFlags = m_uint32Values[UNIT_DYNAMIC_FLAGS] & ~(UNIT_DYNFLAG_TAPPED | UNIT_DYNFLAG_TAPPED_BY_PLAYER);
 
-                    if (!target->isAllowedToLoot(creature))
-                        dynamicFlags &= ~UNIT_DYNFLAG_LOOTABLE;
+            if (creature)
+            {
+                if (creature->hasLootRecipient())
+                {
+                    dynamicFlags |= UNIT_DYNFLAG_TAPPED;
+                    if (creature->isTappedBy(target))
+                        dynamicFlags |= UNIT_DYNFLAG_TAPPED_BY_PLAYER;
                 }
 
-                // unit UNIT_DYNFLAG_TRACK_UNIT should only be sent to caster of SPELL_AURA_MOD_STALKED auras
-                if (dynamicFlags & UNIT_DYNFLAG_TRACK_UNIT)
-                    if (!HasAuraTypeWithCaster(SPELL_AURA_MOD_STALKED, target->GetGUID()))
-                        dynamicFlags &= ~UNIT_DYNFLAG_TRACK_UNIT;
-
-                fieldBuffer << dynamicFlags;
+                if (!target->isAllowedToLoot(creature))
+                    dynamicFlags &= ~UNIT_DYNFLAG_LOOTABLE;
             }
-            // FG: pretend that OTHER players in own group are friendly ("blue")
-            else if (index == UNIT_FIELD_BYTES_2 || index == UNIT_FIELD_FACTIONTEMPLATE)
+
+            // unit UNIT_DYNFLAG_TRACK_UNIT should only be sent to caster of SPELL_AURA_MOD_STALKED auras
+            if (dynamicFlags & UNIT_DYNFLAG_TRACK_UNIT)
+                if (!HasAuraTypeWithCaster(SPELL_AURA_MOD_STALKED, target->GetGUID()))
+                    dynamicFlags &= ~UNIT_DYNFLAG_TRACK_UNIT;
+
+            return dynamicFlags;
+        }
+        // FG: pretend that OTHER players in own group are friendly ("blue")
+        case UNIT_FIELD_BYTES_2:
+        case UNIT_FIELD_FACTIONTEMPLATE:
+        {
+            if (IsControlledByPlayer() && target != this && CONF_GET_BOOL("AllowTwoSide.Interaction.Group") && IsInRaidWith(target))
             {
-                if (IsControlledByPlayer() && target != this && CONF_GET_BOOL("AllowTwoSide.Interaction.Group") && IsInRaidWith(target))
-                {
-                    FactionTemplateEntry const* ft1 = GetFactionTemplateEntry();
-                    FactionTemplateEntry const* ft2 = target->GetFactionTemplateEntry();
-                    if (ft1 && ft2 && !ft1->IsFriendlyTo(*ft2))
-                    {
-                        if (index == UNIT_FIELD_BYTES_2)
-                            // Allow targetting opposite faction in party when enabled in config
-                            fieldBuffer << (m_uint32Values[UNIT_FIELD_BYTES_2] & ((UNIT_BYTE2_FLAG_SANCTUARY /*| UNIT_BYTE2_FLAG_AURAS | UNIT_BYTE2_FLAG_UNK5*/) << 8)); // this flag is at uint8 offset 1 !!
-                        else
-                            // pretend that all other HOSTILE players have own faction, to allow follow, heal, rezz (trade wont work)
-                            fieldBuffer << uint32(target->getFaction());
-                    }
-                    else
-                        fieldBuffer << m_uint32Values[index];
-                }// pussywizard / Callmephil
-                else if (target->IsSpectator() && target->FindMap() && target->FindMap()->IsBattleArena() &&
-                         (this->GetTypeId() == TYPEID_PLAYER || this->GetTypeId() == TYPEID_UNIT || this->GetTypeId() == TYPEID_DYNAMICOBJECT))
+                FactionTemplateEntry const* ft1 = GetFactionTemplateEntry();
+                FactionTemplateEntry const* ft2 = target->GetFactionTemplateEntry();
+                if (ft1 && ft2 && !ft1->IsFriendlyTo(*ft2))
                 {
                     if (index == UNIT_FIELD_BYTES_2)
-                        fieldBuffer << (m_uint32Values[index] & 0xFFFFF2FF); // clear UNIT_BYTE2_FLAG_PVP, UNIT_BYTE2_FLAG_FFA_PVP, UNIT_BYTE2_FLAG_SANCTUARY
+                        // Allow targetting opposite faction in party when enabled in config
+                        return m_uint32Values[UNIT_FIELD_BYTES_2] & ((UNIT_BYTE2_FLAG_SANCTUARY /*| UNIT_BYTE2_FLAG_AURAS | UNIT_BYTE2_FLAG_UNK5*/) << 8); // this flag is at uint8 offset 1 !!
                     else
-                        fieldBuffer << (uint32)target->getFaction();
+                        // pretend that all other HOSTILE players have own faction, to allow follow, heal, rezz (trade wont work)
+                        return uint32(target->getFaction());
                 }
+            }// pussywizard / Callmephil
+            else if (target->IsSpectator() && target->FindMap() && target->FindMap()->IsBattleArena() &&
+                     (this->GetTypeId() == TYPEID_PLAYER || this->GetTypeId() == TYPEID_UNIT || this->GetTypeId() == TYPEID_DYNAMICOBJECT))
+            {
+                if (index == UNIT_FIELD_BYTES_2)
+                    return m_uint32Values[index] & 0xFFFFF2FF; // clear UNIT_BYTE2_FLAG_PVP, UNIT_BYTE2_FLAG_FFA_PVP, UNIT_BYTE2_FLAG_SANCTUARY
                 else
-                    fieldBuffer << m_uint32Values[index];
+                    return (uint32)target->getFaction();
             }
-            else
-                // send in current format (float as float, uint32 as uint32)
-                fieldBuffer << m_uint32Values[index];
+
+            return m_uint32Values[index];
         }
+        default:
+            return m_uint32Values[index];
     }
-
-    *data << uint8(updateMask.GetBlockCount());
-    updateMask.AppendToPacket(data);
-    data->append(fieldBuffer);
 }
 
 void Unit::BuildCooldownPacket(WorldPacket& data, uint8 flags, uint32 spellId, uint32 cooldown)
@@ -2472,6 +2472,8 @@ protected:
     explicit Unit (bool isWorldObject);
 
     void BuildValuesUpdate(uint8 updatetype, ByteBuffer* data, Player* target) const override;
+    uint32 GetUpdateFieldValueForTarget(uint16 index, Player* target) const override;
+    static bool IsUpdateFieldTargetDependent(uint16 index);
 
     UnitAI* i_AI, *i_disabledAI;
 
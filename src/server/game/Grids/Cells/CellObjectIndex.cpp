@@ -0,0 +1,146 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "CellObjectIndex.h"
+#include "Object.h"
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CELLOBJECTINDEX_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+// keeps the prefilter conservative against rounding differences to the exact distance checks
+#define CELL_INDEX_RADIUS_SLACK 0.01f
+
+CellObjectIndex::~CellObjectIndex()
+{
+    for (WorldObject* obj : _objects)
+        obj->m_cellIndex = nullptr;
+}
+
+void CellObjectIndex::Insert(WorldObject* obj)
+{
+    ASSERT(!obj->m_cellIndex);
+
+    obj->m_cellIndex = this;
+    obj->m_cellIndexSlot = GetSize();
+
+    _x.push_back(obj->GetPositionX());
+    _y.push_back(obj->GetPositionY());
+    _size.push_back(obj->GetObjectSize());
+    _phaseMask.push_back(obj->GetPhaseMask());
+    _typeMask.push_back(1 << obj->GetTypeId());
+    _objects.push_back(obj);
+}
+
+void CellObjectIndex::Remove(WorldObject* obj)
+{
+    ASSERT(obj->m_cellIndex == this);
+
+    uint32 slot = obj->m_cellIndexSlot;
+    uint32 last = GetSize() - 1;
+    if (slot != last)
+    {
+        _x[slot] = _x[last];
+        _y[slot] = _y[last];
+        _size[slot] = _size[last];
+        _phaseMask[slot] = _phaseMask[last];
+        _typeMask[slot] = _typeMask[last];
+        _objects[slot] = _objects[last];
+        _objects[slot]->m_cellIndexSlot = slot;
+    }
+
+    _x.pop_back();
+    _y.pop_back();
+    _size.pop_back();
+    _phaseMask.pop_back();
+    _typeMask.pop_back();
+    _objects.pop_back();
+
+    obj->m_cellIndex = nullptr;
+}
+
+void CellObjectIndex::Update(WorldObject const* obj)
+{
+    ASSERT(obj->m_cellIndex == this);
+
+    uint32 slot = obj->m_cellIndexSlot;
+    _x[slot] = obj->GetPositionX();
+    _y[slot] = obj->GetPositionY();
+    _size[slot] = obj->GetObjectSize();
+    _phaseMask[slot] = obj->GetPhaseMask();
+}
+
+uint32 CellObjectIndex::Filter(CellObjectIndexFilter const& filter, uint32 base, uint32 count) const
+{
+    uint32 end = std::min(base + 32, count);
+    uint32 mask = 0;
+    uint32 i = base;
+
+    float radius = filter.radius + CELL_INDEX_RADIUS_SLACK;
+    float sizeFactor = filter.addObjectSize ? 1.0f : 0.0f;
+
+#ifdef CELLOBJECTINDEX_USE_SSE2
+    __m128 const px = _mm_set1_ps(filter.x);
+    __m128 const py = _mm_set1_ps(filter.y);
+    __m128 const pradius = _mm_set1_ps(radius);
+    __m128 const psizeFactor = _mm_set1_ps(sizeFactor);
+    __m128i const phase = _mm_set1_epi32(int32(filter.phaseMask));
+    __m128i const type = _mm_set1_epi32(int32(filter.typeMask));
+    __m128i const zero = _mm_setzero_si128();
+    __m128i const allSet = _mm_cmpeq_epi32(zero, zero);
+
+    for (; i + 4 <= end; i += 4)
+    {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(&_x[i]), px);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(&_y[i]), py);
+        __m128 r = _mm_add_ps(pradius, _mm_mul_ps(_mm_loadu_ps(&_size[i]), psizeFactor));
+        __m128 inRange = _mm_cmpngt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(r, r));
+
+        // WorldObject::InSamePhase is either a bitwise and or an equality test, accept both
+        __m128i phases = _mm_loadu_si128(reinterpret_cast<__m128i const*>(&_phaseMask[i]));
+        __m128i phaseOk = _mm_or_si128(_mm_cmpeq_epi32(phases, phase), _mm_xor_si128(_mm_cmpeq_epi32(_mm_and_si128(phases, phase), zero), allSet));
+
+        __m128i types = _mm_loadu_si128(reinterpret_cast<__m128i const*>(&_typeMask[i]));
+        __m128i typeOk = _mm_xor_si128(_mm_cmpeq_epi32(_mm_and_si128(types, type), zero), allSet);
+
+        __m128i ok = _mm_and_si128(_mm_and_si128(phaseOk, typeOk), _mm_castps_si128(inRange));
+        mask |= uint32(_mm_movemask_ps(_mm_castsi128_ps(ok))) << (i - base);
+    }
+#endif
+
+    for (; i < end; ++i)
+    {
+        if (!(_typeMask[i] & filter.typeMask))
+            continue;
+
+        if (!(_phaseMask[i] & filter.phaseMask) && _phaseMask[i] != filter.phaseMask)
+            continue;
+
+        float dx = _x[i] - filter.x;
+        float dy = _y[i] - filter.y;
+        float r = radius + _size[i] * sizeFactor;
+        if (dx * dx + dy * dy > r * r)
+            continue;
+
+        mask |= 1u << (i - base);
+    }
+
+    return mask;
+}
@@ -0,0 +1,87 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef WARHEAD_CELLOBJECTINDEX_H
+#define WARHEAD_CELLOBJECTINDEX_H
+
+#include "Define.h"
+#include <vector>
+
+class WorldObject;
+
+// Spatial prefilter passed to CellObjectIndex::Visit
+struct CellObjectIndexFilter
+{
+    CellObjectIndexFilter() : x(0.0f), y(0.0f), radius(0.0f), addObjectSize(false), phaseMask(0), typeMask(0) { }
+
+    float x;
+    float y;
+    float radius;                                           // 2d search radius around x, y
+    bool addObjectSize;                                     // widen the radius by the size of each object
+    uint32 phaseMask;
+    uint32 typeMask;                                        // TYPEMASK_* of the wanted objects, 1 << TypeId
+};
+
+// Packed copy of position, size, phase and type of all objects of one grid container in one cell.
+// Visitors that only care about a few objects near a point can reject the rest of the cell
+// four at a time without touching the objects themselves (see Grid::Visit).
+// Kept up to date by the grid add/remove paths and by WorldObject::UpdateCellIndex, which
+// Map::*Relocation, SetPhaseMask and combat reach changes call.
+class CellObjectIndex
+{
+public:
+    CellObjectIndex() = default;
+    ~CellObjectIndex();
+
+    CellObjectIndex(CellObjectIndex const&) = delete;
+    CellObjectIndex& operator=(CellObjectIndex const&) = delete;
+
+    void Insert(WorldObject* obj);
+    void Remove(WorldObject* obj);
+    void Update(WorldObject const* obj);
+
+    uint32 GetSize() const { return uint32(_objects.size()); }
+
+    // Calls worker for every object which may pass the filter. The test is conservative,
+    // callers still have to run their exact checks. The worker must not add or remove objects of this cell.
+    template<class Worker>
+    void Visit(CellObjectIndexFilter const& filter, Worker&& worker) const
+    {
+        uint32 count = GetSize();
+        for (uint32 base = 0; base < count; base += 32)
+        {
+            uint32 mask = Filter(filter, base, count);
+            for (uint32 i = base; mask; ++i, mask >>= 1)
+                if (mask & 1)
+                    worker(_objects[i]);
+        }
+    }
+
+private:
+    // returns a bit for each of the (up to 32) objects starting at base which pass the filter
+    uint32 Filter(CellObjectIndexFilter const& filter, uint32 base, uint32 count) const;
+
+    std::vector<float> _x;
+    std::vector<float> _y;
+    std::vector<float> _size;
+    std::vector<uint32> _phaseMask;
+    std::vector<uint32> _typeMask;
+    std::vector<WorldObject*> _objects;
+};
+
+#endif
@@ -30,12 +30,22 @@
 */
 
 #include "Define.h"
+#include "CellObjectIndex.h"
 #include "TypeContainer.h"
 #include "TypeContainerVisitor.h"
+#include <type_traits>
+#include <utility>
 
 // forward declaration
 template<class A, class T, class O> class GridLoader;
 
+// Visitors providing VisitIndex(CellObjectIndex const&) get the packed cell index instead of the object lists
+template<class VISITOR, class = void>
+struct HasCellIndexVisit : std::false_type { };
+
+template<class VISITOR>
+struct HasCellIndexVisit<VISITOR, decltype(std::declval<VISITOR&>().VisitIndex(std::declval<CellObjectIndex const&>()), void())> : std::true_type { };
+
 template
 <
     class ACTIVE_OBJECT,
@@ -59,6 +69,7 @@ public:
     {
         i_objects.template insert<SPECIFIC_OBJECT>(obj);
         ASSERT(obj->IsInGrid());
+        i_worldIndex.Insert(obj);
     }
 
     /** an object of interested exits the grid
@@ -87,14 +98,20 @@ public:
     template<class T>
     void Visit(TypeContainerVisitor<T, TypeMapContainer<GRID_OBJECT_TYPES> >& visitor)
     {
-        visitor.Visit(i_container);
+        if constexpr (HasCellIndexVisit<T>::value)
+            visitor.GetVisitor().VisitIndex(i_gridIndex);
+        else
+            visitor.Visit(i_container);
     }
 
     // Visit world objects
     template<class T>
     void Visit(TypeContainerVisitor<T, TypeMapContainer<WORLD_OBJECT_TYPES> >& visitor)
     {
-        visitor.Visit(i_objects);
+        if constexpr (HasCellIndexVisit<T>::value)
+            visitor.GetVisitor().VisitIndex(i_worldIndex);
+        else
+            visitor.Visit(i_objects);
     }
 
     /** Inserts a container type object into the grid.
@@ -103,6 +120,7 @@ public:
     {
         i_container.template insert<SPECIFIC_OBJECT>(obj);
         ASSERT(obj->IsInGrid());
+        i_gridIndex.Insert(obj);
     }
 
     /** Removes a containter type object from the grid
@@ -127,6 +145,8 @@ private:
 
     TypeMapContainer<GRID_OBJECT_TYPES> i_container;
     TypeMapContainer<WORLD_OBJECT_TYPES> i_objects;
+    CellObjectIndex i_gridIndex;
+    CellObjectIndex i_worldIndex;
     //typedef std::set<void*> ActiveGridObjects;
     //ActiveGridObjects m_activeGridObjects;
 };
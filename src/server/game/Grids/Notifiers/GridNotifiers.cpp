@@ -26,6 +26,7 @@
 #include "ObjectAccessor.h"
 #include "CellImpl.h"
 #include "SpellInfo.h"
+#include <type_traits>
 
 using namespace Warhead;
 
@@ -35,14 +36,14 @@ void VisibleNotifier::Visit(GameObjectMapType& m)
     {
         if (i_largeOnly != iter->GetSource()->IsVisibilityOverridden())
             continue;
-        vis_guids.erase(iter->GetSource()->GetGUID());
+        i_player.m_clientGUIDs.Touch(iter->GetSource()->GetGUID());
         i_player.UpdateVisibilityOf(iter->GetSource(), i_data, i_visibleNow);
     }
 }
 
 void VisibleNotifier::SendToSelf()
 {
-    // at this moment i_clientGUIDs have guids that not iterate at grid level checks
+    // at this moment guids not touched by this pass have not been iterated at grid level checks
     // but exist one case when this possible and object not out of range: transports
     if (Transport* transport = i_player.GetTransport())
         for (Transport::PassengerSet::const_iterator itr = transport->GetPassengers().begin(); itr != transport->GetPassengers().end(); ++itr)
@@ -50,9 +51,9 @@ void VisibleNotifier::SendToSelf()
             if (i_largeOnly != (*itr)->IsVisibilityOverridden())
                 continue;
 
-            if (vis_guids.find((*itr)->GetGUID()) != vis_guids.end())
+            if (i_player.m_clientGUIDs.IsUnseen((*itr)->GetGUID(), i_pass))
             {
-                vis_guids.erase((*itr)->GetGUID());
+                i_player.m_clientGUIDs.Touch((*itr)->GetGUID());
 
                 switch ((*itr)->GetTypeId())
                 {
@@ -72,7 +73,11 @@ void VisibleNotifier::SendToSelf()
             }
         }
 
-    for (Player::ClientGUIDs::const_iterator it = vis_guids.begin(); it != vis_guids.end(); ++it)
+    // everything the client knows about and the grid visit did not reach
+    std::vector<uint64> outOfRange;
+    i_player.m_clientGUIDs.GetUnseen(i_pass, outOfRange);
+
+    for (std::vector<uint64>::const_iterator it = outOfRange.begin(); it != outOfRange.end(); ++it)
     {
         if (WorldObject* obj = ObjectAccessor::GetWorldObject(i_player, *it))
             if (i_largeOnly != obj->IsVisibilityOverridden())
@@ -167,7 +172,7 @@ void PlayerRelocationNotifier::Visit(PlayerMapType& m)
     for (PlayerMapType::iterator iter = m.begin(); iter != m.end(); ++iter)
     {
         Player* player = iter->GetSource();
-        vis_guids.erase(player->GetGUID());
+        i_player.m_clientGUIDs.Touch(player->GetGUID());
         i_player.UpdateVisibilityOf(player, i_data, i_visibleNow);
         player->UpdateVisibilityOf(&i_player); // this notifier with different Visit(PlayerMapType&) than VisibleNotifier is needed to update visibility of self for other players when we move (eg. stealth detection changes)
     }
@@ -208,67 +213,101 @@ void AIRelocationNotifier::Visit(CreatureMapType& m)
 void MessageDistDeliverer::Visit(PlayerMapType& m)
 {
     for (PlayerMapType::iterator iter = m.begin(); iter != m.end(); ++iter)
-    {
-        Player* target = iter->GetSource();
-        if (!target->InSamePhase(i_phaseMask))
-            continue;
+        Deliver(iter->GetSource());
+}
 
-        if (target->GetExactDist2dSq(i_source) > i_distSq)
-            continue;
+void MessageDistDeliverer::Visit(CreatureMapType& m)
+{
+    for (CreatureMapType::iterator iter = m.begin(); iter != m.end(); ++iter)
+        Deliver(iter->GetSource());
+}
 
-        // Send packet to all who are sharing the player's vision
-        if (target->HasSharedVision())
+void MessageDistDeliverer::Visit(DynamicObjectMapType& m)
+{
+    for (DynamicObjectMapType::iterator iter = m.begin(); iter != m.end(); ++iter)
+        Deliver(iter->GetSource());
+}
+
+void MessageDistDeliverer::VisitIndex(CellObjectIndex const& index)
+{
+    CellObjectIndexFilter filter;
+    filter.x = i_source->GetPositionX();
+    filter.y = i_source->GetPositionY();
+    filter.radius = std::sqrt(i_distSq);
+    filter.phaseMask = i_phaseMask;
+    filter.typeMask = TYPEMASK_PLAYER | TYPEMASK_UNIT | TYPEMASK_DYNAMICOBJECT;
+
+    index.Visit(filter, [this](WorldObject* target)
+    {
+        switch (target->GetTypeId())
         {
-            SharedVisionList::const_iterator i = target->GetSharedVisionList().begin();
-            for (; i != target->GetSharedVisionList().end(); ++i)
-                if ((*i)->m_seer == target)
-                    SendPacket(*i);
+            case TYPEID_PLAYER:
+                Deliver(target->ToPlayer());
+                break;
+            case TYPEID_UNIT:
+                Deliver(target->ToCreature());
+                break;
+            case TYPEID_DYNAMICOBJECT:
+                Deliver(target->ToDynObject());
+                break;
+            default:
+                break;
         }
-
-        if (target->m_seer == target || target->GetVehicle())
-            SendPacket(target);
-    }
+    });
 }
 
-void MessageDistDeliverer::Visit(CreatureMapType& m)
+void MessageDistDeliverer::Deliver(Player* target)
 {
-    for (CreatureMapType::iterator iter = m.begin(); iter != m.end(); ++iter)
-    {
-        Creature* target = iter->GetSource();
-        if (!target->HasSharedVision() || !target->InSamePhase(i_phaseMask))
-            continue;
+    if (!target->InSamePhase(i_phaseMask))
+        return;
 
-        if (target->GetExactDist2dSq(i_source) > i_distSq)
-            continue;
+    if (target->GetExactDist2dSq(i_source) > i_distSq)
+        return;
 
-        // Send packet to all who are sharing the creature's vision
+    // Send packet to all who are sharing the player's vision
+    if (target->HasSharedVision())
+    {
         SharedVisionList::const_iterator i = target->GetSharedVisionList().begin();
         for (; i != target->GetSharedVisionList().end(); ++i)
             if ((*i)->m_seer == target)
                 SendPacket(*i);
     }
+
+    if (target->m_seer == target || target->GetVehicle())
+        SendPacket(target);
 }
 
-void MessageDistDeliverer::Visit(DynamicObjectMapType& m)
+void MessageDistDeliverer::Deliver(Creature* target)
 {
-    for (DynamicObjectMapType::iterator iter = m.begin(); iter != m.end(); ++iter)
-    {
-        DynamicObject* target = iter->GetSource();
-        if (!IS_PLAYER_GUID(target->GetCasterGUID()) || !target->InSamePhase(i_phaseMask))
-            continue;
+    if (!target->HasSharedVision() || !target->InSamePhase(i_phaseMask))
+        return;
 
-        // Xinef: Check whether the dynobject allows to see through it
-        if (!target->IsViewpoint())
-            continue;
+    if (target->GetExactDist2dSq(i_source) > i_distSq)
+        return;
 
-        if (target->GetExactDist2dSq(i_source) > i_distSq)
-            continue;
+    // Send packet to all who are sharing the creature's vision
+    SharedVisionList::const_iterator i = target->GetSharedVisionList().begin();
+    for (; i != target->GetSharedVisionList().end(); ++i)
+        if ((*i)->m_seer == target)
+            SendPacket(*i);
+}
 
-        // Send packet back to the caster if the caster has vision of dynamic object
-        Player* caster = (Player*)target->GetCaster();
-        if (caster && caster->m_seer == target)
-            SendPacket(caster);
-    }
+void MessageDistDeliverer::Deliver(DynamicObject* target)
+{
+    if (!IS_PLAYER_GUID(target->GetCasterGUID()) || !target->InSamePhase(i_phaseMask))
+        return;
+
+    // Xinef: Check whether the dynobject allows to see through it
+    if (!target->IsViewpoint())
+        return;
+
+    if (target->GetExactDist2dSq(i_source) > i_distSq)
+        return;
+
+    // Send packet back to the caster if the caster has vision of dynamic object
+    Player* caster = (Player*)target->GetCaster();
+    if (caster && caster->m_seer == target)
+        SendPacket(caster);
 }
 
 void MessageDistDelivererToHostile::Visit(PlayerMapType& m)
@@ -341,8 +380,15 @@ void ObjectUpdater::Visit(GridRefManager<T>& m)
     {
         obj = iter->GetSource();
         ++iter;
-        if (obj->IsInWorld() && (i_largeOnly == obj->IsVisibilityOverridden()))
-            obj->Update(i_timeDiff);
+        if (!obj->IsInWorld() || (i_largeOnly != obj->IsVisibilityOverridden()))
+            continue;
+
+        // dynamic objects are short living spell effects, always updated
+        uint32 diff = i_timeDiff;
+        if (i_hibernation && !std::is_same<T, DynamicObject>::value && !i_hibernation->ShouldUpdate(obj, diff))
+            continue;
+
+        obj->Update(diff);
     }
 }
 
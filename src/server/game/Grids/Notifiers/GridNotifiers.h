@@ -31,7 +31,10 @@
 #include "CreatureAI.h"
 #include "Spell.h"
 #include "WorldSession.h"
+#include <limits>
+#include <utility>
 
+class MapHibernation;
 class Player;
 //class Map;
 
@@ -40,13 +43,13 @@ namespace Warhead
     struct VisibleNotifier
     {
         Player& i_player;
-        Player::ClientGUIDs vis_guids;
         std::vector<Unit*>& i_visibleNow;
         bool i_gobjOnly;
         bool i_largeOnly;
+        uint32 i_pass;                                      // known guids not touched during this pass went out of range
         UpdateData i_data;
 
-        VisibleNotifier(Player& player, bool gobjOnly, bool largeOnly) : i_player(player), vis_guids(player.m_clientGUIDs), i_visibleNow(player.m_newVisible), i_gobjOnly(gobjOnly), i_largeOnly(largeOnly)
+        VisibleNotifier(Player& player, bool gobjOnly, bool largeOnly) : i_player(player), i_visibleNow(player.m_newVisible), i_gobjOnly(gobjOnly), i_largeOnly(largeOnly), i_pass(player.m_clientGUIDs.BeginPass())
         {
             i_visibleNow.clear();
         }
@@ -111,6 +114,13 @@ namespace Warhead
         void Visit(DynamicObjectMapType& m);
         template<class SKIP> void Visit(GridRefManager<SKIP>&) {}
 
+        // world objects only, skips everything out of range without touching it
+        void VisitIndex(CellObjectIndex const& index);
+
+        void Deliver(Player* target);
+        void Deliver(Creature* target);
+        void Deliver(DynamicObject* target);
+
         void SendPacket(Player* player)
         {
             // never send packet to self
@@ -153,7 +163,8 @@ namespace Warhead
     {
         uint32 i_timeDiff;
         bool i_largeOnly;
-        explicit ObjectUpdater(const uint32 diff, bool largeOnly) : i_timeDiff(diff), i_largeOnly(largeOnly) {}
+        MapHibernation* i_hibernation;
+        explicit ObjectUpdater(const uint32 diff, bool largeOnly, MapHibernation* hibernation = nullptr) : i_timeDiff(diff), i_largeOnly(largeOnly), i_hibernation(hibernation) {}
         template<class T> void Visit(GridRefManager<T>& m);
         void Visit(PlayerMapType&) {}
         void Visit(CorpseMapType&) {}
@@ -399,6 +410,10 @@ namespace Warhead
         void Visit(CreatureMapType& m);
 
         template<class NOT_INTERESTED> void Visit(GridRefManager<NOT_INTERESTED>&) {}
+
+        // only for checks which can describe their range, see AnyUnitInObjectRangeCheck::FillIndexFilter
+        template<class C = Check>
+        auto VisitIndex(CellObjectIndex const& index) -> decltype(std::declval<C&>().FillIndexFilter(std::declval<CellObjectIndexFilter&>()), void());
     };
 
     // Creature searchers
@@ -447,6 +462,10 @@ namespace Warhead
         void Visit(CreatureMapType& m);
 
         template<class NOT_INTERESTED> void Visit(GridRefManager<NOT_INTERESTED>&) {}
+
+        // only for checks which can describe their range, see AnyUnitInObjectRangeCheck::FillIndexFilter
+        template<class C = Check>
+        auto VisitIndex(CellObjectIndex const& index) -> decltype(std::declval<C&>().FillIndexFilter(std::declval<CellObjectIndexFilter&>()), void());
     };
 
     template<class Do>
@@ -950,6 +969,19 @@ namespace Warhead
 
             return false;
         }
+
+        // 2d bound of IsWithinDistInMap, gameobjects and transport passengers measure differently
+        bool FillIndexFilter(CellObjectIndexFilter& filter) const
+        {
+            if (i_obj->GetTypeId() == TYPEID_GAMEOBJECT || i_obj->GetTransport())
+                return false;
+
+            filter.x = i_obj->GetPositionX();
+            filter.y = i_obj->GetPositionY();
+            filter.radius = i_range + i_obj->GetObjectSize();
+            filter.addObjectSize = true;
+            return true;
+        }
     private:
         WorldObject const* i_obj;
         float i_range;
@@ -38,7 +38,7 @@ inline void Warhead::VisibleNotifier::Visit(GridRefManager<T>& m)
     {
         if (i_largeOnly != iter->GetSource()->IsVisibilityOverridden())
             continue;
-        vis_guids.erase(iter->GetSource()->GetGUID());
+        i_player.m_clientGUIDs.Touch(iter->GetSource()->GetGUID());
         i_player.UpdateVisibilityOf(iter->GetSource(), i_data, i_visibleNow);
     }
 }
@@ -427,6 +427,26 @@ void Warhead::UnitListSearcher<Check>::Visit(CreatureMapType& m)
                 i_objects.push_back(itr->GetSource());
 }
 
+template<class Check>
+template<class C>
+auto Warhead::UnitListSearcher<Check>::VisitIndex(CellObjectIndex const& index) -> decltype(std::declval<C&>().FillIndexFilter(std::declval<CellObjectIndexFilter&>()), void())
+{
+    CellObjectIndexFilter filter;
+    if (!i_check.FillIndexFilter(filter))
+        filter.radius = std::numeric_limits<float>::max();
+
+    filter.phaseMask = i_phaseMask;
+    filter.typeMask = TYPEMASK_PLAYER | TYPEMASK_UNIT;
+
+    index.Visit(filter, [this](WorldObject* obj)
+    {
+        Unit* unit = obj->ToUnit();
+        if (unit->InSamePhase(i_phaseMask))
+            if (i_check(unit))
+                i_objects.push_back(unit);
+    });
+}
+
 // Creature searchers
 
 template<class Check>
@@ -471,6 +491,26 @@ void Warhead::CreatureListSearcher<Check>::Visit(CreatureMapType& m)
                 i_objects.push_back(itr->GetSource());
 }
 
+template<class Check>
+template<class C>
+auto Warhead::CreatureListSearcher<Check>::VisitIndex(CellObjectIndex const& index) -> decltype(std::declval<C&>().FillIndexFilter(std::declval<CellObjectIndexFilter&>()), void())
+{
+    CellObjectIndexFilter filter;
+    if (!i_check.FillIndexFilter(filter))
+        filter.radius = std::numeric_limits<float>::max();
+
+    filter.phaseMask = i_phaseMask;
+    filter.typeMask = TYPEMASK_UNIT;
+
+    index.Visit(filter, [this](WorldObject* obj)
+    {
+        Creature* creature = obj->ToCreature();
+        if (creature->InSamePhase(i_phaseMask))
+            if (i_check(creature))
+                i_objects.push_back(creature);
+    });
+}
+
 template<class Check>
 void Warhead::PlayerListSearcher<Check>::Visit(PlayerMapType& m)
 {
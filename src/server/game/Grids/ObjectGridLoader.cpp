@@ -65,19 +65,17 @@ template<> void ObjectGridLoader::SetObjectCell(GameObject* obj, CellCoord const
     obj->SetCurrentCell(cell);
 }
 
-template <class T>
-void AddObjectHelper(CellCoord& cell, GridRefManager<T>& m, uint32& count, Map* /*map*/, T* obj)
+void AddObjectHelper(CellCoord& cell, GridType& grid, uint32& count, Map* /*map*/, Corpse* obj)
 {
-    obj->AddToGrid(m);
+    grid.AddWorldObject(obj);
     ObjectGridLoader::SetObjectCell(obj, cell);
     obj->AddToWorld();
     ++count;
 }
 
-template <>
-void AddObjectHelper(CellCoord& cell, CreatureMapType& m, uint32& count, Map* map, Creature* obj)
+void AddObjectHelper(CellCoord& cell, GridType& grid, uint32& count, Map* map, Creature* obj)
 {
-    obj->AddToGrid(m);
+    grid.AddGridObject(obj);
     ObjectGridLoader::SetObjectCell(obj, cell);
     obj->AddToWorld();
     if (obj->isActiveObject())
@@ -86,10 +84,9 @@ void AddObjectHelper(CellCoord& cell, CreatureMapType& m, uint32& count, Map* ma
     ++count;
 }
 
-template <>
-void AddObjectHelper(CellCoord& cell, GameObjectMapType& m, uint32& count, Map* map, GameObject* obj)
+void AddObjectHelper(CellCoord& cell, GridType& grid, uint32& count, Map* map, GameObject* obj)
 {
-    obj->AddToGrid(m);
+    grid.AddGridObject(obj);
     ObjectGridLoader::SetObjectCell(obj, cell);
     obj->AddToWorld();
     if (obj->isActiveObject())
@@ -99,7 +96,7 @@ void AddObjectHelper(CellCoord& cell, GameObjectMapType& m, uint32& count, Map*
 }
 
 template <class T>
-void LoadHelper(CellGuidSet const& guid_set, CellCoord& cell, GridRefManager<T>& m, uint32& count, Map* map)
+void LoadHelper(CellGuidSet const& guid_set, CellCoord& cell, GridType& grid, uint32& count, Map* map)
 {
     for (CellGuidSet::const_iterator i_guid = guid_set.begin(); i_guid != guid_set.end(); ++i_guid)
     {
@@ -112,12 +109,12 @@ void LoadHelper(CellGuidSet const& guid_set, CellCoord& cell, GridRefManager<T>&
             continue;
         }
 
-        AddObjectHelper(cell, m, count, map, obj);
+        AddObjectHelper(cell, grid, count, map, obj);
     }
 }
 
 template <>
-void LoadHelper(CellGuidSet const& guid_set, CellCoord& cell, GridRefManager<GameObject>& m, uint32& count, Map* map)
+void LoadHelper<GameObject>(CellGuidSet const& guid_set, CellCoord& cell, GridType& grid, uint32& count, Map* map)
 {
     for (CellGuidSet::const_iterator i_guid = guid_set.begin(); i_guid != guid_set.end(); ++i_guid)
     {
@@ -131,11 +128,11 @@ void LoadHelper(CellGuidSet const& guid_set, CellCoord& cell, GridRefManager<Gam
             continue;
         }
 
-        AddObjectHelper(cell, m, count, map, obj);
+        AddObjectHelper(cell, grid, count, map, obj);
     }
 }
 
-void LoadHelper(CellCorpseSet const& cell_corpses, CellCoord& cell, CorpseMapType& m, uint32& count, Map* map)
+void LoadHelper(CellCorpseSet const& cell_corpses, CellCoord& cell, GridType& grid, uint32& count, Map* map)
 {
     if (cell_corpses.empty())
         return;
@@ -163,30 +160,30 @@ void LoadHelper(CellCorpseSet const& cell_corpses, CellCoord& cell, CorpseMapTyp
             continue;
         }
 
-        AddObjectHelper(cell, m, count, map, obj);
+        AddObjectHelper(cell, grid, count, map, obj);
     }
 }
 
-void ObjectGridLoader::Visit(GameObjectMapType& m)
+void ObjectGridLoader::Visit(GameObjectMapType& /*m*/)
 {
     CellCoord cellCoord = i_cell.GetCellCoord();
     CellObjectGuids const& cell_guids = sObjectMgr->GetCellObjectGuids(i_map->GetId(), i_map->GetSpawnMode(), cellCoord.GetId());
-    LoadHelper(cell_guids.gameobjects, cellCoord, m, i_gameObjects, i_map);
+    LoadHelper<GameObject>(cell_guids.gameobjects, cellCoord, i_grid.GetGridType(i_cell.CellX(), i_cell.CellY()), i_gameObjects, i_map);
 }
 
-void ObjectGridLoader::Visit(CreatureMapType& m)
+void ObjectGridLoader::Visit(CreatureMapType& /*m*/)
 {
     CellCoord cellCoord = i_cell.GetCellCoord();
     CellObjectGuids const& cell_guids = sObjectMgr->GetCellObjectGuids(i_map->GetId(), i_map->GetSpawnMode(), cellCoord.GetId());
-    LoadHelper(cell_guids.creatures, cellCoord, m, i_creatures, i_map);
+    LoadHelper<Creature>(cell_guids.creatures, cellCoord, i_grid.GetGridType(i_cell.CellX(), i_cell.CellY()), i_creatures, i_map);
 }
 
-void ObjectWorldLoader::Visit(CorpseMapType& m)
+void ObjectWorldLoader::Visit(CorpseMapType& /*m*/)
 {
     CellCoord cellCoord = i_cell.GetCellCoord();
     // corpses are always added to spawn mode 0 and they are spawned by their instance id
     CellObjectGuids const& cell_guids = sObjectMgr->GetCellObjectGuids(i_map->GetId(), 0, cellCoord.GetId());
-    LoadHelper(cell_guids.corpses, cellCoord, m, i_corpses, i_map);
+    LoadHelper(cell_guids.corpses, cellCoord, i_grid.GetGridType(i_cell.CellX(), i_cell.CellY()), i_corpses, i_map);
 }
 
 void ObjectGridLoader::LoadN(void)
@@ -0,0 +1,192 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "GridPreloader.h"
+#include "GameConfig.h"
+#include "Log.h"
+#include "Map.h"
+#include "MMapFactory.h"
+#include "StringFormat.h"
+#include "Timer.h"
+#include "VMapFactory.h"
+#include "World.h"
+
+struct GridPreloadRequest
+{
+    uint32 mapId;
+    int gx;
+    int gy;
+    bool loadMMap;
+};
+
+GridPreloader::GridPreloader() : _cancelationToken(false), _checkTimer(0)
+{
+}
+
+GridPreloader::~GridPreloader()
+{
+    Deactivate();
+}
+
+void GridPreloader::Activate(size_t numThreads)
+{
+    for (size_t i = 0; i < numThreads; ++i)
+        _workerThreads.push_back(std::thread(&GridPreloader::WorkerThread, this));
+}
+
+void GridPreloader::Deactivate()
+{
+    if (!Activated())
+        return;
+
+    _cancelationToken = true;
+
+    _queue.Cancel();
+
+    for (auto& thread : _workerThreads)
+        thread.join();
+
+    _workerThreads.clear();
+
+    std::lock_guard<std::mutex> guard(_lock);
+    for (auto const& itr : _grids)
+        Discard(itr.first, itr.second);
+
+    _grids.clear();
+}
+
+void GridPreloader::SchedulePreload(uint32 mapId, int gx, int gy, bool loadMMap)
+{
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        uint32 key = MakeKey(mapId, gx, gy);
+        if (_grids.find(key) != _grids.end())
+            return;
+
+        _grids[key].loadMMap = loadMMap;
+    }
+
+    LOG_DEBUG("maps", "GridPreloader: scheduled map %u tile [%i, %i]", mapId, gx, gy);
+
+    _queue.Push(new GridPreloadRequest{ mapId, gx, gy, loadMMap });
+}
+
+GridMap* GridPreloader::TakeGridMap(uint32 mapId, int gx, int gy)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    PreloadedGridMap::iterator itr = _grids.find(MakeKey(mapId, gx, gy));
+    if (itr == _grids.end())
+        return nullptr;
+
+    // still in progress, the worker drops its result once it sees the request is gone
+    GridMap* gridMap = itr->second.gridMap;
+    _grids.erase(itr);
+    return gridMap;
+}
+
+void GridPreloader::Update(uint32 diff)
+{
+    _checkTimer += diff;
+    if (_checkTimer < 1000)
+        return;
+
+    _checkTimer = 0;
+
+    uint32 now = getMSTime();
+
+    std::lock_guard<std::mutex> guard(_lock);
+    for (PreloadedGridMap::iterator itr = _grids.begin(); itr != _grids.end();)
+    {
+        if (itr->second.finished && getMSTimeDiff(itr->second.readyTime, now) > uint32(CONF_GET_INT("GridPreload.KeepTime")))
+        {
+            LOG_DEBUG("maps", "GridPreloader: dropping unused map %u tile [%u, %u]", itr->first >> 16, (itr->first >> 8) & 0xFF, itr->first & 0xFF);
+            Discard(itr->first, itr->second);
+            itr = _grids.erase(itr);
+        }
+        else
+            ++itr;
+    }
+}
+
+void GridPreloader::Discard(uint32 key, PreloadedGrid const& grid)
+{
+    uint32 mapId = key >> 16;
+    int gx = int((key >> 8) & 0xFF);
+    int gy = int(key & 0xFF);
+
+    delete grid.gridMap;
+
+    VMAP::VMapFactory::createOrGetVMapManager()->discardPreloadedMap(mapId, gx, gy);
+
+    if (grid.loadMMap)
+        MMAP::MMapFactory::createOrGetMMapManager()->discardPreloadedMap(mapId, gx, gy);
+}
+
+void GridPreloader::Preload(GridPreloadRequest const& request)
+{
+    uint32 startTime = getMSTime();
+
+    GridMap* gridMap = new GridMap();
+    std::string const& filename = Warhead::StringFormat("%smaps/%03u%02u%02u.map", sWorld->GetDataPath().c_str(), request.mapId, request.gx, request.gy);
+    if (!gridMap->loadData(filename))
+    {
+        LOG_ERROR("maps", "GridPreloader: error loading map file: %s", filename.c_str());
+        delete gridMap;
+        gridMap = nullptr;
+    }
+
+    VMAP::VMapFactory::createOrGetVMapManager()->preloadMap((sWorld->GetDataPath() + "vmaps").c_str(), request.mapId, request.gx, request.gy);
+
+    if (request.loadMMap)
+        MMAP::MMapFactory::createOrGetMMapManager()->preloadMap(request.mapId, request.gx, request.gy);
+
+    uint32 key = MakeKey(request.mapId, request.gx, request.gy);
+
+    std::lock_guard<std::mutex> guard(_lock);
+    PreloadedGridMap::iterator itr = _grids.find(key);
+    if (itr == _grids.end())
+    {
+        // the map thread did not wait for us
+        PreloadedGrid dropped;
+        dropped.gridMap = gridMap;
+        dropped.loadMMap = request.loadMMap;
+        Discard(key, dropped);
+        return;
+    }
+
+    itr->second.gridMap = gridMap;
+    itr->second.finished = true;
+    itr->second.readyTime = getMSTime();
+
+    LOG_DEBUG("maps", "GridPreloader: map %u tile [%i, %i] prepared in %u ms", request.mapId, request.gx, request.gy, getMSTimeDiff(startTime, getMSTime()));
+}
+
+void GridPreloader::WorkerThread()
+{
+    while (1)
+    {
+        GridPreloadRequest* request = nullptr;
+
+        _queue.WaitAndPop(request);
+        if (_cancelationToken)
+            return;
+
+        Preload(*request);
+
+        delete request;
+    }
+}
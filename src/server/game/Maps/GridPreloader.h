@@ -0,0 +1,85 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GRID_PRELOADER_H_INCLUDED
+#define _GRID_PRELOADER_H_INCLUDED
+
+#include "Define.h"
+#include "PCQueue.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class GridMap;
+struct GridPreloadRequest;
+
+// Loads terrain, vmap and mmap tiles of grids a player is heading to on background threads.
+// When the map thread later creates the grid it picks the prepared data up
+// instead of reading the files itself, see Map::LoadMap, VMapManager2::preloadMap
+// and MMapManager::preloadMap.
+// All grid coordinates here are tile coordinates (63 - GridCoord), as used by the data files.
+class GridPreloader
+{
+public:
+    GridPreloader();
+    ~GridPreloader();
+
+    void Activate(size_t numThreads);
+    void Deactivate();
+    bool Activated() const { return !_workerThreads.empty(); }
+
+    // map thread, does nothing if the grid is already queued or prepared
+    void SchedulePreload(uint32 mapId, int gx, int gy, bool loadMMap);
+
+    // map thread, returns the prepared terrain of a grid (ownership passes to the caller) or nullptr
+    GridMap* TakeGridMap(uint32 mapId, int gx, int gy);
+
+    // world thread, drops prepared grids nobody picked up in time
+    void Update(uint32 diff);
+
+private:
+    struct PreloadedGrid
+    {
+        PreloadedGrid() : gridMap(nullptr), loadMMap(false), finished(false), readyTime(0) { }
+
+        GridMap* gridMap;
+        bool loadMMap;
+        bool finished;
+        uint32 readyTime;
+    };
+
+    typedef std::unordered_map<uint32, PreloadedGrid> PreloadedGridMap;
+
+    static uint32 MakeKey(uint32 mapId, int gx, int gy) { return (mapId << 16) | (uint32(gx) << 8) | uint32(gy); }
+    static void Discard(uint32 key, PreloadedGrid const& grid);
+
+    void WorkerThread();
+    void Preload(GridPreloadRequest const& request);
+
+    ProducerConsumerQueue<GridPreloadRequest*> _queue;
+    std::vector<std::thread> _workerThreads;
+    std::atomic<bool> _cancelationToken;
+
+    std::mutex _lock;
+    PreloadedGridMap _grids;
+    uint32 _checkTimer;
+};
+
+#endif // _GRID_PRELOADER_H_INCLUDED
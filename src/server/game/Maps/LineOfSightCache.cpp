@@ -0,0 +1,265 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "LineOfSightCache.h"
+#include "GameConfig.h"
+#include "Metric.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+    // size of the regions tracking gameobject model changes, in yards
+    constexpr float LOS_REGION_SIZE = 32.0f;
+    // segments crossing more regions than this per axis are not cached
+    constexpr int32 LOS_MAX_REGIONS = 6;
+    constexpr uint32 LOS_REGION_BUCKETS = 4096;
+}
+
+LineOfSightCache::LineOfSightCache() : _mapId(0), _instanceId(0), _invPrecision(4.0f), _size(0), _stamp(1), _clearStamp(1),
+    _measure(false), _updateTimer(0), _hits(0), _misses(0), _invalidations(0), _queryTime(0)
+{
+}
+
+void LineOfSightCache::Initialize(uint32 mapId, uint32 instanceId)
+{
+    _mapId = mapId;
+    _instanceId = instanceId;
+    LoadConfig();
+}
+
+void LineOfSightCache::LoadConfig()
+{
+    int32 size = CONF_GET_INT("LineOfSight.Cache.Size");
+    float precision = std::max(CONF_GET_FLOAT("LineOfSight.Cache.Precision"), 0.01f);
+
+    // round down to a power of two
+    uint32 newSize = 0;
+    if (size > 0)
+    {
+        newSize = 1;
+        while (newSize * 2 <= uint32(size))
+            newSize *= 2;
+    }
+
+    if (newSize != _size || 1.0f / precision != _invPrecision)
+    {
+        _size = newSize;
+        _invPrecision = 1.0f / precision;
+        _entries.clear();
+        _entries.shrink_to_fit();
+        _regionStamps.clear();
+        _regionStamps.shrink_to_fit();
+    }
+
+    _measure = sMetric->IsEnabled();
+}
+
+void LineOfSightCache::Clear()
+{
+    // reset the stamps instead of touching all entries, except when they run out
+    if (_stamp == std::numeric_limits<uint32>::max())
+    {
+        std::fill(_entries.begin(), _entries.end(), Entry());
+        std::fill(_regionStamps.begin(), _regionStamps.end(), 0);
+        _stamp = 1;
+        _clearStamp = 1;
+        return;
+    }
+
+    _clearStamp = ++_stamp;
+}
+
+int32 LineOfSightCache::GetRegion(float coord) const
+{
+    return int32(std::floor(coord / LOS_REGION_SIZE));
+}
+
+uint32 LineOfSightCache::RegionBucket(int32 x, int32 y)
+{
+    return (uint32(x) * 73856093u ^ uint32(y) * 19349663u) & (LOS_REGION_BUCKETS - 1);
+}
+
+uint32 LineOfSightCache::Hash(Key const& key)
+{
+    uint32 hash = 2166136261u;
+    for (int32 coord : key.coords)
+        hash = (hash ^ uint32(coord)) * 16777619u;
+
+    hash = (hash ^ key.phaseMask) * 16777619u;
+    hash = (hash ^ key.checks) * 16777619u;
+    return hash ^ (hash >> 15);
+}
+
+bool LineOfSightCache::MakeKey(float x1, float y1, float z1, float x2, float y2, float z2, uint32 phaseMask, uint8 checks, Key& key) const
+{
+    if (!_size)
+        return false;
+
+    key.regionLow[0] = GetRegion(std::min(x1, x2));
+    key.regionLow[1] = GetRegion(std::min(y1, y2));
+    key.regionHigh[0] = GetRegion(std::max(x1, x2));
+    key.regionHigh[1] = GetRegion(std::max(y1, y2));
+
+    // also rejects nan and far out coordinates
+    if (!(key.regionHigh[0] - key.regionLow[0] < LOS_MAX_REGIONS && key.regionHigh[1] - key.regionLow[1] < LOS_MAX_REGIONS))
+        return false;
+
+    float const coords[6] = { x1, y1, z1, x2, y2, z2 };
+    for (uint8 i = 0; i < 6; ++i)
+    {
+        float quantized = std::floor(coords[i] * _invPrecision);
+        if (!(std::fabs(quantized) < float(std::numeric_limits<int32>::max())))
+            return false;
+
+        key.coords[i] = int32(quantized);
+    }
+
+    key.phaseMask = phaseMask;
+    key.checks = checks;
+    return true;
+}
+
+bool LineOfSightCache::IsValid(Entry const& entry, Key const& key) const
+{
+    if (!entry.used || entry.stamp < _clearStamp || entry.phaseMask != key.phaseMask || entry.checks != key.checks)
+        return false;
+
+    if (std::memcmp(entry.coords, key.coords, sizeof(key.coords)) != 0)
+        return false;
+
+    for (int32 x = key.regionLow[0]; x <= key.regionHigh[0]; ++x)
+        for (int32 y = key.regionLow[1]; y <= key.regionHigh[1]; ++y)
+            if (_regionStamps[RegionBucket(x, y)] > entry.stamp)
+                return false;
+
+    return true;
+}
+
+bool LineOfSightCache::Find(Key const& key, bool& result)
+{
+    if (_entries.empty())
+    {
+        ++_misses;
+        return false;
+    }
+
+    Entry const& entry = _entries[Hash(key) & (_size - 1)];
+    if (!IsValid(entry, key))
+    {
+        ++_misses;
+        return false;
+    }
+
+    ++_hits;
+    result = entry.result;
+    return true;
+}
+
+void LineOfSightCache::Insert(Key const& key, bool result, uint32 queryTime)
+{
+    if (_entries.empty())
+    {
+        _entries.resize(_size);
+        _regionStamps.assign(LOS_REGION_BUCKETS, 0);
+    }
+
+    _queryTime += queryTime;
+
+    Entry& entry = _entries[Hash(key) & (_size - 1)];
+    std::memcpy(entry.coords, key.coords, sizeof(key.coords));
+    entry.phaseMask = key.phaseMask;
+    entry.stamp = _stamp;
+    entry.checks = key.checks;
+    entry.result = result;
+    entry.used = true;
+}
+
+void LineOfSightCache::Invalidate(float minX, float minY, float maxX, float maxY)
+{
+    if (_entries.empty())
+        return;
+
+    ++_invalidations;
+
+    int32 lowX = GetRegion(minX);
+    int32 lowY = GetRegion(minY);
+    int32 highX = GetRegion(maxX);
+    int32 highY = GetRegion(maxY);
+
+    // large models (transports, huge doors) or broken bounds, drop everything
+    if (!(highX - lowX < 16 && highY - lowY < 16))
+    {
+        Clear();
+        return;
+    }
+
+    if (_stamp >= std::numeric_limits<uint32>::max() - 1)
+    {
+        _stamp = std::numeric_limits<uint32>::max();
+        Clear();
+        return;
+    }
+
+    // entries stored from now on are newer than the change
+    uint32 stamp = ++_stamp;
+    ++_stamp;
+
+    for (int32 x = lowX; x <= highX; ++x)
+        for (int32 y = lowY; y <= highY; ++y)
+            _regionStamps[RegionBucket(x, y)] = stamp;
+}
+
+void LineOfSightCache::InvalidateAll()
+{
+    if (_entries.empty())
+        return;
+
+    ++_invalidations;
+    Clear();
+}
+
+void LineOfSightCache::Update(uint32 diff)
+{
+    _updateTimer += diff;
+    if (_updateTimer < IN_MILLISECONDS)
+        return;
+
+    _updateTimer = 0;
+
+    if (_measure && (_hits || _misses))
+    {
+        std::string mapId = std::to_string(_mapId);
+        std::string instanceId = std::to_string(_instanceId);
+        WH_METRIC_VALUE("map_los_cache_hits", _hits, WH_METRIC_TAG("map_id", mapId), WH_METRIC_TAG("instance_id", instanceId));
+        WH_METRIC_VALUE("map_los_cache_misses", _misses, WH_METRIC_TAG("map_id", mapId), WH_METRIC_TAG("instance_id", instanceId));
+        WH_METRIC_VALUE("map_los_cache_hit_rate", float(_hits) / float(_hits + _misses), WH_METRIC_TAG("map_id", mapId), WH_METRIC_TAG("instance_id", instanceId));
+        WH_METRIC_VALUE("map_los_cache_invalidations", _invalidations, WH_METRIC_TAG("map_id", mapId), WH_METRIC_TAG("instance_id", instanceId));
+        if (_misses)
+            WH_METRIC_VALUE("map_los_query_time", float(_queryTime) / float(_misses), WH_METRIC_TAG("map_id", mapId), WH_METRIC_TAG("instance_id", instanceId));
+    }
+
+    _hits = 0;
+    _misses = 0;
+    _invalidations = 0;
+    _queryTime = 0;
+
+    LoadConfig();
+}
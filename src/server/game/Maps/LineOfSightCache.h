@@ -0,0 +1,104 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _LINE_OF_SIGHT_CACHE_H
+#define _LINE_OF_SIGHT_CACHE_H
+
+#include "Define.h"
+#include <vector>
+
+// Per map cache of line of sight results.
+// Queries are keyed by their endpoints quantized to LineOfSight.Cache.Precision yards,
+// the phase mask and the requested checks, and stored in a direct mapped table.
+// Entries go stale when a gameobject model is added, removed or toggled: every change stamps
+// the regions covered by the model and entries created before the stamp of any region their
+// segment passes through are ignored. Loading or unloading vmap tiles drops all entries.
+// Only touched by the thread updating the map, there is no locking: line of sight queries
+// made from other threads must not go through the cache.
+class LineOfSightCache
+{
+public:
+    struct Key
+    {
+        int32 coords[6];
+        uint32 phaseMask;
+        uint8 checks;
+        int32 regionLow[2];
+        int32 regionHigh[2];
+    };
+
+    LineOfSightCache();
+
+    void Initialize(uint32 mapId, uint32 instanceId);
+
+    // Returns false if the query can not be cached (cache disabled or segment too long)
+    bool MakeKey(float x1, float y1, float z1, float x2, float y2, float z2, uint32 phaseMask, uint8 checks, Key& key) const;
+
+    bool Find(Key const& key, bool& result);
+    void Insert(Key const& key, bool result, uint32 queryTime);
+
+    // queryTime of Insert is only needed while metrics are collected
+    bool IsMeasuring() const { return _measure; }
+
+    // a dynamic model covering the area changed
+    void Invalidate(float minX, float minY, float maxX, float maxY);
+    // static geometry changed, vmap tiles were loaded or unloaded
+    void InvalidateAll();
+
+    // reloads the configuration and sends the metrics once per second
+    void Update(uint32 diff);
+
+private:
+    struct Entry
+    {
+        int32 coords[6];
+        uint32 phaseMask;
+        uint32 stamp;
+        uint8 checks;
+        bool result;
+        bool used;
+    };
+
+    static uint32 Hash(Key const& key);
+    static uint32 RegionBucket(int32 x, int32 y);
+    int32 GetRegion(float coord) const;
+    bool IsValid(Entry const& entry, Key const& key) const;
+
+    void LoadConfig();
+    void Clear();
+
+    uint32 _mapId;
+    uint32 _instanceId;
+
+    float _invPrecision;
+    uint32 _size;
+    std::vector<Entry> _entries;                            // allocated on first use
+
+    uint32 _stamp;
+    uint32 _clearStamp;                                     // entries older than this are ignored
+    std::vector<uint32> _regionStamps;
+
+    bool _measure;
+    uint32 _updateTimer;
+    uint32 _hits;
+    uint32 _misses;
+    uint32 _invalidations;
+    uint64 _queryTime;                                      // microseconds spent in uncached queries
+};
+
+#endif
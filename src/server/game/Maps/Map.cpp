@@ -30,6 +30,7 @@
 #include "ObjectAccessor.h"
 #include "ObjectMgr.h"
 #include "Pet.h"
+#include "PoolMgr.h"
 #include "ScriptMgr.h"
 #include "Transport.h"
 #include "Vehicle.h"
@@ -39,6 +40,13 @@
 #include "GameTime.h"
 #include "GameConfig.h"
 #include "Metric.h"
+#include "PathCache.h"
+#include <chrono>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define GRIDMAP_USE_SSE2
+#  include <emmintrin.h>
+#endif
 
 union u_map_magic
 {
@@ -47,7 +55,7 @@ union u_map_magic
 };
 
 u_map_magic MapMagic        = { {'M', 'A', 'P', 'S'} };
-u_map_magic MapVersionMagic = { {'v', '1', '.', '8'} };
+u_map_magic MapVersionMagic = { {'v', '1', '.', '9'} };
 u_map_magic MapAreaMagic    = { {'A', 'R', 'E', 'A'} };
 u_map_magic MapHeightMagic  = { {'M', 'H', 'G', 'T'} };
 u_map_magic MapLiquidMagic  = { {'M', 'L', 'I', 'Q'} };
@@ -71,32 +79,27 @@ Map::~Map()
         sMapMgr->DecreaseScheduledScriptCount(m_scriptSchedule.size());
 
     //MMAP::MMapFactory::createOrGetMMapManager()->unloadMap(GetId());
-    MMAP::MMapFactory::createOrGetMMapManager()->unloadMapInstance(GetId(), i_InstanceId);
 }
 
 bool Map::ExistMap(uint32 mapid, int gx, int gy)
 {
     std::string const& filename = Warhead::StringFormat("%smaps/%03u%02u%02u.map", sWorld->GetDataPath().c_str(), mapid, gx, gy);
 
-    bool ret = false;
-    FILE* pf = fopen(filename.c_str(), "rb");
-
-    if (!pf)
+    // compressed map files only decompress the header here
+    map_fileheader header;
+    if (!MappedFile::ReadHeader(filename, &header, sizeof(header)))
+    {
         LOG_ERROR("maps", "Map file '%s': does not exist!", filename.c_str());
-    else
+        return false;
+    }
+
+    if (header.mapMagic != MapMagic.asUInt || header.versionMagic != MapVersionMagic.asUInt)
     {
-        map_fileheader header;
-        if (fread(&header, sizeof(header), 1, pf) == 1)
-        {
-            if (header.mapMagic != MapMagic.asUInt || header.versionMagic != MapVersionMagic.asUInt)
-                LOG_ERROR("maps", "Map file '%s' is from an incompatible clientversion. Please recreate using the mapextractor.", filename.c_str());
-            else
-                ret = true;
-        }
-        fclose(pf);
+        LOG_ERROR("maps", "Map file '%s' is from an incompatible clientversion. Please recreate using the mapextractor.", filename.c_str());
+        return false;
     }
 
-    return ret;
+    return true;
 }
 
 bool Map::ExistVMap(uint32 mapid, int gx, int gy)
@@ -146,6 +149,8 @@ void Map::LoadVMap(int gx, int gy)
     {
         case VMAP::VMAP_LOAD_RESULT_OK:
             LOG_INFO("maps", "VMAP loaded name:%s, id:%d, x:%d, y:%d (vmap rep.: x:%d, y:%d)", GetMapName(), GetId(), gx, gy, gx, gy);
+            // queries without the tile did not collide with it
+            _lineOfSightCache.InvalidateAll();
             break;
         case VMAP::VMAP_LOAD_RESULT_ERROR:
             LOG_ERROR("maps", "Could not load VMAP name:%s, id:%d, x:%d, y:%d (vmap rep.: x:%d, y:%d)", GetMapName(), GetId(), gx, gy, gx, gy);
@@ -189,17 +194,24 @@ void Map::LoadMap(int gx, int gy, bool reload)
 
     LOG_INFO("maps", "Loading map %s", filename.c_str());
 
-    // loading data
-    GridMaps[gx][gy] = new GridMap();
+    // loading data, unless a background thread already did it for us
+    GridMaps[gx][gy] = sMapMgr->GetGridPreloader()->TakeGridMap(GetId(), gx, gy);
+    if (!GridMaps[gx][gy])
+    {
+        GridMaps[gx][gy] = new GridMap();
 
-    if (!GridMaps[gx][gy]->loadData(filename))
-        LOG_ERROR("maps", "Error loading map file: %s", filename.c_str());
+        if (!GridMaps[gx][gy]->loadData(filename))
+            LOG_ERROR("maps", "Error loading map file: %s", filename.c_str());
+    }
 
     sScriptMgr->OnLoadGridMap(this, GridMaps[gx][gy], gx, gy);
 }
 
 void Map::LoadMapAndVMap(int gx, int gy)
 {
+    if (!_gridDataLastUsed.empty())
+        _gridDataLastUsed[gx * MAX_NUMBER_OF_GRIDS + gy] = GameTime::GetGameTimeMS();
+
     LoadMap(gx, gy);
 
     if (!i_InstanceId)
@@ -219,7 +231,18 @@ Map::Map(uint32 id, uint32 InstanceId, uint8 SpawnMode, Map* _parent) :
     m_activeNonPlayersIter(m_activeNonPlayers.end()),
     _transportsUpdateIter(_transports.end()),
     i_scriptLock(false),
-    _defaultLight(GetDefaultMapLight(id))
+    _respawnWheel(GameTime::GetGameTime()),
+    _defaultLight(GetDefaultMapLight(id)),
+    _tickRateEnabled(false),
+    _tickIdleInterval(0),
+    _tickEmptyInterval(0),
+    _tickInterval(0),
+    _tickTimer(0),
+    _pendingDiff(0),
+    _pendingSessionDiff(0),
+    _tickWakeUp(false),
+    _skippedTicks(0),
+    _tickMetricTimer(0)
 {
     m_parentMap = (_parent ? _parent : this);
     for (unsigned int idx = 0; idx < MAX_NUMBER_OF_GRIDS; ++idx)
@@ -232,6 +255,16 @@ Map::Map(uint32 id, uint32 InstanceId, uint8 SpawnMode, Map* _parent) :
         }
     }
 
+    if (CanUnloadGridData())
+        _gridDataLastUsed.assign(MAX_NUMBER_OF_GRIDS * MAX_NUMBER_OF_GRIDS, 0);
+
+    _dynamicVisibility.Initialize(id, InstanceId, i_mapEntry->map_type);
+    _hibernation.Initialize(id, InstanceId);
+    LoadTickRateConfig();
+    _lineOfSightCache.Initialize(id, InstanceId);
+    _pathCache = std::make_shared<PathCache>();
+    _pathCache->Initialize(id, InstanceId);
+
     //lets initialize visibility distance for map
     Map::InitVisibilityDistance();
 
@@ -484,6 +517,8 @@ bool Map::AddPlayerToMap(Player* player)
     EnsureGridLoaded(cell);
     AddToGrid(player, cell);
 
+    WakeUp();
+
     // Check if we are adding to correct map
     ASSERT (player->GetMap() == this);
     player->SetMap(this);
@@ -636,6 +671,8 @@ void Map::VisitNearbyCellsOfPlayer(Player* player, TypeContainerVisitor<Warhead:
     // check maximum visibility distance for large creatures
     CellArea area = Cell::CalculateCellArea(player->GetPositionX(), player->GetPositionY(), MAX_VISIBILITY_DISTANCE);
 
+    TouchGridData(area);
+
     for (uint32 x = area.low_bound.x_coord; x <= area.high_bound.x_coord; ++x)
     {
         for (uint32 y = area.low_bound.y_coord; y <= area.high_bound.y_coord; ++y)
@@ -671,6 +708,8 @@ void Map::VisitNearbyCellsOf(WorldObject* obj, TypeContainerVisitor<Warhead::Obj
     // Update mobs/objects in ALL visible cells around object!
     CellArea area = Cell::CalculateCellArea(obj->GetPositionX(), obj->GetPositionY(), obj->GetGridActivationRange());
 
+    TouchGridData(area);
+
     for (uint32 x = area.low_bound.x_coord; x <= area.high_bound.x_coord; ++x)
     {
         for (uint32 y = area.low_bound.y_coord; y <= area.high_bound.y_coord; ++y)
@@ -699,8 +738,66 @@ void Map::VisitNearbyCellsOf(WorldObject* obj, TypeContainerVisitor<Warhead::Obj
     }
 }
 
+void Map::TouchGridData(CellArea const& area)
+{
+    if (_gridDataLastUsed.empty())
+        return;
+
+    uint32 now = GameTime::GetGameTimeMS();
+
+    for (uint32 x = area.low_bound.x_coord / MAX_NUMBER_OF_CELLS; x <= area.high_bound.x_coord / MAX_NUMBER_OF_CELLS; ++x)
+    {
+        for (uint32 y = area.low_bound.y_coord / MAX_NUMBER_OF_CELLS; y <= area.high_bound.y_coord / MAX_NUMBER_OF_CELLS; ++y)
+        {
+            int gx = (MAX_NUMBER_OF_GRIDS - 1) - x;
+            int gy = (MAX_NUMBER_OF_GRIDS - 1) - y;
+
+            _gridDataLastUsed[gx * MAX_NUMBER_OF_GRIDS + gy] = now;
+
+            // data of an existing grid was unloaded by the tile budget
+            if (!GridMaps[gx][gy] && getNGrid(x, y))
+                ReloadGridData(gx, gy);
+        }
+    }
+}
+
+void Map::ReloadGridData(int gx, int gy)
+{
+    std::lock_guard<std::mutex> guard(_gridLock);
+
+    // another thread may have been faster
+    if (GridMaps[gx][gy])
+        return;
+
+    // vmap tiles are not released by UnloadGridData
+    LoadMap(gx, gy);
+    LoadMMap(gx, gy);
+}
+
+void Map::UnloadGridData(int gx, int gy)
+{
+    ASSERT(CanUnloadGridData());
+
+    std::lock_guard<std::mutex> guard(_gridLock);
+
+    if (!GridMaps[gx][gy])
+        return;
+
+    LOG_DEBUG("maps", "Unloading data of grid[%u, %u] for map %u to stay within the tile memory budget", (MAX_NUMBER_OF_GRIDS - 1) - gx, (MAX_NUMBER_OF_GRIDS - 1) - gy, GetId());
+
+    sScriptMgr->OnUnloadGridMap(this, GridMaps[gx][gy], gx, gy);
+
+    delete GridMaps[gx][gy];
+    GridMaps[gx][gy] = nullptr;
+
+    // vmap tiles stay loaded, their models are shared between tiles so they are not accounted per grid
+    MMAP::MMapFactory::createOrGetMMapManager()->unloadMap(GetId(), gx, gy);
+}
+
 void Map::Update(const uint32 t_diff, const uint32 s_diff, bool  /*thread*/)
 {
+    uint32 startTime = getMSTime();
+
     if (t_diff)
         _dynamicTree.update(t_diff);
 
@@ -738,7 +835,9 @@ void Map::Update(const uint32 t_diff, const uint32 s_diff, bool  /*thread*/)
     resetMarkedCells();
     resetMarkedCellsLarge();
 
-    Warhead::ObjectUpdater updater(t_diff, false);
+    _hibernation.Prepare(m_mapRefManager, !m_activeNonPlayers.empty(), t_diff);
+
+    Warhead::ObjectUpdater updater(t_diff, false, _hibernation.IsEnabled() ? &_hibernation : nullptr);
 
     // for creature
     TypeContainerVisitor<Warhead::ObjectUpdater, GridTypeMapContainer  > grid_object_update(updater);
@@ -828,6 +927,94 @@ void Map::Update(const uint32 t_diff, const uint32 s_diff, bool  /*thread*/)
     sScriptMgr->OnMapUpdate(this, t_diff);
 
     BuildAndSendUpdateForObjects(); // pussywizard
+
+    ProcessRespawns();
+
+    _dynamicVisibility.Update(t_diff, getMSTimeDiff(startTime, getMSTime()));
+
+    UpdateTickInterval(t_diff);
+
+    _lineOfSightCache.Update(t_diff);
+    _pathCache->Update(t_diff);
+}
+
+bool Map::PrepareUpdate(uint32& t_diff, uint32& s_diff)
+{
+    _pendingDiff += t_diff;
+    _pendingSessionDiff += s_diff;
+    _tickTimer += s_diff;
+
+    if (_tickTimer < _tickInterval && !_tickWakeUp && !HasPendingPackets())
+    {
+        ++_skippedTicks;
+        return false;
+    }
+
+    t_diff = _pendingDiff;
+    s_diff = _pendingSessionDiff;
+
+    _pendingDiff = 0;
+    _pendingSessionDiff = 0;
+    _tickTimer = 0;
+    _tickWakeUp = false;
+    return true;
+}
+
+bool Map::HasPendingPackets() const
+{
+    for (MapRefManager::const_iterator itr = m_mapRefManager.begin(); itr != m_mapRefManager.end(); ++itr)
+        if (Player const* player = itr->GetSource())
+            if (player->GetSession()->HasPendingPackets())
+                return true;
+
+    return false;
+}
+
+void Map::LoadTickRateConfig()
+{
+    _tickRateEnabled = Instanceable() && CONF_GET_BOOL("MapTickRate.Enable");
+    _tickIdleInterval = uint32(std::max(CONF_GET_INT("MapTickRate.IdleInterval"), 0));
+    _tickEmptyInterval = uint32(std::max(CONF_GET_INT("MapTickRate.EmptyInterval"), 0));
+}
+
+void Map::UpdateTickInterval(uint32 diff)
+{
+    _tickInterval = 0;
+
+    if (_tickRateEnabled)
+    {
+        if (!HavePlayers())
+            _tickInterval = _tickEmptyInterval;
+        else if (m_activeNonPlayers.empty())
+        {
+            bool busy = false;
+            for (MapRefManager::iterator itr = m_mapRefManager.begin(); itr != m_mapRefManager.end() && !busy; ++itr)
+            {
+                Player const* player = itr->GetSource();
+                busy = player->IsInCombat() || player->isMoving() || player->IsBeingTeleported();
+            }
+
+            if (!busy)
+                _tickInterval = _tickIdleInterval;
+        }
+    }
+
+    _tickMetricTimer += diff;
+    if (_tickMetricTimer < IN_MILLISECONDS)
+        return;
+
+    _tickMetricTimer = 0;
+    LoadTickRateConfig();
+
+    if (sMetric->IsEnabled() && Instanceable())
+    {
+        std::string mapId = std::to_string(GetId());
+        std::string instanceId = std::to_string(GetInstanceId());
+        WH_METRIC_VALUE("map_tick_interval", _tickInterval, WH_METRIC_TAG("map_id", mapId), WH_METRIC_TAG("instance_id", instanceId));
+        WH_METRIC_VALUE("map_skipped_ticks", _skippedTicks, WH_METRIC_TAG("map_id", mapId), WH_METRIC_TAG("instance_id", instanceId));
+    }
+
+    _skippedTicks = 0;
 }
 
 void Map::HandleDelayedVisibility()
@@ -955,15 +1142,53 @@ void Map::PlayerRelocation(Player* player, float x, float y, float z, float o)
             EnsureGridLoaded(new_cell);
 
         AddToGrid(player, new_cell);
+
+        PreloadGridsAhead(player, x, y, o);
     }
 
     player->Relocate(x, y, z, o);
+    player->UpdateCellIndex();
     if (player->IsVehicle())
         player->GetVehicleKit()->RelocatePassengers();
 
     player->UpdateObjectVisibility(false);
 }
 
+void Map::PreloadGridsAhead(Player* player, float x, float y, float o)
+{
+    GridPreloader* preloader = sMapMgr->GetGridPreloader();
+    if (!preloader->Activated() || (!player->isMoving() && !player->IsInFlight()))
+        return;
+
+    // grids get loaded once the visibility range reaches them, look that far plus the distance covered in the look ahead time
+    float speed = player->GetSpeed(player->IsFlying() || player->IsInFlight() ? MOVE_FLIGHT : MOVE_RUN);
+    float distance = GetVisibilityRange() + speed * CONF_GET_INT("GridPreload.LookAheadTime") / float(IN_MILLISECONDS);
+    float dx = std::cos(o);
+    float dy = std::sin(o);
+
+    bool loadMMap = DisableMgr::IsPathfindingEnabled(this);
+
+    for (float step = SIZE_OF_GRIDS / 4; ; step += SIZE_OF_GRIDS / 4)
+    {
+        float px = x + dx * std::min(step, distance);
+        float py = y + dy * std::min(step, distance);
+        if (!Warhead::IsValidMapCoord(px, py))
+            break;
+
+        GridCoord p = Warhead::ComputeGridCoord(px, py);
+        int gx = (MAX_NUMBER_OF_GRIDS - 1) - p.x_coord;
+        int gy = (MAX_NUMBER_OF_GRIDS - 1) - p.y_coord;
+
+        // terrain is shared with the parent map, vmaps and mmaps are only loaded by it,
+        // grids whose data was unloaded by the tile budget are preloaded as well
+        if (!m_parentMap->GridMaps[gx][gy])
+            preloader->SchedulePreload(GetId(), gx, gy, loadMMap);
+
+        if (step >= distance)
+            break;
+    }
+}
+
 void Map::CreatureRelocation(Creature* creature, float x, float y, float z, float o)
 {
     Cell old_cell = creature->GetCurrentCell();
@@ -980,6 +1205,7 @@ void Map::CreatureRelocation(Creature* creature, float x, float y, float z, floa
         RemoveCreatureFromMoveList(creature);
 
     creature->Relocate(x, y, z, o);
+    creature->UpdateCellIndex();
 
     if (creature->IsVehicle())
         creature->GetVehicleKit()->RelocatePassengers();
@@ -1003,6 +1229,7 @@ void Map::GameObjectRelocation(GameObject* go, float x, float y, float z, float
         RemoveGameObjectFromMoveList(go);
 
     go->Relocate(x, y, z, o);
+    go->UpdateCellIndex();
     go->UpdateModelPosition();
     go->UpdateObjectVisibility(false);
 }
@@ -1023,6 +1250,7 @@ void Map::DynamicObjectRelocation(DynamicObject* dynObj, float x, float y, float
         RemoveDynamicObjectFromMoveList(dynObj);
 
     dynObj->Relocate(x, y, z, o);
+    dynObj->UpdateCellIndex();
     dynObj->UpdateObjectVisibility(false);
 }
 
@@ -1192,15 +1420,18 @@ bool Map::UnloadGrid(NGridType& ngrid)
 
     if (i_InstanceId == 0)
     {
+        // no terrain and navmesh data left if the tile budget already unloaded it
         if (GridMaps[gx][gy])
         {
             GridMaps[gx][gy]->unloadData();
             delete GridMaps[gx][gy];
+
+            MMAP::MMapFactory::createOrGetMMapManager()->unloadMap(GetId(), gx, gy);
         }
 
         // x and y are swapped
         VMAP::VMapFactory::createOrGetVMapManager()->unloadMap(GetId(), gx, gy);
-        MMAP::MMapFactory::createOrGetMMapManager()->unloadMap(GetId(), gx, gy);
+        _lineOfSightCache.InvalidateAll();
     }
 
     GridMaps[gx][gy] = nullptr;
@@ -1294,64 +1525,53 @@ bool GridMap::loadData(std::string const& filename)
     // Unload old data if exist
     unloadData();
 
-    map_fileheader header;
-
     // Not return error if file not found
-    FILE* in = fopen(filename.c_str(), "rb");
-    if (!in)
+    if (!_file.Open(filename))
         return true;
 
-    if (fread(&header, sizeof(header), 1, in) != 1)
+    map_fileheader const* header = _file.GetAt<map_fileheader>(0);
+    if (!header)
     {
-        fclose(in);
+        unloadData();
         return false;
     }
 
-    if (header.mapMagic == MapMagic.asUInt && header.versionMagic == MapVersionMagic.asUInt)
+    if (header->mapMagic == MapMagic.asUInt && header->versionMagic == MapVersionMagic.asUInt)
     {
         // loadup area data
-        if (header.areaMapOffset && !loadAreaData(in, header.areaMapOffset, header.areaMapSize))
+        if (header->areaMapOffset && !loadAreaData(header->areaMapOffset, header->areaMapSize))
         {
             LOG_ERROR("maps", "Error loading map area data\n");
-            fclose(in);
+            unloadData();
             return false;
         }
 
         // loadup height data
-        if (header.heightMapOffset && !loadHeightData(in, header.heightMapOffset, header.heightMapSize))
+        if (header->heightMapOffset && !loadHeightData(header->heightMapOffset, header->heightMapSize))
         {
             LOG_ERROR("maps", "Error loading map height data\n");
-            fclose(in);
+            unloadData();
             return false;
         }
 
         // loadup liquid data
-        if (header.liquidMapOffset && !loadLiquidData(in, header.liquidMapOffset, header.liquidMapSize))
+        if (header->liquidMapOffset && !loadLiquidData(header->liquidMapOffset, header->liquidMapSize))
         {
             LOG_ERROR("maps", "Error loading map liquids data\n");
-            fclose(in);
+            unloadData();
             return false;
         }
 
-        fclose(in);
         return true;
     }
 
     LOG_ERROR("maps", "Map file '%s' is from an incompatible clientversion. Please recreate using the mapextractor.", filename.c_str());
-    fclose(in);
+    unloadData();
     return false;
 }
 
 void GridMap::unloadData()
 {
-    delete[] _areaMap;
-    delete[] m_V9;
-    delete[] m_V8;
-    delete[] _maxHeight;
-    delete[] _minHeight;
-    delete[] _liquidEntry;
-    delete[] _liquidFlags;
-    delete[] _liquidMap;
     _areaMap = nullptr;
     m_V9 = nullptr;
     m_V8 = nullptr;
@@ -1361,63 +1581,67 @@ void GridMap::unloadData()
     _liquidFlags = nullptr;
     _liquidMap  = nullptr;
     _gridGetHeight = &GridMap::getHeightFromFlat;
+    _file.Close();
 }
 
-bool GridMap::loadAreaData(FILE* in, uint32 offset, uint32 /*size*/)
+bool GridMap::loadAreaData(uint32 offset, uint32 /*size*/)
 {
-    map_areaHeader header;
-    fseek(in, offset, SEEK_SET);
-
-    if (fread(&header, sizeof(header), 1, in) != 1 || header.fourcc != MapAreaMagic.asUInt)
+    map_areaHeader const* header = _file.GetAt<map_areaHeader>(offset);
+    if (!header || header->fourcc != MapAreaMagic.asUInt)
         return false;
 
-    _gridArea = header.gridArea;
-    if (!(header.flags & MAP_AREA_NO_AREA))
+    offset += MapAlignedSize(sizeof(map_areaHeader));
+
+    _gridArea = header->gridArea;
+    if (!(header->flags & MAP_AREA_NO_AREA))
     {
-        _areaMap = new uint16 [16 * 16];
-        if (fread(_areaMap, sizeof(uint16), 16 * 16, in) != 16 * 16)
+        _areaMap = _file.GetAt<uint16>(offset, 16 * 16);
+        if (!_areaMap)
             return false;
     }
     return true;
 }
 
-bool GridMap::loadHeightData(FILE* in, uint32 offset, uint32 /*size*/)
+bool GridMap::loadHeightData(uint32 offset, uint32 /*size*/)
 {
-    map_heightHeader header;
-    fseek(in, offset, SEEK_SET);
-
-    if (fread(&header, sizeof(header), 1, in) != 1 || header.fourcc != MapHeightMagic.asUInt)
+    map_heightHeader const* header = _file.GetAt<map_heightHeader>(offset);
+    if (!header || header->fourcc != MapHeightMagic.asUInt)
         return false;
 
-    _gridHeight = header.gridHeight;
-    if (!(header.flags & MAP_HEIGHT_NO_HEIGHT))
+    offset += MapAlignedSize(sizeof(map_heightHeader));
+
+    _gridHeight = header->gridHeight;
+    if (!(header->flags & MAP_HEIGHT_NO_HEIGHT))
     {
-        if ((header.flags & MAP_HEIGHT_AS_INT16))
+        if ((header->flags & MAP_HEIGHT_AS_INT16))
         {
-            m_uint16_V9 = new uint16 [129 * 129];
-            m_uint16_V8 = new uint16 [128 * 128];
-            if (fread(m_uint16_V9, sizeof(uint16), 129 * 129, in) != 129 * 129 ||
-                    fread(m_uint16_V8, sizeof(uint16), 128 * 128, in) != 128 * 128)
+            m_uint16_V9 = _file.GetAt<uint16>(offset, 129 * 129);
+            offset += MapAlignedSize(sizeof(uint16) * 129 * 129);
+            m_uint16_V8 = _file.GetAt<uint16>(offset, 128 * 128);
+            offset += MapAlignedSize(sizeof(uint16) * 128 * 128);
+            if (!m_uint16_V9 || !m_uint16_V8)
                 return false;
-            _gridIntHeightMultiplier = (header.gridMaxHeight - header.gridHeight) / 65535;
+            _gridIntHeightMultiplier = (header->gridMaxHeight - header->gridHeight) / 65535;
             _gridGetHeight = &GridMap::getHeightFromUint16;
         }
-        else if ((header.flags & MAP_HEIGHT_AS_INT8))
+        else if ((header->flags & MAP_HEIGHT_AS_INT8))
         {
-            m_uint8_V9 = new uint8 [129 * 129];
-            m_uint8_V8 = new uint8 [128 * 128];
-            if (fread(m_uint8_V9, sizeof(uint8), 129 * 129, in) != 129 * 129 ||
-                    fread(m_uint8_V8, sizeof(uint8), 128 * 128, in) != 128 * 128)
+            m_uint8_V9 = _file.GetAt<uint8>(offset, 129 * 129);
+            offset += MapAlignedSize(sizeof(uint8) * 129 * 129);
+            m_uint8_V8 = _file.GetAt<uint8>(offset, 128 * 128);
+            offset += MapAlignedSize(sizeof(uint8) * 128 * 128);
+            if (!m_uint8_V9 || !m_uint8_V8)
                 return false;
-            _gridIntHeightMultiplier = (header.gridMaxHeight - header.gridHeight) / 255;
+            _gridIntHeightMultiplier = (header->gridMaxHeight - header->gridHeight) / 255;
             _gridGetHeight = &GridMap::getHeightFromUint8;
         }
         else
         {
-            m_V9 = new float [129 * 129];
-            m_V8 = new float [128 * 128];
-            if (fread(m_V9, sizeof(float), 129 * 129, in) != 129 * 129 ||
-                    fread(m_V8, sizeof(float), 128 * 128, in) != 128 * 128)
+            m_V9 = _file.GetAt<float>(offset, 129 * 129);
+            offset += MapAlignedSize(sizeof(float) * 129 * 129);
+            m_V8 = _file.GetAt<float>(offset, 128 * 128);
+            offset += MapAlignedSize(sizeof(float) * 128 * 128);
+            if (!m_V9 || !m_V8)
                 return false;
             _gridGetHeight = &GridMap::getHeightFromFloat;
         }
@@ -1425,48 +1649,47 @@ bool GridMap::loadHeightData(FILE* in, uint32 offset, uint32 /*size*/)
     else
         _gridGetHeight = &GridMap::getHeightFromFlat;
 
-    if (header.flags & MAP_HEIGHT_HAS_FLIGHT_BOUNDS)
+    if (header->flags & MAP_HEIGHT_HAS_FLIGHT_BOUNDS)
     {
-        _maxHeight = new int16[3 * 3];
-        _minHeight = new int16[3 * 3];
-        if (fread(_maxHeight, sizeof(int16), 3 * 3, in) != 3 * 3 ||
-                fread(_minHeight, sizeof(int16), 3 * 3, in) != 3 * 3)
+        _maxHeight = _file.GetAt<int16>(offset, 3 * 3);
+        offset += MapAlignedSize(sizeof(int16) * 3 * 3);
+        _minHeight = _file.GetAt<int16>(offset, 3 * 3);
+        if (!_maxHeight || !_minHeight)
             return false;
     }
 
     return true;
 }
 
-bool GridMap::loadLiquidData(FILE* in, uint32 offset, uint32 /*size*/)
+bool GridMap::loadLiquidData(uint32 offset, uint32 /*size*/)
 {
-    map_liquidHeader header;
-    fseek(in, offset, SEEK_SET);
-
-    if (fread(&header, sizeof(header), 1, in) != 1 || header.fourcc != MapLiquidMagic.asUInt)
+    map_liquidHeader const* header = _file.GetAt<map_liquidHeader>(offset);
+    if (!header || header->fourcc != MapLiquidMagic.asUInt)
         return false;
 
-    _liquidType   = header.liquidType;
-    _liquidOffX  = header.offsetX;
-    _liquidOffY  = header.offsetY;
-    _liquidWidth = header.width;
-    _liquidHeight = header.height;
-    _liquidLevel  = header.liquidLevel;
+    offset += MapAlignedSize(sizeof(map_liquidHeader));
 
-    if (!(header.flags & MAP_LIQUID_NO_TYPE))
-    {
-        _liquidEntry = new uint16[16 * 16];
-        if (fread(_liquidEntry, sizeof(uint16), 16 * 16, in) != 16 * 16)
-            return false;
+    _liquidType   = header->liquidType;
+    _liquidOffX  = header->offsetX;
+    _liquidOffY  = header->offsetY;
+    _liquidWidth = header->width;
+    _liquidHeight = header->height;
+    _liquidLevel  = header->liquidLevel;
 
-        _liquidFlags = new uint8[16 * 16];
-        if (fread(_liquidFlags, sizeof(uint8), 16 * 16, in) != 16 * 16)
+    if (!(header->flags & MAP_LIQUID_NO_TYPE))
+    {
+        _liquidEntry = _file.GetAt<uint16>(offset, 16 * 16);
+        offset += MapAlignedSize(sizeof(uint16) * 16 * 16);
+        _liquidFlags = _file.GetAt<uint8>(offset, 16 * 16);
+        offset += MapAlignedSize(sizeof(uint8) * 16 * 16);
+        if (!_liquidEntry || !_liquidFlags)
             return false;
     }
 
-    if (!(header.flags & MAP_LIQUID_NO_HEIGHT))
+    if (!(header->flags & MAP_LIQUID_NO_HEIGHT))
     {
-        _liquidMap = new float[uint32(_liquidWidth) * uint32(_liquidHeight)];
-        if (fread(_liquidMap, sizeof(float), _liquidWidth * _liquidHeight, in) != (uint32(_liquidWidth) * uint32(_liquidHeight)))
+        _liquidMap = _file.GetAt<float>(offset, uint32(_liquidWidth) * uint32(_liquidHeight));
+        if (!_liquidMap)
             return false;
     }
 
@@ -1594,7 +1817,7 @@ float GridMap::getHeightFromUint8(float x, float y) const
     y_int &= (MAP_RESOLUTION - 1);
 
     int32 a, b, c;
-    uint8* V9_h1_ptr = &m_uint8_V9[x_int * 128 + x_int + y_int];
+    uint8 const* V9_h1_ptr = &m_uint8_V9[x_int * 128 + x_int + y_int];
     if (x + y < 1)
     {
         if (x > y)
@@ -1661,7 +1884,7 @@ float GridMap::getHeightFromUint16(float x, float y) const
     y_int &= (MAP_RESOLUTION - 1);
 
     int32 a, b, c;
-    uint16* V9_h1_ptr = &m_uint16_V9[x_int * 128 + x_int + y_int];
+    uint16 const* V9_h1_ptr = &m_uint16_V9[x_int * 128 + x_int + y_int];
     if (x + y < 1)
     {
         if (x > y)
@@ -1712,6 +1935,132 @@ float GridMap::getHeightFromUint16(float x, float y) const
     return (float)((a * x) + (b * y) + c) * _gridIntHeightMultiplier + _gridHeight;
 }
 
+#ifdef GRIDMAP_USE_SSE2
+namespace
+{
+    inline __m128 SelectPs(__m128 mask, __m128 a, __m128 b)
+    {
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+
+    // Same interpolation as GridMap::getHeightFromFloat/Uint16/Uint8, four points at a time.
+    // All four triangle equations are evaluated and the right one is picked per lane,
+    // the operations are done in the same order as the scalar code so results are identical.
+    template<class T, bool Scaled>
+    void GetHeights4(T const* V9, T const* V8, float const* x, float const* y, float* heights, float multiplier, float offset)
+    {
+        __m128 const resolution = _mm_set1_ps(float(MAP_RESOLUTION));
+        __m128 const center = _mm_set1_ps(32.0f);
+        __m128 const gridSize = _mm_set1_ps(SIZE_OF_GRIDS);
+        __m128i const mask = _mm_set1_epi32(MAP_RESOLUTION - 1);
+
+        __m128 fx = _mm_mul_ps(resolution, _mm_sub_ps(center, _mm_div_ps(_mm_loadu_ps(x), gridSize)));
+        __m128 fy = _mm_mul_ps(resolution, _mm_sub_ps(center, _mm_div_ps(_mm_loadu_ps(y), gridSize)));
+
+        __m128i xi = _mm_cvttps_epi32(fx);
+        __m128i yi = _mm_cvttps_epi32(fy);
+        fx = _mm_sub_ps(fx, _mm_cvtepi32_ps(xi));
+        fy = _mm_sub_ps(fy, _mm_cvtepi32_ps(yi));
+
+        alignas(16) int32 xIdx[4];
+        alignas(16) int32 yIdx[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(xIdx), _mm_and_si128(xi, mask));
+        _mm_store_si128(reinterpret_cast<__m128i*>(yIdx), _mm_and_si128(yi, mask));
+
+        alignas(16) float v1[4], v2[4], v3[4], v4[4], v5[4];
+        for (uint32 i = 0; i < 4; ++i)
+        {
+            T const* V9_h1_ptr = &V9[xIdx[i] * 129 + yIdx[i]];
+            v1[i] = float(V9_h1_ptr[0]);
+            v2[i] = float(V9_h1_ptr[129]);
+            v3[i] = float(V9_h1_ptr[1]);
+            v4[i] = float(V9_h1_ptr[130]);
+            v5[i] = float(V8[xIdx[i] * 128 + yIdx[i]]);
+        }
+
+        __m128 h1 = _mm_load_ps(v1);
+        __m128 h2 = _mm_load_ps(v2);
+        __m128 h3 = _mm_load_ps(v3);
+        __m128 h4 = _mm_load_ps(v4);
+        __m128 h5 = _mm_add_ps(_mm_load_ps(v5), _mm_load_ps(v5));
+
+        __m128 upper = _mm_cmplt_ps(_mm_add_ps(fx, fy), _mm_set1_ps(1.0f));
+        __m128 right = _mm_cmpgt_ps(fx, fy);
+
+        // triangles 1 and 2 (upper) or 3 and 4, see GridMap::getHeightFromFloat
+        __m128 a = SelectPs(upper,
+            SelectPs(right, _mm_sub_ps(h2, h1), _mm_sub_ps(_mm_sub_ps(h5, h1), h3)),
+            SelectPs(right, _mm_sub_ps(_mm_add_ps(h2, h4), h5), _mm_sub_ps(h4, h3)));
+        __m128 b = SelectPs(upper,
+            SelectPs(right, _mm_sub_ps(_mm_sub_ps(h5, h1), h2), _mm_sub_ps(h3, h1)),
+            SelectPs(right, _mm_sub_ps(h4, h2), _mm_sub_ps(_mm_add_ps(h3, h4), h5)));
+        __m128 c = SelectPs(upper, h1, _mm_sub_ps(h5, h4));
+
+        __m128 result = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, fx), _mm_mul_ps(b, fy)), c);
+        if (Scaled)
+            result = _mm_add_ps(_mm_mul_ps(result, _mm_set1_ps(multiplier)), _mm_set1_ps(offset));
+
+        _mm_storeu_ps(heights, result);
+    }
+}
+#endif
+
+void GridMap::getHeights(float const* x, float const* y, float* heights, uint32 count) const
+{
+    uint32 i = 0;
+
+    if (_gridGetHeight == &GridMap::getHeightFromFlat || !m_V8 || !m_V9)
+    {
+        for (; i < count; ++i)
+            heights[i] = _gridHeight;
+        return;
+    }
+
+#ifdef GRIDMAP_USE_SSE2
+    if (_gridGetHeight == &GridMap::getHeightFromFloat)
+    {
+        for (; i + 4 <= count; i += 4)
+            GetHeights4<float, false>(m_V9, m_V8, x + i, y + i, heights + i, 1.0f, 0.0f);
+    }
+    else if (_gridGetHeight == &GridMap::getHeightFromUint16)
+    {
+        for (; i + 4 <= count; i += 4)
+            GetHeights4<uint16, true>(m_uint16_V9, m_uint16_V8, x + i, y + i, heights + i, _gridIntHeightMultiplier, _gridHeight);
+    }
+    else
+    {
+        for (; i + 4 <= count; i += 4)
+            GetHeights4<uint8, true>(m_uint8_V9, m_uint8_V8, x + i, y + i, heights + i, _gridIntHeightMultiplier, _gridHeight);
+    }
+#endif
+
+    // remainder (or everything without SSE2)
+    for (; i < count; ++i)
+        heights[i] = getHeight(x[i], y[i]);
+}
+
+void GridMap::getLiquidLevels(float const* x, float const* y, float* levels, uint32 count) const
+{
+    if (!_liquidMap)
+    {
+        for (uint32 i = 0; i < count; ++i)
+            levels[i] = _liquidLevel;
+        return;
+    }
+
+    for (uint32 i = 0; i < count; ++i)
+    {
+        int cx_int = ((int)(MAP_RESOLUTION * (32 - x[i] / SIZE_OF_GRIDS)) & (MAP_RESOLUTION - 1)) - _liquidOffY;
+        int cy_int = ((int)(MAP_RESOLUTION * (32 - y[i] / SIZE_OF_GRIDS)) & (MAP_RESOLUTION - 1)) - _liquidOffX;
+
+        // unsigned compare covers both < 0 and >= size
+        if (uint32(cx_int) >= _liquidHeight || uint32(cy_int) >= _liquidWidth)
+            levels[i] = INVALID_HEIGHT;
+        else
+            levels[i] = _liquidMap[cx_int * _liquidWidth + cy_int];
+    }
+}
+
 float GridMap::getMinHeight(float x, float y) const
 {
     if (!_minHeight)
@@ -1917,6 +2266,15 @@ GridMap* Map::GetGrid(float x, float y)
     // ensure GridMap is loaded
     EnsureGridCreated(GridCoord(63 - gx, 63 - gy));
 
+    if (!_gridDataLastUsed.empty())
+    {
+        // data of an existing grid was unloaded by the tile budget
+        if (!GridMaps[gx][gy])
+            ReloadGridData(gx, gy);
+        else
+            _gridDataLastUsed[gx * MAX_NUMBER_OF_GRIDS + gy] = GameTime::GetGameTimeMS();
+    }
+
     return GridMaps[gx][gy];
 }
 
@@ -2015,6 +2373,47 @@ float Map::GetMinHeight(float x, float y) const
     return -500.0f;
 }
 
+template<class Func>
+void Map::ForEachGridSpan(float const* x, float const* y, uint32 count, Func&& func) const
+{
+    uint32 begin = 0;
+    while (begin < count)
+    {
+        // consecutive points in the same grid are handed over together
+        int gx = (int)(32 - x[begin] / SIZE_OF_GRIDS);
+        int gy = (int)(32 - y[begin] / SIZE_OF_GRIDS);
+
+        uint32 end = begin + 1;
+        while (end < count && (int)(32 - x[end] / SIZE_OF_GRIDS) == gx && (int)(32 - y[end] / SIZE_OF_GRIDS) == gy)
+            ++end;
+
+        func(const_cast<Map*>(this)->GetGrid(x[begin], y[begin]), begin, end - begin);
+        begin = end;
+    }
+}
+
+void Map::GetGridHeights(float const* x, float const* y, float* heights, uint32 count) const
+{
+    ForEachGridSpan(x, y, count, [&](GridMap const* gmap, uint32 offset, uint32 spanCount)
+    {
+        if (gmap)
+            gmap->getHeights(x + offset, y + offset, heights + offset, spanCount);
+        else
+            std::fill_n(heights + offset, spanCount, INVALID_HEIGHT);
+    });
+}
+
+void Map::GetWaterLevels(float const* x, float const* y, float* levels, uint32 count) const
+{
+    ForEachGridSpan(x, y, count, [&](GridMap const* gmap, uint32 offset, uint32 spanCount)
+    {
+        if (gmap)
+            gmap->getLiquidLevels(x + offset, y + offset, levels + offset, spanCount);
+        else
+            std::fill_n(levels + offset, spanCount, 0.0f);
+    });
+}
+
 inline bool IsOutdoorWMO(uint32 mogpFlags, int32 /*adtId*/, int32 /*rootId*/, int32 /*groupId*/, WMOAreaTableEntry const* wmoEntry, AreaTableEntry const* atEntry)
 {
     bool outdoor = true;
@@ -2256,6 +2655,35 @@ float Map::GetWaterLevel(float x, float y) const
 }
 
 bool Map::isInLineOfSight(float x1, float y1, float z1, float x2, float y2, float z2, uint32 phasemask, LineOfSightChecks checks) const
+{
+    LineOfSightCache::Key key;
+    if (!_lineOfSightCache.MakeKey(x1, y1, z1, x2, y2, z2, phasemask, uint8(checks), key))
+        return CheckLineOfSight(x1, y1, z1, x2, y2, z2, phasemask, checks);
+
+    bool result;
+    if (_lineOfSightCache.Find(key, result))
+        return result;
+
+    if (!_lineOfSightCache.IsMeasuring())
+    {
+        result = CheckLineOfSight(x1, y1, z1, x2, y2, z2, phasemask, checks);
+        _lineOfSightCache.Insert(key, result, 0);
+        return result;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    result = CheckLineOfSight(x1, y1, z1, x2, y2, z2, phasemask, checks);
+    _lineOfSightCache.Insert(key, result, uint32(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count()));
+    return result;
+}
+
+void Map::InvalidateLineOfSight(const GameObjectModel& model)
+{
+    G3D::AABox const& bounds = model.getBounds();
+    _lineOfSightCache.Invalidate(bounds.low().x, bounds.low().y, bounds.high().x, bounds.high().y);
+}
+
+bool Map::CheckLineOfSight(float x1, float y1, float z1, float x2, float y2, float z2, uint32 phasemask, LineOfSightChecks checks) const
 {
     if ((checks & LINEOFSIGHT_CHECK_VMAP) && !VMAP::VMapFactory::createOrGetVMapManager()->isInLineOfSight(GetId(), x1, y1, z1, x2, y2, z2))
         return false;
@@ -3092,6 +3520,9 @@ void Map::SaveCreatureRespawnTime(uint32 dbGuid, time_t& respawnTime)
 
     _creatureRespawnTimes[dbGuid] = respawnTime;
 
+    if (_releasedCreatures.find(dbGuid) != _releasedCreatures.end())
+        _respawnWheel.Schedule(RESPAWN_EVENT_CREATURE, dbGuid, respawnTime);
+
     PreparedStatement* stmt = CharacterDatabase.GetPreparedStatement(CHAR_REP_CREATURE_RESPAWN);
     stmt->setUInt32(0, dbGuid);
     stmt->setUInt32(1, uint32(respawnTime));
@@ -3104,6 +3535,9 @@ void Map::RemoveCreatureRespawnTime(uint32 dbGuid)
 {
     _creatureRespawnTimes.erase(dbGuid);
 
+    if (_releasedCreatures.find(dbGuid) != _releasedCreatures.end())
+        _respawnWheel.Schedule(RESPAWN_EVENT_CREATURE, dbGuid, GameTime::GetGameTime());
+
     PreparedStatement* stmt = CharacterDatabase.GetPreparedStatement(CHAR_DEL_CREATURE_RESPAWN);
     stmt->setUInt32(0, dbGuid);
     stmt->setUInt16(1, GetId());
@@ -3126,6 +3560,9 @@ void Map::SaveGORespawnTime(uint32 dbGuid, time_t& respawnTime)
 
     _goRespawnTimes[dbGuid] = respawnTime;
 
+    if (_releasedGameObjects.find(dbGuid) != _releasedGameObjects.end())
+        _respawnWheel.Schedule(RESPAWN_EVENT_GAMEOBJECT, dbGuid, respawnTime);
+
     PreparedStatement* stmt = CharacterDatabase.GetPreparedStatement(CHAR_REP_GO_RESPAWN);
     stmt->setUInt32(0, dbGuid);
     stmt->setUInt32(1, uint32(respawnTime));
@@ -3138,6 +3575,9 @@ void Map::RemoveGORespawnTime(uint32 dbGuid)
 {
     _goRespawnTimes.erase(dbGuid);
 
+    if (_releasedGameObjects.find(dbGuid) != _releasedGameObjects.end())
+        _respawnWheel.Schedule(RESPAWN_EVENT_GAMEOBJECT, dbGuid, GameTime::GetGameTime());
+
     PreparedStatement* stmt = CharacterDatabase.GetPreparedStatement(CHAR_DEL_GO_RESPAWN);
     stmt->setUInt32(0, dbGuid);
     stmt->setUInt16(1, GetId());
@@ -3201,6 +3641,207 @@ void Map::DeleteRespawnTimesInDB(uint16 mapId, uint32 instanceId)
     CharacterDatabase.Execute(stmt);
 }
 
+bool Map::CanReleaseRespawns() const
+{
+    return CanUnloadGridData() && CONF_GET_BOOL("Respawn.Release.Enable");
+}
+
+void Map::ScheduleRespawnRelease(Creature* creature)
+{
+    if (!creature->GetDBTableGUIDLow() || !CanReleaseRespawns())
+        return;
+
+    _respawnWheel.Schedule(RESPAWN_EVENT_RELEASE_CREATURE, creature->GetDBTableGUIDLow(), GameTime::GetGameTime() + CONF_GET_INT("Respawn.Release.Delay"));
+}
+
+void Map::ScheduleRespawnRelease(GameObject* gameobject)
+{
+    if (!gameobject->GetDBTableGUIDLow() || !CanReleaseRespawns())
+        return;
+
+    _respawnWheel.Schedule(RESPAWN_EVENT_RELEASE_GAMEOBJECT, gameobject->GetDBTableGUIDLow(), GameTime::GetGameTime() + CONF_GET_INT("Respawn.Release.Delay"));
+}
+
+void Map::ProcessRespawns()
+{
+    time_t now = GameTime::GetGameTime();
+
+    _dueRespawns.clear();
+    _respawnWheel.Advance(now, _dueRespawns);
+
+    for (RespawnEvent const& event : _dueRespawns)
+    {
+        switch (event.type)
+        {
+            case RESPAWN_EVENT_CREATURE:
+                // stale event, the respawn time was moved since
+                if (GetCreatureRespawnTime(event.spawnId) > now)
+                    break;
+
+                RespawnReleasedCreature(event.spawnId);
+                break;
+            case RESPAWN_EVENT_GAMEOBJECT:
+                if (GetGORespawnTime(event.spawnId) > now)
+                    break;
+
+                RespawnReleasedGameObject(event.spawnId);
+                break;
+            case RESPAWN_EVENT_RELEASE_CREATURE:
+            {
+                CreatureData const* data = sObjectMgr->GetCreatureData(event.spawnId);
+                if (!data)
+                    break;
+
+                Creature* creature = GetCreature(MAKE_NEW_GUID(event.spawnId, data->id, HIGHGUID_UNIT));
+                if (creature)
+                    ReleaseCreature(creature, now);
+                break;
+            }
+            case RESPAWN_EVENT_RELEASE_GAMEOBJECT:
+            {
+                GameObjectData const* data = sObjectMgr->GetGOData(event.spawnId);
+                if (!data)
+                    break;
+
+                GameObject* gameobject = GetGameObject(MAKE_NEW_GUID(event.spawnId, data->id, HIGHGUID_GAMEOBJECT));
+                if (gameobject)
+                    ReleaseGameObject(gameobject, now);
+                break;
+            }
+        }
+    }
+}
+
+bool Map::ReleaseCreature(Creature* creature, time_t now)
+{
+    if (!creature->IsInWorld() || creature->getDeathState() != DEAD)
+        return false;
+
+    // respawn is close or already due, nothing to gain
+    if (creature->GetRespawnTime() < now + CONF_GET_INT("Respawn.Release.MinRespawnTime"))
+        return false;
+
+    // anything with state outside of the spawn data has to stay
+    if (creature->IsSummon() || creature->IsPet() || creature->IsVehicle() || creature->isActiveObject() || creature->GetTransport() || creature->GetScriptId())
+        return false;
+
+    uint32 dbGuid = creature->GetDBTableGUIDLow();
+    CreatureData const* data = creature->GetCreatureData();
+    if (!data || !data->dbData || sPoolMgr->IsPartOfAPool<Creature>(dbGuid))
+        return false;
+
+    if (sObjectMgr->GetLinkedRespawnGuid(MAKE_NEW_GUID(dbGuid, creature->GetEntry(), HIGHGUID_UNIT)))
+        return false;
+
+    // somebody is around, the creature is updated anyway, look again later
+    Cell cell(creature->GetPositionX(), creature->GetPositionY());
+    if (isCellMarked(cell.GetCellCoord().GetId()))
+    {
+        ScheduleRespawnRelease(creature);
+        return false;
+    }
+
+    _releasedCreatures.insert(dbGuid);
+    creature->SaveRespawnTime();
+
+    LOG_DEBUG("maps", "Map::ReleaseCreature: released creature %u (entry %u) on map %u, respawn in %u s",
+        dbGuid, creature->GetEntry(), GetId(), uint32(creature->GetRespawnTime() - now));
+
+    creature->AddObjectToRemoveList();
+    return true;
+}
+
+bool Map::ReleaseGameObject(GameObject* gameobject, time_t now)
+{
+    if (!gameobject->IsInWorld() || gameobject->isSpawned() || !gameobject->isSpawnedByDefault() || gameobject->getLootState() != GO_READY)
+        return false;
+
+    if (gameobject->GetRespawnTime() < now + CONF_GET_INT("Respawn.Release.MinRespawnTime"))
+        return false;
+
+    if (gameobject->IsTransport() || gameobject->isActiveObject() || gameobject->GetOwnerGUID() || gameobject->GetSpellId() || gameobject->GetScriptId())
+        return false;
+
+    uint32 dbGuid = gameobject->GetDBTableGUIDLow();
+    GameObjectData const* data = gameobject->GetGOData();
+    if (!data || !data->dbData || sPoolMgr->IsPartOfAPool<GameObject>(dbGuid))
+        return false;
+
+    if (sObjectMgr->GetLinkedRespawnGuid(MAKE_NEW_GUID(dbGuid, gameobject->GetEntry(), HIGHGUID_GAMEOBJECT)))
+        return false;
+
+    Cell cell(gameobject->GetPositionX(), gameobject->GetPositionY());
+    if (isCellMarked(cell.GetCellCoord().GetId()))
+    {
+        ScheduleRespawnRelease(gameobject);
+        return false;
+    }
+
+    _releasedGameObjects.insert(dbGuid);
+    gameobject->SaveRespawnTime();
+
+    LOG_DEBUG("maps", "Map::ReleaseGameObject: released gameobject %u (entry %u) on map %u, respawn in %u s",
+        dbGuid, gameobject->GetEntry(), GetId(), uint32(gameobject->GetRespawnTime() - now));
+
+    gameobject->AddObjectToRemoveList();
+    return true;
+}
+
+void Map::RespawnReleasedCreature(uint32 dbGuid)
+{
+    std::unordered_set<uint32>::iterator itr = _releasedCreatures.find(dbGuid);
+    if (itr == _releasedCreatures.end())
+        return;
+
+    _releasedCreatures.erase(itr);
+
+    CreatureData const* data = sObjectMgr->GetCreatureData(dbGuid);
+    if (!data || !IsGridLoaded(data->posX, data->posY))
+        return;
+
+    // spawn may have been removed meanwhile, e.g. by a game event
+    CellCoord cellCoord = Warhead::ComputeCellCoord(data->posX, data->posY);
+    CellObjectGuids const& cellGuids = sObjectMgr->GetCellObjectGuids(GetId(), GetSpawnMode(), cellCoord.GetId());
+    if (cellGuids.creatures.find(dbGuid) == cellGuids.creatures.end())
+        return;
+
+    // the expired respawn time is kept, the creature is loaded dead and goes through Creature::Respawn
+    // on its next update like any other dead creature: AI()->JustRespawned, pools and linked respawns
+    Creature* creature = new Creature();
+    if (!creature->LoadCreatureFromDB(dbGuid, this))
+        delete creature;
+}
+
+void Map::RespawnReleasedGameObject(uint32 dbGuid)
+{
+    std::unordered_set<uint32>::iterator itr = _releasedGameObjects.find(dbGuid);
+    if (itr == _releasedGameObjects.end())
+        return;
+
+    _releasedGameObjects.erase(itr);
+
+    GameObjectData const* data = sObjectMgr->GetGOData(dbGuid);
+    if (!data || !IsGridLoaded(data->posX, data->posY))
+        return;
+
+    CellCoord cellCoord = Warhead::ComputeCellCoord(data->posX, data->posY);
+    CellObjectGuids const& cellGuids = sObjectMgr->GetCellObjectGuids(GetId(), GetSpawnMode(), cellCoord.GetId());
+    if (cellGuids.gameobjects.find(dbGuid) == cellGuids.gameobjects.end())
+        return;
+
+    RemoveGORespawnTime(dbGuid);
+
+    GameObject* gameobject = new GameObject();
+    if (!gameobject->LoadGameObjectFromDB(dbGuid, this, false))
+    {
+        delete gameobject;
+        return;
+    }
+
+    if (!gameobject->isSpawnedByDefault() || !AddToMap(gameobject))
+        delete gameobject;
+}
+
 void Map::UpdateEncounterState(EncounterCreditType type, uint32 creditEntry, Unit* source)
 {
     Difficulty difficulty_fixed = (IsSharedDifficultyMap(GetId()) ? Difficulty(GetDifficulty() % 2) : GetDifficulty());
@@ -34,8 +34,15 @@
 #include "GameObjectModel.h"
 #include "Log.h"
 #include "DataMap.h"
+#include "DynamicVisibility.h"
+#include "LineOfSightCache.h"
+#include "MapHibernation.h"
+#include "MappedFile.h"
+#include "RespawnTimerWheel.h"
 #include <bitset>
 #include <list>
+#include <memory>
+#include <unordered_set>
 
 class Unit;
 class WorldPacket;
@@ -57,6 +64,7 @@ class BattlegroundMap;
 class Transport;
 class StaticTransport;
 class MotionTransport;
+class PathCache;
 namespace Warhead
 {
     struct ObjectUpdater;
@@ -85,8 +93,19 @@ struct map_fileheader
     uint32 heightMapSize;
     uint32 liquidMapOffset;
     uint32 liquidMapSize;
+    uint32 holesOffset;
+    uint32 holesSize;
 };
 
+// Every section, section header and data array in a .map file starts on this boundary,
+// so the loader can point straight into a memory mapping of the file
+#define MAP_SECTION_ALIGNMENT 16
+
+inline uint32 MapAlignedSize(uint32 size)
+{
+    return (size + MAP_SECTION_ALIGNMENT - 1) & ~uint32(MAP_SECTION_ALIGNMENT - 1);
+}
+
 #define MAP_AREA_NO_AREA      0x0001
 
 struct map_areaHeader
@@ -165,30 +184,30 @@ class GridMap
     uint32  _flags;
     union
     {
-        float* m_V9;
-        uint16* m_uint16_V9;
-        uint8* m_uint8_V9;
+        float const* m_V9;
+        uint16 const* m_uint16_V9;
+        uint8 const* m_uint8_V9;
     };
     union
     {
-        float* m_V8;
-        uint16* m_uint16_V8;
-        uint8* m_uint8_V8;
+        float const* m_V8;
+        uint16 const* m_uint16_V8;
+        uint8 const* m_uint8_V8;
     };
-    int16* _maxHeight;
-    int16* _minHeight;
+    int16 const* _maxHeight;
+    int16 const* _minHeight;
     // Height level data
     float _gridHeight;
     float _gridIntHeightMultiplier;
 
     // Area data
-    uint16* _areaMap;
+    uint16 const* _areaMap;
 
     // Liquid data
     float _liquidLevel;
-    uint16* _liquidEntry;
-    uint8* _liquidFlags;
-    float* _liquidMap;
+    uint16 const* _liquidEntry;
+    uint8 const* _liquidFlags;
+    float const* _liquidMap;
     uint16 _gridArea;
     uint16 _liquidType;
     uint8 _liquidOffX;
@@ -196,9 +215,12 @@ class GridMap
     uint8 _liquidWidth;
     uint8 _liquidHeight;
 
-    bool loadAreaData(FILE* in, uint32 offset, uint32 size);
-    bool loadHeightData(FILE* in, uint32 offset, uint32 size);
-    bool loadLiquidData(FILE* in, uint32 offset, uint32 size);
+    // All data pointers above point into this mapping
+    MappedFile _file;
+
+    bool loadAreaData(uint32 offset, uint32 size);
+    bool loadHeightData(uint32 offset, uint32 size);
+    bool loadLiquidData(uint32 offset, uint32 size);
 
     // Get height functions and pointers
     typedef float (GridMap::*GetHeightPtr) (float x, float y) const;
@@ -218,8 +240,14 @@ public:
     inline float getHeight(float x, float y) const {return (this->*_gridGetHeight)(x, y);}
     float getMinHeight(float x, float y) const;
     float getLiquidLevel(float x, float y) const;
+    // Batched getHeight/getLiquidLevel for count points, all points must lie in this grid
+    void getHeights(float const* x, float const* y, float* heights, uint32 count) const;
+    void getLiquidLevels(float const* x, float const* y, float* levels, uint32 count) const;
     uint8 getTerrainType(float x, float y) const;
     ZLiquidStatus getLiquidStatus(float x, float y, float z, uint8 ReqLiquidType, LiquidData* data = 0);
+    // private memory, the mapping of an uncompressed file is page cache and only counted by getMappedSize
+    std::size_t getMemoryUsage() const { return sizeof(GridMap) + (_file.IsCompressed() ? _file.GetSize() : 0); }
+    std::size_t getMappedSize() const { return _file.IsCompressed() ? 0 : _file.GetSize(); }
 };
 
 // GCC have alternative #pragma pack(N) syntax and old gcc version not support pack(push, N), also any gcc version not support it at some platform
@@ -358,6 +386,10 @@ public:
     // can return INVALID_HEIGHT if under z+2 z coord not found height
     float GetHeight(float x, float y, float z, bool checkVMap = true, float maxSearchDist = DEFAULT_HEIGHT_SEARCH) const;
     float GetMinHeight(float x, float y) const;
+    // Raw .map surface heights and liquid levels for count points (no vmap), points may span several grids.
+    // Heights are INVALID_HEIGHT and levels 0 where no grid data exists, like GetHeight and GetWaterLevel
+    void GetGridHeights(float const* x, float const* y, float* heights, uint32 count) const;
+    void GetWaterLevels(float const* x, float const* y, float* levels, uint32 count) const;
     Transport* GetTransportForPos(uint32 phase, float x, float y, float z, WorldObject* worldobject = nullptr);
 
     ZLiquidStatus getLiquidStatus(float x, float y, float z, uint8 ReqLiquidType, LiquidData* data = 0) const;
@@ -476,10 +508,15 @@ public:
 
     float GetWaterOrGroundLevel(uint32 phasemask, float x, float y, float z, float* ground = NULL, bool swim = false, float maxSearchDist = 50.0f) const;
     float GetHeight(uint32 phasemask, float x, float y, float z, bool vmap = true, float maxSearchDist = DEFAULT_HEIGHT_SEARCH) const;
+    // goes through the line of sight cache, only for the thread updating the map
     bool isInLineOfSight(float x1, float y1, float z1, float x2, float y2, float z2, uint32 phasemask, LineOfSightChecks checks) const;
     void Balance() { _dynamicTree.balance(); }
-    void RemoveGameObjectModel(const GameObjectModel& model) { _dynamicTree.remove(model); }
-    void InsertGameObjectModel(const GameObjectModel& model) { _dynamicTree.insert(model); }
+    void RemoveGameObjectModel(const GameObjectModel& model) { _dynamicTree.remove(model); InvalidateLineOfSight(model); }
+    void InsertGameObjectModel(const GameObjectModel& model) { _dynamicTree.insert(model); InvalidateLineOfSight(model); }
+    // drops cached line of sight results around a model that was added, removed or toggled
+    void InvalidateLineOfSight(const GameObjectModel& model);
+    // shared with the paths still being built for units of this map, see PathGenerator
+    std::shared_ptr<PathCache> const& GetPathCache() const { return _pathCache; }
     bool ContainsGameObjectModel(const GameObjectModel& model) const { return _dynamicTree.contains(model);}
     DynamicMapTree const& GetDynamicMapTree() const { return _dynamicTree; }
     bool getObjectHitPos(uint32 phasemask, float x1, float y1, float z1, float x2, float y2, float z2, float& rx, float& ry, float& rz, float modifyDist);
@@ -516,6 +553,12 @@ public:
 
     static void DeleteRespawnTimesInDB(uint16 mapId, uint32 instanceId);
 
+    // Dead creatures and despawned gameobjects in idle cells of continents are deleted
+    // and created again from their spawn data once the respawn time is reached
+    bool CanReleaseRespawns() const;
+    void ScheduleRespawnRelease(Creature* creature);
+    void ScheduleRespawnRelease(GameObject* gameobject);
+
     void SendInitTransports(Player* player);
     void SendRemoveTransports(Player* player);
     void SendZoneDynamicInfo(Player* player);
@@ -536,16 +579,48 @@ public:
     void AllTransportsRemovePassengers(); // pussywizard
     TransportsContainer const& GetAllTransports() const { return _transports; }
 
+    // Terrain and mmap data of idle grids may be unloaded to stay within the memory budget, see TileBudget.
+    // The data is loaded again as soon as the grid is used, both under _gridLock. Grid coordinates as used by the data files (63 - GridCoord)
+    bool CanUnloadGridData() const { return i_InstanceId == 0 && !Instanceable(); }
+    std::size_t GetGridDataMemory(int gx, int gy) const { return GridMaps[gx][gy] ? GridMaps[gx][gy]->getMemoryUsage() : 0; }
+    std::size_t GetGridDataMappedSize(int gx, int gy) const { return GridMaps[gx][gy] ? GridMaps[gx][gy]->getMappedSize() : 0; }
+    uint32 GetGridDataLastUsed(int gx, int gy) const { return _gridDataLastUsed.empty() ? 0 : _gridDataLastUsed[gx * MAX_NUMBER_OF_GRIDS + gy]; }
+    void UnloadGridData(int gx, int gy);
+
+    // visibility and ai notify delays adapted to the load of this map, see MapDynamicVisibility
+    MapDynamicVisibility const& GetDynamicVisibility() const { return _dynamicVisibility; }
+
+    // level of detail of creature and gameobject updates, see MapHibernation
+    MapHibernation const& GetHibernation() const { return _hibernation; }
+
+    // Instance maps without players, combat or moving players are updated less often.
+    // Called before scheduling the update, accumulates the diffs of skipped ticks and
+    // returns true if the map should be updated now, with the accumulated diffs
+    bool PrepareUpdate(uint32& t_diff, uint32& s_diff);
+    // back to full rate for the next tick
+    void WakeUp() { _tickWakeUp = true; }
+    uint32 GetTickInterval() const { return _tickInterval; }
+
     DataMap CustomData;
 
 private:
     void LoadMapAndVMap(int gx, int gy);
+    void ReloadGridData(int gx, int gy);
     void LoadVMap(int gx, int gy);
     void LoadMap(int gx, int gy, bool reload = false);
 
+    template<class Func>
+    void ForEachGridSpan(float const* x, float const* y, uint32 count, Func&& func) const;
+
     // Load MMap Data
     void LoadMMap(int gx, int gy);
 
+    // Queue background loading of the grids in front of a moving player
+    void PreloadGridsAhead(Player* player, float x, float y, float o);
+
+    // Marks the grid data in the area as used and reloads it if it was unloaded
+    void TouchGridData(CellArea const& area);
+
     template<class T> void InitializeObject(T* obj);
     void AddCreatureToMoveList(Creature* c);
     void RemoveCreatureFromMoveList(Creature* c);
@@ -618,6 +693,7 @@ private:
 
     NGridType* i_grids[MAX_NUMBER_OF_GRIDS][MAX_NUMBER_OF_GRIDS];
     GridMap* GridMaps[MAX_NUMBER_OF_GRIDS][MAX_NUMBER_OF_GRIDS];
+    std::vector<uint32> _gridDataLastUsed; // [gx * MAX_NUMBER_OF_GRIDS + gy], only for maps that can unload grid data
     std::bitset<TOTAL_NUMBER_OF_CELLS_PER_MAP* TOTAL_NUMBER_OF_CELLS_PER_MAP> marked_cells;
     std::bitset<TOTAL_NUMBER_OF_CELLS_PER_MAP* TOTAL_NUMBER_OF_CELLS_PER_MAP> marked_cells_large;
 
@@ -660,8 +736,42 @@ private:
     std::unordered_map<uint32 /*dbGUID*/, time_t> _creatureRespawnTimes;
     std::unordered_map<uint32 /*dbGUID*/, time_t> _goRespawnTimes;
 
+    void ProcessRespawns();
+    bool ReleaseCreature(Creature* creature, time_t now);
+    bool ReleaseGameObject(GameObject* gameobject, time_t now);
+    void RespawnReleasedCreature(uint32 dbGuid);
+    void RespawnReleasedGameObject(uint32 dbGuid);
+
+    RespawnTimerWheel _respawnWheel;
+    std::vector<RespawnEvent> _dueRespawns;
+    std::unordered_set<uint32 /*dbGUID*/> _releasedCreatures;
+    std::unordered_set<uint32 /*dbGUID*/> _releasedGameObjects;
+
     ZoneDynamicInfoMap _zoneDynamicInfo;
     uint32 _defaultLight;
+
+    MapDynamicVisibility _dynamicVisibility;
+    MapHibernation _hibernation;
+
+    bool CheckLineOfSight(float x1, float y1, float z1, float x2, float y2, float z2, uint32 phasemask, LineOfSightChecks checks) const;
+    mutable LineOfSightCache _lineOfSightCache;
+    std::shared_ptr<PathCache> _pathCache;
+
+    void LoadTickRateConfig();
+    void UpdateTickInterval(uint32 diff);
+    bool HasPendingPackets() const;
+
+    // MapTickRate.* options, read again every second
+    bool _tickRateEnabled;
+    uint32 _tickIdleInterval;
+    uint32 _tickEmptyInterval;
+    uint32 _tickInterval;
+    uint32 _tickTimer;
+    uint32 _pendingDiff;
+    uint32 _pendingSessionDiff;
+    bool _tickWakeUp;
+    uint32 _skippedTicks;
+    uint32 _tickMetricTimer;
 };
 
 enum InstanceResetMethod
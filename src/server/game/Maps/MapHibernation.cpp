@@ -0,0 +1,186 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "MapHibernation.h"
+#include "Cell.h"
+#include "Creature.h"
+#include "GameConfig.h"
+#include "GameObject.h"
+#include "MapReference.h"
+#include "Metric.h"
+#include "MotionMaster.h"
+#include "Player.h"
+#include <algorithm>
+
+MapHibernation::MapHibernation() : _mapId(0), _instanceId(0), _enabled(false), _dormantEnabled(false), _checkDormant(false),
+    _radius(0.0f), _updateInterval(0), _configTimer(0), _fullUpdates(0), _reducedUpdates(0), _skippedUpdates(0), _dormantUpdates(0)
+{
+}
+
+void MapHibernation::Initialize(uint32 mapId, uint32 instanceId)
+{
+    _mapId = mapId;
+    _instanceId = instanceId;
+    LoadConfig();
+}
+
+void MapHibernation::LoadConfig()
+{
+    _enabled = CONF_GET_BOOL("Hibernation.Enable");
+    _dormantEnabled = CONF_GET_BOOL("Hibernation.Dormant");
+    _radius = std::max(CONF_GET_FLOAT("Hibernation.Radius"), 0.0f);
+    _updateInterval = uint32(std::max(CONF_GET_INT("Hibernation.UpdateInterval"), 0));
+}
+
+void MapHibernation::Prepare(MapRefManager const& players, bool checkDormant, uint32 diff)
+{
+    _configTimer += diff;
+    if (_configTimer >= IN_MILLISECONDS)
+    {
+        _configTimer = 0;
+        SendMetrics();
+        LoadConfig();
+    }
+
+    ClearCells(_observedCells, _markedObservedCells);
+    ClearCells(_playerCells, _markedPlayerCells);
+
+    if (!_enabled)
+        return;
+
+    // without active non-player objects all visited cells are around players
+    _checkDormant = _dormantEnabled && checkDormant;
+
+    for (MapRefManager::const_iterator itr = players.begin(); itr != players.end(); ++itr)
+    {
+        Player const* player = itr->GetSource();
+        if (!player || !player->IsInWorld() || !player->IsPositionValid())
+            continue;
+
+        MarkCells(_observedCells, _markedObservedCells, player->GetPositionX(), player->GetPositionY(), _radius);
+
+        if (_checkDormant)
+            MarkCells(_playerCells, _markedPlayerCells, player->GetPositionX(), player->GetPositionY(), player->GetGridActivationRange());
+    }
+}
+
+bool MapHibernation::ShouldUpdate(WorldObject* obj, uint32& diff)
+{
+    uint32 cellId = Warhead::ComputeCellCoord(obj->GetPositionX(), obj->GetPositionY()).GetId();
+
+    if (_observedCells.test(cellId) || RequiresFullRate(obj))
+    {
+        // woken up, catch up with the time slept
+        diff += obj->m_hibernationDiff;
+        obj->m_hibernationDiff = 0;
+        ++_fullUpdates;
+        return true;
+    }
+
+    obj->m_hibernationDiff += diff;
+
+    if (_checkDormant && !_playerCells.test(cellId))
+    {
+        ++_dormantUpdates;
+        return false;
+    }
+
+    // spread objects that went to sleep together over the interval
+    uint32 threshold = _updateInterval - (obj->GetGUIDLow() % (_updateInterval / 2 + 1));
+    if (obj->m_hibernationDiff < threshold)
+    {
+        ++_skippedUpdates;
+        return false;
+    }
+
+    diff = obj->m_hibernationDiff;
+    obj->m_hibernationDiff = 0;
+    ++_reducedUpdates;
+    return true;
+}
+
+bool MapHibernation::RequiresFullRate(WorldObject* obj)
+{
+    if (obj->RequiresFullRateUpdate() || obj->isActiveObject() || obj->IsVisibilityOverridden())
+        return true;
+
+    if (Creature* creature = obj->ToCreature())
+    {
+        if (creature->IsInCombat() || creature->GetCharmerOrOwnerGUID() || creature->IsVehicle() || creature->GetTransport() || creature->GetScriptId())
+            return true;
+
+        // database AI events and timers, waypoints and formations run on the update diff and fall behind otherwise
+        if (!creature->GetCreatureTemplate()->AIName.empty() || creature->GetFormation())
+            return true;
+
+        if (creature->GetDefaultMovementType() == WAYPOINT_MOTION_TYPE || creature->GetMotionMaster()->GetCurrentMovementGeneratorType() == WAYPOINT_MOTION_TYPE)
+            return true;
+
+        // respawn on time
+        return creature->isDead() && creature->GetRespawnTime();
+    }
+
+    if (GameObject* gameobject = obj->ToGameObject())
+        return gameobject->IsTransport() || gameobject->GetOwnerGUID() || gameobject->GetSpellId() || gameobject->GetScriptId();
+
+    return true;
+}
+
+void MapHibernation::MarkCells(CellBitset& cells, std::vector<uint32>& marked, float x, float y, float radius)
+{
+    CellArea area = Cell::CalculateCellArea(x, y, radius);
+
+    for (uint32 cx = area.low_bound.x_coord; cx <= area.high_bound.x_coord; ++cx)
+    {
+        for (uint32 cy = area.low_bound.y_coord; cy <= area.high_bound.y_coord; ++cy)
+        {
+            uint32 cellId = (cy * TOTAL_NUMBER_OF_CELLS_PER_MAP) + cx;
+            if (cells.test(cellId))
+                continue;
+
+            cells.set(cellId);
+            marked.push_back(cellId);
+        }
+    }
+}
+
+void MapHibernation::ClearCells(CellBitset& cells, std::vector<uint32>& marked)
+{
+    for (uint32 cellId : marked)
+        cells.reset(cellId);
+
+    marked.clear();
+}
+
+void MapHibernation::SendMetrics()
+{
+    if (sMetric->IsEnabled() && _enabled)
+    {
+        std::string mapId = std::to_string(_mapId);
+        std::string instanceId = std::to_string(_instanceId);
+        WH_METRIC_VALUE("map_hibernation_full_updates", _fullUpdates, WH_METRIC_TAG("map_id", mapId), WH_METRIC_TAG("instance_id", instanceId));
+        WH_METRIC_VALUE("map_hibernation_reduced_updates", _reducedUpdates, WH_METRIC_TAG("map_id", mapId), WH_METRIC_TAG("instance_id", instanceId));
+        WH_METRIC_VALUE("map_hibernation_skipped_updates", _skippedUpdates, WH_METRIC_TAG("map_id", mapId), WH_METRIC_TAG("instance_id", instanceId));
+        WH_METRIC_VALUE("map_hibernation_dormant_updates", _dormantUpdates, WH_METRIC_TAG("map_id", mapId), WH_METRIC_TAG("instance_id", instanceId));
+    }
+
+    _fullUpdates = 0;
+    _reducedUpdates = 0;
+    _skippedUpdates = 0;
+    _dormantUpdates = 0;
+}
@@ -0,0 +1,85 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _MAP_HIBERNATION_H
+#define _MAP_HIBERNATION_H
+
+#include "Define.h"
+#include "GridDefines.h"
+#include <bitset>
+#include <vector>
+
+class MapRefManager;
+class WorldObject;
+
+// Level of detail for the object updates of a map.
+// Creatures and gameobjects without a player within Hibernation.Radius are updated every
+// Hibernation.UpdateInterval milliseconds with the time accumulated since their last update.
+// Objects in cells only kept loaded by active non-player objects (no player within grid
+// activation range) are not updated at all until a player comes close.
+// Objects in combat, owned, active, scripted or flagged with WorldObject::SetFullRateUpdate
+// are always updated at full rate, as are creatures with an AIName, on waypoints, in a
+// formation or dead and waiting for their respawn.
+// Only touched by the thread updating the map.
+class MapHibernation
+{
+public:
+    MapHibernation();
+
+    void Initialize(uint32 mapId, uint32 instanceId);
+
+    // marks the cells observed by players, called before the cells of the map are visited
+    void Prepare(MapRefManager const& players, bool checkDormant, uint32 diff);
+
+    bool IsEnabled() const { return _enabled; }
+
+    // Returns false if the object skips this update, otherwise diff is set to the time since its last update
+    bool ShouldUpdate(WorldObject* obj, uint32& diff);
+
+private:
+    typedef std::bitset<TOTAL_NUMBER_OF_CELLS_PER_MAP * TOTAL_NUMBER_OF_CELLS_PER_MAP> CellBitset;
+
+    void LoadConfig();
+    void SendMetrics();
+    static bool RequiresFullRate(WorldObject* obj);
+    static void MarkCells(CellBitset& cells, std::vector<uint32>& marked, float x, float y, float radius);
+    static void ClearCells(CellBitset& cells, std::vector<uint32>& marked);
+
+    uint32 _mapId;
+    uint32 _instanceId;
+
+    bool _enabled;
+    bool _dormantEnabled;
+    bool _checkDormant;
+    float _radius;
+    uint32 _updateInterval;
+    uint32 _configTimer;
+
+    // cells with a player within _radius and within grid activation range of a player
+    CellBitset _observedCells;
+    CellBitset _playerCells;
+    std::vector<uint32> _markedObservedCells;
+    std::vector<uint32> _markedPlayerCells;
+
+    uint32 _fullUpdates;
+    uint32 _reducedUpdates;
+    uint32 _skippedUpdates;
+    uint32 _dormantUpdates;
+};
+
+#endif
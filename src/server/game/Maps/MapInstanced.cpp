@@ -60,11 +60,20 @@ void MapInstanced::Update(const uint32 t, const uint32 s_diff, bool /*thread*/)
         }
         else
         {
+            // idle instances skip ticks, the diffs add up until their next update
+            uint32 t_diff = t;
+            uint32 diff = s_diff;
+            if (!i->second->PrepareUpdate(t_diff, diff))
+            {
+                ++i;
+                continue;
+            }
+
             // update only here, because it may schedule some bad things before delete
             if (sMapMgr->GetMapUpdater()->activated())
-                sMapMgr->GetMapUpdater()->schedule_update(*i->second, t, s_diff);
+                sMapMgr->GetMapUpdater()->schedule_update(*i->second, t_diff, diff);
             else
-                i->second->Update(t, s_diff);
+                i->second->Update(t_diff, diff);
             ++i;
         }
     }
@@ -38,6 +38,8 @@
 #include "Chat.h"
 #include "AvgDiffTracker.h"
 #include "GameConfig.h"
+#include "Metric.h"
+#include "RandomMovementCache.h"
 
 MapManager::MapManager()
     : _nextInstanceId(0), _scheduledScripts(0)
@@ -63,6 +65,14 @@ void MapManager::Initialize()
     // Start mtmaps if needed
     if (num_threads > 0)
         m_updater.activate(num_threads);
+
+    int preloadThreads(CONF_GET_INT("GridPreload.Threads"));
+    if (preloadThreads > 0)
+        m_gridPreloader.Activate(preloadThreads);
+
+    int pathfindingThreads(CONF_GET_INT("Pathfinding.Threads"));
+    if (pathfindingThreads > 0)
+        m_pathfindingService.Activate(pathfindingThreads);
 }
 
 void MapManager::InitializeVisibilityDistanceInfo()
@@ -275,6 +285,15 @@ void MapManager::Update(uint32 diff)
 
     sObjectAccessor->ProcessDelayedCorpseActions();
 
+    if (m_gridPreloader.Activated())
+        m_gridPreloader.Update(diff);
+
+    if (m_pathfindingService.Activated())
+        WH_METRIC_VALUE("pathfinding_queue_size", m_pathfindingService.GetQueueSize());
+
+    // maps are not updating now, safe to unload their grid data
+    m_tileBudget.Update(diff);
+
     if (mapUpdateStep < 3)
     {
         for (iter = i_maps.begin(); iter != i_maps.end(); ++iter)
@@ -323,6 +342,10 @@ bool MapManager::IsValidMAP(uint32 mapid, bool startUp)
 
 void MapManager::UnloadAll()
 {
+    // stop background grid loading and path building before the maps and their tiles go away
+    m_gridPreloader.Deactivate();
+    m_pathfindingService.Deactivate();
+
     for (MapMapType::iterator iter = i_maps.begin(); iter != i_maps.end();)
     {
         iter->second->UnloadAll();
@@ -332,6 +355,8 @@ void MapManager::UnloadAll()
 
     if (m_updater.activated())
         m_updater.deactivate();
+
+    sRandomMovementCache->SaveToFile();
 }
 
 void MapManager::GetNumInstances(uint32& dungeons, uint32& battlegrounds, uint32& arenas)
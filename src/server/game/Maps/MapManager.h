@@ -23,6 +23,9 @@
 #include "Map.h"
 #include "Object.h"
 #include "MapUpdater.h"
+#include "GridPreloader.h"
+#include "PathfindingService.h"
+#include "TileBudget.h"
 #include <atomic>
 
 class Transport;
@@ -130,6 +133,18 @@ public:
     uint32 GenerateInstanceId();
 
     MapUpdater* GetMapUpdater() { return &m_updater; }
+    GridPreloader* GetGridPreloader() { return &m_gridPreloader; }
+    PathfindingService* GetPathfindingService() { return &m_pathfindingService; }
+    TileBudget* GetTileBudget() { return &m_tileBudget; }
+
+    template<typename Worker>
+    void DoForAllBaseMaps(Worker&& worker)
+    {
+        std::lock_guard<std::mutex> guard(_mapsLock);
+
+        for (auto const& itr : i_maps)
+            worker(itr.second);
+    }
 
     uint32 IncreaseScheduledScriptsCount() { return ++_scheduledScripts; }
     uint32 DecreaseScheduledScriptCount() { return --_scheduledScripts; }
@@ -154,6 +169,9 @@ private:
     InstanceIds _instanceIds;
     uint32 _nextInstanceId;
     MapUpdater m_updater;
+    GridPreloader m_gridPreloader;
+    PathfindingService m_pathfindingService;
+    TileBudget m_tileBudget;
 
     // atomic op counter for active scripts amount
     std::atomic<uint32> _scheduledScripts;
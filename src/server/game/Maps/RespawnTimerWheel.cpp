@@ -0,0 +1,146 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "RespawnTimerWheel.h"
+#include <algorithm>
+
+RespawnTimerWheel::RespawnTimerWheel(time_t now) : _current(now), _size(0)
+{
+}
+
+void RespawnTimerWheel::Reset(time_t now)
+{
+    for (uint32 level = 0; level < LEVEL_COUNT; ++level)
+        for (uint32 slot = 0; slot < SLOT_COUNT; ++slot)
+            _slots[level][slot].clear();
+
+    _overflow.clear();
+    _expired.clear();
+    _current = now;
+    _size = 0;
+}
+
+void RespawnTimerWheel::Schedule(RespawnEventType type, uint32 spawnId, time_t time)
+{
+    Insert(RespawnEvent{ time, spawnId, type });
+    ++_size;
+}
+
+void RespawnTimerWheel::Insert(RespawnEvent const& event)
+{
+    if (event.time < _current)
+    {
+        _expired.push_back(event);
+        return;
+    }
+
+    // lowest level whose slot window still reaches the event
+    for (uint32 level = 0; level < LEVEL_COUNT; ++level)
+    {
+        uint32 shift = level * SLOT_BITS;
+        if ((event.time >> shift) - (_current >> shift) < time_t(SLOT_COUNT))
+        {
+            _slots[level][(event.time >> shift) & SLOT_MASK].push_back(event);
+            return;
+        }
+    }
+
+    _overflow.push_back(event);
+}
+
+void RespawnTimerWheel::Cascade(EventList& events)
+{
+    if (events.empty())
+        return;
+
+    EventList pending;
+    pending.swap(events);
+
+    for (RespawnEvent const& event : pending)
+        Insert(event);
+}
+
+void RespawnTimerWheel::Advance(time_t now, std::vector<RespawnEvent>& due)
+{
+    std::size_t first = due.size();
+
+    Collect(now, due);
+
+    // expired events and the unsorted slots of a rebuild may be out of order
+    std::stable_sort(due.begin() + first, due.end(), [](RespawnEvent const& left, RespawnEvent const& right)
+    {
+        return left.time < right.time;
+    });
+}
+
+void RespawnTimerWheel::Collect(time_t now, std::vector<RespawnEvent>& due)
+{
+    if (!_expired.empty())
+    {
+        _size -= _expired.size();
+        due.insert(due.end(), _expired.begin(), _expired.end());
+        _expired.clear();
+    }
+
+    // clock jumped far ahead (or back), rebuild instead of stepping through every second
+    if (now < _current - 1 || now - _current > OVERFLOW_PERIOD)
+    {
+        EventList pending;
+        pending.swap(_overflow);
+        for (uint32 level = 0; level < LEVEL_COUNT; ++level)
+            for (uint32 slot = 0; slot < SLOT_COUNT; ++slot)
+                pending.insert(pending.end(), _slots[level][slot].begin(), _slots[level][slot].end());
+
+        Reset(now + 1);
+
+        for (RespawnEvent const& event : pending)
+        {
+            if (event.time <= now)
+                due.push_back(event);
+            else
+            {
+                Insert(event);
+                ++_size;
+            }
+        }
+
+        return;
+    }
+
+    for (; _current <= now; ++_current)
+    {
+        if ((_current & (OVERFLOW_PERIOD - 1)) == 0)
+            Cascade(_overflow);
+
+        // higher levels first, their events may land in the lower levels processed right after
+        for (uint32 level = LEVEL_COUNT - 1; level > 0; --level)
+        {
+            uint32 shift = level * SLOT_BITS;
+            if ((_current & ((time_t(1) << shift) - 1)) == 0)
+                Cascade(_slots[level][(_current >> shift) & SLOT_MASK]);
+        }
+
+        EventList& slot = _slots[0][_current & SLOT_MASK];
+        if (slot.empty())
+            continue;
+
+        _size -= slot.size();
+        due.insert(due.end(), slot.begin(), slot.end());
+        slot.clear();
+    }
+}
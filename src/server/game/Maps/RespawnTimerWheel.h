@@ -0,0 +1,82 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _RESPAWN_TIMER_WHEEL_H
+#define _RESPAWN_TIMER_WHEEL_H
+
+#include "Define.h"
+#include <ctime>
+#include <vector>
+
+enum RespawnEventType : uint8
+{
+    RESPAWN_EVENT_CREATURE              = 0,    // recreate a released creature
+    RESPAWN_EVENT_GAMEOBJECT            = 1,    // recreate a released gameobject
+    RESPAWN_EVENT_RELEASE_CREATURE      = 2,    // check if a dead creature can be released
+    RESPAWN_EVENT_RELEASE_GAMEOBJECT    = 3     // check if a despawned gameobject can be released
+};
+
+struct RespawnEvent
+{
+    time_t time;
+    uint32 spawnId;
+    RespawnEventType type;
+};
+
+// Hierarchical timer wheel with one second resolution.
+// Three levels of 64 slots cover a bit more than three days, anything further away
+// waits in an overflow list that is looked at every 2^18 seconds.
+// Scheduling is O(1) and Advance only touches slots that are due, so the cost of
+// keeping respawns around does not depend on how many are pending.
+// Events are never cancelled, the owner validates them once they are returned.
+class RespawnTimerWheel
+{
+public:
+    explicit RespawnTimerWheel(time_t now = 0);
+
+    void Reset(time_t now);
+
+    void Schedule(RespawnEventType type, uint32 spawnId, time_t time);
+
+    // Appends all events due up to and including now to due, in time order
+    void Advance(time_t now, std::vector<RespawnEvent>& due);
+
+    std::size_t GetSize() const { return _size; }
+
+private:
+    static constexpr uint32 SLOT_BITS = 6;
+    static constexpr uint32 SLOT_COUNT = 1 << SLOT_BITS;
+    static constexpr uint32 SLOT_MASK = SLOT_COUNT - 1;
+    static constexpr uint32 LEVEL_COUNT = 3;
+    static constexpr time_t OVERFLOW_PERIOD = time_t(1) << (SLOT_BITS * LEVEL_COUNT);
+
+    typedef std::vector<RespawnEvent> EventList;
+
+    void Collect(time_t now, std::vector<RespawnEvent>& due);
+    void Insert(RespawnEvent const& event);
+    void Cascade(EventList& events);
+
+    EventList _slots[LEVEL_COUNT][SLOT_COUNT];
+    EventList _overflow;
+    EventList _expired;
+
+    time_t _current;                                        // next second to process
+    std::size_t _size;
+};
+
+#endif
@@ -0,0 +1,182 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TileBudget.h"
+#include "GameConfig.h"
+#include "GameTime.h"
+#include "Log.h"
+#include "Map.h"
+#include "MapManager.h"
+#include "Metric.h"
+#include "MMapFactory.h"
+#include "Timer.h"
+#include "VMapFactory.h"
+#include <algorithm>
+
+#define TILE_BUDGET_CHECK_INTERVAL 5000
+
+std::size_t TileMemoryReport::GetTotal() const
+{
+    std::size_t size = 0;
+    for (uint8 i = 0; i < MAX_TILE_MEMORY_TYPES; ++i)
+        size += total[i];
+
+    return size;
+}
+
+TileBudget::TileBudget() : _checkTimer(0)
+{
+}
+
+void TileBudget::Update(uint32 diff)
+{
+    _checkTimer += diff;
+    if (_checkTimer < TILE_BUDGET_CHECK_INTERVAL)
+        return;
+
+    _checkTimer = 0;
+
+    // idle navmesh tiles are not used by any grid, they go before grids are unloaded
+    MMAP::MMapManager* mmgr = MMAP::MMapFactory::createOrGetMMapManager();
+    uint32 evictedTiles = mmgr->trimTileCache();
+    if (evictedTiles)
+        LOG_DEBUG("maps", "TileBudget: removed %u idle navmesh tiles from the tile cache", evictedTiles);
+
+    if (sMetric->IsEnabled())
+    {
+        MMAP::TileCacheStats stats;
+        mmgr->getTileCacheStats(stats);
+        WH_METRIC_VALUE("mmap_tile_cache_hits", stats.hits);
+        WH_METRIC_VALUE("mmap_tile_cache_misses", stats.misses);
+        WH_METRIC_VALUE("mmap_tile_cache_evictions", stats.evictions);
+        WH_METRIC_VALUE("mmap_tile_cache_idle_tiles", stats.idleTiles);
+        WH_METRIC_VALUE("mmap_tile_cache_idle_memory", uint64(stats.idleMemory));
+        WH_METRIC_VALUE("mmap_tile_resident_memory", uint64(stats.residentMemory));
+    }
+
+    std::size_t limit = std::size_t(CONF_GET_INT("TileBudget.MemoryLimit")) * 1024 * 1024;
+
+    // the report is always taken here, the map threads are idle and .server memory reads the copy
+    TileMemoryReport report;
+    std::vector<GridDataEntry> candidates;
+    BuildReport(report, limit ? &candidates : nullptr);
+
+    WH_METRIC_VALUE("tile_memory", uint64(report.total[TILE_MEMORY_TERRAIN]), WH_METRIC_TAG("type", "terrain"));
+    WH_METRIC_VALUE("tile_memory", uint64(report.mappedTerrain), WH_METRIC_TAG("type", "terrain_mapped"));
+    WH_METRIC_VALUE("tile_memory", uint64(report.total[TILE_MEMORY_VMAP]), WH_METRIC_TAG("type", "vmap"));
+    WH_METRIC_VALUE("tile_memory", uint64(report.total[TILE_MEMORY_MMAP]), WH_METRIC_TAG("type", "mmap"));
+
+    std::size_t total = report.GetEvictableTotal();
+    if (limit && total > limit)
+    {
+        // least recently used first
+        std::sort(candidates.begin(), candidates.end(), [](GridDataEntry const& left, GridDataEntry const& right)
+        {
+            return left.lastUsed < right.lastUsed;
+        });
+
+        uint32 now = GameTime::GetGameTimeMS();
+        uint32 minIdleTime = uint32(CONF_GET_INT("TileBudget.MinIdleTime"));
+        uint32 unloaded = 0;
+        std::size_t released = 0;
+
+        for (GridDataEntry const& entry : candidates)
+        {
+            if (total <= limit || getMSTimeDiff(entry.lastUsed, now) < minIdleTime)
+                break;
+
+            entry.map->UnloadGridData(entry.gx, entry.gy);
+            total -= std::min(total, entry.memory);
+            released += entry.memory;
+            ++unloaded;
+        }
+
+        if (unloaded)
+        {
+            LOG_INFO("maps", "TileBudget: unloaded %u idle grids (" SZFMTD " KB), tile memory now " SZFMTD " KB of " SZFMTD " KB", unloaded, released / 1024, total / 1024, limit / 1024);
+
+            report = TileMemoryReport();
+            BuildReport(report, nullptr);
+        }
+
+        if (total > limit)
+            LOG_DEBUG("maps", "TileBudget: tile memory " SZFMTD " KB still above the limit, no more idle grids to unload", total / 1024);
+
+        WH_METRIC_VALUE("tile_budget_unloaded_grids", unloaded);
+    }
+
+    std::lock_guard<std::mutex> guard(_reportLock);
+    _report = std::move(report);
+}
+
+void TileBudget::GetReport(TileMemoryReport& report) const
+{
+    std::lock_guard<std::mutex> guard(_reportLock);
+    report = _report;
+}
+
+void TileBudget::BuildReport(TileMemoryReport& report, std::vector<GridDataEntry>* candidates) const
+{
+    VMAP::IVMapManager* vmgr = VMAP::VMapFactory::createOrGetVMapManager();
+    MMAP::MMapManager* mmgr = MMAP::MMapFactory::createOrGetMMapManager();
+
+    sMapMgr->DoForAllBaseMaps([&](Map* map)
+    {
+        MapTileMemory usage;
+        usage.mapId = map->GetId();
+        usage.mapName = map->GetMapName();
+        usage.loadedGrids = 0;
+        usage.memory[TILE_MEMORY_TERRAIN] = 0;
+        usage.memory[TILE_MEMORY_VMAP] = vmgr->getMapMemoryUsage(map->GetId());
+        usage.memory[TILE_MEMORY_MMAP] = 0;
+        usage.mappedTerrain = 0;
+
+        bool canUnload = candidates && map->CanUnloadGridData();
+
+        for (int gx = 0; gx < MAX_NUMBER_OF_GRIDS; ++gx)
+        {
+            for (int gy = 0; gy < MAX_NUMBER_OF_GRIDS; ++gy)
+            {
+                std::size_t terrain = map->GetGridDataMemory(gx, gy);
+                if (!terrain)
+                    continue;
+
+                std::size_t navMesh = mmgr->getTileMemoryUsage(map->GetId(), gx, gy);
+
+                ++usage.loadedGrids;
+                usage.memory[TILE_MEMORY_TERRAIN] += terrain;
+                usage.mappedTerrain += map->GetGridDataMappedSize(gx, gy);
+                usage.memory[TILE_MEMORY_MMAP] += navMesh;
+
+                // vmap tiles are not released by Map::UnloadGridData, only terrain and navmesh count for the candidate
+                if (canUnload)
+                    candidates->push_back({ map, gx, gy, map->GetGridDataLastUsed(gx, gy), terrain + navMesh });
+            }
+        }
+
+        for (uint8 i = 0; i < MAX_TILE_MEMORY_TYPES; ++i)
+            report.total[i] += usage.memory[i];
+
+        report.mappedTerrain += usage.mappedTerrain;
+
+        if (usage.loadedGrids || usage.memory[TILE_MEMORY_VMAP])
+            report.maps.push_back(usage);
+    });
+
+    report.modelMemory = vmgr->getModelMemoryUsage();
+    report.total[TILE_MEMORY_VMAP] += report.modelMemory;
+}
@@ -0,0 +1,97 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TILE_BUDGET_H_INCLUDED
+#define _TILE_BUDGET_H_INCLUDED
+
+#include "Define.h"
+#include <mutex>
+#include <vector>
+
+class Map;
+
+enum TileMemoryType
+{
+    TILE_MEMORY_TERRAIN     = 0,
+    TILE_MEMORY_VMAP        = 1,
+    TILE_MEMORY_MMAP        = 2,
+
+    MAX_TILE_MEMORY_TYPES
+};
+
+struct MapTileMemory
+{
+    uint32 mapId;
+    char const* mapName;
+    uint32 loadedGrids;
+    std::size_t memory[MAX_TILE_MEMORY_TYPES];
+    std::size_t mappedTerrain;
+};
+
+// Terrain memory is the private memory of a grid, the decompressed copy of compressed map files.
+// Uncompressed map files are mapped from disk, their pages belong to the page cache and are
+// only reported as mappedTerrain, unloading the grid does not release them.
+struct TileMemoryReport
+{
+    TileMemoryReport() : modelMemory(0), total(), mappedTerrain(0) { }
+
+    std::vector<MapTileMemory> maps;
+    std::size_t modelMemory;                    // vmap models, shared by all maps
+    std::size_t total[MAX_TILE_MEMORY_TYPES];   // includes modelMemory in TILE_MEMORY_VMAP
+    std::size_t mappedTerrain;
+
+    // terrain and mmap memory, the part released by Map::UnloadGridData and limited by TileBudget.MemoryLimit
+    std::size_t GetEvictableTotal() const { return total[TILE_MEMORY_TERRAIN] + total[TILE_MEMORY_MMAP]; }
+    std::size_t GetTotal() const;
+};
+
+// Keeps the terrain and navmesh memory of loaded grids below TileBudget.MemoryLimit.
+// When the limit is exceeded the data of the least recently used idle grids is unloaded,
+// see Map::UnloadGridData. vmap tiles are not released that way, their models are shared
+// between tiles, so they are reported but do not count towards the limit. Only non
+// instanceable maps own their tiles exclusively, so those are the only ones whose grids are released.
+// Runs on the world thread while no map is updating, which is also where the report is taken.
+class TileBudget
+{
+public:
+    TileBudget();
+
+    void Update(uint32 diff);
+
+    // thread safe, copy of the report taken by the last Update
+    void GetReport(TileMemoryReport& report) const;
+
+private:
+    struct GridDataEntry
+    {
+        Map* map;
+        int gx;
+        int gy;
+        uint32 lastUsed;
+        std::size_t memory;
+    };
+
+    // walks the grids of all maps and the vmap and mmap managers, no map may update meanwhile
+    void BuildReport(TileMemoryReport& report, std::vector<GridDataEntry>* candidates) const;
+
+    uint32 _checkTimer;
+
+    mutable std::mutex _reportLock;
+    TileMemoryReport _report;
+};
+
+#endif // _TILE_BUDGET_H_INCLUDED
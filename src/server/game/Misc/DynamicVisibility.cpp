@@ -16,6 +16,11 @@
  */
 
 #include "DynamicVisibility.h"
+#include "DBCEnums.h"
+#include "GameConfig.h"
+#include "Metric.h"
+#include <algorithm>
+#include <cmath>
 
 uint8 DynamicVisibilityMgr::visibilitySettingsIndex = 0;
 
@@ -26,3 +31,73 @@ void DynamicVisibilityMgr::Update(uint32 sessionCount)
     else if (visibilitySettingsIndex && sessionCount < visibilitySettingsIndex * ((uint32)VISIBILITY_SETTINGS_PLAYER_INTERVAL) - 100)
         --visibilitySettingsIndex;
 }
+
+MapDynamicVisibility::MapDynamicVisibility() : _mapId(0), _instanceId(0), _mapType(0),
+    _adaptive(false), _smoothing(0.0f), _averageUpdateTime(0.0f), _loadLevel(0.0f), _adjustInterval(0), _adjustTimer(0)
+{
+    _settings = VisibilitySettings[0][0];
+}
+
+void MapDynamicVisibility::Initialize(uint32 mapId, uint32 instanceId, uint8 mapType)
+{
+    _mapId = mapId;
+    _instanceId = instanceId;
+    _mapType = mapType;
+    Adjust();
+}
+
+void MapDynamicVisibility::Update(uint32 diff, uint32 updateTime)
+{
+    // session only updates (diff 0) are not full map updates, they would pull the average down
+    if (!diff)
+        return;
+
+    _averageUpdateTime += (float(updateTime) - _averageUpdateTime) * _smoothing;
+
+    _adjustTimer += diff;
+    if (_adjustTimer < _adjustInterval)
+        return;
+
+    _adjustTimer = 0;
+    Adjust();
+}
+
+void MapDynamicVisibility::Adjust()
+{
+    // pvp maps keep the fixed settings, a late visibility update there decides fights
+    _adaptive = CONF_GET_BOOL("Visibility.Adaptive.Enable") && _mapType != MAP_BATTLEGROUND && _mapType != MAP_ARENA;
+    _adjustInterval = CONF_GET_INT("Visibility.Adaptive.AdjustInterval");
+    _smoothing = std::min(std::max(CONF_GET_FLOAT("Visibility.Adaptive.Smoothing"), 0.0f), 1.0f);
+
+    if (!_adaptive)
+    {
+        _settings.visibilityNotifyDelay = DynamicVisibilityMgr::GetVisibilityNotifyDelay(_mapType);
+        _settings.aiNotifyDelay = DynamicVisibilityMgr::GetAINotifyDelay(_mapType);
+        _settings.requiredMoveDistanceSq = DynamicVisibilityMgr::GetReqMoveDistSq(_mapType);
+        return;
+    }
+
+    // integral step: relative distance from the target, limited so one slow update does not throw the level around
+    float target = float(std::max(CONF_GET_INT("Visibility.Adaptive.TargetUpdateTime"), 1));
+    float error = std::min(std::max(_averageUpdateTime / target - 1.0f, -1.0f), 1.0f);
+    _loadLevel = std::min(std::max(_loadLevel + error * CONF_GET_FLOAT("Visibility.Adaptive.Gain"), 0.0f), 1.0f);
+
+    float curve = std::pow(_loadLevel, std::max(CONF_GET_FLOAT("Visibility.Adaptive.CurveExponent"), 0.01f));
+
+    auto interpolate = [curve](float min, float max) { return min + (std::max(max, min) - min) * curve; };
+
+    float moveDistance = interpolate(CONF_GET_FLOAT("Visibility.Adaptive.MoveDistance.Min"), CONF_GET_FLOAT("Visibility.Adaptive.MoveDistance.Max"));
+    _settings.visibilityNotifyDelay = uint32(interpolate(float(CONF_GET_INT("Visibility.Adaptive.NotifyDelay.Min")), float(CONF_GET_INT("Visibility.Adaptive.NotifyDelay.Max"))));
+    _settings.aiNotifyDelay = uint32(interpolate(float(CONF_GET_INT("Visibility.Adaptive.AINotifyDelay.Min")), float(CONF_GET_INT("Visibility.Adaptive.AINotifyDelay.Max"))));
+    _settings.requiredMoveDistanceSq = moveDistance * moveDistance;
+
+    if (!sMetric->IsEnabled())
+        return;
+
+    std::string mapId = std::to_string(_mapId);
+    std::string instanceId = std::to_string(_instanceId);
+    WH_METRIC_VALUE("map_visibility_notify_delay", _settings.visibilityNotifyDelay, WH_METRIC_TAG("map_id", mapId), WH_METRIC_TAG("instance_id", instanceId));
+    WH_METRIC_VALUE("map_ai_notify_delay", _settings.aiNotifyDelay, WH_METRIC_TAG("map_id", mapId), WH_METRIC_TAG("instance_id", instanceId));
+    WH_METRIC_VALUE("map_required_move_distance", moveDistance, WH_METRIC_TAG("map_id", mapId), WH_METRIC_TAG("instance_id", instanceId));
+    WH_METRIC_VALUE("map_update_time_avg", _averageUpdateTime, WH_METRIC_TAG("map_id", mapId), WH_METRIC_TAG("instance_id", instanceId));
+}
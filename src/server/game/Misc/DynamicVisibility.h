@@ -44,6 +44,7 @@ const VisibilitySettingData VisibilitySettings[VISIBILITY_SETTINGS_MAX_INTERVAL_
     { {1200, 550, 20.0f}, {1200, 550, 25.0f}, {1200, 550, 25.0f}, {1100, 550, 16.0f}, {300, 350, 1.0f} } // 3000+
 };
 
+// Baseline settings picked by the number of sessions, used as is when Visibility.Adaptive.Enable is off
 class DynamicVisibilityMgr
 {
 public:
@@ -55,4 +56,44 @@ protected:
     static uint8 visibilitySettingsIndex;
 };
 
+// Per map feedback controller for the visibility settings.
+// Keeps an average of the map's full update time and moves a load level between 0 and 1
+// towards the configured target update time: an idle instance settles at the minimum delays
+// and move distance, a crowded city backs off towards the maximum ones. Battlegrounds and
+// arenas always use the fixed settings of DynamicVisibilityMgr.
+// Only touched by the thread updating the map.
+class MapDynamicVisibility
+{
+public:
+    MapDynamicVisibility();
+
+    void Initialize(uint32 mapId, uint32 instanceId, uint8 mapType);
+
+    // updateTime is the time the last full map update took, in milliseconds. Updates with a diff of 0 are ignored
+    void Update(uint32 diff, uint32 updateTime);
+
+    uint32 GetVisibilityNotifyDelay() const { return _settings.visibilityNotifyDelay; }
+    uint32 GetAINotifyDelay() const { return _settings.aiNotifyDelay; }
+    float GetReqMoveDistSq() const { return _settings.requiredMoveDistanceSq; }
+
+    float GetAverageUpdateTime() const { return _averageUpdateTime; }
+    float GetLoadLevel() const { return _loadLevel; }
+    bool IsAdaptive() const { return _adaptive; }
+
+private:
+    void Adjust();
+
+    uint32 _mapId;
+    uint32 _instanceId;
+    uint8 _mapType;
+
+    VisibilitySettingData _settings;
+    bool _adaptive;
+    float _smoothing;
+    float _averageUpdateTime;
+    float _loadLevel;
+    uint32 _adjustInterval;
+    uint32 _adjustTimer;
+};
+
 #endif
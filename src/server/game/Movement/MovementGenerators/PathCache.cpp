@@ -0,0 +1,166 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PathCache.h"
+#include "GameConfig.h"
+#include "Metric.h"
+#include "Timer.h"
+#include <algorithm>
+#include <cstring>
+
+PathCache::PathCache() : _mapId(0), _instanceId(0), _size(0), _toleranceSq(0.0f), _lifetime(0),
+    _measure(false), _updateTimer(0), _hits(0), _misses(0), _rejects(0)
+{
+}
+
+void PathCache::Initialize(uint32 mapId, uint32 instanceId)
+{
+    _mapId = mapId;
+    _instanceId = instanceId;
+    LoadConfig();
+}
+
+void PathCache::LoadConfig()
+{
+    int32 size = CONF_GET_INT("Pathfinding.Cache.Size");
+    float tolerance = std::max(CONF_GET_FLOAT("Pathfinding.Cache.Tolerance"), 0.0f);
+
+    // round down to a power of two
+    uint32 newSize = 0;
+    if (size > 0)
+    {
+        newSize = 1;
+        while (newSize * 2 <= uint32(size))
+            newSize *= 2;
+    }
+
+    std::lock_guard<std::mutex> guard(_lock);
+
+    if (newSize != _size)
+    {
+        _size = newSize;
+        _entries.clear();
+        _entries.shrink_to_fit();
+    }
+
+    _toleranceSq = tolerance * tolerance;
+    _lifetime = uint32(std::max(CONF_GET_INT("Pathfinding.Cache.Lifetime"), 0));
+    _measure = sMetric->IsEnabled();
+}
+
+uint32 PathCache::Hash(dtPolyRef startPoly, dtPolyRef endPoly, uint16 includeFlags, uint16 excludeFlags)
+{
+    uint64 hash = 14695981039346656037ull;
+    hash = (hash ^ uint64(startPoly)) * 1099511628211ull;
+    hash = (hash ^ uint64(endPoly)) * 1099511628211ull;
+    hash = (hash ^ (uint64(includeFlags) << 16 | excludeFlags)) * 1099511628211ull;
+    return uint32(hash ^ (hash >> 32));
+}
+
+uint32 PathCache::Find(dtPolyRef startPoly, dtPolyRef endPoly, G3D::Vector3 const& start, G3D::Vector3 const& end,
+    uint16 includeFlags, uint16 excludeFlags, dtPolyRef* path, uint32 maxLength)
+{
+    std::lock_guard<std::mutex> guard(_lock);
+
+    if (_entries.empty())
+    {
+        if (_size)
+            ++_misses;
+
+        return 0;
+    }
+
+    Entry const& entry = _entries[Hash(startPoly, endPoly, includeFlags, excludeFlags) & (_size - 1)];
+    if (entry.path.empty() || entry.startPoly != startPoly || entry.endPoly != endPoly ||
+            entry.includeFlags != includeFlags || entry.excludeFlags != excludeFlags ||
+            getMSTimeDiff(entry.time, getMSTime()) > _lifetime || entry.path.size() > maxLength ||
+            (entry.start - start).squaredLength() > _toleranceSq || (entry.end - end).squaredLength() > _toleranceSq)
+    {
+        ++_misses;
+        return 0;
+    }
+
+    ++_hits;
+    memcpy(path, entry.path.data(), entry.path.size() * sizeof(dtPolyRef));
+    return uint32(entry.path.size());
+}
+
+void PathCache::Insert(G3D::Vector3 const& start, G3D::Vector3 const& end, uint16 includeFlags, uint16 excludeFlags,
+    dtPolyRef const* path, uint32 length)
+{
+    if (!length)
+        return;
+
+    std::lock_guard<std::mutex> guard(_lock);
+
+    if (!_size)
+        return;
+
+    if (_entries.empty())
+        _entries.resize(_size);
+
+    dtPolyRef startPoly = path[0];
+    dtPolyRef endPoly = path[length - 1];
+
+    Entry& entry = _entries[Hash(startPoly, endPoly, includeFlags, excludeFlags) & (_size - 1)];
+    entry.startPoly = startPoly;
+    entry.endPoly = endPoly;
+    entry.includeFlags = includeFlags;
+    entry.excludeFlags = excludeFlags;
+    entry.time = getMSTime();
+    entry.start = start;
+    entry.end = end;
+    entry.path.assign(path, path + length);
+}
+
+void PathCache::Reject()
+{
+    std::lock_guard<std::mutex> guard(_lock);
+    ++_rejects;
+}
+
+void PathCache::Update(uint32 diff)
+{
+    _updateTimer += diff;
+    if (_updateTimer < IN_MILLISECONDS)
+        return;
+
+    _updateTimer = 0;
+
+    uint32 hits, misses, rejects;
+    {
+        std::lock_guard<std::mutex> guard(_lock);
+        hits = _hits;
+        misses = _misses;
+        rejects = _rejects;
+        _hits = 0;
+        _misses = 0;
+        _rejects = 0;
+    }
+
+    if (_measure && (hits || misses))
+    {
+        std::string mapId = std::to_string(_mapId);
+        std::string instanceId = std::to_string(_instanceId);
+        WH_METRIC_VALUE("map_path_cache_hits", hits, WH_METRIC_TAG("map_id", mapId), WH_METRIC_TAG("instance_id", instanceId));
+        WH_METRIC_VALUE("map_path_cache_misses", misses, WH_METRIC_TAG("map_id", mapId), WH_METRIC_TAG("instance_id", instanceId));
+        WH_METRIC_VALUE("map_path_cache_hit_rate", float(hits) / float(hits + misses), WH_METRIC_TAG("map_id", mapId), WH_METRIC_TAG("instance_id", instanceId));
+        WH_METRIC_VALUE("map_path_cache_rejects", rejects, WH_METRIC_TAG("map_id", mapId), WH_METRIC_TAG("instance_id", instanceId));
+    }
+
+    LoadConfig();
+}
@@ -0,0 +1,94 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PATH_CACHE_H
+#define _PATH_CACHE_H
+
+#include "Define.h"
+#include "DetourNavMesh.h"
+#include <G3D/Vector3.h>
+#include <mutex>
+#include <vector>
+
+// Per map cache of recently found poly corridors.
+// Units chasing the same target all path from about the same place to about the same
+// spot, so a corridor found for one of them is reused for the others instead of running
+// another findPath. Entries are keyed by start and end poly and the query filter, and
+// are only handed out while both endpoints are within Pathfinding.Cache.Tolerance yards
+// of the ones the corridor was found for. The point path is always built for the exact
+// endpoints of the caller, only the corridor is shared.
+// Poly references carry the salt of their tile, so corridors through a reloaded tile
+// are caught by dtNavMeshQuery::isValidPolyRef; entries also expire after
+// Pathfinding.Cache.Lifetime milliseconds.
+// Paths are built on the pathfinding threads as well, so every access is locked.
+class PathCache
+{
+public:
+    PathCache();
+
+    void Initialize(uint32 mapId, uint32 instanceId);
+
+    // Copies a matching corridor into path (room for maxLength polys), returns its length or 0
+    uint32 Find(dtPolyRef startPoly, dtPolyRef endPoly, G3D::Vector3 const& start, G3D::Vector3 const& end,
+        uint16 includeFlags, uint16 excludeFlags, dtPolyRef* path, uint32 maxLength);
+
+    // path must lead from its first to its last poly
+    void Insert(G3D::Vector3 const& start, G3D::Vector3 const& end, uint16 includeFlags, uint16 excludeFlags,
+        dtPolyRef const* path, uint32 length);
+
+    // corridor taken from the cache turned out to be unusable
+    void Reject();
+
+    // map thread, reloads the configuration and sends the metrics once per second
+    void Update(uint32 diff);
+
+private:
+    struct Entry
+    {
+        Entry() : startPoly(0), endPoly(0), includeFlags(0), excludeFlags(0), time(0) { }
+
+        dtPolyRef startPoly;
+        dtPolyRef endPoly;
+        uint16 includeFlags;
+        uint16 excludeFlags;
+        uint32 time;
+        G3D::Vector3 start;
+        G3D::Vector3 end;
+        std::vector<dtPolyRef> path;
+    };
+
+    static uint32 Hash(dtPolyRef startPoly, dtPolyRef endPoly, uint16 includeFlags, uint16 excludeFlags);
+
+    void LoadConfig();
+
+    uint32 _mapId;
+    uint32 _instanceId;
+
+    std::mutex _lock;
+    uint32 _size;
+    float _toleranceSq;
+    uint32 _lifetime;
+    std::vector<Entry> _entries;                            // allocated on first use
+
+    bool _measure;
+    uint32 _updateTimer;
+    uint32 _hits;
+    uint32 _misses;
+    uint32 _rejects;
+};
+
+#endif
@@ -24,22 +24,23 @@
 #include "DetourCommon.h"
 #include "DetourNavMeshQuery.h"
 #include "Metric.h"
+#include "PathCache.h"
 
 ////////////////// PathGenerator //////////////////
 PathGenerator::PathGenerator(const Unit* owner) :
     _polyLength(0), _type(PATHFIND_BLANK), _useStraightPath(false),
     _forceDestination(false), _pointPathLimit(MAX_POINT_PATH_LENGTH),
-    _endPosition(G3D::Vector3::zero()), _sourceUnit(owner), _navMesh(nullptr),
-    _navMeshQuery(nullptr)
+    _endPosition(G3D::Vector3::zero()), _sourceUnit(owner), _mapId(owner->GetMapId()), _navMesh(nullptr),
+    _navMeshQuery(nullptr), _sourceIsFlying(false), _sourceCanSwim(false), _sourceCanWalk(false),
+    _startInLiquid(-1), _endInLiquid(-1), _endInWaterFar(false), _cutToFirstHigher(false), _finishPending(false), _built(true)
 {
     memset(_pathPolyRefs, 0, sizeof(_pathPolyRefs));
 
-    uint32 mapId = _sourceUnit->GetMapId();
+    uint32 mapId = _mapId;
     //if (DisableMgr::IsPathfindingEnabled(_sourceUnit->FindMap())) // pussywizard: checked before creating new PathGenerator
     {
         MMAP::MMapManager* mmap = MMAP::MMapFactory::createOrGetMMapManager();
         _navMesh = mmap->GetNavMesh(mapId);
-        _navMeshQuery = mmap->GetNavMeshQuery(mapId, _sourceUnit->GetInstanceId());
     }
 
     CreateFilter();
@@ -51,6 +52,25 @@ PathGenerator::~PathGenerator()
 
 bool PathGenerator::CalculatePath(float destX, float destY, float destZ, bool forceDest)
 {
+    switch (PreparePath(destX, destY, destZ, forceDest))
+    {
+        case PATH_PREPARE_FAILED:
+            return false;
+        case PATH_PREPARE_DONE:
+            return true;
+        default:
+            break;
+    }
+
+    BuildPath();
+    FinishPath();
+    return true;
+}
+
+PathPrepareResult PathGenerator::PreparePath(float destX, float destY, float destZ, bool forceDest)
+{
+    ASSERT(IsBuilt(), "PathGenerator reused while its path is still being built");
+
     float x, y, z;
     if (!_sourceUnit->movespline->Finalized() && _sourceUnit->movespline->Initialized())
     {
@@ -63,7 +83,7 @@ bool PathGenerator::CalculatePath(float destX, float destY, float destZ, bool fo
         _sourceUnit->GetPosition(x, y, z);
 
     if (!Warhead::IsValidMapCoord(destX, destY, destZ) || !Warhead::IsValidMapCoord(x, y, z))
-        return false;
+        return PATH_PREPARE_FAILED;
 
     WH_METRIC_EVENT("mmap_events", "CalculatePath", "");
 
@@ -87,18 +107,68 @@ bool PathGenerator::CalculatePath(float destX, float destY, float destZ, bool fo
 
     // make sure navMesh works - we can run on map w/o mmap
     // check if the start and end point have a .mmtile loaded (can we pass via not loaded tile on the way?)
-    if (!_navMesh || !_navMeshQuery || _sourceUnit->HasUnitState(UNIT_STATE_IGNORE_PATHFINDING) ||
-            _sourceUnit->GetObjectSize() >= SIZE_OF_GRIDS / 2.0f || _sourceUnit->GetExactDistSq(destX, destY, destZ) >= (SIZE_OF_GRIDS * SIZE_OF_GRIDS / 4.0f) ||
-            !HaveTile(start) || !HaveTile(dest))
+    {
+        MMAP::NavMeshQueryHolder query(MMAP::MMapFactory::createOrGetMMapManager(), _mapId);
+        if (!_navMesh || !query.GetQuery() || _sourceUnit->HasUnitState(UNIT_STATE_IGNORE_PATHFINDING) ||
+                _sourceUnit->GetObjectSize() >= SIZE_OF_GRIDS / 2.0f || _sourceUnit->GetExactDistSq(destX, destY, destZ) >= (SIZE_OF_GRIDS * SIZE_OF_GRIDS / 4.0f) ||
+                !HaveTile(start) || !HaveTile(dest))
+        {
+            BuildShortcut();
+            _type = PathType(PATHFIND_NORMAL | PATHFIND_NOT_USING_PATH);
+            //mmapLock.release();
+            return PATH_PREPARE_DONE;
+        }
+    }
+
+    // everything BuildPolyPath needs to know about the unit and the map, it may not run on the map thread
+    _sourceIsFlying = (_sourceUnit->GetUnitMovementFlags() & (MOVEMENTFLAG_CAN_FLY | MOVEMENTFLAG_FLYING)) || (_sourceUnit->HasUnitMovementFlag(MOVEMENTFLAG_DISABLE_GRAVITY) && !_sourceUnit->HasUnitMovementFlag(MOVEMENTFLAG_SWIMMING)) || (_sourceUnit->GetTypeId() == TYPEID_UNIT && ((Creature*)_sourceUnit)->CanFly());
+    _sourceCanSwim = _sourceUnit->GetTypeId() == TYPEID_UNIT ? _sourceUnit->ToCreature()->CanSwim() : true;
+    _sourceCanWalk = _sourceUnit->GetTypeId() == TYPEID_UNIT ? _sourceUnit->ToCreature()->CanWalk() : true;
+    _startInLiquid = -1;
+    _endInLiquid = -1;
+    _pathCache = _sourceUnit->GetMap()->GetPathCache();
+
+    // liquid is only checked for units that can not fly. It has to be looked up before BuildPath takes
+    // the navmesh query: GetGrid may load mmap tiles, which waits for the queries of the map to be released
+    if (!_sourceIsFlying)
+    {
+        _startInLiquid = GetLiquidState(start);
+        _endInLiquid = GetLiquidState(dest);
+    }
+
+    _finishPending = false;
+    _built.store(false, std::memory_order_relaxed);
+    return PATH_PREPARE_BUILD;
+}
+
+void PathGenerator::BuildPath()
+{
+    // the query is only ours until the path is built, so this may run on any thread
+    MMAP::NavMeshQueryHolder query(MMAP::MMapFactory::createOrGetMMapManager(), _mapId);
+    _navMeshQuery = query.GetQuery();
+
+    // navmesh got unloaded since PreparePath
+    if (!_navMeshQuery)
     {
         BuildShortcut();
         _type = PathType(PATHFIND_NORMAL | PATHFIND_NOT_USING_PATH);
-        //mmapLock.release();
-        return true;
     }
+    else
+        _finishPending = BuildPolyPath(_startPosition, _endPosition);
 
-    BuildPolyPath(start, dest);
-    return true;
+    _navMeshQuery = nullptr;
+    _built.store(true, std::memory_order_release);
+}
+
+int8 PathGenerator::GetLiquidState(G3D::Vector3 const& point) const
+{
+    return LIQUID_MAP_NO_WATER != _sourceUnit->GetBaseMap()->getLiquidStatus(point.x, point.y, point.z, MAP_ALL_LIQUIDS, nullptr) ? 1 : 0;
+}
+
+bool PathGenerator::IsInLiquid(int8 state) const
+{
+    ASSERT(state >= 0, "PathGenerator: liquid state not looked up by PreparePath");
+    return state != 0;
 }
 
 dtPolyRef PathGenerator::GetPathPolyByPosition(dtPolyRef const* polyPath, uint32 polyPathSize, float const* point, float* distance) const
@@ -180,7 +250,7 @@ G3D::Vector3 ClosestPointOnLine(const G3D::Vector3& a, const G3D::Vector3& b, co
     return a + v;
 }
 
-void PathGenerator::BuildPolyPath(G3D::Vector3 const& startPos, G3D::Vector3 const& endPos)
+bool PathGenerator::BuildPolyPath(G3D::Vector3 const& startPos, G3D::Vector3 const& endPos)
 {
     bool endInWaterFar = false;
     bool cutToFirstHigher = false;
@@ -196,9 +266,9 @@ void PathGenerator::BuildPolyPath(G3D::Vector3 const& startPos, G3D::Vector3 con
         dtPolyRef startPoly = GetPolyByLocation(startPoint, &distToStartPoly);
         dtPolyRef endPoly = GetPolyByLocation(endPoint, &distToEndPoly);
 
-        bool sourceIsFlying = (_sourceUnit->GetUnitMovementFlags() & (MOVEMENTFLAG_CAN_FLY | MOVEMENTFLAG_FLYING)) || (_sourceUnit->HasUnitMovementFlag(MOVEMENTFLAG_DISABLE_GRAVITY) && !_sourceUnit->HasUnitMovementFlag(MOVEMENTFLAG_SWIMMING)) || (_sourceUnit->GetTypeId() == TYPEID_UNIT && ((Creature*)_sourceUnit)->CanFly());
-        bool sourceCanSwim = _sourceUnit->GetTypeId() == TYPEID_UNIT ? _sourceUnit->ToCreature()->CanSwim() : true;
-        bool sourceCanWalk = _sourceUnit->GetTypeId() == TYPEID_UNIT ? _sourceUnit->ToCreature()->CanWalk() : true;
+        bool sourceIsFlying = _sourceIsFlying;
+        bool sourceCanSwim = _sourceCanSwim;
+        bool sourceCanWalk = _sourceCanWalk;
 
         // we have a hole in our mesh
         // make shortcut path and mark it as NOPATH ( with flying and swimming exception )
@@ -209,21 +279,21 @@ void PathGenerator::BuildPolyPath(G3D::Vector3 const& startPos, G3D::Vector3 con
             if (sourceIsFlying)
             {
                 _type = PathType(PATHFIND_NORMAL | PATHFIND_NOT_USING_PATH);
-                return;
+                return false;
             }
             if (sourceCanSwim)
             {
-                if ((startPoly == INVALID_POLYREF && LIQUID_MAP_NO_WATER == _sourceUnit->GetBaseMap()->getLiquidStatus(startPos.x, startPos.y, startPos.z, MAP_ALL_LIQUIDS, nullptr)) ||
-                        (endPoly == INVALID_POLYREF && LIQUID_MAP_NO_WATER == _sourceUnit->GetBaseMap()->getLiquidStatus(endPos.x, endPos.y, endPos.z, MAP_ALL_LIQUIDS, nullptr)))
+                if ((startPoly == INVALID_POLYREF && !IsInLiquid(_startInLiquid)) ||
+                        (endPoly == INVALID_POLYREF && !IsInLiquid(_endInLiquid)))
                 {
                     _type = PATHFIND_NOPATH;
-                    return;
+                    return false;
                 }
                 _type = PathType(PATHFIND_NORMAL | PATHFIND_NOT_USING_PATH);
-                return;
+                return false;
             }
             _type = PATHFIND_NOPATH;
-            return;
+            return false;
         }
 
         // we may need a better number here
@@ -235,36 +305,36 @@ void PathGenerator::BuildPolyPath(G3D::Vector3 const& startPos, G3D::Vector3 con
             {
                 BuildShortcut();
                 _type = PathType(PATHFIND_NORMAL | PATHFIND_NOT_USING_PATH);
-                return;
+                return false;
             }
             if (sourceCanSwim)
             {
-                if (LIQUID_MAP_NO_WATER == _sourceUnit->GetBaseMap()->getLiquidStatus(startPos.x, startPos.y, startPos.z, MAP_ALL_LIQUIDS, nullptr))
+                if (!IsInLiquid(_startInLiquid))
                 {
                     if (distToStartPoly > MAX_FIXABLE_Z_ERROR)
                     {
                         BuildShortcut();
                         _type = PATHFIND_NOPATH;
-                        return;
+                        return false;
                     }
 
                     if (farFromEndPoly)
                     {
-                        if (LIQUID_MAP_NO_WATER == _sourceUnit->GetBaseMap()->getLiquidStatus(endPos.x, endPos.y, endPos.z, MAP_ALL_LIQUIDS, nullptr))
+                        if (!IsInLiquid(_endInLiquid))
                         {
                             BuildShortcut();
                             _type = PATHFIND_NOPATH;
-                            return;
+                            return false;
                         }
                     }
                 }
-                else if (LIQUID_MAP_NO_WATER == _sourceUnit->GetBaseMap()->getLiquidStatus(endPos.x, endPos.y, endPos.z, MAP_ALL_LIQUIDS, nullptr))
+                else if (!IsInLiquid(_endInLiquid))
                 {
                     if (farFromEndPoly)
                     {
                         BuildShortcut();
                         _type = PATHFIND_NOPATH;
-                        return;
+                        return false;
                     }
 
                     cutToFirstHigher = true;
@@ -273,7 +343,7 @@ void PathGenerator::BuildPolyPath(G3D::Vector3 const& startPos, G3D::Vector3 con
                 {
                     BuildShortcut();
                     _type = PathType(PATHFIND_NORMAL | PATHFIND_NOT_USING_PATH);
-                    return;
+                    return false;
                 }
             }
             else
@@ -282,7 +352,7 @@ void PathGenerator::BuildPolyPath(G3D::Vector3 const& startPos, G3D::Vector3 con
                 {
                     BuildShortcut();
                     _type = PATHFIND_NOPATH;
-                    return;
+                    return false;
                 }
             }
         }
@@ -292,15 +362,15 @@ void PathGenerator::BuildPolyPath(G3D::Vector3 const& startPos, G3D::Vector3 con
             {
                 BuildShortcut();
                 _type = PathType(PATHFIND_NORMAL | PATHFIND_NOT_USING_PATH);
-                return;
+                return false;
             }
-            if (LIQUID_MAP_NO_WATER == _sourceUnit->GetBaseMap()->getLiquidStatus(endPos.x, endPos.y, endPos.z, MAP_ALL_LIQUIDS, nullptr))
+            if (!IsInLiquid(_endInLiquid))
             {
                 if (!sourceCanWalk)
                 {
                     BuildShortcut();
                     _type = PATHFIND_NOPATH;
-                    return;
+                    return false;
                 }
             }
             else
@@ -309,15 +379,15 @@ void PathGenerator::BuildPolyPath(G3D::Vector3 const& startPos, G3D::Vector3 con
                 {
                     BuildShortcut();
                     _type = PATHFIND_NOPATH;
-                    return;
+                    return false;
                 }
 
                 // if both points are in water
-                if (LIQUID_MAP_NO_WATER != _sourceUnit->GetBaseMap()->getLiquidStatus(startPos.x, startPos.y, startPos.z, MAP_ALL_LIQUIDS, nullptr))
+                if (IsInLiquid(_startInLiquid))
                 {
                     BuildShortcut();
                     _type = PathType(PATHFIND_NORMAL | PATHFIND_NOT_USING_PATH);
-                    return;
+                    return false;
                 }
 
                 endInWaterFar = true;
@@ -343,7 +413,7 @@ void PathGenerator::BuildPolyPath(G3D::Vector3 const& startPos, G3D::Vector3 con
             _type = !farFromEndPoly || endInWaterFar ? PATHFIND_NORMAL : PATHFIND_INCOMPLETE;
             _pathPolyRefs[0] = startPoly;
             _polyLength = 1;
-            return;
+            return false;
         }
 
         // look for startPoly/endPoly in current path
@@ -447,22 +517,12 @@ void PathGenerator::BuildPolyPath(G3D::Vector3 const& startPos, G3D::Vector3 con
                 // free and invalidate old path data
                 Clear();
 
-                dtStatus dtResult = _navMeshQuery->findPath(
-                                        startPoly,          // start polygon
-                                        endPoly,            // end polygon
-                                        startPoint,         // start position
-                                        endPoint,           // end position
-                                        &_filter,           // polygon search filter
-                                        _pathPolyRefs,     // [out] path
-                                        (int*)&_polyLength,
-                                        MAX_PATH_LENGTH);   // max number of polygons in output path
-
-                if (!_polyLength || dtStatusFailed(dtResult))
+                if (!FindPolyPath(startPoly, endPoly, startPoint, endPoint))
                 {
                     // only happens if we passed bad data to findPath(), or navmesh is messed up
                     BuildShortcut();
                     _type = PATHFIND_NOPATH;
-                    return;
+                    return false;
                 }
             }
         }
@@ -476,22 +536,12 @@ void PathGenerator::BuildPolyPath(G3D::Vector3 const& startPos, G3D::Vector3 con
             // free and invalidate old path data
             Clear();
 
-            dtStatus dtResult = _navMeshQuery->findPath(
-                                    startPoly,          // start polygon
-                                    endPoly,            // end polygon
-                                    startPoint,         // start position
-                                    endPoint,           // end position
-                                    &_filter,           // polygon search filter
-                                    _pathPolyRefs,     // [out] path
-                                    (int*)&_polyLength,
-                                    MAX_PATH_LENGTH);   // max number of polygons in output path
-
-            if (!_polyLength || dtStatusFailed(dtResult))
+            if (!FindPolyPath(startPoly, endPoly, startPoint, endPoint))
             {
                 // only happens if we passed bad data to findPath(), or navmesh is messed up
                 BuildShortcut();
                 _type = PATHFIND_NOPATH;
-                return;
+                return false;
             }
         }
 
@@ -507,7 +557,67 @@ void PathGenerator::BuildPolyPath(G3D::Vector3 const& startPos, G3D::Vector3 con
         // pussywizard: no mmap usage below, release mutex
     } // end of scope (mutex released in object destructor)
 
-    if (_type == PATHFIND_NORMAL && cutToFirstHigher) // starting in water, far from bottom, target is on the ground (above starting Z) -> update beginning points that are lower than starting Z
+    // the rest needs the map, see FinishPath
+    _endInWaterFar = endInWaterFar;
+    _cutToFirstHigher = cutToFirstHigher;
+    return true;
+}
+
+bool PathGenerator::FindPolyPath(dtPolyRef startPoly, dtPolyRef endPoly, float const* startPoint, float const* endPoint)
+{
+    // another unit of the map recently went about the same way
+    if (_pathCache)
+    {
+        _polyLength = _pathCache->Find(startPoly, endPoly, _startPosition, _endPosition, _filter.getIncludeFlags(), _filter.getExcludeFlags(), _pathPolyRefs, MAX_PATH_LENGTH);
+
+        for (uint32 i = 0; i < _polyLength; ++i)
+        {
+            // tile got reloaded or the corridor is closed to us
+            if (!_navMeshQuery->isValidPolyRef(_pathPolyRefs[i], &_filter))
+            {
+                _pathCache->Reject();
+                _polyLength = 0;
+                break;
+            }
+        }
+
+        if (_polyLength)
+            return true;
+    }
+
+    dtStatus dtResult = _navMeshQuery->findPath(
+                            startPoly,          // start polygon
+                            endPoly,            // end polygon
+                            startPoint,         // start position
+                            endPoint,           // end position
+                            &_filter,           // polygon search filter
+                            _pathPolyRefs,     // [out] path
+                            (int*)&_polyLength,
+                            MAX_PATH_LENGTH);   // max number of polygons in output path
+
+    if (!_polyLength || dtStatusFailed(dtResult))
+    {
+        _polyLength = 0;
+        return false;
+    }
+
+    // only whole corridors, partial results end wherever the search gave up
+    if (_pathCache && _pathPolyRefs[_polyLength - 1] == endPoly)
+        _pathCache->Insert(_startPosition, _endPosition, _filter.getIncludeFlags(), _filter.getExcludeFlags(), _pathPolyRefs, _polyLength);
+
+    return true;
+}
+
+void PathGenerator::FinishPath()
+{
+    ASSERT(IsBuilt());
+
+    if (!_finishPending)
+        return;
+
+    _finishPending = false;
+
+    if (_type == PATHFIND_NORMAL && _cutToFirstHigher) // starting in water, far from bottom, target is on the ground (above starting Z) -> update beginning points that are lower than starting Z
     {
         uint32 i = 0;
         uint32 size = _pathPoints.size();
@@ -523,7 +633,7 @@ void PathGenerator::BuildPolyPath(G3D::Vector3 const& startPos, G3D::Vector3 con
         if (uint32 lastIdx = _pathPoints.size())
         {
             lastIdx = lastIdx - 1;
-            if (endInWaterFar)
+            if (_endInWaterFar)
             {
                 SetActualEndPosition(GetEndPosition());
                 _pathPoints[lastIdx] = GetEndPosition();
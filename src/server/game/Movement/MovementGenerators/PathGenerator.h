@@ -24,7 +24,10 @@
 #include "MoveSplineInitArgs.h"
 #include "MMapFactory.h"
 #include "MMapManager.h"
+#include <atomic>
+#include <memory>
 
+class PathCache;
 class Unit;
 
 // 74*4.0f=296y  number_of_points*interval = max_path_len
@@ -54,6 +57,13 @@ enum PathType
     PATHFIND_SHORT          = 0x20,   // path is longer or equal to its limited path length
 };
 
+enum PathPrepareResult
+{
+    PATH_PREPARE_FAILED     = 0,    // invalid coordinates, nothing calculated
+    PATH_PREPARE_DONE       = 1,    // path is complete, no navmesh lookup needed
+    PATH_PREPARE_BUILD      = 2,    // call BuildPath and then FinishPath
+};
+
 class PathGenerator
 {
 public:
@@ -64,6 +74,13 @@ public:
     // return: true if new path was calculated, false otherwise (no change needed)
     bool CalculatePath(float destX, float destY, float destZ, bool forceDest = false);
 
+    // CalculatePath split up so the navmesh work can run on another thread, see PathfindingService
+    // PreparePath and FinishPath must run on the map thread, BuildPath on any thread
+    PathPrepareResult PreparePath(float destX, float destY, float destZ, bool forceDest);
+    void BuildPath();
+    void FinishPath();
+    bool IsBuilt() const { return _built.load(std::memory_order_acquire); }
+
     // option setters - use optional
     void SetUseStraightPath(bool useStraightPath) { _useStraightPath = useStraightPath; }
     void SetPathLengthLimit(float distance) { _pointPathLimit = std::min<uint32>(uint32(distance / SMOOTH_PATH_STEP_SIZE), MAX_POINT_PATH_LENGTH); }
@@ -117,8 +134,22 @@ private:
     G3D::Vector3 _actualEndPosition;    // {x, y, z} of the closest possible point to given destination
 
     Unit const* const _sourceUnit;          // the unit that is moving
+    uint32 const _mapId;
     dtNavMesh const* _navMesh;              // the nav mesh
-    dtNavMeshQuery const* _navMeshQuery;    // the nav mesh query used to find the path
+    dtNavMeshQuery const* _navMeshQuery;    // the nav mesh query used to find the path, only set inside BuildPath
+    std::shared_ptr<PathCache> _pathCache;  // corridors shared between units of the map, taken in PreparePath
+
+    // taken from the unit in PreparePath, BuildPath must not touch the unit or its map
+    bool _sourceIsFlying;
+    bool _sourceCanSwim;
+    bool _sourceCanWalk;
+    int8 _startInLiquid;                    // -1 not looked up yet
+    int8 _endInLiquid;
+
+    bool _endInWaterFar;
+    bool _cutToFirstHigher;
+    bool _finishPending;                    // BuildPolyPath got far enough to need FinishPath
+    std::atomic<bool> _built;
 
     dtQueryFilter _filter;  // use single filter for all movements, update it when needed
 
@@ -139,8 +170,11 @@ private:
     dtPolyRef GetPathPolyByPosition(dtPolyRef const* polyPath, uint32 polyPathSize, float const* Point, float* Distance = nullptr) const;
     dtPolyRef GetPolyByLocation(float* Point, float* Distance) const;
     bool HaveTile(G3D::Vector3 const& p) const;
+    int8 GetLiquidState(G3D::Vector3 const& point) const;
+    bool IsInLiquid(int8 state) const;
 
-    void BuildPolyPath(G3D::Vector3 const& startPos, G3D::Vector3 const& endPos);
+    bool BuildPolyPath(G3D::Vector3 const& startPos, G3D::Vector3 const& endPos);
+    bool FindPolyPath(dtPolyRef startPoly, dtPolyRef endPoly, float const* startPoint, float const* endPoint);
     void BuildPointPath(float const* startPoint, float const* endPoint);
     void BuildShortcut();
 
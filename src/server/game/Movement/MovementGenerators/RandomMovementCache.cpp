@@ -0,0 +1,291 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "RandomMovementCache.h"
+#include "GameConfig.h"
+#include "Log.h"
+#include "MapDefines.h"
+#include "MappedFile.h"
+#include "RandomMovementGenerator.h"
+#include "Timer.h"
+#include "World.h"
+#include <boost/filesystem/operations.hpp>
+#include <cstdio>
+#include <mutex>
+
+static uint32 const RANDOM_MOVEMENT_CACHE_MAGIC = 0x43504D52; // 'RMPC'
+static uint32 const RANDOM_MOVEMENT_CACHE_VERSION = 2;
+
+bool RandomMovementPaths::GetPath(uint16 pathIdx, Movement::PointsArray& path) const
+{
+    std::shared_lock<std::shared_mutex> lock(_lock);
+    auto itr = _paths.find(pathIdx);
+    if (itr == _paths.end())
+        return false;
+
+    path = itr->second;
+    return true;
+}
+
+void RandomMovementPaths::AddPath(uint16 pathIdx, Movement::PointsArray const& path)
+{
+    std::unique_lock<std::shared_mutex> lock(_lock);
+    _paths.try_emplace(pathIdx, path);
+}
+
+uint32 RandomMovementPaths::GetPathCount() const
+{
+    std::shared_lock<std::shared_mutex> lock(_lock);
+    return uint32(_paths.size());
+}
+
+RandomMovementCache* RandomMovementCache::instance()
+{
+    static RandomMovementCache instance;
+    return &instance;
+}
+
+bool RandomMovementCache::Matches(RandomMovementPaths const& paths, G3D::Vector3 const& initialPosition, float wanderDistance)
+{
+    return (paths.GetInitialPosition() - initialPosition).squaredLength() < 0.1f * 0.1f && G3D::fuzzyEq(paths.GetWanderDistance(), wanderDistance);
+}
+
+std::shared_ptr<RandomMovementPaths> RandomMovementCache::Get(uint32 spawnId, G3D::Vector3 const& initialPosition, float wanderDistance) const
+{
+    std::shared_lock<std::shared_mutex> lock(_lock);
+    auto itr = _spawns.find(spawnId);
+    if (itr == _spawns.end() || !Matches(*itr->second, initialPosition, wanderDistance))
+        return nullptr;
+
+    return itr->second;
+}
+
+std::shared_ptr<RandomMovementPaths> RandomMovementCache::Add(uint32 spawnId, G3D::Vector3 const& initialPosition, float wanderDistance, std::vector<G3D::Vector3> const& destinationPoints)
+{
+    std::unique_lock<std::shared_mutex> lock(_lock);
+    std::shared_ptr<RandomMovementPaths>& paths = _spawns[spawnId];
+    if (!paths || !Matches(*paths, initialPosition, wanderDistance))
+        paths = std::make_shared<RandomMovementPaths>(initialPosition, wanderDistance, destinationPoints);
+
+    return paths;
+}
+
+std::string RandomMovementCache::GetFileName()
+{
+    return sWorld->GetDataPath() + "mmaps/random_movement.cache";
+}
+
+uint64 RandomMovementCache::GetNavMeshKey()
+{
+    namespace fs = boost::filesystem;
+
+    // sum of the hashes of name, size and modification time of every navmesh file, independent of the directory order
+    uint64 key = 0;
+    boost::system::error_code error;
+    for (fs::directory_iterator itr(sWorld->GetDataPath() + "mmaps", error), end; !error && itr != end; itr.increment(error))
+    {
+        fs::path const& path = itr->path();
+        std::string extension = path.extension().string();
+        if (extension != ".mmap" && extension != ".mmtile")
+            continue;
+
+        uint64 size = uint64(fs::file_size(path, error));
+        uint64 writeTime = uint64(fs::last_write_time(path, error));
+        if (error)
+            return 0;
+
+        uint64 hash = 14695981039346656037ull;
+        for (char c : path.filename().string())
+            hash = (hash ^ uint8(c)) * 1099511628211ull;
+
+        for (uint64 value : { size, writeTime })
+            for (uint8 i = 0; i < 8; ++i)
+                hash = (hash ^ ((value >> (i * 8)) & 0xFF)) * 1099511628211ull;
+
+        key += hash;
+    }
+
+    return error ? 0 : key;
+}
+
+void RandomMovementCache::LoadFromFile()
+{
+    if (!CONF_GET_BOOL("RandomMovementCache.Persist") || CONF_GET_BOOL("DontCacheRandomMovementPaths"))
+        return;
+
+    uint32 oldMSTime = getMSTime();
+
+    // the paths saved at shutdown were built on the navmesh found now
+    _navMeshKey = GetNavMeshKey();
+
+    std::string fileName = GetFileName();
+    MappedFile file;
+    if (!file.Open(fileName))
+    {
+        LOG_INFO("server.loading", ">> Random movement path cache %s not found, paths will be built as creatures move", fileName.c_str());
+        LOG_INFO("server.loading", " ");
+        return;
+    }
+
+    MappedFileReader reader(file);
+    uint32 magic, version, mmapVersion, spawnCount;
+    uint64 navMeshKey;
+    if (!reader.Read(magic) || !reader.Read(version) || !reader.Read(mmapVersion) || !reader.Read(navMeshKey) || !reader.Read(spawnCount) ||
+        magic != RANDOM_MOVEMENT_CACHE_MAGIC || version != RANDOM_MOVEMENT_CACHE_VERSION || mmapVersion != MMAP_VERSION)
+    {
+        LOG_ERROR("server.loading", "Random movement path cache %s is outdated or broken, ignoring it", fileName.c_str());
+        return;
+    }
+
+    if (!_navMeshKey || navMeshKey != _navMeshKey)
+    {
+        LOG_INFO("server.loading", ">> Random movement path cache %s was built on other mmaps, ignoring it", fileName.c_str());
+        LOG_INFO("server.loading", " ");
+        return;
+    }
+
+    std::unordered_map<uint32, std::shared_ptr<RandomMovementPaths>> spawns;
+    uint32 pathCount = 0;
+    for (uint32 i = 0; i < spawnCount; ++i)
+    {
+        uint32 spawnId, spawnPathCount;
+        G3D::Vector3 initialPosition;
+        float wanderDistance;
+        uint8 pointCount;
+        // RandomMovementGenerator indexes the points and paths without further checks
+        if (!reader.Read(spawnId) || !reader.Read(initialPosition) || !reader.Read(wanderDistance) || !reader.Read(pointCount) ||
+            pointCount != RANDOM_POINTS_NUMBER)
+            break;
+
+        std::vector<G3D::Vector3> points(pointCount);
+        if (!reader.Read(points.data(), pointCount * sizeof(G3D::Vector3)) || !reader.Read(spawnPathCount))
+            break;
+
+        std::shared_ptr<RandomMovementPaths> paths = std::make_shared<RandomMovementPaths>(initialPosition, wanderDistance, points);
+        bool valid = true;
+        for (uint32 j = 0; j < spawnPathCount && valid; ++j)
+        {
+            uint16 pathIdx, pathSize;
+            // the generator starts from point RANDOM_POINTS_NUMBER, its initial position
+            valid = reader.Read(pathIdx) && reader.Read(pathSize) && pathIdx < (RANDOM_POINTS_NUMBER + 1) * RANDOM_POINTS_NUMBER;
+            if (!valid)
+                break;
+
+            Movement::PointsArray& path = paths->_paths[pathIdx];
+            path.resize(pathSize);
+            valid = reader.Read(path.data(), pathSize * sizeof(G3D::Vector3));
+        }
+
+        if (!valid)
+            break;
+
+        pathCount += spawnPathCount;
+        spawns[spawnId] = std::move(paths);
+    }
+
+    if (spawns.size() != spawnCount)
+    {
+        LOG_ERROR("server.loading", "Random movement path cache %s is truncated or broken, ignoring it", fileName.c_str());
+        return;
+    }
+
+    {
+        std::unique_lock<std::shared_mutex> lock(_lock);
+        _spawns = std::move(spawns);
+    }
+
+    LOG_INFO("server.loading", ">> Loaded %u random movement paths of %u spawns in %u ms", pathCount, spawnCount, GetMSTimeDiffToNow(oldMSTime));
+    LOG_INFO("server.loading", " ");
+}
+
+void RandomMovementCache::SaveToFile() const
+{
+    if (!CONF_GET_BOOL("RandomMovementCache.Persist") || CONF_GET_BOOL("DontCacheRandomMovementPaths"))
+        return;
+
+    uint32 oldMSTime = getMSTime();
+
+    // write to a temporary file first, a crash while saving must not leave a truncated cache behind
+    std::string fileName = GetFileName();
+    std::string tempFileName = fileName + ".tmp";
+    FILE* file = fopen(tempFileName.c_str(), "wb");
+    if (!file)
+    {
+        LOG_ERROR("server", "Could not write random movement path cache %s", tempFileName.c_str());
+        return;
+    }
+
+    std::shared_lock<std::shared_mutex> lock(_lock);
+
+    uint32 header[3] = { RANDOM_MOVEMENT_CACHE_MAGIC, RANDOM_MOVEMENT_CACHE_VERSION, MMAP_VERSION };
+    uint32 spawnCount = uint32(_spawns.size());
+    bool success = fwrite(header, sizeof(header), 1, file) == 1 &&
+        fwrite(&_navMeshKey, sizeof(uint64), 1, file) == 1 &&
+        fwrite(&spawnCount, sizeof(uint32), 1, file) == 1;
+
+    uint32 pathCount = 0;
+    for (auto const& itr : _spawns)
+    {
+        if (!success)
+            break;
+
+        RandomMovementPaths const& paths = *itr.second;
+        std::shared_lock<std::shared_mutex> pathsLock(paths._lock);
+
+        uint8 pointCount = uint8(paths._destinationPoints.size());
+        uint32 spawnPathCount = uint32(paths._paths.size());
+        success = fwrite(&itr.first, sizeof(uint32), 1, file) == 1 &&
+            fwrite(&paths._initialPosition, sizeof(G3D::Vector3), 1, file) == 1 &&
+            fwrite(&paths._wanderDistance, sizeof(float), 1, file) == 1 &&
+            fwrite(&pointCount, sizeof(uint8), 1, file) == 1 &&
+            fwrite(paths._destinationPoints.data(), sizeof(G3D::Vector3), pointCount, file) == pointCount &&
+            fwrite(&spawnPathCount, sizeof(uint32), 1, file) == 1;
+
+        for (auto const& path : paths._paths)
+        {
+            if (!success)
+                break;
+
+            uint16 pathSize = uint16(path.second.size());
+            success = fwrite(&path.first, sizeof(uint16), 1, file) == 1 &&
+                fwrite(&pathSize, sizeof(uint16), 1, file) == 1 &&
+                fwrite(path.second.data(), sizeof(G3D::Vector3), pathSize, file) == pathSize;
+        }
+
+        pathCount += spawnPathCount;
+    }
+
+    lock.unlock();
+
+    success = fclose(file) == 0 && success;
+
+#if WH_PLATFORM == WH_PLATFORM_WINDOWS
+    // rename does not replace existing files on windows
+    if (success)
+        std::remove(fileName.c_str());
+#endif
+
+    if (!success || std::rename(tempFileName.c_str(), fileName.c_str()) != 0)
+    {
+        LOG_ERROR("server", "Could not write random movement path cache %s", fileName.c_str());
+        std::remove(tempFileName.c_str());
+        return;
+    }
+
+    LOG_INFO("server", "Saved %u random movement paths of %u spawns in %u ms", pathCount, spawnCount, GetMSTimeDiffToNow(oldMSTime));
+}
@@ -0,0 +1,89 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _RANDOM_MOVEMENT_CACHE_H
+#define _RANDOM_MOVEMENT_CACHE_H
+
+#include "Define.h"
+#include "MoveSplineInitArgs.h"
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Random movement points and navmesh paths of one creature spawn.
+// Shared by every respawn of the spawn and its copies in other instances.
+class RandomMovementPaths
+{
+public:
+    RandomMovementPaths(G3D::Vector3 const& initialPosition, float wanderDistance, std::vector<G3D::Vector3> const& destinationPoints) :
+        _initialPosition(initialPosition), _wanderDistance(wanderDistance), _destinationPoints(destinationPoints) { }
+
+    G3D::Vector3 const& GetInitialPosition() const { return _initialPosition; }
+    float GetWanderDistance() const { return _wanderDistance; }
+    std::vector<G3D::Vector3> const& GetDestinationPoints() const { return _destinationPoints; }
+
+    // thread safe, pathIdx as used by RandomMovementGenerator
+    bool GetPath(uint16 pathIdx, Movement::PointsArray& path) const;
+    void AddPath(uint16 pathIdx, Movement::PointsArray const& path);
+    uint32 GetPathCount() const;
+
+private:
+    friend class RandomMovementCache;
+
+    G3D::Vector3 _initialPosition;
+    float _wanderDistance;
+    std::vector<G3D::Vector3> _destinationPoints;
+
+    mutable std::shared_mutex _lock;
+    std::unordered_map<uint16, Movement::PointsArray> _paths;
+};
+
+class RandomMovementCache
+{
+public:
+    static RandomMovementCache* instance();
+
+    // thread safe, returns the paths of the spawn if they were made for the same position and wander distance
+    std::shared_ptr<RandomMovementPaths> Get(uint32 spawnId, G3D::Vector3 const& initialPosition, float wanderDistance) const;
+
+    // thread safe, replaces paths made for another position or wander distance
+    // returns the stored paths, which are the ones of another thread if it was faster
+    std::shared_ptr<RandomMovementPaths> Add(uint32 spawnId, G3D::Vector3 const& initialPosition, float wanderDistance, std::vector<G3D::Vector3> const& destinationPoints);
+
+    // the file lives next to the mmaps, the paths are only valid for the navmesh they were built on:
+    // it is ignored when the names, sizes or modification times of the mmap files changed since it was saved
+    void LoadFromFile();
+    void SaveToFile() const;
+
+private:
+    RandomMovementCache() : _navMeshKey(0) { }
+
+    static bool Matches(RandomMovementPaths const& paths, G3D::Vector3 const& initialPosition, float wanderDistance);
+    static std::string GetFileName();
+    static uint64 GetNavMeshKey();
+
+    mutable std::shared_mutex _lock;
+    std::unordered_map<uint32, std::shared_ptr<RandomMovementPaths>> _spawns;
+    uint64 _navMeshKey;                                     // of the mmaps found at startup, 0 if they could not be read
+};
+
+#define sRandomMovementCache RandomMovementCache::instance()
+
+#endif // _RANDOM_MOVEMENT_CACHE_H
@@ -25,6 +25,83 @@
 #include "MoveSpline.h"
 #include "Spell.h"
 #include "GameConfig.h"
+#include <algorithm>
+
+template<>
+bool RandomMovementGenerator<Creature>::_validatePath(Creature* creature, Movement::PointsArray& finalPath, float x, float y, float z)
+{
+    if (_pathGenerator->GetPathType() & PATHFIND_NOPATH)
+        return false;
+
+    // generated path is too long
+    float pathLen = _pathGenerator->getPathLength();
+    if (pathLen * pathLen > creature->GetExactDistSq(x, y, z) * MAX_PATH_LENGHT_FACTOR * MAX_PATH_LENGHT_FACTOR)
+        return false;
+
+    finalPath = _pathGenerator->GetPath();
+
+    // no valid path
+    if (finalPath.size() < 2)
+        return false;
+
+    Map* map = creature->GetMap();
+    Movement::PointsArray::iterator itr = finalPath.begin();
+    Movement::PointsArray::iterator itrNext = finalPath.begin() + 1;
+    float zDiff, distDiff;
+
+    for (; itrNext != finalPath.end(); ++itr, ++itrNext)
+    {
+        distDiff = sqrt(((*itr).x - (*itrNext).x) * ((*itr).x - (*itrNext).x) + ((*itr).y - (*itrNext).y) * ((*itr).y - (*itrNext).y));
+        zDiff = fabs((*itr).z - (*itrNext).z);
+
+        // Xinef: tree climbing, cut as much as we can
+        if (zDiff > 2.0f ||
+                (G3D::fuzzyNe(zDiff, 0.0f) && distDiff / zDiff < 2.15f)) // ~25˚
+            return false;
+
+        if (!map->isInLineOfSight((*itr).x, (*itr).y, (*itr).z + 2.f, (*itrNext).x, (*itrNext).y, (*itrNext).z + 2.f, creature->GetPhaseMask(), LINEOFSIGHT_ALL_CHECKS))
+            return false;
+    }
+
+    return true;
+}
+
+template<>
+void RandomMovementGenerator<Creature>::_moveToPoint(Creature* creature, uint8 newPoint)
+{
+    uint16 pathIdx = uint16(_currentPoint * RANDOM_POINTS_NUMBER + newPoint);
+    Movement::PointsArray& finalPath = _preComputedPaths[pathIdx];
+
+    _currentPoint = newPoint;
+    G3D::Vector3 finalPoint = finalPath[finalPath.size() - 1];
+    _currDestPosition.Relocate(finalPoint.x, finalPoint.y, finalPoint.z);
+
+    creature->AddUnitState(UNIT_STATE_ROAMING_MOVE);
+    ++_moveCount;
+    if (roll_chance_i((int32)_moveCount * 25 + 10))
+    {
+        _moveCount = 0;
+        _nextMoveTime.Reset(urand(4000, 8000));
+    }
+
+    Movement::MoveSplineInit init(creature);
+    init.MovebyPath(finalPath);
+    init.SetWalk(true);
+    init.Launch();
+
+    // the spline has its own copy, keep a single one for all respawns of the spawn
+    if (_sharedPaths)
+    {
+        _sharedPaths->AddPath(pathIdx, finalPath);
+        _preComputedPaths.erase(pathIdx);
+    }
+    else if (CONF_GET_BOOL("DontCacheRandomMovementPaths"))
+        _preComputedPaths.erase(pathIdx);
+
+    //Call for creature group update
+    if (creature->GetFormation() && creature->GetFormation()->getLeader() == creature)
+        creature->GetFormation()->LeaderMoveTo(finalPoint.x, finalPoint.y, finalPoint.z, false);
+}
 
 template<>
 void RandomMovementGenerator<Creature>::_setRandomLocation(Creature* creature)
@@ -62,6 +139,9 @@ void RandomMovementGenerator<Creature>::_setRandomLocation(Creature* creature)
     }
 
     Movement::PointsArray& finalPath = _preComputedPaths[pathIdx];
+    if (finalPath.empty() && _sharedPaths)
+        _sharedPaths->GetPath(pathIdx, finalPath);
+
     if (finalPath.empty())
     {
         Map* map = creature->GetMap();
@@ -127,54 +207,17 @@ void RandomMovementGenerator<Creature>::_setRandomLocation(Creature* creature)
         }
         else // ground
         {
-            bool result = _pathGenerator->CalculatePath(x, y, levelZ, false);
-            if (result && !(_pathGenerator->GetPathType() & PATHFIND_NOPATH))
+            PathfindingResult result = sMapMgr->GetPathfindingService()->CalculatePath(_pathGenerator, x, y, levelZ, false);
+            if (result == PATHFINDING_QUEUED)
             {
-                // generated path is too long
-                float pathLen = _pathGenerator->getPathLength();
-                if (pathLen * pathLen > creature->GetExactDistSq(x, y, levelZ) * MAX_PATH_LENGHT_FACTOR * MAX_PATH_LENGHT_FACTOR)
-                {
-                    _validPointsVector[_currentPoint].erase(randomIter);
-                    _preComputedPaths.erase(pathIdx);
-                    return;
-                }
-
-                finalPath = _pathGenerator->GetPath();
-                Movement::PointsArray::iterator itr = finalPath.begin();
-                Movement::PointsArray::iterator itrNext = finalPath.begin() + 1;
-                float zDiff, distDiff;
-
-                for (; itrNext != finalPath.end(); ++itr, ++itrNext)
-                {
-                    distDiff = sqrt(((*itr).x - (*itrNext).x) * ((*itr).x - (*itrNext).x) + ((*itr).y - (*itrNext).y) * ((*itr).y - (*itrNext).y));
-                    zDiff = fabs((*itr).z - (*itrNext).z);
-
-                    // Xinef: tree climbing, cut as much as we can
-                    if (zDiff > 2.0f ||
-                            (G3D::fuzzyNe(zDiff, 0.0f) && distDiff / zDiff < 2.15f)) // ~25˚
-                    {
-                        _validPointsVector[_currentPoint].erase(randomIter);
-                        _preComputedPaths.erase(pathIdx);
-                        return;
-                    }
-
-                    if (!map->isInLineOfSight((*itr).x, (*itr).y, (*itr).z + 2.f, (*itrNext).x, (*itrNext).y, (*itrNext).z + 2.f, creature->GetPhaseMask(), LINEOFSIGHT_ALL_CHECKS))
-                    {
-                        _validPointsVector[_currentPoint].erase(randomIter);
-                        _preComputedPaths.erase(pathIdx);
-                        return;
-                    }
-                }
-
-                // no valid path
-                if (finalPath.size() < 2)
-                {
-                    _validPointsVector[_currentPoint].erase(randomIter);
-                    _preComputedPaths.erase(pathIdx);
-                    return;
-                }
+                // keep standing until the path is built, see DoUpdate
+                _pathPending = true;
+                _pendingPoint = newPoint;
+                _pendingDestination = G3D::Vector3(x, y, levelZ);
+                return;
             }
-            else
+
+            if (result != PATHFINDING_DONE || !_validatePath(creature, finalPath, x, y, levelZ))
             {
                 _validPointsVector[_currentPoint].erase(randomIter);
                 _preComputedPaths.erase(pathIdx);
@@ -183,29 +226,25 @@ void RandomMovementGenerator<Creature>::_setRandomLocation(Creature* creature)
         }
     }
 
-    _currentPoint = newPoint;
-    G3D::Vector3& finalPoint = finalPath[finalPath.size() - 1];
-    _currDestPosition.Relocate(finalPoint.x, finalPoint.y, finalPoint.z);
-
-    creature->AddUnitState(UNIT_STATE_ROAMING_MOVE);
-    ++_moveCount;
-    if (roll_chance_i((int32)_moveCount * 25 + 10))
-    {
-        _moveCount = 0;
-        _nextMoveTime.Reset(urand(4000, 8000));
-    }
+    _moveToPoint(creature, newPoint);
+}
 
-    Movement::MoveSplineInit init(creature);
-    init.MovebyPath(finalPath);
-    init.SetWalk(true);
-    init.Launch();
+template<>
+void RandomMovementGenerator<Creature>::_setPendingLocation(Creature* creature)
+{
+    _pathPending = false;
+    _pathGenerator->FinishPath();
 
-    if (CONF_GET_BOOL("DontCacheRandomMovementPaths"))
+    uint16 pathIdx = uint16(_currentPoint * RANDOM_POINTS_NUMBER + _pendingPoint);
+    if (!_validatePath(creature, _preComputedPaths[pathIdx], _pendingDestination.x, _pendingDestination.y, _pendingDestination.z))
+    {
+        std::vector<uint8>& points = _validPointsVector[_currentPoint];
+        points.erase(std::remove(points.begin(), points.end(), _pendingPoint), points.end());
         _preComputedPaths.erase(pathIdx);
+        return;
+    }
 
-    //Call for creature group update
-    if (creature->GetFormation() && creature->GetFormation()->getLeader() == creature)
-        creature->GetFormation()->LeaderMoveTo(finalPoint.x, finalPoint.y, finalPoint.z, false);
+    _moveToPoint(creature, _pendingPoint);
 }
 
 template<>
@@ -217,23 +256,48 @@ void RandomMovementGenerator<Creature>::DoInitialize(Creature* creature)
     if (!_wanderDistance)
         _wanderDistance = creature->GetWanderDistance();
 
-    _nextMoveTime.Reset(creature->GetDBTableGUIDLow() && creature->GetWanderDistance() == _wanderDistance ? urand(1, 5000) : 0);
+    bool spawnWanderDistance = creature->GetDBTableGUIDLow() && creature->GetWanderDistance() == _wanderDistance;
+
+    _nextMoveTime.Reset(spawnWanderDistance ? urand(1, 5000) : 0);
     _wanderDistance = std::max((creature->GetWanderDistance() == _wanderDistance && creature->GetInstanceId() == 0) ? (creature->CanFly() ? MIN_WANDER_DISTANCE_AIR : MIN_WANDER_DISTANCE_GROUND) : 0.0f, _wanderDistance);
 
     if (G3D::fuzzyEq(_initialPosition.GetExactDist2d(0.0f, 0.0f), 0.0f))
     {
         _initialPosition.Relocate(creature);
-        _destinationPoints.clear();
-        for (uint8 i = 0; i < RANDOM_POINTS_NUMBER; ++i)
+        G3D::Vector3 initialPosition(_initialPosition.GetPositionX(), _initialPosition.GetPositionY(), _initialPosition.GetPositionZ());
+
+        // creatures wandering around their spawn point share points and paths with all other respawns of the spawn
+        bool sharePaths = false;
+        if (spawnWanderDistance && !CONF_GET_BOOL("DontCacheRandomMovementPaths"))
         {
-            float angle = (M_PI * 2.0f / (float)RANDOM_POINTS_NUMBER) * i;
-            float factor = 0.5f + rand_norm() * 0.5f;
-            _destinationPoints.push_back(G3D::Vector3(_initialPosition.GetPositionX() + _wanderDistance * cos(angle)*factor, _initialPosition.GetPositionY() + _wanderDistance * sin(angle)*factor, _initialPosition.GetPositionZ()));
+            float x, y, z;
+            creature->GetRespawnPosition(x, y, z);
+            sharePaths = creature->GetExactDistSq(x, y, z) < 0.1f * 0.1f;
         }
+
+        if (sharePaths)
+            _sharedPaths = sRandomMovementCache->Get(creature->GetDBTableGUIDLow(), initialPosition, _wanderDistance);
+
+        if (!_sharedPaths)
+        {
+            _destinationPoints.clear();
+            for (uint8 i = 0; i < RANDOM_POINTS_NUMBER; ++i)
+            {
+                float angle = (M_PI * 2.0f / (float)RANDOM_POINTS_NUMBER) * i;
+                float factor = 0.5f + rand_norm() * 0.5f;
+                _destinationPoints.push_back(G3D::Vector3(_initialPosition.GetPositionX() + _wanderDistance * cos(angle)*factor, _initialPosition.GetPositionY() + _wanderDistance * sin(angle)*factor, _initialPosition.GetPositionZ()));
+            }
+
+            if (sharePaths)
+                _sharedPaths = sRandomMovementCache->Add(creature->GetDBTableGUIDLow(), initialPosition, _wanderDistance, _destinationPoints);
+        }
+
+        if (_sharedPaths)
+            _destinationPoints = _sharedPaths->GetDestinationPoints();
     }
 
     if (!_pathGenerator)
-        _pathGenerator = new PathGenerator(creature);
+        _pathGenerator = std::make_shared<PathGenerator>(creature);
     creature->AddUnitState(UNIT_STATE_ROAMING | UNIT_STATE_ROAMING_MOVE);
 }
 
@@ -285,6 +349,15 @@ bool RandomMovementGenerator<Creature>::DoUpdate(Creature* creature, const uint3
         }
     }
 
+    // path requested on an earlier update is ready
+    if (_pathPending)
+    {
+        if (!_pathGenerator->IsBuilt() || creature->_moveState != MAP_OBJECT_CELL_MOVE_NONE)
+            return true;
+
+        _setPendingLocation(creature);
+    }
+
     if (creature->movespline->Finalized())
     {
         _nextMoveTime.Update(diff);
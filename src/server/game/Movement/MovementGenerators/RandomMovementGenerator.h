@@ -19,6 +19,8 @@
 
 #include "MovementGenerator.h"
 #include "PathGenerator.h"
+#include "RandomMovementCache.h"
+#include <memory>
 
 #define RANDOM_POINTS_NUMBER        12
 #define RANDOM_LINKS_COUNT          7
@@ -30,7 +32,7 @@ template<class T>
 class RandomMovementGenerator : public MovementGeneratorMedium< T, RandomMovementGenerator<T> >
 {
 public:
-    RandomMovementGenerator(float wanderDistance = 0.0f) : _nextMoveTime(0), _moveCount(0), _wanderDistance(wanderDistance), _pathGenerator(nullptr), _currentPoint(RANDOM_POINTS_NUMBER)
+    RandomMovementGenerator(float wanderDistance = 0.0f) : _nextMoveTime(0), _moveCount(0), _wanderDistance(wanderDistance), _currentPoint(RANDOM_POINTS_NUMBER), _pathPending(false), _pendingPoint(0)
     {
         _initialPosition.Relocate(0.0f, 0.0f, 0.0f, 0.0f);
         _destinationPoints.reserve(RANDOM_POINTS_NUMBER);
@@ -48,6 +50,9 @@ public:
     }
 
     void _setRandomLocation(T*);
+    bool _validatePath(T*, Movement::PointsArray& finalPath, float x, float y, float z);
+    void _setPendingLocation(T*);
+    void _moveToPoint(T*, uint8 newPoint);
     void DoInitialize(T*);
     void DoFinalize(T*);
     void DoReset(T*);
@@ -59,11 +64,15 @@ private:
     TimeTrackerSmall _nextMoveTime;
     uint8 _moveCount;
     float _wanderDistance;
-    PathGenerator* _pathGenerator;
+    std::shared_ptr<PathGenerator> _pathGenerator;
     std::vector<G3D::Vector3> _destinationPoints;
     std::vector<uint8> _validPointsVector[RANDOM_POINTS_NUMBER + 1];
     uint8 _currentPoint;
     std::map<uint16, Movement::PointsArray> _preComputedPaths;
+    std::shared_ptr<RandomMovementPaths> _sharedPaths;  // used instead of _preComputedPaths if set
     Position _initialPosition, _currDestPosition;
+    bool _pathPending;                  // _pathGenerator is being built by the PathfindingService
+    uint8 _pendingPoint;
+    G3D::Vector3 _pendingDestination;
 };
 #endif
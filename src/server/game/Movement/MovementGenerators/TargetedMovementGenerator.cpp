@@ -31,6 +31,7 @@
 #include "MapManager.h"
 #include "DisableMgr.h"
 #include "GameTime.h"
+#include "GameConfig.h"
 #include <cmath>
 
 template<class T, typename D>
@@ -45,6 +46,10 @@ void TargetedMovementGeneratorMedium<T, D>::_setTargetLocation(T* owner, bool in
     if (owner->HasUnitState(UNIT_STATE_CASTING) && !owner->CanMoveDuringChannel())
         return;
 
+    // a path is being built for us, keep the current spline until it arrives
+    if (i_pathPending)
+        return;
+
     float x, y, z;
     bool isPlayerPet = owner->IsPet() && IS_PLAYER_GUID(owner->GetOwnerGUID());
     bool sameTransport = owner->GetTransport() && owner->GetTransport() ==  i_target->GetTransport();
@@ -147,7 +152,7 @@ void TargetedMovementGeneratorMedium<T, D>::_setTargetLocation(T* owner, bool in
     if (useMMaps) // pussywizard
     {
         if (!i_path)
-            i_path = new PathGenerator(owner);
+            i_path = std::make_shared<PathGenerator>(owner);
 
         if (!forceDest)
         {
@@ -192,28 +197,17 @@ void TargetedMovementGeneratorMedium<T, D>::_setTargetLocation(T* owner, bool in
             return;
         }
 
-        bool result = i_path->CalculatePath(x, y, z, forceDest);
-        if (result)
+        switch (sMapMgr->GetPathfindingService()->CalculatePath(i_path, x, y, z, forceDest))
         {
-            float maxDist = MELEE_RANGE + owner->GetMeleeReach() + i_target->GetMeleeReach();
-            if (!forceDest && (i_path->GetPathType() & PATHFIND_NOPATH || (!i_offset && !isPlayerPet && i_target->GetExactDistSq(i_path->GetActualEndPosition().x, i_path->GetActualEndPosition().y, i_path->GetActualEndPosition().z) > maxDist * maxDist)))
-            {
-                lastPathingFailMSTime = GameTime::GetGameTimeMS();
-                owner->m_targetsNotAcceptable[i_target->GetGUID()] = MMapTargetData(GameTime::GetGameTime() + DISALLOW_TIME_AFTER_FAIL, owner, i_target.getTarget());
+            case PATHFINDING_DONE:
+                _launchPath(owner, forceDest);
                 return;
-            }
-            else
-            {
-                owner->m_targetsNotAcceptable.erase(i_target->GetGUID());
-                owner->AddUnitState(UNIT_STATE_CHASE);
-
-                init.MovebyPath(i_path->GetPath());
-                if (i_angle == 0.f)
-                    init.SetFacing(i_target.getTarget());
-                init.SetWalk(((D*)this)->EnableWalking());
-                init.Launch();
+            case PATHFINDING_QUEUED:
+                i_pathPending = true;
+                i_pathForceDest = forceDest;
                 return;
-            }
+            default:
+                break;
         }
 
         // if failed to generate, just use normal MoveTo
@@ -231,6 +225,29 @@ void TargetedMovementGeneratorMedium<T, D>::_setTargetLocation(T* owner, bool in
     init.Launch();
 }
 
+template<class T, typename D>
+void TargetedMovementGeneratorMedium<T, D>::_launchPath(T* owner, bool forceDest)
+{
+    bool isPlayerPet = owner->IsPet() && IS_PLAYER_GUID(owner->GetOwnerGUID());
+    float maxDist = MELEE_RANGE + owner->GetMeleeReach() + i_target->GetMeleeReach();
+    if (!forceDest && (i_path->GetPathType() & PATHFIND_NOPATH || (!i_offset && !isPlayerPet && i_target->GetExactDistSq(i_path->GetActualEndPosition().x, i_path->GetActualEndPosition().y, i_path->GetActualEndPosition().z) > maxDist * maxDist)))
+    {
+        lastPathingFailMSTime = GameTime::GetGameTimeMS();
+        owner->m_targetsNotAcceptable[i_target->GetGUID()] = MMapTargetData(GameTime::GetGameTime() + DISALLOW_TIME_AFTER_FAIL, owner, i_target.getTarget());
+        return;
+    }
+
+    owner->m_targetsNotAcceptable.erase(i_target->GetGUID());
+    owner->AddUnitState(UNIT_STATE_CHASE);
+
+    Movement::MoveSplineInit init(owner);
+    init.MovebyPath(i_path->GetPath());
+    if (i_angle == 0.f)
+        init.SetFacing(i_target.getTarget());
+    init.SetWalk(((D*)this)->EnableWalking());
+    init.Launch();
+}
+
 template<class T, typename D>
 bool TargetedMovementGeneratorMedium<T, D>::DoUpdate(T* owner, uint32 time_diff)
 {
@@ -272,6 +289,15 @@ bool TargetedMovementGeneratorMedium<T, D>::DoUpdate(T* owner, uint32 time_diff)
         return true;
     }
 
+    // path requested on an earlier update is ready
+    if (i_pathPending && i_path->IsBuilt())
+    {
+        i_pathPending = false;
+        i_path->FinishPath();
+        i_targetReached = false;
+        _launchPath(owner, i_pathForceDest);
+    }
+
     i_recheckDistanceForced.Update(time_diff);
     if (i_recheckDistanceForced.Passed())
     {
@@ -302,12 +328,23 @@ bool TargetedMovementGeneratorMedium<T, D>::DoUpdate(T* owner, uint32 time_diff)
 
         float dist = (dest - G3D::Vector3(i_target->GetPositionX(), i_target->GetPositionY(), i_target->GetPositionZ())).squaredLength();
         float targetMoveDistSq = i_target->GetExactDistSq(&lastTargetXYZ);
-        if (dist >= allowed_dist_sq || (!i_offset && targetMoveDistSq >= 1.5f * 1.5f))
+        bool repath = dist >= allowed_dist_sq || (!i_offset && targetMoveDistSq >= 1.5f * 1.5f);
+
+        // while still far away, the target moving a bit hardly changes where we have to go next
+        // so only re-path once it moved away relative to the way we still have in front of us
+        if (repath && !owner->movespline->Finalized())
+        {
+            float threshold = owner->GetExactDist(dest.x, dest.y, dest.z) * CONF_GET_FLOAT("Pathfinding.Chase.RepathRatio");
+            if (std::max(dist, targetMoveDistSq) < threshold * threshold)
+                repath = false;
+        }
+
+        if (repath)
             if (targetMoveDistSq >= 0.1f * 0.1f || owner->GetExactDistSq(&lastOwnerXYZ) >= 0.1f * 0.1f)
                 _setTargetLocation(owner, false);
     }
 
-    if (owner->movespline->Finalized())
+    if (owner->movespline->Finalized() && !i_pathPending)
     {
         static_cast<D*>(this)->MovementInform(owner);
         if (i_angle == 0.f && !owner->HasInArc(0.01f, i_target.getTarget()))
@@ -23,6 +23,7 @@
 #include "Timer.h"
 #include "Unit.h"
 #include "PathGenerator.h"
+#include <memory>
 
 class TargetedMovementGeneratorBase
 {
@@ -40,24 +41,25 @@ class TargetedMovementGeneratorMedium : public MovementGeneratorMedium< T, D >,
 {
 protected:
     TargetedMovementGeneratorMedium(Unit* target, float offset, float angle) :
-        TargetedMovementGeneratorBase(target), i_path(nullptr), lastPathingFailMSTime(0),
+        TargetedMovementGeneratorBase(target), lastPathingFailMSTime(0),
         i_recheckDistance(0), i_recheckDistanceForced(2500), i_offset(offset), i_angle(angle),
-        i_recalculateTravel(false), i_targetReached(false)
+        i_recalculateTravel(false), i_targetReached(false), i_pathPending(false), i_pathForceDest(false)
     {
     }
-    ~TargetedMovementGeneratorMedium() { delete i_path; }
+    ~TargetedMovementGeneratorMedium() { }
 
 public:
     bool DoUpdate(T*, uint32);
     Unit* GetTarget() const { return i_target.getTarget(); }
 
     void unitSpeedChanged() { i_recalculateTravel = true; }
-    bool IsReachable() const { return (i_path) ? (i_path->GetPathType() & PATHFIND_NORMAL) : true; }
+    bool IsReachable() const { return (i_path && !i_pathPending) ? (i_path->GetPathType() & PATHFIND_NORMAL) : true; }
 
 protected:
     void _setTargetLocation(T* owner, bool initial);
+    void _launchPath(T* owner, bool forceDest);
 
-    PathGenerator* i_path;
+    std::shared_ptr<PathGenerator> i_path;
     uint32 lastPathingFailMSTime;
     TimeTrackerSmall i_recheckDistance;
     TimeTrackerSmall i_recheckDistanceForced;
@@ -65,6 +67,8 @@ protected:
     float i_angle;
     bool i_recalculateTravel : 1;
     bool i_targetReached : 1;
+    bool i_pathPending : 1;     // i_path is being built by the PathfindingService
+    bool i_pathForceDest : 1;
 };
 
 template<class T>
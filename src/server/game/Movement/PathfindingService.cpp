@@ -0,0 +1,100 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "PathfindingService.h"
+#include "PathGenerator.h"
+
+struct PathfindingRequest
+{
+    std::shared_ptr<PathGenerator> path;
+};
+
+PathfindingService::PathfindingService() : _cancelationToken(false), _queueSize(0)
+{
+}
+
+PathfindingService::~PathfindingService()
+{
+    Deactivate();
+}
+
+void PathfindingService::Activate(size_t numThreads)
+{
+    for (size_t i = 0; i < numThreads; ++i)
+        _workerThreads.push_back(std::thread(&PathfindingService::WorkerThread, this));
+}
+
+void PathfindingService::Deactivate()
+{
+    if (!Activated())
+        return;
+
+    _cancelationToken = true;
+
+    _queue.Cancel();
+
+    for (auto& thread : _workerThreads)
+        thread.join();
+
+    _workerThreads.clear();
+}
+
+PathfindingResult PathfindingService::CalculatePath(std::shared_ptr<PathGenerator> const& path, float destX, float destY, float destZ, bool forceDest)
+{
+    bool async = Activated();
+    switch (path->PreparePath(destX, destY, destZ, forceDest))
+    {
+        case PATH_PREPARE_FAILED:
+            return PATHFINDING_FAILED;
+        case PATH_PREPARE_DONE:
+            return PATHFINDING_DONE;
+        default:
+            break;
+    }
+
+    if (!async)
+    {
+        path->BuildPath();
+        path->FinishPath();
+        return PATHFINDING_DONE;
+    }
+
+    ++_queueSize;
+
+    // the request keeps the generator alive even if its owner is gone before the worker gets to it
+    _queue.Push(new PathfindingRequest{ path });
+    return PATHFINDING_QUEUED;
+}
+
+void PathfindingService::WorkerThread()
+{
+    while (1)
+    {
+        PathfindingRequest* request = nullptr;
+
+        _queue.WaitAndPop(request);
+        if (_cancelationToken)
+            return;
+
+        --_queueSize;
+
+        request->path->BuildPath();
+
+        delete request;
+    }
+}
@@ -0,0 +1,66 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _PATHFINDING_SERVICE_H
+#define _PATHFINDING_SERVICE_H
+
+#include "Define.h"
+#include "PCQueue.h"
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+class PathGenerator;
+struct PathfindingRequest;
+
+enum PathfindingResult
+{
+    PATHFINDING_FAILED      = 0,    // same as CalculatePath returning false
+    PATHFINDING_DONE        = 1,    // path is ready to use
+    PATHFINDING_QUEUED      = 2,    // poll PathGenerator::IsBuilt, then call PathGenerator::FinishPath on the map thread
+};
+
+// Builds navmesh paths of movement generators on worker threads, so long or complex paths
+// do not stall the map update. Every worker takes its own navmesh query out of the MMapManager pool.
+// The owner keeps its current spline until the path is built and picks the result up on its next update.
+class PathfindingService
+{
+public:
+    PathfindingService();
+    ~PathfindingService();
+
+    void Activate(size_t numThreads);
+    void Deactivate();
+    bool Activated() const { return !_workerThreads.empty(); }
+
+    // map thread, falls back to building the path right away when the service is not active
+    PathfindingResult CalculatePath(std::shared_ptr<PathGenerator> const& path, float destX, float destY, float destZ, bool forceDest = false);
+
+    uint32 GetQueueSize() const { return _queueSize; }
+
+private:
+    void WorkerThread();
+
+    ProducerConsumerQueue<PathfindingRequest*> _queue;
+    std::vector<std::thread> _workerThreads;
+    std::atomic<bool> _cancelationToken;
+    std::atomic<uint32> _queueSize;
+};
+
+#endif // _PATHFINDING_SERVICE_H
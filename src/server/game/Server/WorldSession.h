@@ -213,6 +213,7 @@ public:
     bool PlayerLoading() const { return m_playerLoading; }
     bool PlayerLogout() const { return m_playerLogout; }
     bool PlayerLogoutWithSave() const { return m_playerLogout && m_playerSave; }
+    bool HasPendingPackets() const { return !_recvQueue.empty(); }
 
     void ReadAddonsInfo(WorldPacket& data);
     void SendAddonsInfo();
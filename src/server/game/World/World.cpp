@@ -53,6 +53,7 @@
 #include "TemporarySummon.h"
 #include "WaypointMovementGenerator.h"
 #include "VMapFactory.h"
+#include "CollisionKernels.h"
 #include "MMapFactory.h"
 #include "GameEventMgr.h"
 #include "PoolMgr.h"
@@ -89,11 +90,13 @@
 #include "ServerMotd.h"
 #include "GameGraveyard.h"
 #include "GameTime.h"
+#include "UpdateFieldFlags.h"
 #include "UpdateTime.h"
 #include "GameConfig.h"
 #include "GameLocale.h"
 #include "Metric.h"
 #include "QuestTracker.h"
+#include "RandomMovementCache.h"
 #include <VMapManager2.h>
 
 std::atomic_long World::m_stopEvent = false;
@@ -512,9 +515,13 @@ void World::LoadConfigSettings(bool reload)
 
     VMAP::VMapFactory::createOrGetVMapManager()->setEnableLineOfSightCalc(enableLOS);
     VMAP::VMapFactory::createOrGetVMapManager()->setEnableHeightCalc(enableHeight);
+    MMAP::MMapFactory::createOrGetMMapManager()->setTileCacheLimit(std::size_t(std::max(CONF_GET_INT("MMap.TileCache.MemoryLimit"), 0)) * 1024 * 1024);
 
     if (!reload)
     {
+        // triangle packets are built while loading the models, so the kernel stays fixed after startup
+        VMAP::SetCollisionKernel(VMAP::CollisionKernel(std::max(0, std::min<int32>(CONF_GET_INT("vmap.collisionKernel"), VMAP::COLLISION_KERNEL_AVX2))));
+
         auto VMAPBoolToString = [](bool value)
         {
             return value ? "Enable" : "Disable";
@@ -528,6 +535,7 @@ void World::LoadConfigSettings(bool reload)
         LOG_INFO("server.loading", "> Get Height:           %s", VMAPBoolToString(enableHeight));
         LOG_INFO("server.loading", "> Indoor Check:         %s", VMAPBoolToString(enableIndoor));
         LOG_INFO("server.loading", "> Pet LOS:              %s", VMAPBoolToString(enablePetLOS));
+        LOG_INFO("server.loading", "> Collision Kernel:     %s (best supported: %s)", VMAP::GetCollisionKernelName(VMAP::GetCollisionKernel()), VMAP::GetCollisionKernelName(VMAP::GetBestCollisionKernel()));
     }
 
     if (reload)
@@ -557,6 +565,9 @@ void World::SetInitialWorldSettings()
     ///- Initialize detour memory management
     dtAllocSetCustom(dtCustomAlloc, dtCustomFree);
 
+    ///- Initialize the update fields each receiver visibility class can see
+    InitUpdateFieldVisibility();
+
     LOG_INFO("server.loading", "Initializing Scripts...");
     sScriptMgr->Initialize();
 
@@ -977,6 +988,9 @@ void World::SetInitialWorldSettings()
     LOG_INFO("server.loading", "Loading Creature Formations...");
     sFormationMgr->LoadCreatureFormations();
 
+    LOG_INFO("server.loading", "Loading Random Movement Path Cache...");
+    sRandomMovementCache->LoadFromFile();
+
     LOG_INFO("server.loading", "Loading World States...");              // must be loaded before battleground, outdoor PvP and conditions
     LoadWorldStates();
 
@@ -28,11 +28,14 @@ EndScriptData */
 #include "Chat.h"
 #include "Cell.h"
 #include "CellImpl.h"
+#include "CollisionKernels.h"
 #include "GridNotifiers.h"
 #include "GridNotifiersImpl.h"
 #include "GossipDef.h"
 #include "Language.h"
+#include "VMapFactory.h"
 
+#include <chrono>
 #include <fstream>
 
 class debug_commandscript : public CommandScript
@@ -88,6 +91,8 @@ public:
             { "itemexpire",     SEC_ADMINISTRATOR,  false, &HandleDebugItemExpireCommand,      "" },
             { "areatriggers",   SEC_ADMINISTRATOR,  false, &HandleDebugAreaTriggersCommand,    "" },
             { "los",            SEC_ADMINISTRATOR,  false, &HandleDebugLoSCommand,             "" },
+            { "terrainbench",   SEC_ADMINISTRATOR,  false, &HandleDebugTerrainBenchCommand,    "" },
+            { "collisionbench", SEC_ADMINISTRATOR,  false, &HandleDebugCollisionBenchCommand,  "" },
             { "moveflags",      SEC_ADMINISTRATOR,  false, &HandleDebugMoveflagsCommand,       "" },
             { "unitstate",      SEC_ADMINISTRATOR,  false, &HandleDebugUnitStateCommand,       "" }
         };
@@ -1353,6 +1358,154 @@ public:
         return true;
     }
 
+    static bool HandleDebugTerrainBenchCommand(ChatHandler* handler, char const* args)
+    {
+        // USAGE: .debug terrainbench [#points]
+        // Compares the scalar grid height/liquid lookups with the batched ones on random points around the player
+        uint32 count = *args ? uint32(atoi(args)) : 100000;
+        if (count < 4 || count > 10000000)
+        {
+            handler->SendSysMessage(LANG_BAD_VALUE);
+            handler->SetSentErrorMessage(true);
+            return false;
+        }
+
+        Player* player = handler->GetSession()->GetPlayer();
+        Map* map = player->GetMap();
+
+        std::vector<float> x(count), y(count), scalar(count), batched(count);
+        for (uint32 i = 0; i < count; ++i)
+        {
+            x[i] = player->GetPositionX() + frand(-50.0f, 50.0f);
+            y[i] = player->GetPositionY() + frand(-50.0f, 50.0f);
+        }
+
+        // make sure all grids are loaded before timing anything
+        map->GetGridHeights(x.data(), y.data(), batched.data(), count);
+
+        auto timeUs = [](std::chrono::steady_clock::time_point start)
+        {
+            return uint32(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+        };
+
+        auto mismatches = [&]()
+        {
+            uint32 result = 0;
+            for (uint32 i = 0; i < count; ++i)
+                if (scalar[i] != batched[i])
+                    ++result;
+            return result;
+        };
+
+        auto start = std::chrono::steady_clock::now();
+        for (uint32 i = 0; i < count; ++i)
+        {
+            GridMap* gmap = map->GetGrid(x[i], y[i]);
+            scalar[i] = gmap ? gmap->getHeight(x[i], y[i]) : INVALID_HEIGHT;
+        }
+        uint32 scalarTime = timeUs(start);
+
+        start = std::chrono::steady_clock::now();
+        map->GetGridHeights(x.data(), y.data(), batched.data(), count);
+        uint32 batchedTime = timeUs(start);
+
+        handler->PSendSysMessage("Height of %u points: scalar %u us, batched %u us, %u mismatches", count, scalarTime, batchedTime, mismatches());
+
+        start = std::chrono::steady_clock::now();
+        for (uint32 i = 0; i < count; ++i)
+            scalar[i] = map->GetWaterLevel(x[i], y[i]);
+        scalarTime = timeUs(start);
+
+        start = std::chrono::steady_clock::now();
+        map->GetWaterLevels(x.data(), y.data(), batched.data(), count);
+        batchedTime = timeUs(start);
+
+        handler->PSendSysMessage("Liquid level of %u points: scalar %u us, batched %u us, %u mismatches", count, scalarTime, batchedTime, mismatches());
+        return true;
+    }
+
+    static bool HandleDebugCollisionBenchCommand(ChatHandler* handler, char const* args)
+    {
+        // USAGE: .debug collisionbench [#rays]
+        // Compares the scalar vmap ray/triangle kernel with the SIMD one on random rays around the player
+        uint32 count = *args ? uint32(atoi(args)) : 20000;
+        if (count < 1 || count > 1000000)
+        {
+            handler->SendSysMessage(LANG_BAD_VALUE);
+            handler->SetSentErrorMessage(true);
+            return false;
+        }
+
+        Player* player = handler->GetSession()->GetPlayer();
+        uint32 mapId = player->GetMapId();
+        VMAP::IVMapManager* vmgr = VMAP::VMapFactory::createOrGetVMapManager();
+
+        VMAP::CollisionKernel configured = VMAP::GetCollisionKernel();
+        VMAP::CollisionKernel best = VMAP::GetBestCollisionKernel();
+        if (configured == VMAP::COLLISION_KERNEL_SCALAR)
+        {
+            handler->PSendSysMessage("vmap.collisionKernel is scalar, models were loaded without SIMD data (best supported: %s)", VMAP::GetCollisionKernelName(best));
+            return true;
+        }
+
+        // random segments between points around the player, both ends somewhere above the ground
+        std::vector<G3D::Vector3> from(count), to(count);
+        for (uint32 i = 0; i < count; ++i)
+        {
+            from[i] = G3D::Vector3(player->GetPositionX() + frand(-60.0f, 60.0f), player->GetPositionY() + frand(-60.0f, 60.0f), player->GetPositionZ() + frand(-5.0f, 20.0f));
+            to[i] = G3D::Vector3(player->GetPositionX() + frand(-60.0f, 60.0f), player->GetPositionY() + frand(-60.0f, 60.0f), player->GetPositionZ() + frand(-5.0f, 20.0f));
+        }
+
+        std::vector<uint8> scalarLos(count), simdLos(count);
+        std::vector<float> scalarHeight(count), simdHeight(count);
+
+        auto timeUs = [](std::chrono::steady_clock::time_point start)
+        {
+            return uint32(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+        };
+
+        // the map cache is bypassed, every query walks the vmap trees
+        auto run = [&](std::vector<uint8>& los, std::vector<float>& height, uint32& losTime, uint32& heightTime)
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (uint32 i = 0; i < count; ++i)
+                los[i] = vmgr->isInLineOfSight(mapId, from[i].x, from[i].y, from[i].z, to[i].x, to[i].y, to[i].z);
+            losTime = timeUs(start);
+
+            start = std::chrono::steady_clock::now();
+            for (uint32 i = 0; i < count; ++i)
+                height[i] = vmgr->getHeight(mapId, from[i].x, from[i].y, from[i].z, 100.0f);
+            heightTime = timeUs(start);
+        };
+
+        uint32 scalarLosTime, scalarHeightTime, simdLosTime, simdHeightTime;
+
+        // warm up the caches with the kernel the server runs with
+        run(simdLos, simdHeight, simdLosTime, simdHeightTime);
+
+        // only the queries of this thread use the scalar kernel, other maps keep running with the configured one
+        {
+            VMAP::CollisionKernelScope scalar(VMAP::COLLISION_KERNEL_SCALAR);
+            run(scalarLos, scalarHeight, scalarLosTime, scalarHeightTime);
+        }
+
+        run(simdLos, simdHeight, simdLosTime, simdHeightTime);
+
+        uint32 losMismatches = 0, heightMismatches = 0;
+        for (uint32 i = 0; i < count; ++i)
+        {
+            if (scalarLos[i] != simdLos[i])
+                ++losMismatches;
+            if (scalarHeight[i] != simdHeight[i])
+                ++heightMismatches;
+        }
+
+        char const* name = VMAP::GetCollisionKernelName(configured);
+        handler->PSendSysMessage("Line of sight of %u rays: scalar %u us, %s %u us, %u mismatches", count, scalarLosTime, name, simdLosTime, losMismatches);
+        handler->PSendSysMessage("VMap height of %u points: scalar %u us, %s %u us, %u mismatches", count, scalarHeightTime, name, simdHeightTime, heightMismatches);
+        return true;
+    }
+
     static bool HandleWPGPSCommand(ChatHandler* handler, char const* /*args*/)
     {
         Player* player = handler->GetSession()->GetPlayer();
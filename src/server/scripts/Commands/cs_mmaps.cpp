@@ -135,7 +135,8 @@ public:
 
         // calculate navmesh tile location
         dtNavMesh const* navmesh = MMAP::MMapFactory::createOrGetMMapManager()->GetNavMesh(handler->GetSession()->GetPlayer()->GetMapId());
-        dtNavMeshQuery const* navmeshquery = MMAP::MMapFactory::createOrGetMMapManager()->GetNavMeshQuery(handler->GetSession()->GetPlayer()->GetMapId(), player->GetInstanceId());
+        MMAP::NavMeshQueryHolder query(MMAP::MMapFactory::createOrGetMMapManager(), player->GetMapId());
+        dtNavMeshQuery const* navmeshquery = query.GetQuery();
         if (!navmesh || !navmeshquery)
         {
             handler->PSendSysMessage("NavMesh not loaded for current map.");
@@ -187,8 +188,7 @@ public:
     {
         uint32 mapid = handler->GetSession()->GetPlayer()->GetMapId();
         dtNavMesh const* navmesh = MMAP::MMapFactory::createOrGetMMapManager()->GetNavMesh(mapid);
-        dtNavMeshQuery const* navmeshquery = MMAP::MMapFactory::createOrGetMMapManager()->GetNavMeshQuery(mapid, handler->GetSession()->GetPlayer()->GetInstanceId());
-        if (!navmesh || !navmeshquery)
+        if (!navmesh)
         {
             handler->PSendSysMessage("NavMesh not loaded for current map.");
             return true;
@@ -251,6 +251,7 @@ public:
         handler->PSendSysMessage(" %u polygons (%u vertices)", polyCount, vertCount);
         handler->PSendSysMessage(" %u triangles (%u vertices)", triCount, triVertCount);
         handler->PSendSysMessage(" %.2f MB of data (not including pointers)", ((float)dataSize / sizeof(unsigned char)) / 1048576);
+        handler->PSendSysMessage(" %u navmesh queries allocated", manager->getNavMeshQueryCount(handler->GetSession()->GetPlayer()->GetMapId()));
 
         return true;
     }
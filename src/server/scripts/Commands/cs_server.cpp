@@ -24,7 +24,9 @@ EndScriptData */
 
 #include "Chat.h"
 #include "Config.h"
+#include "GameConfig.h"
 #include "Language.h"
+#include "MapManager.h"
 #include "ObjectAccessor.h"
 #include "GameTime.h"
 #include "UpdateTime.h"
@@ -78,6 +80,7 @@ public:
             { "idlerestart",    SEC_ADMINISTRATOR,  true,  nullptr,                                 "", serverIdleRestartCommandTable },
             { "idleshutdown",   SEC_ADMINISTRATOR,  true,  nullptr,                                 "", serverIdleShutdownCommandTable },
             { "info",           SEC_PLAYER,         true,  &HandleServerInfoCommand,                "" },
+            { "memory",         SEC_ADMINISTRATOR,  true,  &HandleServerMemoryCommand,              "" },
             { "motd",           SEC_PLAYER,         true,  &HandleServerMotdCommand,                "" },
             { "restart",        SEC_ADMINISTRATOR,  true,  nullptr,                                 "", serverRestartCommandTable },
             { "shutdown",       SEC_ADMINISTRATOR,  true,  nullptr,                                 "", serverShutdownCommandTable },
@@ -129,6 +132,25 @@ public:
 
         return true;
     }
+    // Display memory held by terrain, vmap and mmap tiles per map, as of the last tile budget check
+    static bool HandleServerMemoryCommand(ChatHandler* handler, char const* /*args*/)
+    {
+        TileMemoryReport report;
+        sMapMgr->GetTileBudget()->GetReport(report);
+
+        handler->PSendSysMessage("Tile memory in KB (terrain / mapped terrain / vmap / mmap):");
+        for (MapTileMemory const& usage : report.maps)
+            handler->PSendSysMessage("  Map %u (%s), %u grids: " SZFMTD " / " SZFMTD " / " SZFMTD " / " SZFMTD, usage.mapId, usage.mapName, usage.loadedGrids,
+                usage.memory[TILE_MEMORY_TERRAIN] / 1024, usage.mappedTerrain / 1024, usage.memory[TILE_MEMORY_VMAP] / 1024, usage.memory[TILE_MEMORY_MMAP] / 1024);
+
+        handler->PSendSysMessage("vmap models: " SZFMTD " KB", report.modelMemory / 1024);
+        handler->PSendSysMessage("Total: " SZFMTD " / " SZFMTD " / " SZFMTD " / " SZFMTD " KB",
+            report.total[TILE_MEMORY_TERRAIN] / 1024, report.mappedTerrain / 1024, report.total[TILE_MEMORY_VMAP] / 1024, report.total[TILE_MEMORY_MMAP] / 1024);
+        handler->PSendSysMessage("Terrain and mmap: " SZFMTD " KB of " SZFMTD " KB allowed (0 - no limit), mapped terrain and vmap are not budgeted",
+            report.GetEvictableTotal() / 1024, std::size_t(CONF_GET_INT("TileBudget.MemoryLimit")) * 1024);
+        return true;
+    }
+
     // Display the 'Message of the day' for the realm
     static bool HandleServerMotdCommand(ChatHandler* handler, char const* /*args*/)
     {
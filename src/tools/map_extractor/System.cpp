@@ -18,7 +18,12 @@
 #define _CRT_SECURE_NO_DEPRECATE
 
 #include <stdio.h>
+#include <atomic>
 #include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 #include <set>
 #include <cstdlib>
 
@@ -29,6 +34,7 @@
 #include <unistd.h>
 #endif
 
+#include "DataCompression.h"
 #include "dbcfile.h"
 #include "mpq_libmpq04.h"
 #include "StringFormat.h"
@@ -54,7 +60,7 @@
 #else
 #define OPEN_FLAGS (O_RDONLY | O_BINARY)
 #endif
-extern ArchiveSet gOpenArchives;
+extern thread_local ArchiveSet gOpenArchives;
 
 typedef struct
 {
@@ -64,6 +70,7 @@ typedef struct
 
 map_id* map_ids;
 uint16* LiqType;
+uint32 LiqTypeCount;
 #define MAX_PATH_LENGTH 128
 char output_path[MAX_PATH_LENGTH] = ".";
 char input_path[MAX_PATH_LENGTH] = ".";
@@ -90,6 +97,13 @@ float CONF_float_to_int16_limit = 2048.0f;   // Max accuracy = val/65536
 float CONF_flat_height_delta_limit = 0.005f; // If max - min less this value - surface is flat
 float CONF_flat_liquid_delta_limit = 0.001f; // If max - min less this value - liquid surface is flat
 
+// Number of threads converting map tiles, each opens its own MPQ handles (0 - one per core)
+uint32 CONF_threads = 1;
+// Skip tiles whose .adt and conversion settings did not change since the last run
+bool  CONF_incremental = false;
+// Store .map files in the block compressed container of DataCompression.h
+bool  CONF_compress = false;
+
 // List MPQ for extract from
 const char* CONF_mpq_list[] =
 {
@@ -151,6 +165,9 @@ void Usage(char* prg)
         "-o set output path\n"\
         "-e extract only MAP(1)/DBC(2) - standard: both(3)\n"\
         "-f height stored as int (less map size but lost some accuracy) 1 by default\n"\
+        "--threads N convert map tiles on N threads (0 - one per core) 1 by default\n"\
+        "--incremental only convert tiles whose source changed since the last run\n"\
+        "--compress store compressed .map files, decompressed by the server on load\n"\
         "Example: %s -f 0 -i \"c:\\games\\game\"", prg, prg);
     exit(1);
 }
@@ -167,6 +184,27 @@ void HandleArgs(int argc, char* arg[])
         if(arg[c][0] != '-')
             Usage(arg[0]);
 
+        if (!strcmp(arg[c], "--threads"))
+        {
+            if (c + 1 < argc)
+                CONF_threads = uint32(atoi(arg[++c]));
+            else
+                Usage(arg[0]);
+            continue;
+        }
+
+        if (!strcmp(arg[c], "--incremental"))
+        {
+            CONF_incremental = true;
+            continue;
+        }
+
+        if (!strcmp(arg[c], "--compress"))
+        {
+            CONF_compress = true;
+            continue;
+        }
+
         switch(arg[c][1])
         {
             case 'i':
@@ -272,6 +310,7 @@ void ReadLiquidTypeTableDBC()
 
     size_t liqTypeCount = dbc.getRecordCount();
     size_t liqTypeMaxId = dbc.getMaxId();
+    LiqTypeCount = uint32(liqTypeMaxId + 1);
     LiqType = new uint16[liqTypeMaxId + 1];
     memset(LiqType, 0xff, (liqTypeMaxId + 1) * sizeof(uint16));
 
@@ -287,7 +326,7 @@ void ReadLiquidTypeTableDBC()
 
 // Map file format data
 static char const* MAP_MAGIC         = "MAPS";
-static char const* MAP_VERSION_MAGIC = "v1.8";
+static char const* MAP_VERSION_MAGIC = "v1.9";
 static char const* MAP_AREA_MAGIC    = "AREA";
 static char const* MAP_HEIGHT_MAGIC  = "MHGT";
 static char const* MAP_LIQUID_MAGIC  = "MLIQ";
@@ -307,6 +346,25 @@ struct map_fileheader
     uint32 holesSize;
 };
 
+// Every section, section header and data array starts on this boundary,
+// the server memory maps .map files and reads them in place
+#define MAP_SECTION_ALIGNMENT 16
+
+uint32 MapAlignedSize(uint32 size)
+{
+    return (size + MAP_SECTION_ALIGNMENT - 1) & ~uint32(MAP_SECTION_ALIGNMENT - 1);
+}
+
+// Writes data and pads the output up to the next MAP_SECTION_ALIGNMENT boundary
+void WriteAligned(void const* data, uint32 size, FILE* output)
+{
+    static uint8 const padding[MAP_SECTION_ALIGNMENT] = { };
+
+    fwrite(data, size, 1, output);
+    if (uint32 padSize = MapAlignedSize(size) - size)
+        fwrite(padding, padSize, 1, output);
+}
+
 #define MAP_AREA_NO_AREA      0x0001
 
 struct map_areaHeader
@@ -362,31 +420,26 @@ float selectUInt16StepStore(float maxDiff)
 {
     return 65535 / maxDiff;
 }
-// Temporary grid data store
-uint16 area_ids[ADT_CELLS_PER_GRID][ADT_CELLS_PER_GRID];
+// Temporary grid data store, one per converting thread
+thread_local uint16 area_ids[ADT_CELLS_PER_GRID][ADT_CELLS_PER_GRID];
 
-float V8[ADT_GRID_SIZE][ADT_GRID_SIZE];
-float V9[ADT_GRID_SIZE + 1][ADT_GRID_SIZE + 1];
-uint16 uint16_V8[ADT_GRID_SIZE][ADT_GRID_SIZE];
-uint16 uint16_V9[ADT_GRID_SIZE + 1][ADT_GRID_SIZE + 1];
-uint8  uint8_V8[ADT_GRID_SIZE][ADT_GRID_SIZE];
-uint8  uint8_V9[ADT_GRID_SIZE + 1][ADT_GRID_SIZE + 1];
+thread_local float V8[ADT_GRID_SIZE][ADT_GRID_SIZE];
+thread_local float V9[ADT_GRID_SIZE + 1][ADT_GRID_SIZE + 1];
+thread_local uint16 uint16_V8[ADT_GRID_SIZE][ADT_GRID_SIZE];
+thread_local uint16 uint16_V9[ADT_GRID_SIZE + 1][ADT_GRID_SIZE + 1];
+thread_local uint8  uint8_V8[ADT_GRID_SIZE][ADT_GRID_SIZE];
+thread_local uint8  uint8_V9[ADT_GRID_SIZE + 1][ADT_GRID_SIZE + 1];
 
-uint16 liquid_entry[ADT_CELLS_PER_GRID][ADT_CELLS_PER_GRID];
-uint8 liquid_flags[ADT_CELLS_PER_GRID][ADT_CELLS_PER_GRID];
-bool  liquid_show[ADT_GRID_SIZE][ADT_GRID_SIZE];
-float liquid_height[ADT_GRID_SIZE + 1][ADT_GRID_SIZE + 1];
+thread_local uint16 liquid_entry[ADT_CELLS_PER_GRID][ADT_CELLS_PER_GRID];
+thread_local uint8 liquid_flags[ADT_CELLS_PER_GRID][ADT_CELLS_PER_GRID];
+thread_local bool  liquid_show[ADT_GRID_SIZE][ADT_GRID_SIZE];
+thread_local float liquid_height[ADT_GRID_SIZE + 1][ADT_GRID_SIZE + 1];
 
-int16 flight_box_max[3][3];
-int16 flight_box_min[3][3];
+thread_local int16 flight_box_max[3][3];
+thread_local int16 flight_box_min[3][3];
 
-bool ConvertADT(std::string const& inputPath, std::string const& outputPath, int /*cell_y*/, int /*cell_x*/, uint32 build)
+bool ConvertADT(ADT_file& adt, std::string const& inputPath, std::string const& outputPath, uint32 build)
 {
-    ADT_file adt;
-
-    if (!adt.loadFile(inputPath))
-        return false;
-
     adt_MCIN* cells = adt.a_grid->getMCIN();
     if (!cells)
     {
@@ -426,8 +479,8 @@ bool ConvertADT(std::string const& inputPath, std::string const& outputPath, int
         }
     }
 
-    map.areaMapOffset = sizeof(map);
-    map.areaMapSize   = sizeof(map_areaHeader);
+    map.areaMapOffset = MapAlignedSize(sizeof(map));
+    map.areaMapSize   = MapAlignedSize(sizeof(map_areaHeader));
 
     map_areaHeader areaHeader;
     areaHeader.fourcc = *reinterpret_cast<uint32 const*>(MAP_AREA_MAGIC);
@@ -435,7 +488,7 @@ bool ConvertADT(std::string const& inputPath, std::string const& outputPath, int
     if (fullAreaData)
     {
         areaHeader.gridArea = 0;
-        map.areaMapSize += sizeof(area_ids);
+        map.areaMapSize += MapAlignedSize(sizeof(area_ids));
     }
     else
     {
@@ -564,7 +617,7 @@ bool ConvertADT(std::string const& inputPath, std::string const& outputPath, int
     }
 
     map.heightMapOffset = map.areaMapOffset + map.areaMapSize;
-    map.heightMapSize = sizeof(map_heightHeader);
+    map.heightMapSize = MapAlignedSize(sizeof(map_heightHeader));
 
     map_heightHeader heightHeader;
     heightHeader.fourcc = *reinterpret_cast<uint32 const*>(MAP_HEIGHT_MAGIC);
@@ -582,7 +635,7 @@ bool ConvertADT(std::string const& inputPath, std::string const& outputPath, int
     if (hasFlightBox)
     {
         heightHeader.flags |= MAP_HEIGHT_HAS_FLIGHT_BOUNDS;
-        map.heightMapSize += sizeof(flight_box_max) + sizeof(flight_box_min);
+        map.heightMapSize += MapAlignedSize(sizeof(flight_box_max)) + MapAlignedSize(sizeof(flight_box_min));
     }
 
     // Try store as packed in uint16 or uint8 values
@@ -614,7 +667,7 @@ bool ConvertADT(std::string const& inputPath, std::string const& outputPath, int
             for (int y = 0; y <= ADT_GRID_SIZE; y++)
                 for (int x = 0; x <= ADT_GRID_SIZE; x++)
                     uint8_V9[y][x] = uint8((V9[y][x] - minHeight) * step + 0.5f);
-            map.heightMapSize += sizeof(uint8_V9) + sizeof(uint8_V8);
+            map.heightMapSize += MapAlignedSize(sizeof(uint8_V9)) + MapAlignedSize(sizeof(uint8_V8));
         }
         else if (heightHeader.flags & MAP_HEIGHT_AS_INT16)
         {
@@ -624,10 +677,10 @@ bool ConvertADT(std::string const& inputPath, std::string const& outputPath, int
             for (int y = 0; y <= ADT_GRID_SIZE; y++)
                 for (int x = 0; x <= ADT_GRID_SIZE; x++)
                     uint16_V9[y][x] = uint16((V9[y][x] - minHeight) * step + 0.5f);
-            map.heightMapSize += sizeof(uint16_V9) + sizeof(uint16_V8);
+            map.heightMapSize += MapAlignedSize(sizeof(uint16_V9)) + MapAlignedSize(sizeof(uint16_V8));
         }
         else
-            map.heightMapSize += sizeof(V9) + sizeof(V8);
+            map.heightMapSize += MapAlignedSize(sizeof(V9)) + MapAlignedSize(sizeof(V8));
     }
 
     // Get from MCLQ chunk (old)
@@ -821,7 +874,7 @@ bool ConvertADT(std::string const& inputPath, std::string const& outputPath, int
             }
         }
         map.liquidMapOffset = map.heightMapOffset + map.heightMapSize;
-        map.liquidMapSize = sizeof(map_liquidHeader);
+        map.liquidMapSize = MapAlignedSize(sizeof(map_liquidHeader));
         liquidHeader.fourcc = *(uint32 const*)MAP_LIQUID_MAGIC;
         liquidHeader.flags = 0;
         liquidHeader.liquidType = 0;
@@ -844,10 +897,10 @@ bool ConvertADT(std::string const& inputPath, std::string const& outputPath, int
         if (liquidHeader.flags & MAP_LIQUID_NO_TYPE)
             liquidHeader.liquidType = type;
         else
-            map.liquidMapSize += sizeof(liquid_entry) + sizeof(liquid_flags);
+            map.liquidMapSize += MapAlignedSize(sizeof(liquid_entry)) + MapAlignedSize(sizeof(liquid_flags));
 
         if (!(liquidHeader.flags & MAP_LIQUID_NO_HEIGHT))
-            map.liquidMapSize += sizeof(float) * liquidHeader.width * liquidHeader.height;
+            map.liquidMapSize += MapAlignedSize(sizeof(float) * liquidHeader.width * liquidHeader.height);
     }
 
     // map hole info
@@ -886,68 +939,203 @@ bool ConvertADT(std::string const& inputPath, std::string const& outputPath, int
         printf("Can't create the output file '%s'\n", outputPath.c_str());
         return false;
     }
-    fwrite(&map, sizeof(map), 1, output);
+    WriteAligned(&map, sizeof(map), output);
     // Store area data
-    fwrite(&areaHeader, sizeof(areaHeader), 1, output);
+    WriteAligned(&areaHeader, sizeof(areaHeader), output);
     if (!(areaHeader.flags & MAP_AREA_NO_AREA))
-        fwrite(area_ids, sizeof(area_ids), 1, output);
+        WriteAligned(area_ids, sizeof(area_ids), output);
 
     // Store height data
-    fwrite(&heightHeader, sizeof(heightHeader), 1, output);
+    WriteAligned(&heightHeader, sizeof(heightHeader), output);
     if (!(heightHeader.flags & MAP_HEIGHT_NO_HEIGHT))
     {
         if (heightHeader.flags & MAP_HEIGHT_AS_INT16)
         {
-            fwrite(uint16_V9, sizeof(uint16_V9), 1, output);
-            fwrite(uint16_V8, sizeof(uint16_V8), 1, output);
+            WriteAligned(uint16_V9, sizeof(uint16_V9), output);
+            WriteAligned(uint16_V8, sizeof(uint16_V8), output);
         }
         else if (heightHeader.flags & MAP_HEIGHT_AS_INT8)
         {
-            fwrite(uint8_V9, sizeof(uint8_V9), 1, output);
-            fwrite(uint8_V8, sizeof(uint8_V8), 1, output);
+            WriteAligned(uint8_V9, sizeof(uint8_V9), output);
+            WriteAligned(uint8_V8, sizeof(uint8_V8), output);
         }
         else
         {
-            fwrite(V9, sizeof(V9), 1, output);
-            fwrite(V8, sizeof(V8), 1, output);
+            WriteAligned(V9, sizeof(V9), output);
+            WriteAligned(V8, sizeof(V8), output);
         }
     }
 
     if (heightHeader.flags & MAP_HEIGHT_HAS_FLIGHT_BOUNDS)
     {
-        fwrite(flight_box_max, sizeof(flight_box_max), 1, output);
-        fwrite(flight_box_min, sizeof(flight_box_min), 1, output);
+        WriteAligned(flight_box_max, sizeof(flight_box_max), output);
+        WriteAligned(flight_box_min, sizeof(flight_box_min), output);
     }
 
     // Store liquid data if need
     if (map.liquidMapOffset)
     {
-        fwrite(&liquidHeader, sizeof(liquidHeader), 1, output);
+        WriteAligned(&liquidHeader, sizeof(liquidHeader), output);
         if (!(liquidHeader.flags & MAP_LIQUID_NO_TYPE))
         {
-            fwrite(liquid_entry, sizeof(liquid_entry), 1, output);
-            fwrite(liquid_flags, sizeof(liquid_flags), 1, output);
+            WriteAligned(liquid_entry, sizeof(liquid_entry), output);
+            WriteAligned(liquid_flags, sizeof(liquid_flags), output);
         }
         if (!(liquidHeader.flags & MAP_LIQUID_NO_HEIGHT))
         {
+            std::vector<float> liquidMap(liquidHeader.width * liquidHeader.height);
             for (int y = 0; y < liquidHeader.height; y++)
-                fwrite(&liquid_height[y + liquidHeader.offsetY][liquidHeader.offsetX], sizeof(float), liquidHeader.width, output);
+                memcpy(&liquidMap[y * liquidHeader.width], &liquid_height[y + liquidHeader.offsetY][liquidHeader.offsetX], sizeof(float) * liquidHeader.width);
+            WriteAligned(liquidMap.data(), uint32(sizeof(float) * liquidMap.size()), output);
         }
     }
 
     // store hole data
     if (hasHoles)
-        fwrite(holes, map.holesSize, 1, output);
+        WriteAligned(holes, map.holesSize, output);
 
     fclose(output);
 
+    if (CONF_compress)
+    {
+        // one block run per section, the server can read the header alone
+        std::vector<uint32> sections = { map.areaMapOffset, map.heightMapOffset };
+        if (map.liquidMapOffset)
+            sections.push_back(map.liquidMapOffset);
+        if (hasHoles)
+            sections.push_back(map.holesOffset);
+
+        if (!Warhead::DataCompression::CompressFile(outputPath, sections))
+        {
+            printf("Can't compress the output file '%s'\n", outputPath.c_str());
+            return false;
+        }
+    }
+
     return true;
 }
 
-void ExtractMapsFromMpq(uint32 build)
+void LoadLocaleMPQFiles(int const locale);
+void LoadCommonMPQFiles();
+inline void CloseMPQFiles();
+
+struct MapTile
+{
+    uint32 mapIndex;                        // into map_ids
+    uint32 x;
+    uint32 y;
+};
+
+// mapId, y, x as in the .map file name
+typedef std::unordered_map<uint32, uint64> TileChecksumMap;
+
+uint32 TileChecksumKey(uint32 mapId, uint32 y, uint32 x)
+{
+    return mapId << 16 | y << 8 | x;
+}
+
+// FNV-1a, only has to notice changes between two runs
+uint64 Checksum(void const* data, size_t size, uint64 hash = 14695981039346656037ull)
+{
+    uint8 const* bytes = static_cast<uint8 const*>(data);
+    for (size_t i = 0; i < size; ++i)
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+
+    return hash;
+}
+
+// Everything a .map file depends on besides its .adt
+uint64 SettingsChecksum(uint32 build)
+{
+    uint64 hash = Checksum(MAP_VERSION_MAGIC, 4);
+    hash = Checksum(&build, sizeof(build), hash);
+    hash = Checksum(&CONF_allow_height_limit, sizeof(CONF_allow_height_limit), hash);
+    hash = Checksum(&CONF_use_minHeight, sizeof(CONF_use_minHeight), hash);
+    hash = Checksum(&CONF_allow_float_to_int, sizeof(CONF_allow_float_to_int), hash);
+    hash = Checksum(&CONF_float_to_int8_limit, sizeof(CONF_float_to_int8_limit), hash);
+    hash = Checksum(&CONF_float_to_int16_limit, sizeof(CONF_float_to_int16_limit), hash);
+    hash = Checksum(&CONF_flat_height_delta_limit, sizeof(CONF_flat_height_delta_limit), hash);
+    hash = Checksum(&CONF_flat_liquid_delta_limit, sizeof(CONF_flat_liquid_delta_limit), hash);
+    hash = Checksum(&CONF_compress, sizeof(CONF_compress), hash);
+    return Checksum(LiqType, LiqTypeCount * sizeof(uint16), hash);
+}
+
+void LoadTileChecksums(std::string const& fileName, TileChecksumMap& checksums)
+{
+    FILE* input = fopen(fileName.c_str(), "r");
+    if (!input)
+        return;
+
+    uint32 mapId, y, x;
+    unsigned long long checksum;
+    while (fscanf(input, "%u %u %u %llx", &mapId, &y, &x, &checksum) == 4)
+        checksums[TileChecksumKey(mapId, y, x)] = uint64(checksum);
+
+    fclose(input);
+}
+
+void SaveTileChecksums(std::string const& fileName, std::vector<MapTile> const& tiles, std::vector<uint64> const& checksums)
+{
+    std::string tempFileName = fileName + ".tmp";
+    FILE* output = fopen(tempFileName.c_str(), "w");
+    if (!output)
+    {
+        printf("Can't create the checksum file '%s'\n", tempFileName.c_str());
+        return;
+    }
+
+    for (size_t i = 0; i < tiles.size(); ++i)
+        if (checksums[i])
+            fprintf(output, "%u %u %u %016llx\n", map_ids[tiles[i].mapIndex].id, tiles[i].y, tiles[i].x, (unsigned long long)checksums[i]);
+
+    fclose(output);
+
+    remove(fileName.c_str());
+    if (rename(tempFileName.c_str(), fileName.c_str()) != 0)
+        printf("Can't write the checksum file '%s'\n", fileName.c_str());
+}
+
+// Converts tiles handed out through nextTile until none are left, checksums[i] is 0 for tiles that failed
+void ExtractMapTiles(std::vector<MapTile> const& tiles, std::atomic<size_t>& nextTile, std::atomic<size_t>& doneTiles, std::atomic<size_t>& skippedTiles,
+    TileChecksumMap const& oldChecksums, std::vector<uint64>& checksums, uint64 settingsChecksum, uint32 build)
+{
+    static std::mutex progressLock;
+
+    for (size_t i = nextTile++; i < tiles.size(); i = nextTile++)
+    {
+        MapTile const& tile = tiles[i];
+        map_id const& map = map_ids[tile.mapIndex];
+        std::string mpqFileName = Warhead::StringFormat("World\\Maps\\%s\\%s_%u_%u.adt", map.name, map.name, tile.x, tile.y);
+        std::string outputFileName = Warhead::StringFormat("%s/maps/%03u%02u%02u.map", output_path, map.id, tile.y, tile.x);
+
+        ADT_file adt;
+        if (adt.loadFile(mpqFileName))
+        {
+            uint64 checksum = Checksum(adt.GetData(), adt.GetDataSize(), settingsChecksum);
+
+            TileChecksumMap::const_iterator itr = oldChecksums.find(TileChecksumKey(map.id, tile.y, tile.x));
+            if (itr != oldChecksums.end() && itr->second == checksum && FileExists(outputFileName.c_str()))
+            {
+                checksums[i] = checksum;
+                ++skippedTiles;
+            }
+            else if (ConvertADT(adt, mpqFileName, outputFileName, build))
+                checksums[i] = checksum;
+        }
+
+        // draw progress bar
+        size_t done = ++doneTiles;
+        if (done * 100 / tiles.size() != (done - 1) * 100 / tiles.size())
+        {
+            std::lock_guard<std::mutex> guard(progressLock);
+            printf("Processing........................%u%%\r", uint32(done * 100 / tiles.size()));
+            fflush(stdout);
+        }
+    }
+}
+
+void ExtractMapsFromMpq(uint32 build, int locale)
 {
-    std::string mpqFileName;
-    std::string outputFileName;
     std::string mpqMapName;
 
     printf("Extracting maps...\n");
@@ -960,10 +1148,10 @@ void ExtractMapsFromMpq(uint32 build)
     path += "/maps/";
     CreateDir(path);
 
-    printf("Convert map files\n");
+    // collect the tiles of all maps first, so threads are not left idle waiting for a large map
+    std::vector<MapTile> tiles;
     for(uint32 z = 0; z < map_count; ++z)
     {
-        printf("Extract %s (%d/%u)                  \n", map_ids[z].name, z + 1, map_count);
         // Loadup map grid data
         mpqMapName = Warhead::StringFormat("World\\Maps\\%s\\%s.wdt", map_ids[z].name, map_ids[z].name);
         WDT_file wdt;
@@ -974,20 +1162,56 @@ void ExtractMapsFromMpq(uint32 build)
         }
 
         for(uint32 y = 0; y < WDT_MAP_SIZE; ++y)
-        {
             for(uint32 x = 0; x < WDT_MAP_SIZE; ++x)
+                if (wdt.main->adt_list[y][x].exist)
+                    tiles.push_back({ z, x, y });
+    }
+
+    std::string checksumFileName = path + "checksums.txt";
+    TileChecksumMap oldChecksums;
+    if (CONF_incremental)
+        LoadTileChecksums(checksumFileName, oldChecksums);
+
+    uint32 threads = CONF_threads ? CONF_threads : std::max(std::thread::hardware_concurrency(), 1u);
+    printf("Convert %u map tiles using %u threads\n", uint32(tiles.size()), threads);
+
+    std::vector<uint64> checksums(tiles.size(), 0);
+    std::atomic<size_t> nextTile(0);
+    std::atomic<size_t> doneTiles(0);
+    std::atomic<size_t> skippedTiles(0);
+    uint64 settingsChecksum = SettingsChecksum(build);
+
+    if (threads <= 1)
+        ExtractMapTiles(tiles, nextTile, doneTiles, skippedTiles, oldChecksums, checksums, settingsChecksum, build);
+    else
+    {
+        std::vector<std::thread> workers;
+        for (uint32 i = 0; i < threads; ++i)
+        {
+            workers.emplace_back([&, locale]()
             {
-                if (!wdt.main->adt_list[y][x].exist)
-                    continue;
-                mpqFileName = Warhead::StringFormat("World\\Maps\\%s\\%s_%u_%u.adt", map_ids[z].name, map_ids[z].name, x, y);
-                outputFileName = Warhead::StringFormat("%s/maps/%03u%02u%02u.map", output_path, map_ids[z].id, y, x);
-                ConvertADT(mpqFileName, outputFileName, y, x, build);
-            }
-            // draw progress bar
-            printf("Processing........................%d%%\r", (100 * (y + 1)) / WDT_MAP_SIZE);
+                // archives opened by the main thread are not visible here
+                LoadLocaleMPQFiles(locale);
+                LoadCommonMPQFiles();
+
+                ExtractMapTiles(tiles, nextTile, doneTiles, skippedTiles, oldChecksums, checksums, settingsChecksum, build);
+
+                CloseMPQFiles();
+            });
         }
+
+        for (std::thread& worker : workers)
+            worker.join();
     }
+
     printf("\n");
+
+    if (CONF_incremental)
+        printf("Skipped %u unchanged map tiles\n", uint32(skippedTiles));
+
+    // always kept up to date, so a later incremental run can rely on it
+    SaveTileChecksums(checksumFileName, tiles, checksums);
+
     delete[] map_ids;
 }
 
@@ -1154,7 +1378,7 @@ int main(int argc, char* arg[])
         LoadCommonMPQFiles();
 
         // Extract maps
-        ExtractMapsFromMpq(build);
+        ExtractMapsFromMpq(build, FirstLocale);
 
         // Close MPQs
         CloseMPQFiles();
@@ -19,7 +19,8 @@
 #include <deque>
 #include <cstdio>
 
-ArchiveSet gOpenArchives;
+// every thread opens its own archives, libmpq handles can not be shared
+thread_local ArchiveSet gOpenArchives;
 
 MPQArchive::MPQArchive(const char* filename)
 {
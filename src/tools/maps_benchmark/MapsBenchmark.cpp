@@ -0,0 +1,546 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "QueryWorkload.h"
+#include "DynamicTree.h"
+#include "GameObjectModel.h"
+#include "MMapFactory.h"
+#include "MapDefines.h"
+#include "Timer.h"
+#include "VMapDefinitions.h"
+#include "VMapFactory.h"
+#include "VMapManager2.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <random>
+#include <thread>
+
+using namespace MapsBenchmark;
+
+// Measures the vmap, dynamic tree and Detour queries underneath Map and PathGenerator, not
+// those classes: GridMap terrain (.map files) is not loaded and path queries run a plain
+// nearest poly / findPath / findStraightPath sequence without PathGenerator's smoothing,
+// shortcuts and partial path handling. Limits and search distances are the server's.
+#define MAX_PATH_LENGTH         74
+#define MAX_POINT_PATH_LENGTH   74
+#define HEIGHT_SEARCH_DISTANCE  70.0f
+#define PHASEMASK_NORMAL        0x00000001
+
+struct BenchmarkOptions
+{
+    BenchmarkOptions() : threads(std::max(std::thread::hardware_concurrency(), 1u)), queries(100000), weights{ 40, 30, 10, 20 },
+        maxDistance(40.0f), seed(1), iterations(1), gameObjects(0), tileX(-1), tileY(-1) { }
+
+    std::vector<uint32> mapIds;
+    uint32 threads;
+    uint32 queries;                         // generated per map
+    uint32 weights[MAX_QUERY_TYPES];
+    float maxDistance;
+    uint32 seed;
+    uint32 iterations;
+    uint32 gameObjects;                     // placed per map
+    int tileX;                              // only this tile and its neighbours are loaded when set
+    int tileY;
+    std::string recordFile;
+    std::string replayFile;
+};
+
+struct alignas(64) ThreadResults
+{
+    std::vector<uint64> latencies[MAX_QUERY_TYPES];    // nanoseconds
+    uint64 hits[MAX_QUERY_TYPES] = { };
+};
+
+// stands in for a spawned gameobject, the server uses GameObject through the same interface
+class BenchmarkModelOwner : public GameObjectModelOwnerBase
+{
+public:
+    BenchmarkModelOwner(uint32 displayId, G3D::Vector3 const& position, float orientation) :
+        _displayId(displayId), _position(position), _orientation(orientation) { }
+
+    bool IsSpawned() const override { return true; }
+    uint32 GetDisplayId() const override { return _displayId; }
+    uint32 GetPhaseMask() const override { return PHASEMASK_NORMAL; }
+    G3D::Vector3 GetPosition() const override { return _position; }
+    float GetOrientation() const override { return _orientation; }
+
+private:
+    uint32 _displayId;
+    G3D::Vector3 _position;
+    float _orientation;
+};
+
+typedef std::map<uint32, std::unique_ptr<DynamicMapTree>> DynamicTreeMap;
+
+void printUsage(char const* program)
+{
+    printf("Usage: %s [options] [mapId ...]\n", program);
+    printf("Runs vmap height, LOS and liquid queries and Detour path queries against vmaps/mmaps in the current directory.\n");
+    printf("Terrain (.map) heights and PathGenerator itself are not covered.\n");
+    printf("  --threads <n>           worker threads, one per core by default\n");
+    printf("  --queries <n>           queries generated per map (default 100000)\n");
+    printf("  --mix <h,l,q,p>         relative share of height, los, liquid and path queries (default 40,30,10,20)\n");
+    printf("  --distance <yards>      max distance between los/path end points (default 40)\n");
+    printf("  --seed <n>              seed of the generated workload (default 1)\n");
+    printf("  --iterations <n>        how often the workload is replayed (default 1)\n");
+    printf("  --gameobjects <n>       gameobject models placed per map for dynamic LOS/height (default 0)\n");
+    printf("  --tile <x> <y>          only load this tile and its neighbours\n");
+    printf("  --record <file>         save the generated workload\n");
+    printf("  --replay <file>         run a saved workload instead of generating one, map ids are taken from it\n");
+}
+
+bool handleArgs(int argc, char** argv, BenchmarkOptions& options)
+{
+    char* param = nullptr;
+    for (int i = 1; i < argc; ++i)
+    {
+        // argv[argc] is null, so a missing parameter ends up as nullptr
+        if (strcmp(argv[i], "--threads") == 0)
+        {
+            param = argv[++i];
+            if (!param)
+                return false;
+
+            options.threads = uint32(std::max(atoi(param), 1));
+        }
+        else if (strcmp(argv[i], "--queries") == 0)
+        {
+            param = argv[++i];
+            if (!param)
+                return false;
+
+            options.queries = uint32(std::max(atoi(param), 1));
+        }
+        else if (strcmp(argv[i], "--mix") == 0)
+        {
+            param = argv[++i];
+            if (!param)
+                return false;
+
+            if (sscanf(param, "%u,%u,%u,%u", &options.weights[QUERY_HEIGHT], &options.weights[QUERY_LOS],
+                       &options.weights[QUERY_LIQUID], &options.weights[QUERY_PATH]) != MAX_QUERY_TYPES)
+            {
+                printf("invalid option for '--mix'\n");
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--distance") == 0)
+        {
+            param = argv[++i];
+            if (!param)
+                return false;
+
+            options.maxDistance = std::max(float(atof(param)), 1.0f);
+        }
+        else if (strcmp(argv[i], "--seed") == 0)
+        {
+            param = argv[++i];
+            if (!param)
+                return false;
+
+            options.seed = uint32(atoi(param));
+        }
+        else if (strcmp(argv[i], "--iterations") == 0)
+        {
+            param = argv[++i];
+            if (!param)
+                return false;
+
+            options.iterations = uint32(std::max(atoi(param), 1));
+        }
+        else if (strcmp(argv[i], "--gameobjects") == 0)
+        {
+            param = argv[++i];
+            if (!param)
+                return false;
+
+            options.gameObjects = uint32(std::max(atoi(param), 0));
+        }
+        else if (strcmp(argv[i], "--tile") == 0)
+        {
+            param = argv[++i];
+            if (!param)
+                return false;
+
+            options.tileX = atoi(param);
+
+            param = argv[++i];
+            if (!param)
+                return false;
+
+            options.tileY = atoi(param);
+
+            if (options.tileX < 0 || options.tileX > 63 || options.tileY < 0 || options.tileY > 63)
+            {
+                printf("invalid tile coords.\n");
+                return false;
+            }
+        }
+        else if (strcmp(argv[i], "--record") == 0)
+        {
+            param = argv[++i];
+            if (!param)
+                return false;
+
+            options.recordFile = param;
+        }
+        else if (strcmp(argv[i], "--replay") == 0)
+        {
+            param = argv[++i];
+            if (!param)
+                return false;
+
+            options.replayFile = param;
+        }
+        else
+        {
+            int map = atoi(argv[i]);
+            if (map > 0 || (map == 0 && (strcmp(argv[i], "0") == 0)))
+                options.mapIds.push_back(uint32(map));
+            else
+            {
+                printf("invalid map id %s\n", argv[i]);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+void loadMapTiles(uint32 mapId, BenchmarkOptions const& options)
+{
+    VMAP::IVMapManager* vmgr = VMAP::VMapFactory::createOrGetVMapManager();
+    MMAP::MMapManager* mmgr = MMAP::MMapFactory::createOrGetMMapManager();
+
+    int minX = options.tileX < 0 ? 0 : std::max(options.tileX - 1, 0);
+    int maxX = options.tileX < 0 ? 63 : std::min(options.tileX + 1, 63);
+    int minY = options.tileY < 0 ? 0 : std::max(options.tileY - 1, 0);
+    int maxY = options.tileY < 0 ? 63 : std::min(options.tileY + 1, 63);
+
+    uint32 startTime = getMSTime();
+    uint32 mmapTiles = 0;
+
+    // the vmap and mmap calls the server makes for every grid it creates, missing tiles are skipped silently
+    for (int x = minX; x <= maxX; ++x)
+    {
+        for (int y = minY; y <= maxY; ++y)
+        {
+            vmgr->loadMap("vmaps", mapId, x, y);
+            if (mmgr->loadMap(mapId, x, y))
+                ++mmapTiles;
+        }
+    }
+
+    printf("Map %03u: loaded %u navmesh tiles in %u ms, vmaps use %u KB, navmesh uses %u KB\n", mapId, mmapTiles, GetMSTimeDiffToNow(startTime),
+           uint32(vmgr->getMapMemoryUsage(mapId) / 1024), uint32(mmgr->getMapMemoryUsage(mapId) / 1024));
+}
+
+std::vector<uint32> readGameObjectDisplayIds()
+{
+    std::vector<uint32> displayIds;
+
+    FILE* file = fopen((std::string("vmaps/") + VMAP::GAMEOBJECT_MODELS).c_str(), "rb");
+    if (!file)
+        return displayIds;
+
+    // displayId, name length, name, bounds
+    uint32 displayId, nameLength;
+    while (fread(&displayId, sizeof(uint32), 1, file) == 1 && fread(&nameLength, sizeof(uint32), 1, file) == 1)
+    {
+        if (fseek(file, long(nameLength + 2 * sizeof(G3D::Vector3)), SEEK_CUR) != 0)
+            break;
+
+        displayIds.push_back(displayId);
+    }
+
+    fclose(file);
+    return displayIds;
+}
+
+void placeGameObjects(uint32 mapId, BenchmarkOptions const& options, std::vector<uint32> const& displayIds,
+                      DynamicMapTree& tree, std::vector<std::unique_ptr<GameObjectModel>>& models)
+{
+    std::vector<G3D::Vector3> positions;
+    if (displayIds.empty() || !GetRandomPositions(mapId, options.gameObjects, options.seed, positions))
+        return;
+
+    std::mt19937 randomEngine(options.seed + mapId);
+    std::uniform_int_distribution<size_t> displayIdDistribution(0, displayIds.size() - 1);
+    std::uniform_real_distribution<float> orientationDistribution(0.0f, 2.0f * float(M_PI));
+
+    uint32 placed = 0;
+    for (G3D::Vector3 const& position : positions)
+    {
+        std::unique_ptr<GameObjectModelOwnerBase> owner(new BenchmarkModelOwner(displayIds[displayIdDistribution(randomEngine)],
+            position, orientationDistribution(randomEngine)));
+
+        if (GameObjectModel* model = GameObjectModel::Create(std::move(owner), ""))
+        {
+            tree.insert(*model);
+            models.emplace_back(model);
+            ++placed;
+        }
+    }
+
+    tree.balance();
+
+    printf("Map %03u: placed %u gameobject models\n", mapId, placed);
+}
+
+bool runPathQuery(Query const& query)
+{
+    MMAP::NavMeshQueryHolder holder(MMAP::MMapFactory::createOrGetMMapManager(), query.mapId);
+    dtNavMeshQuery const* navMeshQuery = holder.GetQuery();
+    if (!navMeshQuery)
+        return false;
+
+    dtQueryFilter filter;
+    filter.setIncludeFlags(NAV_GROUND | NAV_WATER | NAV_MAGMA | NAV_SLIME);
+    filter.setExcludeFlags(0);
+
+    float const extents[3] = { 3.0f, 5.0f, 3.0f };
+    float const start[3] = { query.start.y, query.start.z, query.start.x };
+    float const end[3] = { query.end.y, query.end.z, query.end.x };
+
+    dtPolyRef startRef = 0, endRef = 0;
+    float startPoint[3], endPoint[3];
+    if (dtStatusFailed(navMeshQuery->findNearestPoly(start, extents, &filter, &startRef, startPoint)) || !startRef ||
+        dtStatusFailed(navMeshQuery->findNearestPoly(end, extents, &filter, &endRef, endPoint)) || !endRef)
+        return false;
+
+    dtPolyRef path[MAX_PATH_LENGTH];
+    int pathLength = 0;
+    if (dtStatusFailed(navMeshQuery->findPath(startRef, endRef, startPoint, endPoint, &filter, path, &pathLength, MAX_PATH_LENGTH)) || !pathLength)
+        return false;
+
+    float points[MAX_POINT_PATH_LENGTH * 3];
+    int pointCount = 0;
+    if (dtStatusFailed(navMeshQuery->findStraightPath(startPoint, endPoint, path, pathLength, points, nullptr, nullptr, &pointCount, MAX_POINT_PATH_LENGTH)))
+        return false;
+
+    // partial paths end on another polygon
+    return path[pathLength - 1] == endRef;
+}
+
+// returns whether the query found something: a height, a clear line, liquid or a complete path
+// heights and liquid only come from vmaps and the dynamic tree, Map also asks the terrain
+bool runQuery(Query const& query, DynamicMapTree const* dynamicTree)
+{
+    VMAP::IVMapManager* vmgr = VMAP::VMapFactory::createOrGetVMapManager();
+
+    switch (query.type)
+    {
+        case QUERY_HEIGHT:
+        {
+            float height = vmgr->getHeight(query.mapId, query.start.x, query.start.y, query.start.z, HEIGHT_SEARCH_DISTANCE);
+            if (dynamicTree)
+                height = std::max(height, dynamicTree->getHeight(query.start.x, query.start.y, query.start.z, HEIGHT_SEARCH_DISTANCE, PHASEMASK_NORMAL));
+
+            return height > VMAP_INVALID_HEIGHT;
+        }
+        case QUERY_LOS:
+            return vmgr->isInLineOfSight(query.mapId, query.start.x, query.start.y, query.start.z, query.end.x, query.end.y, query.end.z) &&
+                (!dynamicTree || dynamicTree->isInLineOfSight(query.start.x, query.start.y, query.start.z, query.end.x, query.end.y, query.end.z, PHASEMASK_NORMAL));
+        case QUERY_LIQUID:
+        {
+            float level, floor;
+            uint32 type;
+            return vmgr->GetLiquidLevel(query.mapId, query.start.x, query.start.y, query.start.z, 0, level, floor, type);
+        }
+        case QUERY_PATH:
+            return runPathQuery(query);
+        default:
+            return false;
+    }
+}
+
+void workerThread(QueryList const& queries, DynamicTreeMap const& dynamicTrees, uint32 iterations, std::atomic<uint64>& nextQuery, ThreadResults& results)
+{
+    // queries are handed out in small batches, so all threads finish at about the same time
+    uint64 const batchSize = 64;
+    uint64 const totalQueries = uint64(queries.size()) * iterations;
+
+    while (true)
+    {
+        uint64 begin = nextQuery.fetch_add(batchSize);
+        if (begin >= totalQueries)
+            return;
+
+        uint64 end = std::min(begin + batchSize, totalQueries);
+        for (uint64 i = begin; i < end; ++i)
+        {
+            Query const& query = queries[i % queries.size()];
+
+            DynamicTreeMap::const_iterator tree = dynamicTrees.find(query.mapId);
+            DynamicMapTree const* dynamicTree = tree != dynamicTrees.end() ? tree->second.get() : nullptr;
+
+            std::chrono::steady_clock::time_point queryStart = std::chrono::steady_clock::now();
+            bool hit = runQuery(query, dynamicTree);
+            std::chrono::steady_clock::duration duration = std::chrono::steady_clock::now() - queryStart;
+
+            results.latencies[query.type].push_back(uint64(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()));
+            if (hit)
+                ++results.hits[query.type];
+        }
+    }
+}
+
+void printResults(std::vector<ThreadResults>& threadResults, double seconds)
+{
+    uint64 totalQueries = 0;
+
+    printf("\n%-8s %10s %7s %10s %10s %10s %10s %10s %10s %10s\n", "query", "count", "hit %", "per sec", "mean us", "p50 us", "p90 us", "p99 us", "p99.9 us", "max us");
+
+    for (uint8 type = 0; type < MAX_QUERY_TYPES; ++type)
+    {
+        std::vector<uint64> latencies;
+        uint64 hits = 0;
+        for (ThreadResults& results : threadResults)
+        {
+            latencies.insert(latencies.end(), results.latencies[type].begin(), results.latencies[type].end());
+            hits += results.hits[type];
+        }
+
+        if (latencies.empty())
+            continue;
+
+        totalQueries += latencies.size();
+
+        std::sort(latencies.begin(), latencies.end());
+
+        uint64 sum = 0;
+        for (uint64 latency : latencies)
+            sum += latency;
+
+        auto percentile = [&latencies](double fraction)
+        {
+            return double(latencies[std::min(latencies.size() - 1, size_t(fraction * latencies.size()))]) / 1000.0;
+        };
+
+        printf("%-8s %10u %7.2f %10.0f %10.2f %10.2f %10.2f %10.2f %10.2f %10.2f\n", GetQueryTypeName(QueryType(type)), uint32(latencies.size()),
+               100.0 * double(hits) / double(latencies.size()), double(latencies.size()) / seconds, double(sum) / double(latencies.size()) / 1000.0,
+               percentile(0.5), percentile(0.9), percentile(0.99), percentile(0.999), double(latencies.back()) / 1000.0);
+    }
+
+    printf("\n%u queries in %.3f s, %.0f queries per second on %u threads\n", uint32(totalQueries), seconds, double(totalQueries) / seconds, uint32(threadResults.size()));
+}
+
+int main(int argc, char** argv)
+{
+    BenchmarkOptions options;
+    if (!handleArgs(argc, argv, options))
+    {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    QueryList queries;
+    if (!options.replayFile.empty())
+    {
+        if (!LoadWorkload(options.replayFile, queries))
+            return -1;
+
+        // the maps to load come from the workload
+        options.mapIds.clear();
+        for (Query const& query : queries)
+            if (std::find(options.mapIds.begin(), options.mapIds.end(), query.mapId) == options.mapIds.end())
+                options.mapIds.push_back(query.mapId);
+    }
+
+    if (options.mapIds.empty() || (options.replayFile.empty() && !options.queries))
+    {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    // the data is read from the working directory, like the generators write it
+    MMAP::MMapFactory::createOrGetMMapManager()->setDataDir(".");
+
+    for (uint32 mapId : options.mapIds)
+        loadMapTiles(mapId, options);
+
+    if (options.replayFile.empty())
+    {
+        for (uint32 mapId : options.mapIds)
+            if (!GenerateWorkload(mapId, options.queries, options.weights, options.maxDistance, options.seed, queries))
+                return -1;
+
+        if (!options.recordFile.empty() && !SaveWorkload(options.recordFile, queries))
+            return -1;
+    }
+
+    if (queries.empty())
+    {
+        printf("Nothing to do, the workload is empty\n");
+        return -1;
+    }
+
+    DynamicTreeMap dynamicTrees;
+    std::vector<std::unique_ptr<GameObjectModel>> gameObjectModels;
+    if (options.gameObjects)
+    {
+        LoadGameObjectModelList("");
+
+        std::vector<uint32> displayIds = readGameObjectDisplayIds();
+        for (uint32 mapId : options.mapIds)
+        {
+            std::unique_ptr<DynamicMapTree>& tree = dynamicTrees[mapId];
+            tree.reset(new DynamicMapTree());
+            placeGameObjects(mapId, options, displayIds, *tree, gameObjectModels);
+        }
+    }
+
+    printf("Running %u queries %u times on %u threads...\n", uint32(queries.size()), options.iterations, options.threads);
+
+    std::vector<ThreadResults> threadResults(options.threads);
+    std::vector<std::thread> threads;
+    std::atomic<uint64> nextQuery(0);
+
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+    for (uint32 i = 0; i < options.threads; ++i)
+        threads.push_back(std::thread(&workerThread, std::cref(queries), std::cref(dynamicTrees), options.iterations, std::ref(nextQuery), std::ref(threadResults[i])));
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    printResults(threadResults, std::max(seconds, 0.001));
+
+    // models hold references to vmap model instances
+    dynamicTrees.clear();
+    gameObjectModels.clear();
+
+    for (uint32 mapId : options.mapIds)
+    {
+        VMAP::VMapFactory::createOrGetVMapManager()->unloadMap(mapId);
+        MMAP::MMapFactory::createOrGetMMapManager()->unloadMap(mapId);
+    }
+
+    VMAP::VMapFactory::clear();
+    MMAP::MMapFactory::clear();
+    return 0;
+}
@@ -0,0 +1,239 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "QueryWorkload.h"
+#include "MapDefines.h"
+#include "MMapFactory.h"
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+namespace MapsBenchmark
+{
+    namespace
+    {
+        char const* const QueryTypeNames[MAX_QUERY_TYPES] = { "height", "los", "liquid", "path" };
+
+        // dtNavMeshQuery only takes a plain function as random source, generation runs on one thread
+        std::mt19937 randomEngine;
+
+        float RandomFloat()
+        {
+            return std::uniform_real_distribution<float>(0.0f, 1.0f)(randomEngine);
+        }
+
+        // recast uses y, z, x order
+        G3D::Vector3 ToWorldPosition(float const* point)
+        {
+            return G3D::Vector3(point[2], point[0], point[1]);
+        }
+
+        struct RandomNavMeshPoint
+        {
+            dtPolyRef ref;
+            float point[3];
+        };
+
+        bool FindRandomPoint(dtNavMeshQuery const* query, dtQueryFilter const& filter, RandomNavMeshPoint& result)
+        {
+            return dtStatusSucceed(query->findRandomPoint(&filter, &RandomFloat, &result.ref, result.point)) && result.ref;
+        }
+
+        bool FindRandomPointAround(dtNavMeshQuery const* query, dtQueryFilter const& filter, RandomNavMeshPoint const& center, float maxDistance, RandomNavMeshPoint& result)
+        {
+            return dtStatusSucceed(query->findRandomPointAroundCircle(center.ref, center.point, maxDistance, &filter, &RandomFloat, &result.ref, result.point)) && result.ref;
+        }
+
+        void InitFilter(dtQueryFilter& filter)
+        {
+            filter.setIncludeFlags(NAV_GROUND | NAV_WATER | NAV_MAGMA | NAV_SLIME);
+            filter.setExcludeFlags(0);
+        }
+    }
+
+    char const* GetQueryTypeName(QueryType type)
+    {
+        return type < MAX_QUERY_TYPES ? QueryTypeNames[type] : "unknown";
+    }
+
+    bool LoadWorkload(std::string const& fileName, QueryList& queries)
+    {
+        FILE* file = fopen(fileName.c_str(), "r");
+        if (!file)
+        {
+            printf("Cannot open workload file %s\n", fileName.c_str());
+            return false;
+        }
+
+        char line[512];
+        uint32 lineNumber = 0;
+        bool result = true;
+        while (fgets(line, sizeof(line), file))
+        {
+            ++lineNumber;
+            if (line[0] == '#' || line[0] == '\n' || line[0] == '\r')
+                continue;
+
+            char typeName[16] = "";
+            Query query;
+            int fields = sscanf(line, "%15s %u %f %f %f %f %f %f", typeName, &query.mapId,
+                                &query.start.x, &query.start.y, &query.start.z, &query.end.x, &query.end.y, &query.end.z);
+
+            uint8 type = 0;
+            while (type < MAX_QUERY_TYPES && strcmp(typeName, QueryTypeNames[type]) != 0)
+                ++type;
+
+            query.type = QueryType(type);
+
+            bool hasEnd = query.type == QUERY_LOS || query.type == QUERY_PATH;
+            if (fields < 2 || query.type == MAX_QUERY_TYPES || fields != (hasEnd ? 8 : 5))
+            {
+                printf("%s:%u: invalid query\n", fileName.c_str(), lineNumber);
+                result = false;
+                break;
+            }
+
+            if (!hasEnd)
+                query.end = query.start;
+
+            queries.push_back(query);
+        }
+
+        fclose(file);
+        return result;
+    }
+
+    bool SaveWorkload(std::string const& fileName, QueryList const& queries)
+    {
+        FILE* file = fopen(fileName.c_str(), "w");
+        if (!file)
+        {
+            printf("Cannot open %s for writing\n", fileName.c_str());
+            return false;
+        }
+
+        fprintf(file, "# <type> <mapId> <x> <y> <z> [<x> <y> <z>]\n");
+        for (Query const& query : queries)
+        {
+            fprintf(file, "%s %u %.4f %.4f %.4f", QueryTypeNames[query.type], query.mapId, query.start.x, query.start.y, query.start.z);
+            if (query.type == QUERY_LOS || query.type == QUERY_PATH)
+                fprintf(file, " %.4f %.4f %.4f", query.end.x, query.end.y, query.end.z);
+
+            fprintf(file, "\n");
+        }
+
+        fclose(file);
+        return true;
+    }
+
+    bool GenerateWorkload(uint32 mapId, uint32 count, uint32 const (&weights)[MAX_QUERY_TYPES], float maxDistance, uint32 seed, QueryList& queries)
+    {
+        MMAP::NavMeshQueryHolder holder(MMAP::MMapFactory::createOrGetMMapManager(), mapId);
+        dtNavMeshQuery const* query = holder.GetQuery();
+        if (!query)
+        {
+            printf("Map %03u has no navmesh, a workload can only be generated for maps with mmaps\n", mapId);
+            return false;
+        }
+
+        dtQueryFilter filter;
+        InitFilter(filter);
+
+        randomEngine.seed(seed + mapId);
+
+        uint32 totalWeight = 0;
+        for (uint32 weight : weights)
+            totalWeight += weight;
+
+        if (!totalWeight)
+            return false;
+
+        std::uniform_int_distribution<uint32> typeDistribution(0, totalWeight - 1);
+
+        // give up on maps whose navmesh is (nearly) empty instead of retrying forever
+        uint32 failures = 0;
+        uint32 generated = 0;
+        while (generated < count)
+        {
+            if (failures > count + 1000)
+            {
+                printf("Map %03u: only found %u of %u query positions on the navmesh\n", mapId, generated, count);
+                return generated > 0;
+            }
+
+            uint32 roll = typeDistribution(randomEngine);
+            uint8 type = 0;
+            while (roll >= weights[type])
+                roll -= weights[type++];
+
+            RandomNavMeshPoint start, end;
+            if (!FindRandomPoint(query, filter, start))
+            {
+                ++failures;
+                continue;
+            }
+
+            end = start;
+            if ((type == QUERY_LOS || type == QUERY_PATH) && !FindRandomPointAround(query, filter, start, maxDistance, end))
+            {
+                ++failures;
+                continue;
+            }
+
+            Query newQuery;
+            newQuery.type = QueryType(type);
+            newQuery.mapId = mapId;
+            newQuery.start = ToWorldPosition(start.point);
+            newQuery.end = ToWorldPosition(end.point);
+
+            // the server looks for the height from slightly above the unit and checks LOS between eye heights
+            if (type == QUERY_HEIGHT || type == QUERY_LOS)
+            {
+                newQuery.start.z += 2.0f;
+                newQuery.end.z += 2.0f;
+            }
+
+            queries.push_back(newQuery);
+            ++generated;
+        }
+
+        return true;
+    }
+
+    bool GetRandomPositions(uint32 mapId, uint32 count, uint32 seed, std::vector<G3D::Vector3>& positions)
+    {
+        MMAP::NavMeshQueryHolder holder(MMAP::MMapFactory::createOrGetMMapManager(), mapId);
+        dtNavMeshQuery const* query = holder.GetQuery();
+        if (!query)
+            return false;
+
+        dtQueryFilter filter;
+        InitFilter(filter);
+
+        randomEngine.seed(seed ^ (mapId << 16));
+
+        for (uint32 i = 0; i < count; ++i)
+        {
+            RandomNavMeshPoint point;
+            if (FindRandomPoint(query, filter, point))
+                positions.push_back(ToWorldPosition(point.point));
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,65 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _QUERY_WORKLOAD_H
+#define _QUERY_WORKLOAD_H
+
+#include "Define.h"
+#include <G3D/Vector3.h>
+#include <string>
+#include <vector>
+
+namespace MapsBenchmark
+{
+    enum QueryType : uint8
+    {
+        QUERY_HEIGHT,               // start
+        QUERY_LOS,                  // start -> end
+        QUERY_LIQUID,               // start
+        QUERY_PATH,                 // start -> end
+
+        MAX_QUERY_TYPES
+    };
+
+    char const* GetQueryTypeName(QueryType type);
+
+    // positions are world coordinates, as used by the server
+    struct Query
+    {
+        QueryType type;
+        uint32 mapId;
+        G3D::Vector3 start;
+        G3D::Vector3 end;
+    };
+
+    typedef std::vector<Query> QueryList;
+
+    // Text format, one query per line: "<type> <mapId> <x> <y> <z> [<x> <y> <z>]",
+    // the end position is only present for los and path queries. Lines starting with # are skipped.
+    bool LoadWorkload(std::string const& fileName, QueryList& queries);
+    bool SaveWorkload(std::string const& fileName, QueryList const& queries);
+
+    // Appends count queries on random navmesh positions of a map, its tiles must be loaded into the MMapManager.
+    // weights holds the relative share of every QueryType, end positions are at most maxDistance yards away.
+    bool GenerateWorkload(uint32 mapId, uint32 count, uint32 const (&weights)[MAX_QUERY_TYPES], float maxDistance, uint32 seed, QueryList& queries);
+
+    // Random positions on the navmesh of a map, used to place gameobjects
+    bool GetRandomPositions(uint32 mapId, uint32 count, uint32 seed, std::vector<G3D::Vector3>& positions);
+}
+
+#endif
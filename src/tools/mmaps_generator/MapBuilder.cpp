@@ -16,9 +16,12 @@
  */
 
 #include "MapBuilder.h"
+#include "DataCompression.h"
+#include "MappedFile.h"
 #include "MapTree.h"
 #include "ModelInstance.h"
 #include "PathCommon.h"
+#include "VMapManager2.h"
 
 #include <DetourCommon.h>
 #include <DetourNavMesh.h>
@@ -49,11 +52,44 @@ static_assert(sizeof(MmapTileHeader) == (sizeof(MmapTileHeader::mmapMagic) +
               sizeof(MmapTileHeader::usesLiquids) +
               sizeof(MmapTileHeader::padding)), "MmapTileHeader has uninitialized padding fields");
 
+namespace
+{
+    uint64 const FNV_OFFSET_BASIS = 14695981039346656037ULL;
+    uint64 const FNV_PRIME = 1099511628211ULL;
+
+    uint64 hashBytes(uint64 hash, void const* data, size_t size)
+    {
+        uint8 const* bytes = static_cast<uint8 const*>(data);
+        for (size_t i = 0; i < size; ++i)
+            hash = (hash ^ bytes[i]) * FNV_PRIME;
+
+        return hash;
+    }
+
+    template<class T>
+    uint64 hashValue(uint64 hash, T const& value)
+    {
+        return hashBytes(hash, &value, sizeof(T));
+    }
+
+    uint64 getFileSize(char const* fileName)
+    {
+        FILE* file = fopen(fileName, "rb");
+        if (!file)
+            return 0;
+
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fclose(file);
+        return size > 0 ? uint64(size) : 0;
+    }
+}
+
 namespace MMAP
 {
     MapBuilder::MapBuilder(float maxWalkableAngle, bool skipLiquid,
                            bool skipContinents, bool skipJunkMaps, bool skipBattlegrounds,
-                           bool debugOutput, bool bigBaseUnit, const char* offMeshFilePath) :
+                           bool debugOutput, bool bigBaseUnit, bool compress, const char* offMeshFilePath) :
         m_terrainBuilder     (nullptr),
         m_debugOutput        (debugOutput),
         m_offMeshFilePath    (offMeshFilePath),
@@ -62,8 +98,9 @@ namespace MMAP
         m_skipBattlegrounds  (skipBattlegrounds),
         m_maxWalkableAngle   (maxWalkableAngle),
         m_bigBaseUnit        (bigBaseUnit),
+        m_compress           (compress),
         m_rcContext          (nullptr),
-        _cancelationToken    (false)
+        _settingsHash        (FNV_OFFSET_BASIS)
     {
         m_terrainBuilder = new TerrainBuilder(skipLiquid);
 
@@ -74,6 +111,17 @@ namespace MMAP
         m_totalTilesBuilt = 0;
 
         discoverTiles();
+
+        // anything that changes the output of every tile
+        _settingsHash = hashValue(_settingsHash, m_maxWalkableAngle);
+        _settingsHash = hashValue(_settingsHash, m_bigBaseUnit);
+        _settingsHash = hashValue(_settingsHash, m_compress);
+        _settingsHash = hashValue(_settingsHash, m_terrainBuilder->usesLiquids());
+        _settingsHash = hashValue(_settingsHash, uint32(MMAP_VERSION));
+        _settingsHash = hashValue(_settingsHash, uint32(DT_NAVMESH_VERSION));
+
+        loadOffMeshHashes();
+        loadManifest();
     }
 
     /**************************************************************************/
@@ -195,35 +243,142 @@ namespace MMAP
     {
         printf("Using %u threads to extract mmaps\n", threads);
 
-        for (unsigned int i = 0; i < threads; ++i)
-            _workerThreads.push_back(std::thread(&MapBuilder::WorkerThread, this));
+        std::vector<TileJob> jobs;
+        for (TileList::iterator it = m_tiles.begin(); it != m_tiles.end(); ++it)
+        {
+            uint32 mapId = it->m_mapId;
+            if (shouldSkipMap(mapId) || it->m_tiles->empty())
+                continue;
+
+            // only the navmesh params are shared by the tiles of a map,
+            // every tile job creates its own navmesh from them
+            dtNavMesh* navMesh = nullptr;
+            buildNavMesh(mapId, navMesh);
+            if (!navMesh)
+            {
+                printf("[Map %03i] Failed creating navmesh!\n", mapId);
+                m_totalTilesBuilt += it->m_tiles->size();
+                continue;
+            }
+
+            MapBuildState& state = _mapStates[mapId];
+            state.navMeshParams = *navMesh->getParams();
+            state.remainingTiles = uint32(it->m_tiles->size());
+            dtFreeNavMesh(navMesh);
+
+            printf("[Map %03i] We have %u tiles.                          \n", mapId, (unsigned int)it->m_tiles->size());
+            for (std::set<uint32>::iterator tile = it->m_tiles->begin(); tile != it->m_tiles->end(); ++tile)
+            {
+                uint32 tileX, tileY;
+                StaticMapTree::unpackTileID(*tile, tileX, tileY);
+                jobs.push_back({ mapId, tileX, tileY, estimateTileCost(mapId, tileX, tileY) });
+            }
+        }
 
-        m_tiles.sort([](MapTiles a, MapTiles b)
+        // start with the most expensive tiles, so no thread is left alone with a big one at the end
+        std::stable_sort(jobs.begin(), jobs.end(), [](TileJob const& a, TileJob const& b)
         {
-            return a.m_tiles->size() > b.m_tiles->size();
+            return a.cost > b.cost;
         });
 
-        for (TileList::iterator it = m_tiles.begin(); it != m_tiles.end(); ++it)
+        // deal the jobs out round robin, every queue gets its share of the big tiles
+        uint32 queueCount = std::max(threads, 1u);
+        for (uint32 i = 0; i < queueCount; ++i)
+            _jobQueues.push_back(std::make_unique<TileJobQueue>());
+
+        for (size_t i = 0; i < jobs.size(); ++i)
+            _jobQueues[i % queueCount]->jobs.push_back(jobs[i]);
+
+        if (threads > 0)
         {
-            uint32 mapId = it->m_mapId;
-            if (!shouldSkipMap(mapId))
+            std::vector<std::thread> workerThreads;
+            for (uint32 i = 0; i < threads; ++i)
+                workerThreads.push_back(std::thread(&MapBuilder::WorkerThread, this, i));
+
+            for (auto& thread : workerThreads)
+                thread.join();
+        }
+        else
+            WorkerThread(0);
+
+        _jobQueues.clear();
+        _mapStates.clear();
+
+        saveManifest();
+    }
+
+    /**************************************************************************/
+    uint64 MapBuilder::estimateTileCost(uint32 mapID, uint32 tileX, uint32 tileY) const
+    {
+        // build time grows with the amount of terrain and model geometry, the file sizes are a good enough guess
+        char fileName[255];
+        sprintf(fileName, "maps/%03u%02u%02u.map", mapID, tileY, tileX);
+        uint64 cost = getFileSize(fileName);
+
+        std::string vmapTileName = "vmaps/" + StaticMapTree::getTileFileName(mapID, tileY, tileX);
+        cost += getFileSize(vmapTileName.c_str());
+        return cost;
+    }
+
+    /**************************************************************************/
+    bool MapBuilder::popTileJob(uint32 index, TileJob& job)
+    {
+        {
+            TileJobQueue& queue = *_jobQueues[index];
+            std::lock_guard<std::mutex> guard(queue.lock);
+            if (!queue.jobs.empty())
+            {
+                job = queue.jobs.front();
+                queue.jobs.pop_front();
+                return true;
+            }
+        }
+
+        // our own queue is drained, steal from the others
+        for (size_t i = 1; i < _jobQueues.size(); ++i)
+        {
+            TileJobQueue& queue = *_jobQueues[(index + i) % _jobQueues.size()];
+            std::lock_guard<std::mutex> guard(queue.lock);
+            if (!queue.jobs.empty())
             {
-                if (threads > 0)
-                    _queue.Push(mapId);
-                else
-                    buildMap(mapId);
+                job = queue.jobs.back();
+                queue.jobs.pop_back();
+                return true;
             }
         }
 
-        while (!_queue.Empty())
-            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+        // no jobs are added once the workers run, so everything is done
+        return false;
+    }
+
+    /**************************************************************************/
+    void MapBuilder::buildTileJob(TileJob const& job)
+    {
+        MapBuildState& state = _mapStates.find(job.mapId)->second;
+
+        // percentageDone - increment tiles built
+        m_totalTilesBuilt++;
 
-        _cancelationToken = true;
+        uint64 inputHash = getTileInputHash(job.mapId, job.tileX, job.tileY);
+        if (shouldSkipTile(job.mapId, job.tileX, job.tileY, inputHash))
+            updateManifest(job.mapId, job.tileX, job.tileY, inputHash);
+        else
+        {
+            // dtNavMesh is not thread safe, tiles of the same map are built with separate instances
+            dtNavMesh* navMesh = dtAllocNavMesh();
+            if (navMesh->init(&state.navMeshParams))
+            {
+                buildTile(job.mapId, job.tileX, job.tileY, navMesh);
+                updateManifest(job.mapId, job.tileX, job.tileY, inputHash);
+            }
+            else
+                printf("[Map %03i] Failed creating navmesh for tile [%02u,%02u]!\n", job.mapId, job.tileX, job.tileY);
 
-        _queue.Cancel();
+            dtFreeNavMesh(navMesh);
+        }
 
-        for (auto& thread : _workerThreads)
-            thread.join();
+        if (--state.remainingTiles == 0)
+            printf("[Map %03i] Complete!\n", job.mapId);
     }
 
     /**************************************************************************/
@@ -369,21 +524,16 @@ namespace MMAP
 
         buildTile(mapID, tileX, tileY, navMesh);
         dtFreeNavMesh(navMesh);
+
+        updateManifest(mapID, tileX, tileY, getTileInputHash(mapID, tileX, tileY));
+        saveManifest();
     }
 
-    void MapBuilder::WorkerThread()
+    void MapBuilder::WorkerThread(uint32 index)
     {
-        while (1)
-        {
-            uint32 mapId = 0;
-
-            _queue.WaitAndPop(mapId);
-
-            if (_cancelationToken)
-                return;
-
-            buildMap(mapId);
-        }
+        TileJob job;
+        while (popTileJob(index, job))
+            buildTileJob(job);
     }
 
     /**************************************************************************/
@@ -426,13 +576,15 @@ namespace MMAP
                 // unpack tile coords
                 StaticMapTree::unpackTileID((*it), tileX, tileY);
 
-                if (shouldSkipTile(mapID, tileX, tileY))
-                    continue;
+                uint64 inputHash = getTileInputHash(mapID, tileX, tileY);
+                if (!shouldSkipTile(mapID, tileX, tileY, inputHash))
+                    buildTile(mapID, tileX, tileY, navMesh);
 
-                buildTile(mapID, tileX, tileY, navMesh);
+                updateManifest(mapID, tileX, tileY, inputHash);
             }
 
             dtFreeNavMesh(navMesh);
+            saveManifest();
         }
 
         printf("[Map %03i] Complete!\n", mapID);
@@ -877,6 +1029,10 @@ namespace MMAP
             fwrite(navData, sizeof(unsigned char), navDataSize, file);
             fclose(file);
 
+            // the header gets a block of its own, so checking a tile does not decompress the whole mesh
+            if (m_compress && !Warhead::DataCompression::CompressFile(fileName, { uint32(sizeof(MmapTileHeader)) }))
+                printf("%s Failed to compress %s!\n", tileString, fileName);
+
             // now that tile is written to disk, we can unload it
             navMesh->removeTile(tileRef, nullptr, nullptr);
         } while (0);
@@ -1009,18 +1165,12 @@ namespace MMAP
     }
 
     /**************************************************************************/
-    bool MapBuilder::shouldSkipTile(uint32 mapID, uint32 tileX, uint32 tileY)
+    bool MapBuilder::isTileFileValid(uint32 mapID, uint32 tileX, uint32 tileY)
     {
         char fileName[255];
         sprintf(fileName, "mmaps/%03u%02i%02i.mmtile", mapID, tileY, tileX);
-        FILE* file = fopen(fileName, "rb");
-        if (!file)
-            return false;
-
         MmapTileHeader header;
-        int count = fread(&header, sizeof(MmapTileHeader), 1, file);
-        fclose(file);
-        if (count != 1)
+        if (!MappedFile::ReadHeader(fileName, &header, sizeof(MmapTileHeader)))
             return false;
 
         if (header.mmapMagic != MMAP_MAGIC || header.dtVersion != uint32(DT_NAVMESH_VERSION))
@@ -1032,6 +1182,158 @@ namespace MMAP
         return true;
     }
 
+    /**************************************************************************/
+    bool MapBuilder::shouldSkipTile(uint32 mapID, uint32 tileX, uint32 tileY, uint64 inputHash)
+    {
+        bool hasTile = isTileFileValid(mapID, tileX, tileY);
+
+        std::lock_guard<std::mutex> guard(_manifestLock);
+        auto itr = _manifest.find(makeTileKey(mapID, tileX, tileY));
+
+        // never built with a manifest, keep whatever an earlier run produced
+        if (itr == _manifest.end())
+            return hasTile;
+
+        // the inputs changed, or the tile file was deleted or replaced since
+        return itr->second.inputHash == inputHash && itr->second.hasTile == hasTile;
+    }
+
+    /**************************************************************************/
+    void MapBuilder::updateManifest(uint32 mapID, uint32 tileX, uint32 tileY, uint64 inputHash)
+    {
+        bool hasTile = isTileFileValid(mapID, tileX, tileY);
+
+        std::lock_guard<std::mutex> guard(_manifestLock);
+        _manifest[makeTileKey(mapID, tileX, tileY)] = { inputHash, hasTile };
+    }
+
+    /**************************************************************************/
+    void MapBuilder::loadManifest()
+    {
+        FILE* file = fopen("mmaps/manifest.txt", "r");
+        if (!file)
+            return;
+
+        char buf[128];
+        while (fgets(buf, sizeof(buf), file))
+        {
+            uint32 mapID, tileX, tileY, hasTile;
+            unsigned long long inputHash;
+            if (sscanf(buf, "%u %u %u %llx %u", &mapID, &tileX, &tileY, &inputHash, &hasTile) != 5)
+                continue;
+
+            _manifest[makeTileKey(mapID, tileX, tileY)] = { uint64(inputHash), hasTile != 0 };
+        }
+
+        fclose(file);
+    }
+
+    /**************************************************************************/
+    void MapBuilder::saveManifest()
+    {
+        // written to a temporary file first, an interrupted run must not leave a truncated manifest behind
+        FILE* file = fopen("mmaps/manifest.txt.tmp", "w");
+        if (!file)
+        {
+            perror("Failed to open mmaps/manifest.txt.tmp for writing!");
+            return;
+        }
+
+        std::lock_guard<std::mutex> guard(_manifestLock);
+        std::map<uint32, ManifestEntry> sorted(_manifest.begin(), _manifest.end());
+        for (auto const& itr : sorted)
+            fprintf(file, "%u %u %u %016llx %u\n", itr.first >> 16, (itr.first >> 8) & 0xFF, itr.first & 0xFF,
+                    (unsigned long long)itr.second.inputHash, itr.second.hasTile ? 1 : 0);
+
+        fclose(file);
+
+        remove("mmaps/manifest.txt");
+        if (rename("mmaps/manifest.txt.tmp", "mmaps/manifest.txt") != 0)
+            perror("Failed to write mmaps/manifest.txt!");
+    }
+
+    /**************************************************************************/
+    void MapBuilder::loadOffMeshHashes()
+    {
+        if (!m_offMeshFilePath)
+            return;
+
+        FILE* file = fopen(m_offMeshFilePath, "rb");
+        if (!file)
+            return;
+
+        // same format as TerrainBuilder::loadOffMeshConnections, the hash covers every line of a tile
+        char buf[512];
+        while (fgets(buf, sizeof(buf), file))
+        {
+            float p0[3], p1[3];
+            uint32 mid, tx, ty;
+            float size;
+            if (sscanf(buf, "%u %u,%u (%f %f %f) (%f %f %f) %f", &mid, &tx, &ty,
+                       &p0[0], &p0[1], &p0[2], &p1[0], &p1[1], &p1[2], &size) != 10)
+                continue;
+
+            uint64& hash = _offMeshHashes.emplace(makeTileKey(mid, tx, ty), FNV_OFFSET_BASIS).first->second;
+            hash = hashBytes(hash, buf, strlen(buf));
+        }
+
+        fclose(file);
+    }
+
+    /**************************************************************************/
+    uint64 MapBuilder::getFileHash(std::string const& fileName)
+    {
+        {
+            std::lock_guard<std::mutex> guard(_fileHashLock);
+            auto itr = _fileHashes.find(fileName);
+            if (itr != _fileHashes.end())
+                return itr->second;
+        }
+
+        // a missing file hashes to 0, so the tile is rebuilt once it shows up
+        uint64 hash = 0;
+        if (FILE* file = fopen(fileName.c_str(), "rb"))
+        {
+            hash = FNV_OFFSET_BASIS;
+
+            std::vector<uint8> buffer(64 * 1024);
+            size_t count;
+            while ((count = fread(buffer.data(), 1, buffer.size(), file)) > 0)
+                hash = hashBytes(hash, buffer.data(), count);
+
+            fclose(file);
+        }
+
+        std::lock_guard<std::mutex> guard(_fileHashLock);
+        _fileHashes[fileName] = hash;
+        return hash;
+    }
+
+    /**************************************************************************/
+    uint64 MapBuilder::getTileInputHash(uint32 mapID, uint32 tileX, uint32 tileY)
+    {
+        uint64 hash = _settingsHash;
+
+        // the tile and the borders of its neighbours, see TerrainBuilder::loadMap
+        static int const neighbours[5][2] = { { 0, 0 }, { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+        char fileName[255];
+        for (auto const& offset : neighbours)
+        {
+            sprintf(fileName, "maps/%03u%02u%02u.map", mapID, tileY + offset[1], tileX + offset[0]);
+            hash = hashValue(hash, getFileHash(fileName));
+        }
+
+        // model placement, see TerrainBuilder::loadVMap
+        hash = hashValue(hash, getFileHash("vmaps/" + VMapManager2::getMapFileName(mapID)));
+        hash = hashValue(hash, getFileHash("vmaps/" + StaticMapTree::getTileFileName(mapID, tileY, tileX)));
+
+        auto itr = _offMeshHashes.find(makeTileKey(mapID, tileX, tileY));
+        if (itr != _offMeshHashes.end())
+            hash = hashValue(hash, itr->second);
+
+        return hash;
+    }
+
     /**************************************************************************/
     uint32 MapBuilder::percentageDone(uint32 totalTiles, uint32 totalTilesBuilt)
     {
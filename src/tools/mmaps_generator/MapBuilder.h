@@ -22,15 +22,19 @@
 #include <vector>
 #include <set>
 #include <atomic>
+#include <deque>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <string>
 #include <thread>
+#include <unordered_map>
 
 #include "TerrainBuilder.h"
 #include "IntermediateValues.h"
 
 #include "Recast.h"
 #include "DetourNavMesh.h"
-#include "PCQueue.h"
 
 using namespace VMAP;
 
@@ -72,6 +76,35 @@ namespace MMAP
         rcPolyMeshDetail* dmesh;
     };
 
+    struct TileJob
+    {
+        uint32 mapId;
+        uint32 tileX;
+        uint32 tileY;
+        uint64 cost;            // estimated from the size of the input files
+    };
+
+    // one per worker thread, the owner pops from the front (most expensive tiles first)
+    // while idle workers steal from the back
+    struct TileJobQueue
+    {
+        std::mutex lock;
+        std::deque<TileJob> jobs;
+    };
+
+    struct MapBuildState
+    {
+        dtNavMeshParams navMeshParams;
+        std::atomic<uint32> remainingTiles;
+    };
+
+    // mmaps/manifest.txt, inputs every tile was last built from
+    struct ManifestEntry
+    {
+        uint64 inputHash;
+        bool hasTile;           // false if the inputs produced no mmtile
+    };
+
     class MapBuilder
     {
     public:
@@ -82,6 +115,7 @@ namespace MMAP
                    bool skipBattlegrounds   = false,
                    bool debugOutput         = false,
                    bool bigBaseUnit         = false,
+                   bool compress            = false,
                    const char* offMeshFilePath = nullptr);
 
         ~MapBuilder();
@@ -94,9 +128,10 @@ namespace MMAP
         void buildSingleTile(uint32 mapID, uint32 tileX, uint32 tileY);
 
         // builds list of maps, then builds all of mmap tiles (based on the skip settings)
+        // tiles are scheduled individually, so big maps are spread over all threads
         void buildAllMaps(unsigned int threads);
 
-        void WorkerThread();
+        void WorkerThread(uint32 index);
 
     private:
         // detect maps and tiles
@@ -107,6 +142,11 @@ namespace MMAP
 
         void buildTile(uint32 mapID, uint32 tileX, uint32 tileY, dtNavMesh* navMesh);
 
+        // work stealing tile scheduling
+        uint64 estimateTileCost(uint32 mapID, uint32 tileX, uint32 tileY) const;
+        bool popTileJob(uint32 index, TileJob& job);
+        void buildTileJob(TileJob const& job);
+
         // move map building
         void buildMoveMapTile(uint32 mapID,
                               uint32 tileX,
@@ -123,7 +163,18 @@ namespace MMAP
 
         bool shouldSkipMap(uint32 mapID);
         bool isTransportMap(uint32 mapID);
-        bool shouldSkipTile(uint32 mapID, uint32 tileX, uint32 tileY);
+        bool isTileFileValid(uint32 mapID, uint32 tileX, uint32 tileY);
+        bool shouldSkipTile(uint32 mapID, uint32 tileX, uint32 tileY, uint64 inputHash);
+
+        // incremental rebuilds, a tile is only rebuilt if the hash of its inputs changed
+        static uint32 makeTileKey(uint32 mapID, uint32 tileX, uint32 tileY) { return (mapID << 16) | (tileX << 8) | tileY; }
+        void loadManifest();
+        void saveManifest();
+        void updateManifest(uint32 mapID, uint32 tileX, uint32 tileY, uint64 inputHash);
+        void loadOffMeshHashes();
+        uint64 getFileHash(std::string const& fileName);
+        uint64 getTileInputHash(uint32 mapID, uint32 tileX, uint32 tileY);
+
         // percentageDone - method to calculate percentage
         uint32 percentageDone(uint32 totalTiles, uint32 totalTilesDone);
 
@@ -139,6 +190,7 @@ namespace MMAP
 
         float m_maxWalkableAngle;
         bool m_bigBaseUnit;
+        bool m_compress;
         // percentageDone - variables to calculate percentage
         std::atomic<uint32> m_totalTiles;
         std::atomic<uint32> m_totalTilesBuilt;
@@ -146,9 +198,17 @@ namespace MMAP
         // build performance - not really used for now
         rcContext* m_rcContext;
 
-        std::vector<std::thread> _workerThreads;
-        ProducerConsumerQueue<uint32> _queue;
-        std::atomic<bool> _cancelationToken;
+        std::vector<std::unique_ptr<TileJobQueue>> _jobQueues;
+        std::unordered_map<uint32, MapBuildState> _mapStates;
+
+        uint64 _settingsHash;
+        std::unordered_map<uint32, uint64> _offMeshHashes;
+
+        std::mutex _fileHashLock;
+        std::unordered_map<std::string, uint64> _fileHashes;
+
+        std::mutex _manifestLock;
+        std::unordered_map<uint32, ManifestEntry> _manifest;
     };
 }
 
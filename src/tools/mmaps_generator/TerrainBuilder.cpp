@@ -20,6 +20,7 @@
 #include "MapBuilder.h"
 #include "VMapManager2.h"
 #include "MapTree.h"
+#include "MappedFile.h"
 #include "ModelInstance.h"
 #include <vector>
 
@@ -41,6 +42,14 @@ struct map_fileheader
     uint32 holesSize;
 };
 
+// Every section, section header and data array starts on this boundary
+#define MAP_SECTION_ALIGNMENT 16
+
+static uint32 MapAlignedSize(uint32 size)
+{
+    return (size + MAP_SECTION_ALIGNMENT - 1) & ~uint32(MAP_SECTION_ALIGNMENT - 1);
+}
+
 #define MAP_HEIGHT_NO_HEIGHT  0x0001
 #define MAP_HEIGHT_AS_INT16   0x0002
 #define MAP_HEIGHT_AS_INT8    0x0004
@@ -79,7 +88,7 @@ struct map_liquidHeader
 namespace MMAP
 {
 
-    char const* MAP_VERSION_MAGIC = "v1.8";
+    char const* MAP_VERSION_MAGIC = "v1.9";
 
     TerrainBuilder::TerrainBuilder(bool skipLiquid) : m_skipLiquid (skipLiquid) { }
     TerrainBuilder::~TerrainBuilder() { }
@@ -135,25 +144,26 @@ namespace MMAP
         char mapFileName[255];
         sprintf(mapFileName, "maps/%03u%02u%02u.map", mapID, tileY, tileX);
 
-        FILE* mapFile = fopen(mapFileName, "rb");
-        if (!mapFile)
+        // compressed .map files are decompressed by MappedFile
+        MappedFile file;
+        if (!file.Open(mapFileName))
             return false;
 
+        MappedFileReader mapFile(file);
         map_fileheader fheader;
-        if (fread(&fheader, sizeof(map_fileheader), 1, mapFile) != 1 ||
+        if (!mapFile.Read(fheader) ||
                 fheader.versionMagic != *((uint32 const*)(MAP_VERSION_MAGIC)))
         {
-            fclose(mapFile);
             printf("%s is the wrong version, please extract new .map files\n", mapFileName);
             return false;
         }
 
         map_heightHeader hheader;
-        fseek(mapFile, fheader.heightMapOffset, SEEK_SET);
+        mapFile.Seek(fheader.heightMapOffset);
 
         bool haveTerrain = false;
         bool haveLiquid = false;
-        if (fread(&hheader, sizeof(map_heightHeader), 1, mapFile) == 1)
+        if (mapFile.Read(hheader))
         {
             haveTerrain = !(hheader.flags & MAP_HEIGHT_NO_HEIGHT);
             haveLiquid = fheader.liquidMapOffset && !m_skipLiquid;
@@ -161,10 +171,7 @@ namespace MMAP
 
         // no data in this map file
         if (!haveTerrain && !haveLiquid)
-        {
-            fclose(mapFile);
             return false;
-        }
 
         // data used later
         uint16 holes[16][16];
@@ -186,8 +193,9 @@ namespace MMAP
                 uint8 v9[V9_SIZE_SQ];
                 uint8 v8[V8_SIZE_SQ];
                 int count = 0;
-                count += fread(v9, sizeof(uint8), V9_SIZE_SQ, mapFile);
-                count += fread(v8, sizeof(uint8), V8_SIZE_SQ, mapFile);
+                count += mapFile.Read(v9) ? V9_SIZE_SQ : 0;
+                mapFile.Skip(MapAlignedSize(sizeof(v9)) - sizeof(v9));
+                count += mapFile.Read(v8) ? V8_SIZE_SQ : 0;
                 if (count != expected)
                     printf("TerrainBuilder::loadMap: Failed to read some data expected %d, read %d\n", expected, count);
 
@@ -204,8 +212,9 @@ namespace MMAP
                 uint16 v9[V9_SIZE_SQ];
                 uint16 v8[V8_SIZE_SQ];
                 int count = 0;
-                count += fread(v9, sizeof(uint16), V9_SIZE_SQ, mapFile);
-                count += fread(v8, sizeof(uint16), V8_SIZE_SQ, mapFile);
+                count += mapFile.Read(v9) ? V9_SIZE_SQ : 0;
+                mapFile.Skip(MapAlignedSize(sizeof(v9)) - sizeof(v9));
+                count += mapFile.Read(v8) ? V8_SIZE_SQ : 0;
                 if (count != expected)
                     printf("TerrainBuilder::loadMap: Failed to read some data expected %d, read %d\n", expected, count);
 
@@ -220,8 +229,9 @@ namespace MMAP
             else
             {
                 int count = 0;
-                count += fread(V9, sizeof(float), V9_SIZE_SQ, mapFile);
-                count += fread(V8, sizeof(float), V8_SIZE_SQ, mapFile);
+                count += mapFile.Read(V9) ? V9_SIZE_SQ : 0;
+                mapFile.Skip(MapAlignedSize(sizeof(V9)) - sizeof(V9));
+                count += mapFile.Read(V8) ? V8_SIZE_SQ : 0;
                 if (count != expected)
                     printf("TerrainBuilder::loadMap: Failed to read some data expected %d, read %d\n", expected, count);
             }
@@ -230,8 +240,8 @@ namespace MMAP
             if (fheader.holesSize != 0)
             {
                 memset(holes, 0, fheader.holesSize);
-                fseek(mapFile, fheader.holesOffset, SEEK_SET);
-                if (fread(holes, fheader.holesSize, 1, mapFile) != 1)
+                mapFile.Seek(fheader.holesOffset);
+                if (!mapFile.Read(holes, fheader.holesSize))
                     printf("TerrainBuilder::loadMap: Failed to read some data expected 1, read 0\n");
             }
 
@@ -274,21 +284,29 @@ namespace MMAP
         if (haveLiquid)
         {
             map_liquidHeader lheader;
-            fseek(mapFile, fheader.liquidMapOffset, SEEK_SET);
-            if (fread(&lheader, sizeof(map_liquidHeader), 1, mapFile) != 1)
+            mapFile.Seek(fheader.liquidMapOffset);
+            if (!mapFile.Read(lheader))
                 printf("TerrainBuilder::loadMap: Failed to read some data expected 1, read 0\n");
 
             float* liquid_map = nullptr;
 
+            uint32 liquidDataOffset = fheader.liquidMapOffset + MapAlignedSize(sizeof(map_liquidHeader));
             if (!(lheader.flags & MAP_LIQUID_NO_TYPE))
-                if (fread(liquid_type, sizeof(liquid_type), 1, mapFile) != 1)
+            {
+                // liquid entries (uint16[16][16]) precede the liquid type flags
+                liquidDataOffset += MapAlignedSize(sizeof(uint16) * 16 * 16);
+                mapFile.Seek(liquidDataOffset);
+                if (!mapFile.Read(liquid_type))
                     printf("TerrainBuilder::loadMap: Failed to read some data expected 1, read 0\n");
+                liquidDataOffset += MapAlignedSize(sizeof(liquid_type));
+            }
 
             if (!(lheader.flags & MAP_LIQUID_NO_HEIGHT))
             {
                 uint32 toRead = lheader.width * lheader.height;
                 liquid_map = new float [toRead];
-                if (fread(liquid_map, sizeof(float), toRead, mapFile) != toRead)
+                mapFile.Seek(liquidDataOffset);
+                if (!mapFile.Read(liquid_map, sizeof(float) * toRead))
                     printf("TerrainBuilder::loadMap: Failed to read some data expected 1, read 0\n");
             }
 
@@ -353,8 +371,6 @@ namespace MMAP
             }
         }
 
-        fclose(mapFile);
-
         // now that we have gathered the data, we can figure out which parts to keep:
         // liquid above ground, ground above liquid
         int loopStart = 0, loopEnd = 0, loopInc = 0, tTriCount = 4;
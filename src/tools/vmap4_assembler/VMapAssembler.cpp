@@ -15,25 +15,40 @@
  * with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cstdlib>
+#include <cstring>
 #include <string>
 #include <iostream>
+#include <thread>
 
 #include "TileAssembler.h"
 
 int main(int argc, char* argv[])
 {
-    if (argc != 3)
+    if (argc < 3 || argc > 5)
     {
-        std::cout << "usage: " << argv[0] << " <raw data dir> <vmap dest dir>" << std::endl;
+        std::cout << "usage: " << argv[0] << " <raw data dir> <vmap dest dir> [threads, one per core by default] [--compress]" << std::endl;
         return 1;
     }
 
     std::string src = argv[1];
     std::string dest = argv[2];
+    unsigned int threads = std::thread::hardware_concurrency();
+    bool compress = false;
+
+    for (int i = 3; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--compress") == 0)
+            compress = true;
+        else
+            threads = unsigned(atoi(argv[i]));
+    }
 
     std::cout << "using " << src << " as source directory and writing output to " << dest << std::endl;
 
     VMAP::TileAssembler* ta = new VMAP::TileAssembler(src, dest);
+    ta->setThreads(threads);
+    ta->setCompression(compress);
 
     if (!ta->convertWorld2())
     {
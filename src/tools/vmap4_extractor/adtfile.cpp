@@ -78,7 +78,7 @@ ADTFile::ADTFile(char* filename): ADT(filename), nWMO(0), nMDX(0), WmoInstansNam
     Adtfilename.append(filename);
 }
 
-bool ADTFile::init(uint32 map_num, uint32 tileX, uint32 tileY)
+bool ADTFile::init(uint32 map_num, uint32 tileX, uint32 tileY, FILE* dirfile)
 {
     if(ADT.isEof ())
         return false;
@@ -100,15 +100,6 @@ bool ADTFile::init(uint32 map_num, uint32 tileX, uint32 tileY)
     //printf("xMap = %s\n", xMap.c_str());
     //printf("yMap = %s\n", yMap.c_str());
 
-    std::string dirname = std::string(szWorkDirWmo) + "/dir_bin";
-    FILE* dirfile;
-    dirfile = fopen(dirname.c_str(), "ab");
-    if(!dirfile)
-    {
-        printf("Can't open dirfile!'%s'\n", dirname.c_str());
-        return false;
-    }
-
     while (!ADT.isEof())
     {
         char fourcc[5];
@@ -203,7 +194,6 @@ bool ADTFile::init(uint32 map_num, uint32 tileX, uint32 tileY)
         ADT.seek(nextpos);
     }
     ADT.close();
-    fclose(dirfile);
     return true;
 }
 
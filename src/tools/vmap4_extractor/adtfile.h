@@ -119,7 +119,7 @@ public:
     int nMDX;
     string* WmoInstansName;
     string* ModelInstansName;
-    bool init(uint32 map_num, uint32 tileX, uint32 tileY);
+    bool init(uint32 map_num, uint32 tileX, uint32 tileY, FILE* dirfile);
     //void LoadMapChunks();
 
     //uint32 wmo_count;
@@ -22,6 +22,7 @@
 
 #include <algorithm>
 #include <stdio.h>
+#include <vector>
 
 bool ExtractSingleModel(std::string& fname)
 {
@@ -42,14 +43,17 @@ bool ExtractSingleModel(std::string& fname)
     output += "/";
     output += name;
 
-    if (FileExists(output.c_str()))
-        return true;
+    return ExtractModelOnce(output, [&]()
+    {
+        if (FileExists(output.c_str()))
+            return true;
 
-    Model mdl(fname);
-    if (!mdl.open())
-        return false;
+        Model mdl(fname);
+        if (!mdl.open())
+            return false;
 
-    return mdl.ConvertToVMAPModel(output.c_str());
+        return mdl.ConvertToVMAPModel(output.c_str());
+    });
 }
 
 void ExtractGameobjectModels()
@@ -64,7 +68,6 @@ void ExtractGameobjectModels()
 
     std::string basepath = szWorkDirWmo;
     basepath += "/";
-    std::string path;
 
     std::string modelListPath = basepath + "temp_gameobject_models";
     FILE* model_list = fopen(modelListPath.c_str(), "wb");
@@ -74,12 +77,23 @@ void ExtractGameobjectModels()
         return;
     }
 
-    for (DBCFile::Iterator it = dbc.begin(); it != dbc.end(); ++it)
+    struct GameobjectModel
     {
-        path = it->getString(1);
+        uint32 displayId;
+        std::string path;
+        bool extracted;
+    };
+
+    std::vector<GameobjectModel> models;
+    for (DBCFile::Iterator it = dbc.begin(); it != dbc.end(); ++it)
+        models.push_back({ it->getUInt(0), it->getString(1), false });
 
+    // models are extracted in parallel, the list is written in DBC order afterwards
+    ParallelFor(models.size(), [&models](size_t i)
+    {
+        std::string& path = models[i].path;
         if (path.length() < 4)
-            continue;
+            return;
 
         fixnamen((char*)path.c_str(), path.size());
         char* name = GetPlainName((char*)path.c_str());
@@ -87,29 +101,31 @@ void ExtractGameobjectModels()
 
         char* ch_ext = GetExtension(name);
         if (!ch_ext)
-            continue;
+            return;
 
         strToLower(ch_ext);
 
-        bool result = false;
         if (!strcmp(ch_ext, ".wmo"))
-            result = ExtractSingleWmo(path);
+            models[i].extracted = ExtractSingleWmo(path);
         else if (!strcmp(ch_ext, ".mdl"))
         {
             // TODO: extract .mdl files, if needed
-            continue;
+            return;
         }
         else //if (!strcmp(ch_ext, ".mdx") || !strcmp(ch_ext, ".m2"))
-            result = ExtractSingleModel(path);
+            models[i].extracted = ExtractSingleModel(path);
+    });
 
-        if (result)
-        {
-            uint32 displayId = it->getUInt(0);
-            uint32 path_length = strlen(name);
-            fwrite(&displayId, sizeof(uint32), 1, model_list);
-            fwrite(&path_length, sizeof(uint32), 1, model_list);
-            fwrite(name, sizeof(char), path_length, model_list);
-        }
+    for (GameobjectModel const& model : models)
+    {
+        if (!model.extracted)
+            continue;
+
+        char const* name = GetPlainName(model.path.c_str());
+        uint32 path_length = strlen(name);
+        fwrite(&model.displayId, sizeof(uint32), 1, model_list);
+        fwrite(&path_length, sizeof(uint32), 1, model_list);
+        fwrite(name, sizeof(char), path_length, model_list);
     }
 
     fclose(model_list);
@@ -19,7 +19,8 @@
 #include <deque>
 #include <cstdio>
 
-ArchiveSet gOpenArchives;
+// per thread, libmpq archive handles can't be shared between threads
+thread_local ArchiveSet gOpenArchives;
 
 MPQArchive::MPQArchive(const char* filename)
 {
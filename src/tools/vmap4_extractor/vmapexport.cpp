@@ -16,8 +16,15 @@
  */
 
 #define _CRT_SECURE_NO_DEPRECATE
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdio>
 #include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <list>
 #include <errno.h>
@@ -55,7 +62,7 @@
 
 //-----------------------------------------------------------------------------
 
-extern ArchiveSet gOpenArchives;
+extern thread_local ArchiveSet gOpenArchives;
 
 typedef struct
 {
@@ -70,6 +77,21 @@ char output_path[128] = ".";
 char input_path[1024] = ".";
 bool hasInputPathParam = false;
 bool preciseVectorData = false;
+// 0 - one per core
+uint32 threadCount = 0;
+std::vector<std::string> archiveNames;
+
+enum ModelExtractState
+{
+    MODEL_PENDING,
+    MODEL_EXTRACTED,
+    MODEL_FAILED
+};
+
+// models are referenced by many tiles and maps, every one is only extracted once
+std::mutex extractedModelsLock;
+std::condition_variable extractedModelsCondition;
+std::unordered_map<std::string, ModelExtractState> extractedModels;
 
 // Constants
 
@@ -79,6 +101,92 @@ const char* szRawVMAPMagic = "VMAP044";
 
 // Local testing functions
 
+bool OpenArchives()
+{
+    for (size_t i = 0; i < archiveNames.size(); ++i)
+    {
+        MPQArchive* archive = new MPQArchive(archiveNames[i].c_str());
+        if (gOpenArchives.empty() || gOpenArchives.front() != archive)
+            delete archive;
+    }
+
+    return !gOpenArchives.empty();
+}
+
+void CloseArchives()
+{
+    for (MPQArchive* archive : gOpenArchives)
+    {
+        archive->close();
+        delete archive;
+    }
+
+    gOpenArchives.clear();
+}
+
+void ParallelFor(size_t count, std::function<void(size_t)> const& work)
+{
+    size_t threads = std::min<size_t>(threadCount, count);
+    if (threads <= 1)
+    {
+        for (size_t i = 0; i < count; ++i)
+            work(i);
+
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&]()
+        {
+            // archives opened by the main thread are not visible here
+            OpenArchives();
+
+            for (size_t i = next++; i < count; i = next++)
+                work(i);
+
+            CloseArchives();
+        });
+    }
+
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+bool ExtractModelOnce(std::string const& localFile, std::function<bool()> const& extract)
+{
+    {
+        std::unique_lock<std::mutex> lock(extractedModelsLock);
+        auto itr = extractedModels.find(localFile);
+        if (itr != extractedModels.end())
+        {
+            // references stay valid on rehash, iterators don't
+            ModelExtractState& state = itr->second;
+            extractedModelsCondition.wait(lock, [&state]() { return state != MODEL_PENDING; });
+            return state == MODEL_EXTRACTED;
+        }
+
+        extractedModels[localFile] = MODEL_PENDING;
+    }
+
+    bool result = extract();
+
+    {
+        std::lock_guard<std::mutex> lock(extractedModelsLock);
+        extractedModels[localFile] = result ? MODEL_EXTRACTED : MODEL_FAILED;
+    }
+
+    extractedModelsCondition.notify_all();
+    return result;
+}
+
+uint32 GetMSTimeDiffToNow(std::chrono::steady_clock::time_point start)
+{
+    return uint32(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
 bool FileExists(const char* file)
 {
     if (FILE* n = fopen(file, "rb"))
@@ -122,28 +230,39 @@ void ReadLiquidTypeTableDBC()
 
 bool ExtractWmo()
 {
-    bool success = true;
+    std::atomic<bool> success(true);
 
     //const char* ParsArchiveNames[] = {"patch-2.MPQ", "patch.MPQ", "common.MPQ", "expansion.MPQ"};
 
-    for (ArchiveSet::const_iterator ar_itr = gOpenArchives.begin(); ar_itr != gOpenArchives.end() && success; ++ar_itr)
+    // the same wmo is listed by several archives
+    std::vector<std::string> wmoFiles;
+    std::unordered_set<std::string> listedFiles;
+    for (ArchiveSet::const_iterator ar_itr = gOpenArchives.begin(); ar_itr != gOpenArchives.end(); ++ar_itr)
     {
         vector<string> filelist;
 
         (*ar_itr)->GetFileListTo(filelist);
-        for (vector<string>::iterator fname = filelist.begin(); fname != filelist.end() && success; ++fname)
+        for (vector<string>::iterator fname = filelist.begin(); fname != filelist.end(); ++fname)
         {
-            if (fname->find(".wmo") != string::npos)
-                success = ExtractSingleWmo(*fname);
+            if (fname->find(".wmo") != string::npos && listedFiles.insert(*fname).second)
+                wmoFiles.push_back(*fname);
         }
     }
 
+    ParallelFor(wmoFiles.size(), [&](size_t i)
+    {
+        if (success && !ExtractSingleWmo(wmoFiles[i]))
+            success = false;
+    });
+
     if (success)
         printf("\nExtract wmo complete (No (fatal) errors)\n");
 
     return success;
 }
 
+bool ConvertSingleWmo(std::string& fname, char const* szLocalFile, char const* plain_name);
+
 bool ExtractSingleWmo(std::string& fname)
 {
     // Copy files from archive
@@ -153,9 +272,6 @@ bool ExtractSingleWmo(std::string& fname)
     sprintf(szLocalFile, "%s/%s", szWorkDirWmo, plain_name);
     fixnamen(szLocalFile, strlen(szLocalFile));
 
-    if (FileExists(szLocalFile))
-        return true;
-
     int p = 0;
     // Select root wmo files
     char const* rchr = strrchr(plain_name, '_');
@@ -174,6 +290,17 @@ bool ExtractSingleWmo(std::string& fname)
     if (p == 3)
         return true;
 
+    return ExtractModelOnce(szLocalFile, [&]()
+    {
+        return ConvertSingleWmo(fname, szLocalFile, plain_name);
+    });
+}
+
+bool ConvertSingleWmo(std::string& fname, char const* szLocalFile, char const* plain_name)
+{
+    if (FileExists(szLocalFile))
+        return true;
+
     bool file_ok = true;
     std::cout << "Extracting " << fname << std::endl;
     WMORoot froot(fname);
@@ -230,36 +357,80 @@ bool ExtractSingleWmo(std::string& fname)
     return true;
 }
 
-void ParsMapFiles()
+std::string GetMapDirFileName(uint32 mapId)
+{
+    char fileName[512];
+    sprintf(fileName, "%s/dir_bin_%03u", szWorkDirWmo, mapId);
+    return fileName;
+}
+
+void ParsMapFile(uint32 index)
 {
     char fn[512];
     //char id_filename[64];
     char id[10];
-    for (unsigned int i = 0; i < map_count; ++i)
+    sprintf(id, "%03u", map_ids[index].id);
+    sprintf(fn, "World\\Maps\\%s\\%s.wdt", map_ids[index].name, map_ids[index].name);
+    WDTFile WDT(fn, map_ids[index].name);
+
+    // every map gets its own spawn file, ParsMapFiles joins them in map order
+    std::string dirname = GetMapDirFileName(map_ids[index].id);
+    FILE* dirfile = fopen(dirname.c_str(), "wb");
+    if (!dirfile)
     {
-        sprintf(id, "%03u", map_ids[i].id);
-        sprintf(fn, "World\\Maps\\%s\\%s.wdt", map_ids[i].name, map_ids[i].name);
-        WDTFile WDT(fn, map_ids[i].name);
-        if(WDT.init(id, map_ids[i].id))
+        printf("Can't open dirfile!'%s'\n", dirname.c_str());
+        return;
+    }
+
+    if(WDT.init(id, map_ids[index].id, dirfile))
+    {
+        printf("Processing Map %u\n", map_ids[index].id);
+        for (int x = 0; x < 64; ++x)
         {
-            printf("Processing Map %u\n[", map_ids[i].id);
-            for (int x = 0; x < 64; ++x)
+            for (int y = 0; y < 64; ++y)
             {
-                for (int y = 0; y < 64; ++y)
+                if (ADTFile* ADT = WDT.GetMap(x, y))
                 {
-                    if (ADTFile* ADT = WDT.GetMap(x, y))
-                    {
-                        //sprintf(id_filename,"%02u %02u %03u",x,y,map_ids[i].id);//!!!!!!!!!
-                        ADT->init(map_ids[i].id, x, y);
-                        delete ADT;
-                    }
+                    //sprintf(id_filename,"%02u %02u %03u",x,y,map_ids[index].id);//!!!!!!!!!
+                    ADT->init(map_ids[index].id, x, y, dirfile);
+                    delete ADT;
                 }
-                printf("#");
-                fflush(stdout);
             }
-            printf("]\n");
         }
     }
+
+    fclose(dirfile);
+}
+
+void ParsMapFiles()
+{
+    ParallelFor(map_count, [](size_t i) { ParsMapFile(uint32(i)); });
+
+    std::string dirname = std::string(szWorkDirWmo) + "/dir_bin";
+    FILE* dirfile = fopen(dirname.c_str(), "ab");
+    if (!dirfile)
+    {
+        printf("Can't open dirfile!'%s'\n", dirname.c_str());
+        return;
+    }
+
+    char buffer[64 * 1024];
+    for (unsigned int i = 0; i < map_count; ++i)
+    {
+        std::string mapDirname = GetMapDirFileName(map_ids[i].id);
+        if (FILE* mapDirfile = fopen(mapDirname.c_str(), "rb"))
+        {
+            size_t count;
+            while ((count = fread(buffer, 1, sizeof(buffer), mapDirfile)) > 0)
+                fwrite(buffer, 1, count, dirfile);
+
+            fclose(mapDirfile);
+        }
+
+        remove(mapDirname.c_str());
+    }
+
+    fclose(dirfile);
 }
 
 void getGamePath()
@@ -415,6 +586,13 @@ bool processArgv(int argc, char** argv, const char* versionString)
             result = false;
         else if(strcmp("-l", argv[i]) == 0)
             preciseVectorData = true;
+        else if(strcmp("-t", argv[i]) == 0)
+        {
+            if((i + 1) < argc)
+                threadCount = uint32(atoi(argv[++i]));
+            else
+                result = false;
+        }
         else
         {
             result = false;
@@ -424,10 +602,11 @@ bool processArgv(int argc, char** argv, const char* versionString)
     if(!result)
     {
         printf("Extract %s.\n", versionString);
-        printf("%s [-?][-s][-l][-d <path>]\n", argv[0]);
+        printf("%s [-?][-s][-l][-d <path>][-t <threads>]\n", argv[0]);
         printf("   -s : (default) small size (data size optimization), ~500MB less vmap data.\n");
         printf("   -l : large size, ~500MB more vmap data. (might contain more details)\n");
         printf("   -d <path>: Path to the vector data source folder.\n");
+        printf("   -t <threads>: Number of extraction threads, each opens its own MPQ handles. (default 0 - one per core)\n");
         printf("   -? : This message.\n");
     }
     return result;
@@ -476,26 +655,29 @@ int main(int argc, char** argv)
              ))
         success = (errno == EEXIST);
 
+    if (!threadCount)
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+    printf("Using %u threads\n", threadCount);
+
     // prepare archive name list
-    std::vector<std::string> archiveNames;
     fillArchiveNameVector(archiveNames);
-    for (size_t i = 0; i < archiveNames.size(); ++i)
-    {
-        MPQArchive* archive = new MPQArchive(archiveNames[i].c_str());
-        if (gOpenArchives.empty() || gOpenArchives.front() != archive)
-            delete archive;
-    }
-
-    if (gOpenArchives.empty())
+    if (!OpenArchives())
     {
         printf("FATAL ERROR: None MPQ archive found by path '%s'. Use -d option with proper path.\n", input_path);
         return 1;
     }
     ReadLiquidTypeTableDBC();
 
+    uint32 wmoTime = 0, mapTime = 0, gameobjectTime = 0;
+
     // extract data
     if (success)
+    {
+        auto start = std::chrono::steady_clock::now();
         success = ExtractWmo();
+        wmoTime = GetMSTimeDiffToNow(start);
+    }
 
     //xxxxxxxxxxxxxxxxxxxxxxxxxxxxxx
     //map.dbc
@@ -518,13 +700,24 @@ int main(int argc, char** argv)
         }
 
         delete dbc;
+
+        auto start = std::chrono::steady_clock::now();
         ParsMapFiles();
+        mapTime = GetMSTimeDiffToNow(start);
+
         delete [] map_ids;
         //nError = ERROR_SUCCESS;
         // Extract models, listed in DameObjectDisplayInfo.dbc
+        start = std::chrono::steady_clock::now();
         ExtractGameobjectModels();
+        gameobjectTime = GetMSTimeDiffToNow(start);
     }
 
+    printf("\n");
+    printf("Stage timings:\n");
+    printf("   WMO extraction:         %u ms\n", wmoTime);
+    printf("   Map spawns and M2s:     %u ms\n", mapTime);
+    printf("   GameObject models:      %u ms\n", gameobjectTime);
     printf("\n");
     if (!success)
     {
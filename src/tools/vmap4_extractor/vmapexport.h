@@ -18,6 +18,7 @@
 #ifndef VMAPEXPORT_H
 #define VMAPEXPORT_H
 
+#include <functional>
 #include <string>
 
 enum ModelFlags
@@ -33,9 +34,15 @@ extern const char* szRawVMAPMagic;                          // vmap magic string
 bool FileExists(const char* file);
 void strToLower(char* str);
 
+// Runs extract for the first thread asking for localFile, the others wait for it and get the same result
+bool ExtractModelOnce(std::string const& localFile, std::function<bool()> const& extract);
+
 bool ExtractSingleWmo(std::string& fname);
 bool ExtractSingleModel(std::string& fname);
 
 void ExtractGameobjectModels();
 
+// Calls work for every index below count on the extractor threads, each of them with its own MPQ handles
+void ParallelFor(size_t count, std::function<void(size_t)> const& work);
+
 #endif